@@ -1,5 +1,6 @@
 %module cffirmware
 %include <stdint.i>
+%include <pybuffer.i>
 
 // ignore GNU specific compiler attributes
 #define __attribute__(x)
@@ -19,6 +20,8 @@
 #include "num.h"
 #include "controller_mellinger.h"
 #include "power_distribution.h"
+#include "controller.h"
+#include "controller_batch.h"
 %}
 
 %include "math3d.h"
@@ -30,6 +33,21 @@
 %include "imu_types.h"
 %include "controller_mellinger.h"
 %include "power_distribution.h"
+// Only the controller types are used by the bindings, the controller selection is not compiled in
+%ignore controllerInit;
+%ignore controllerTest;
+%ignore controller;
+%ignore getControllerType;
+%ignore controllerGetName;
+%include "controller.h"
+%include "controller_batch.h"
+
+// Arrays of structs for the batch evaluation are passed as buffers, see controller_batch() below
+%pybuffer_binary(const char *setpoints, size_t setpointsSize);
+%pybuffer_binary(const char *sensors, size_t sensorsSize);
+%pybuffer_binary(const char *states, size_t statesSize);
+%pybuffer_mutable_binary(char *controls, size_t controlsSize);
+%pybuffer_mutable_binary(char *motors, size_t motorsSize);
 
 %inline %{
 struct poly4d* piecewise_get(struct piecewise_traj *pp, int i)
@@ -87,10 +105,119 @@ void collisionAvoidanceUpdateSetpointWrap(
     free(workspace);
 }
 
+bool controllerBatchRunBuffers(ControllerType controller, uint32_t vehicles, uint32_t steps, uint32_t tick,
+    const char *setpoints, size_t setpointsSize,
+    const char *sensors, size_t sensorsSize,
+    const char *states, size_t statesSize,
+    char *controls, size_t controlsSize,
+    char *motors, size_t motorsSize)
+{
+    const size_t count = (size_t)vehicles * steps;
+    if (setpointsSize != count * sizeof(setpoint_t) ||
+        sensorsSize != count * sizeof(sensorData_t) ||
+        statesSize != count * sizeof(state_t) ||
+        controlsSize != count * sizeof(control_t) ||
+        motorsSize != count * sizeof(motors_thrust_t)) {
+        return false;
+    }
+
+    return controllerBatchRun(controller, vehicles, steps, tick,
+        (const setpoint_t *)setpoints, (const sensorData_t *)sensors, (const state_t *)states,
+        (control_t *)controls, (motors_thrust_t *)motors);
+}
+
 %}
 
 %pythoncode %{
 import numpy as np
+
+# numpy dtypes with the memory layout of the firmware structs, for controller_batch(). The offsets and sizes are
+# taken from the compiled structs, fields that are not compiled in (accSec and gyroSec in sensorData_t without
+# LOG_SEC_IMU) are left out.
+def _struct_dtype(ctype, fields):
+    names, formats, offsets = [], [], []
+    for name, fmt in fields:
+        offset = controllerBatchOffsetof(ctype, name)
+        if offset < 0:
+            continue
+        fmt = np.dtype(fmt)
+        if fmt.itemsize != controllerBatchFieldSizeof(ctype, name):
+            raise ImportError("the numpy dtype of {}.{} does not match the firmware".format(ctype, name))
+        names.append(name)
+        formats.append(fmt)
+        offsets.append(offset)
+    if len(names) != controllerBatchFieldCount(ctype):
+        raise ImportError("the numpy dtype of {} does not describe all fields of the firmware struct".format(ctype))
+    return np.dtype({"names": names, "formats": formats, "offsets": offsets, "itemsize": controllerBatchSizeof(ctype)})
+
+_vec3_dtype = _struct_dtype("vec3_s", [("timestamp", np.uint32), ("x", np.float32), ("y", np.float32), ("z", np.float32)])
+_attitude_dtype = _struct_dtype("attitude_t", [("timestamp", np.uint32), ("roll", np.float32), ("pitch", np.float32), ("yaw", np.float32)])
+_quaternion_dtype = _struct_dtype("quaternion_t", [("timestamp", np.uint32), ("x", np.float32), ("y", np.float32), ("z", np.float32), ("w", np.float32)])
+_axis3f_dtype = _struct_dtype("Axis3f", [("x", np.float32), ("y", np.float32), ("z", np.float32)])
+_baro_dtype = _struct_dtype("baro_t", [("pressure", np.float32), ("temperature", np.float32), ("asl", np.float32)])
+_mode_dtype = _struct_dtype("setpoint_t.mode", [(axis, np.intc) for axis in ("x", "y", "z", "roll", "pitch", "yaw", "quat")])
+
+setpoint_dtype = _struct_dtype("setpoint_t", [
+    ("timestamp", np.uint32),
+    ("attitude", _attitude_dtype),
+    ("attitudeRate", _attitude_dtype),
+    ("attitudeQuaternion", _quaternion_dtype),
+    ("thrust", np.float32),
+    ("position", _vec3_dtype),
+    ("velocity", _vec3_dtype),
+    ("acceleration", _vec3_dtype),
+    ("velocity_body", np.bool_),
+    ("mode", _mode_dtype),
+])
+
+sensor_data_dtype = _struct_dtype("sensorData_t", [
+    ("acc", _axis3f_dtype),
+    ("gyro", _axis3f_dtype),
+    ("mag", _axis3f_dtype),
+    ("baro", _baro_dtype),
+    ("accSec", _axis3f_dtype),
+    ("gyroSec", _axis3f_dtype),
+    ("interruptTimestamp", np.uint64),
+])
+
+state_dtype = _struct_dtype("state_t", [
+    ("attitude", _attitude_dtype),
+    ("attitudeQuaternion", _quaternion_dtype),
+    ("position", _vec3_dtype),
+    ("velocity", _vec3_dtype),
+    ("acc", _vec3_dtype),
+])
+
+control_dtype = _struct_dtype("control_t", [("roll", np.int16), ("pitch", np.int16), ("yaw", np.int16), ("thrust", np.float32)])
+
+motors_thrust_dtype = _struct_dtype("motors_thrust_t", [("m1", np.uint16), ("m2", np.uint16), ("m3", np.uint16), ("m4", np.uint16)])
+
+
+def controller_batch(controller, setpoints, sensors, states, tick=0):
+    """Run a controller and the power distribution over arrays of time steps in one call.
+
+    setpoints, sensors and states are numpy arrays of setpoint_dtype, sensor_data_dtype and state_dtype, of
+    shape (steps,) for one vehicle or (vehicles, steps). Time step s is evaluated with tick + s and the controller
+    is reset for every vehicle. Returns the control (control_dtype) and motor (motors_thrust_dtype) arrays of the
+    same shape.
+    """
+    setpoints = np.ascontiguousarray(setpoints, dtype=setpoint_dtype)
+    sensors = np.ascontiguousarray(sensors, dtype=sensor_data_dtype)
+    states = np.ascontiguousarray(states, dtype=state_dtype)
+    if setpoints.shape != sensors.shape or setpoints.shape != states.shape:
+        raise ValueError("setpoints, sensors and states must have the same shape")
+    if setpoints.ndim == 1:
+        vehicles, steps = 1, setpoints.shape[0]
+    elif setpoints.ndim == 2:
+        vehicles, steps = setpoints.shape
+    else:
+        raise ValueError("expected arrays of shape (steps,) or (vehicles, steps)")
+
+    controls = np.zeros(setpoints.shape, dtype=control_dtype)
+    motors = np.zeros(setpoints.shape, dtype=motors_thrust_dtype)
+    if not controllerBatchRunBuffers(controller, vehicles, steps, tick, setpoints, sensors, states, controls, motors):
+        raise ValueError("controller not supported, or the buffer sizes do not match the firmware structs")
+    return controls, motors
 %}
 
 #define COPY_CTOR(structname) \
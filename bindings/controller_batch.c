@@ -0,0 +1,234 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2023 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * controller_batch.c - Batch evaluation of the controllers for the python bindings
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "controller_batch.h"
+#include "controller_pid.h"
+#include "controller_mellinger.h"
+#include "power_distribution.h"
+
+typedef struct {
+  void (*init)(void);
+  void (*update)(control_t *control, setpoint_t *setpoint, const sensorData_t *sensors, const state_t *state, const uint32_t tick);
+} batchController_t;
+
+static void initPid(void) {
+  controllerPidInit();
+  controllerPidReset();
+}
+
+static bool getController(ControllerType type, batchController_t *controller) {
+  switch (type) {
+    case ControllerTypePID:
+      controller->init = initPid;
+      controller->update = controllerPid;
+      return true;
+    case ControllerTypeMellinger:
+      controller->init = controllerMellingerInit;
+      controller->update = controllerMellinger;
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool controllerBatchRun(ControllerType type, uint32_t vehicles, uint32_t steps, uint32_t tick,
+  const setpoint_t *setpoints, const sensorData_t *sensors, const state_t *states,
+  control_t *controls, motors_thrust_t *motors) {
+  batchController_t controller;
+  if (!getController(type, &controller)) {
+    return false;
+  }
+
+  powerDistributionInit();
+
+  for (uint32_t v = 0; v < vehicles; v++) {
+    controller.init();
+    control_t control;
+    memset(&control, 0, sizeof(control));
+
+    for (uint32_t s = 0; s < steps; s++) {
+      const uint32_t i = v * steps + s;
+      // The controllers take a mutable setpoint
+      setpoint_t setpoint = setpoints[i];
+      controller.update(&control, &setpoint, &sensors[i], &states[i], tick + s);
+      powerDistribution(&motors[i], &control);
+      controls[i] = control;
+    }
+  }
+
+  return true;
+}
+
+typedef struct {
+  const char *type;
+  uint32_t size;
+} batchType_t;
+
+typedef struct {
+  const char *type;
+  const char *field;
+  uint32_t offset;
+  uint32_t size;
+} batchField_t;
+
+#define MEMBER_SIZE(type, member) sizeof(((type *)0)->member)
+#define BATCH_FIELD(type, member) {#type, #member, offsetof(type, member), MEMBER_SIZE(type, member)}
+#define BATCH_MODE_FIELD(member) {"setpoint_t.mode", #member, offsetof(setpoint_t, mode.member) - offsetof(setpoint_t, mode), \
+  MEMBER_SIZE(setpoint_t, mode.member)}
+
+typedef struct vec3_s vec3_s;
+
+static const batchType_t batchTypes[] = {
+  {"setpoint_t", sizeof(setpoint_t)},
+  {"setpoint_t.mode", MEMBER_SIZE(setpoint_t, mode)},
+  {"sensorData_t", sizeof(sensorData_t)},
+  {"state_t", sizeof(state_t)},
+  {"control_t", sizeof(control_t)},
+  {"motors_thrust_t", sizeof(motors_thrust_t)},
+  {"attitude_t", sizeof(attitude_t)},
+  {"quaternion_t", sizeof(quaternion_t)},
+  {"vec3_s", sizeof(vec3_s)},
+  {"Axis3f", sizeof(Axis3f)},
+  {"baro_t", sizeof(baro_t)},
+};
+
+// The fields that are compiled in, the python bindings check that they describe all of them
+static const batchField_t batchFields[] = {
+  BATCH_FIELD(setpoint_t, timestamp),
+  BATCH_FIELD(setpoint_t, attitude),
+  BATCH_FIELD(setpoint_t, attitudeRate),
+  BATCH_FIELD(setpoint_t, attitudeQuaternion),
+  BATCH_FIELD(setpoint_t, thrust),
+  BATCH_FIELD(setpoint_t, position),
+  BATCH_FIELD(setpoint_t, velocity),
+  BATCH_FIELD(setpoint_t, acceleration),
+  BATCH_FIELD(setpoint_t, velocity_body),
+  BATCH_FIELD(setpoint_t, mode),
+
+  BATCH_MODE_FIELD(x),
+  BATCH_MODE_FIELD(y),
+  BATCH_MODE_FIELD(z),
+  BATCH_MODE_FIELD(roll),
+  BATCH_MODE_FIELD(pitch),
+  BATCH_MODE_FIELD(yaw),
+  BATCH_MODE_FIELD(quat),
+
+  BATCH_FIELD(sensorData_t, acc),
+  BATCH_FIELD(sensorData_t, gyro),
+  BATCH_FIELD(sensorData_t, mag),
+  BATCH_FIELD(sensorData_t, baro),
+#ifdef LOG_SEC_IMU
+  BATCH_FIELD(sensorData_t, accSec),
+  BATCH_FIELD(sensorData_t, gyroSec),
+#endif
+  BATCH_FIELD(sensorData_t, interruptTimestamp),
+
+  BATCH_FIELD(state_t, attitude),
+  BATCH_FIELD(state_t, attitudeQuaternion),
+  BATCH_FIELD(state_t, position),
+  BATCH_FIELD(state_t, velocity),
+  BATCH_FIELD(state_t, acc),
+
+  BATCH_FIELD(control_t, roll),
+  BATCH_FIELD(control_t, pitch),
+  BATCH_FIELD(control_t, yaw),
+  BATCH_FIELD(control_t, thrust),
+
+  BATCH_FIELD(motors_thrust_t, m1),
+  BATCH_FIELD(motors_thrust_t, m2),
+  BATCH_FIELD(motors_thrust_t, m3),
+  BATCH_FIELD(motors_thrust_t, m4),
+
+  BATCH_FIELD(attitude_t, timestamp),
+  BATCH_FIELD(attitude_t, roll),
+  BATCH_FIELD(attitude_t, pitch),
+  BATCH_FIELD(attitude_t, yaw),
+
+  BATCH_FIELD(quaternion_t, timestamp),
+  BATCH_FIELD(quaternion_t, x),
+  BATCH_FIELD(quaternion_t, y),
+  BATCH_FIELD(quaternion_t, z),
+  BATCH_FIELD(quaternion_t, w),
+
+  BATCH_FIELD(vec3_s, timestamp),
+  BATCH_FIELD(vec3_s, x),
+  BATCH_FIELD(vec3_s, y),
+  BATCH_FIELD(vec3_s, z),
+
+  BATCH_FIELD(Axis3f, x),
+  BATCH_FIELD(Axis3f, y),
+  BATCH_FIELD(Axis3f, z),
+
+  BATCH_FIELD(baro_t, pressure),
+  BATCH_FIELD(baro_t, temperature),
+  BATCH_FIELD(baro_t, asl),
+};
+
+#define ARRAY_LENGTH(a) (sizeof(a) / sizeof((a)[0]))
+
+static const batchField_t *findField(const char *type, const char *field) {
+  for (uint32_t i = 0; i < ARRAY_LENGTH(batchFields); i++) {
+    if (strcmp(batchFields[i].type, type) == 0 && strcmp(batchFields[i].field, field) == 0) {
+      return &batchFields[i];
+    }
+  }
+
+  return 0;
+}
+
+uint32_t controllerBatchSizeof(const char *type) {
+  for (uint32_t i = 0; i < ARRAY_LENGTH(batchTypes); i++) {
+    if (strcmp(batchTypes[i].type, type) == 0) {
+      return batchTypes[i].size;
+    }
+  }
+
+  return 0;
+}
+
+uint32_t controllerBatchFieldCount(const char *type) {
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < ARRAY_LENGTH(batchFields); i++) {
+    if (strcmp(batchFields[i].type, type) == 0) {
+      count++;
+    }
+  }
+
+  return count;
+}
+
+int32_t controllerBatchOffsetof(const char *type, const char *field) {
+  const batchField_t *batchField = findField(type, field);
+  return batchField ? (int32_t)batchField->offset : -1;
+}
+
+int32_t controllerBatchFieldSizeof(const char *type, const char *field) {
+  const batchField_t *batchField = findField(type, field);
+  return batchField ? (int32_t)batchField->size : -1;
+}
@@ -0,0 +1,95 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2023 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * controller_batch.h - Batch evaluation of the controllers for the python bindings
+ *
+ * Runs a controller and the power distribution over many time steps of many vehicles in one call, for parameter
+ * sweeps and Monte-Carlo tuning where the per call overhead of python dominates.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "stabilizer_types.h"
+#include "controller.h"
+
+/**
+ * @brief Run a controller and the power distribution for a number of vehicles over a number of time steps
+ *
+ * All arrays hold vehicles * steps items, vehicle major: item (v * steps + s) is time step s of vehicle v. Time
+ * step s is evaluated with tick (tick + s), the controllers run their inner and outer loops at the stabilizer rates
+ * of the ticks. The controllers keep their state in the firmware modules, the controller is initialized and reset at the
+ * start of every vehicle, so the vehicles are independent. The control output is kept between time steps of a vehicle, as
+ * in the stabilizer loop.
+ *
+ * @param controller ControllerTypePID or ControllerTypeMellinger
+ * @param vehicles number of vehicles
+ * @param steps number of time steps per vehicle
+ * @param tick tick of the first time step
+ * @param setpoints setpoint of every time step, not modified
+ * @param sensors sensor data of every time step
+ * @param states state estimate of every time step
+ * @param controls output, control of every time step
+ * @param motors output, motor PWM ratios of every time step
+ * @return false if the controller is not supported
+ */
+bool controllerBatchRun(ControllerType controller, uint32_t vehicles, uint32_t steps, uint32_t tick,
+  const setpoint_t *setpoints, const sensorData_t *sensors, const state_t *states,
+  control_t *controls, motors_thrust_t *motors);
+
+/**
+ * @brief Size of a struct that is passed to controllerBatchRun(), used by the python bindings to build numpy dtypes
+ * with the layout of the structs as compiled
+ *
+ * @param type name of the struct: "setpoint_t", "setpoint_t.mode", "sensorData_t", "state_t", "control_t",
+ * "motors_thrust_t", "attitude_t", "quaternion_t", "vec3_s", "Axis3f" or "baro_t"
+ * @return size in bytes, 0 if the struct is unknown
+ */
+uint32_t controllerBatchSizeof(const char *type);
+
+/**
+ * @brief Number of fields of a struct, see controllerBatchSizeof()
+ *
+ * @param type name of the struct
+ * @return number of fields, 0 if the struct is unknown
+ */
+uint32_t controllerBatchFieldCount(const char *type);
+
+/**
+ * @brief Offset of a field in a struct, see controllerBatchSizeof()
+ *
+ * @param type name of the struct
+ * @param field name of the field
+ * @return offset in bytes, -1 if the field is unknown or not compiled in, for instance accSec in sensorData_t
+ */
+int32_t controllerBatchOffsetof(const char *type, const char *field);
+
+/**
+ * @brief Size of a field in a struct, see controllerBatchSizeof()
+ *
+ * @param type name of the struct
+ * @param field name of the field
+ * @return size in bytes, -1 if the field is unknown or not compiled in
+ */
+int32_t controllerBatchFieldSizeof(const char *type, const char *field);
@@ -12,6 +12,7 @@ include = [
     "build/include/generated",
     "src/config",
     "src/drivers/interface",
+    "bindings",
 ]
 
 fw_sources = [
@@ -27,6 +28,7 @@ fw_sources = [
     "src/utils/src/num.c",
     "src/modules/src/controller_mellinger.c",
     "src/modules/src/power_distribution_quadrotor.c",
+    "bindings/controller_batch.c",
 ]
 
 cffirmware = Extension(
@@ -101,6 +101,7 @@
 #define UART2_TASK_PRI          3
 #define CRTP_SRV_TASK_PRI       0
 #define PLATFORM_SRV_TASK_PRI   0
+#define I2C_ASYNC_TASK_PRI      3
 
 // Not compiled
 #if 0
@@ -153,6 +154,8 @@
 #define CRTP_SRV_TASK_NAME      "CRTP-SRV"
 #define PLATFORM_SRV_TASK_NAME  "PLATFORM-SRV"
 #define PASSTHROUGH_TASK_NAME   "PASSTHROUGH"
+#define I2C_ASYNC_DECK_TASK_NAME    "I2C-DECK"
+#define I2C_ASYNC_SENSORS_TASK_NAME "I2C-SENSORS"
 
 //Task stack sizes
 #define SYSTEM_TASK_STACKSIZE         (2* configMINIMAL_STACK_SIZE)
@@ -188,6 +191,7 @@
 #define CRTP_SRV_TASK_STACKSIZE       configMINIMAL_STACK_SIZE
 #define PLATFORM_SRV_TASK_STACKSIZE   configMINIMAL_STACK_SIZE
 #define PASSTHROUGH_TASK_STACKSIZE    configMINIMAL_STACK_SIZE
+#define I2C_ASYNC_TASK_STACKSIZE      (2 * configMINIMAL_STACK_SIZE)
 
 //The radio channel. From 0 to 125
 #define RADIO_CHANNEL 80
@@ -120,6 +120,10 @@ bool lpsGetLppShort(lpsLppShortPacket_t* shortPacket);
 uint16_t locoDeckGetRangingState();
 void locoDeckSetRangingState(const uint16_t newState);
 
+// Time of the latest interrupt from the DW1000 (us, see usecTimestamp()). Used by the algorithms as the capture time
+// of the measurements from a received packet.
+uint64_t locoDeckGetInterruptTimestamp();
+
 // LPP Packet types and format
 #define LPP_HEADER_SHORT_PACKET 0xF0
 
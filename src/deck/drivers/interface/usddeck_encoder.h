@@ -0,0 +1,135 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2022 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * usddeck_encoder.h - Encoder for blocks of the version 3 uSD log format
+ */
+
+#ifndef __USDDECK_ENCODER_H__
+#define __USDDECK_ENCODER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * In version 3 of the uSD log format, the records of the log are stored in
+ * blocks, each with its own CRC, to make it possible to decode the rest of a
+ * file that contains a corrupt block. A block looks like:
+ *
+ *   uint8_t  marker            USD_ENCODER_BLOCK_MARKER
+ *   uint16_t numRecords
+ *   uint16_t payloadLength     length of the records
+ *   uint64_t baseTimestamp     time of the first record [us]
+ *   records
+ *   uint32_t crc               CRC32 of the block from marker to the last record
+ *
+ * and a record:
+ *
+ *   uint8_t  eventIndex        index of the event in the file header
+ *   varint   timestampDelta    zigzag encoded time since the previous record
+ *                              in the block [us], records from different
+ *                              tasks are not strictly ordered
+ *   payload                    event trigger payload, raw
+ *   raw variables              the variables that are not delta encoded, raw
+ *   delta variables            for each delta encoded variable a zigzag varint
+ *                              of the difference to the value in the previous
+ *                              record of the same event in the block
+ *
+ * All values are little endian and varints use 7 bits per byte, least
+ * significant group first, with the top bit set on all but the last byte.
+ * Delta encoded values start at 0 in each block. The raw fields come before
+ * the varints to keep them at a fixed offset from the timestamp.
+ */
+
+#define USD_ENCODER_BLOCK_MARKER          (0xB3)
+#define USD_ENCODER_BLOCK_HEADER_SIZE     (13)
+#define USD_ENCODER_BLOCK_CRC_SIZE        (4)
+#define USD_ENCODER_MAX_VARIABLES         (20)
+
+typedef struct {
+  uint8_t payloadSize;
+  uint8_t numVariables;
+  // Log type (LOG_UINT8 ... LOG_FLOAT) of each variable
+  uint8_t variableTypes[USD_ENCODER_MAX_VARIABLES];
+  // Bit mask of the variables that are delta encoded, only for integer types
+  uint32_t deltaVariables;
+  // Values in the previous record of the block
+  uint32_t previousValues[USD_ENCODER_MAX_VARIABLES];
+} usdEncoderEvent_t;
+
+typedef struct {
+  uint8_t* buffer;
+  uint16_t capacity;
+  uint16_t length;
+  uint16_t numRecords;
+  uint64_t baseTimestamp;
+  uint64_t previousTimestamp;
+
+  usdEncoderEvent_t* events;
+  uint8_t numEvents;
+} usdEncoderBlock_t;
+
+/**
+ * @brief Initialize a block encoder
+ *
+ * @param block The block encoder
+ * @param buffer Buffer for the encoded block, including header and CRC
+ * @param capacity Size of the buffer
+ * @param events The events that records are appended for, indexed by the event index
+ * @param numEvents Number of events
+ */
+void usdEncoderInit(usdEncoderBlock_t* block, uint8_t* buffer, uint16_t capacity, usdEncoderEvent_t* events, uint8_t numEvents);
+
+/**
+ * @brief Get the size of the variables of an event in a raw record
+ */
+uint16_t usdEncoderRawVariablesSize(const usdEncoderEvent_t* event);
+
+/**
+ * @brief Append a record to the block
+ *
+ * @param block The block encoder
+ * @param eventIndex Index of the event of the record
+ * @param timestamp Time of the record [us]
+ * @param payload The event trigger payload, payloadSize bytes
+ * @param variables The raw values of the variables, packed
+ * @return true if the record was appended, false if the block is full
+ */
+bool usdEncoderAppend(usdEncoderBlock_t* block, uint8_t eventIndex, uint64_t timestamp, const uint8_t* payload, const uint8_t* variables);
+
+/**
+ * @brief Check if there are records in the block
+ */
+static inline bool usdEncoderIsEmpty(const usdEncoderBlock_t* block) {
+  return block->numRecords == 0;
+}
+
+/**
+ * @brief Complete the block with header and CRC. The block is restarted
+ * when the next record is appended.
+ *
+ * @param block The block encoder
+ * @return the length of the completed block in the buffer
+ */
+uint16_t usdEncoderFinish(usdEncoderBlock_t* block);
+
+#endif //__USDDECK_ENCODER_H__
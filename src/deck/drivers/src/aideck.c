@@ -59,6 +59,7 @@
 #include "cpx_internal_router.h"
 #include "cpx_external_router.h"
 #include "cpx_uart_transport.h"
+#include "cpx_packet_pool.h"
 #include "cpx.h"
 
 #include "aideck.h"
@@ -303,6 +304,7 @@ static void aideckInit(DeckInfo *info)
   pinMode(DECK_GPIO_IO4, OUTPUT);
   digitalWrite(DECK_GPIO_IO4, LOW);
 
+  cpxPacketPoolInit();
   cpxUARTTransportInit();
   cpxInternalRouterInit();
   cpxExternalRouterInit();
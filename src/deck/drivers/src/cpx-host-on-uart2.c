@@ -37,6 +37,7 @@
 #include "cpx_internal_router.h"
 #include "cpx_external_router.h"
 #include "cpx_uart_transport.h"
+#include "cpx_packet_pool.h"
 #include "cpx.h"
 
 static bool isInit = false;
@@ -46,6 +47,7 @@ static void cpxOverUart2Init(DeckInfo *info)
   if (isInit)
     return;
 
+  cpxPacketPoolInit();
   cpxUARTTransportInit();
   cpxInternalRouterInit();
   cpxExternalRouterInit();
@@ -89,6 +89,8 @@ static void flowdeckTask(void *param)
   while(1) {
     vTaskDelay(10);
 
+    // The motion counters are latched by the read
+    const uint64_t readTime = usecTimestamp();
     pmw3901ReadMotion(NCS_PIN, &currentMotion);
 
     // Flip motion information to comply with sensor mounting
@@ -151,9 +153,11 @@ static void flowdeckTask(void *param)
       // Push measurements into the estimator if flow is not disabled
       //    and the PMW flow sensor indicates motion detection
       if (!useFlowDisabled && currentMotion.motion == 0xB0) {
-        flowData.dt = (float)(usecTimestamp()-lastTime)/1000000.0f;
-        lastTime = usecTimestamp();
-        estimatorEnqueueFlow(&flowData);
+        flowData.dt = (float)(readTime - lastTime)/1000000.0f;
+        // The flow is the mean over dt, which is the flow in the middle of the interval
+        const uint64_t captureTime = readTime - (readTime - lastTime) / 2;
+        lastTime = readTime;
+        estimatorEnqueueFlowAt(&flowData, captureTime);
       }
     } else {
       outlierCount++;
@@ -53,6 +53,7 @@
 #include "mem.h"
 
 #include "locodeck.h"
+#include "usec_time.h"
 
 #include "lpsTdoa2Tag.h"
 #include "lpsTdoa3Tag.h"
@@ -127,6 +128,7 @@ static uwbAlgorithm_t *algorithm = &uwbTwrTagAlgorithm;
 
 static bool isInit = false;
 static TaskHandle_t uwbTaskHandle = 0;
+static volatile uint64_t interruptTimestamp;
 static SemaphoreHandle_t algoSemaphore;
 static dwDevice_t dwm_device;
 static dwDevice_t *dwm = &dwm_device;
@@ -433,6 +435,8 @@ static void spiRead(dwDevice_t* dev, const void *header, size_t headerLength,
   {
     portBASE_TYPE  xHigherPriorityTaskWoken = pdFALSE;
 
+    interruptTimestamp = usecTimestamp();
+
     // Unlock interrupt handling task
     vTaskNotifyGiveFromISR(uwbTaskHandle, &xHigherPriorityTaskWoken);
 
@@ -554,6 +558,10 @@ void locoDeckSetRangingState(const uint16_t newState) {
   algoOptions.rangingState = newState;
 }
 
+uint64_t locoDeckGetInterruptTimestamp() {
+  return interruptTimestamp;
+}
+
 
 static bool dwm1000Test()
 {
@@ -281,14 +281,16 @@ static void sendTdoaToEstimatorCallback(tdoaMeasurement_t* tdoaMeasurement) {
   // Override the default standard deviation set by the TDoA engine.
   tdoaMeasurement->stdDev = stdDev;
 
-  estimatorEnqueueTDOA(tdoaMeasurement);
+  // The measurement is completed by the packet that was just received
+  const uint64_t timestamp = locoDeckGetInterruptTimestamp();
+  estimatorEnqueueTDOAAt(tdoaMeasurement, timestamp);
 
   #ifdef CONFIG_DECK_LOCO_2D_POSITION
   heightMeasurement_t heightData;
   heightData.timestamp = xTaskGetTickCount();
   heightData.height = DECK_LOCO_2D_POSITION_HEIGHT;
   heightData.stdDev = 0.0001;
-  estimatorEnqueueAbsoluteHeight(&heightData);
+  estimatorEnqueueAbsoluteHeightAt(&heightData, timestamp);
   #endif
 
   const uint8_t idA = tdoaMeasurement->anchorIds[0];
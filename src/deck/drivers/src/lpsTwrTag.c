@@ -258,7 +258,8 @@ static uint32_t rxcallback(dwDevice_t *dev) {
         dist.z = options->anchorPosition[current_anchor].z;
         dist.anchorId = current_anchor;
         dist.stdDev = 0.25;
-        estimatorEnqueueDistance(&dist);
+        // The ranging is completed by the report packet that was just received
+        estimatorEnqueueDistanceAt(&dist, locoDeckGetInterruptTimestamp());
       }
 
       if (options->useTdma && current_anchor == 0) {
@@ -49,6 +49,7 @@
 
 #include "deck.h"
 #include "usddeck.h"
+#include "usddeck_encoder.h"
 #include "system.h"
 #include "sensors.h"
 #include "debug.h"
@@ -90,11 +91,27 @@
 #define SPI_END_TRANSACTION     spiEndTransaction
 #endif
 
-#define MAX_USD_LOG_VARIABLES_PER_EVENT   (20)
+#define MAX_USD_LOG_VARIABLES_PER_EVENT   (USD_ENCODER_MAX_VARIABLES)
 #define MAX_USD_LOG_EVENTS                (20)
 #define FIXED_FREQUENCY_EVENT_ID          (0xFFFF)
 #define FIXED_FREQUENCY_EVENT_NAME        "fixedFrequency"
 
+// Data is written to the card in blocks of whole sectors. As the file starts
+// at a sector boundary, FatFS hands each block directly to the SD driver as a
+// single multi sector write (pre-erased with ACMD23) without going through the
+// sector cache.
+#define USD_SECTOR_SIZE                   (512)
+#define USD_WRITE_BLOCK_SECTORS           (4)
+#define USD_WRITE_BLOCK_SIZE              (USD_SECTOR_SIZE * USD_WRITE_BLOCK_SECTORS)
+
+#define USD_LOG_FORMAT_VERSION            (3)
+// Raw records in the log buffer are: event index (uint8), time stamp (uint64), payload, variables
+#define USD_RAW_RECORD_HEADER_SIZE        (1 + 8)
+// Must fit the largest raw record
+#define USD_RAW_RECORDS_BUFFER_SIZE       (512)
+#define USD_ENCODER_BUFFER_SIZE           (1024)
+#define USD_DELTA_SUFFIX                  ":delta"
+
 
 /* set to true when graceful shutdown is triggered */
 static volatile bool in_shutdown = false;
@@ -104,6 +121,8 @@ typedef struct usdLogEventConfig_s {
   uint8_t numVars;
   uint16_t numBytes;
   logVarId_t varIds[MAX_USD_LOG_VARIABLES_PER_EVENT];
+  // Bit mask of the variables that are delta encoded
+  uint32_t deltaVars;
 } usdLogEventConfig_t;
 
 typedef struct usdLogConfig_s {
@@ -123,6 +142,14 @@ typedef struct usdLogStats_s {
   uint32_t eventsWritten;
 } usdLogStats_t;
 
+typedef struct usdWriteStats_s {
+  uint64_t startTime;       // time when the file was opened [us]
+  uint32_t bytesWritten;    // bytes written to the file
+  uint32_t throughput;      // average write throughput since the file was opened [bytes/s]
+  uint32_t maxLatency;      // longest time to write one block [us]
+  uint32_t recordsDropped;  // records that did not fit an empty block
+} usdWriteStats_t;
+
 // Ring buffer
 typedef struct ringBuffer_s {
   uint8_t* buffer;        // pointer to buffer
@@ -130,7 +157,6 @@ typedef struct ringBuffer_s {
   uint16_t size;          // used size of buffer
   uint8_t* readPtr;       // pointer for read/pop
   uint8_t* writePtr;      // pointer for write/push
-  uint16_t popSize;       // size for ongoing pop operation
 } ringBuffer_t;
 
 void ringBuffer_init(ringBuffer_t* b, uint8_t *buffer, uint16_t capacity)
@@ -140,7 +166,6 @@ void ringBuffer_init(ringBuffer_t* b, uint8_t *buffer, uint16_t capacity)
   b->size = 0;
   b->readPtr = buffer;
   b->writePtr = buffer;
-  b->popSize = 0;
 }
 
 void ringBuffer_reset(ringBuffer_t *b)
@@ -148,7 +173,6 @@ void ringBuffer_reset(ringBuffer_t *b)
   b->size = 0;
   b->readPtr = b->buffer;
   b->writePtr = b->buffer;
-  b->popSize = 0;
 }
 
 uint16_t ringBuffer_availableSpace(const ringBuffer_t* b)
@@ -173,30 +197,28 @@ bool ringBuffer_push(ringBuffer_t* b, const void* data, uint16_t size)
   return true;
 }
 
-bool ringBuffer_pop_start(ringBuffer_t* b, const uint8_t** buf, uint16_t* size)
+// Pops up to maxSize bytes from the buffer into dst, returns the number of bytes popped
+uint16_t ringBuffer_pop(ringBuffer_t* b, uint8_t* dst, uint16_t maxSize)
 {
-  if (b->size == 0) {
-    return false;
-  }
-
-  *buf = b->readPtr;
-  if (b->writePtr > b->readPtr) {
-    // writer did not wrap around yet
-    *size = b->writePtr - b->readPtr;
-    b->readPtr = b->writePtr;
-  } else {
-    // wrap around -> read until end of buffer, only
-    *size = b->buffer + b->capacity - b->readPtr;
-    b->readPtr = b->buffer;
+  uint16_t size = 0;
+  while (size < maxSize && b->size > 0) {
+    // read until end of buffer, at most
+    uint16_t chunk = b->buffer + b->capacity - b->readPtr;
+    if (chunk > b->size) {
+      chunk = b->size;
+    }
+    if (chunk > maxSize - size) {
+      chunk = maxSize - size;
+    }
+    memcpy(&dst[size], b->readPtr, chunk);
+    b->readPtr += chunk;
+    if (b->readPtr == b->buffer + b->capacity) {
+      b->readPtr = b->buffer;
+    }
+    b->size -= chunk;
+    size += chunk;
   }
-  b->popSize = *size;
-  return true;
-}
-
-void ringBuffer_pop_done(ringBuffer_t *b)
-{
-  b->size -= b->popSize;
-  b->popSize = 0;
+  return size;
 }
 
 // FATFS low lever driver functions.
@@ -219,6 +241,7 @@ static STATS_CNT_RATE_DEFINE(fatWriteRate, 1000);
 
 static usdLogConfig_t usdLogConfig;
 static usdLogStats_t usdLogStats;
+static usdWriteStats_t usdWriteStats;
 
 static BYTE exchangeBuff[512];
 static uint16_t spiSpeed;
@@ -235,8 +258,22 @@ static SemaphoreHandle_t logFileMutex;
 
 static SemaphoreHandle_t logBufferMutex;
 static ringBuffer_t logBuffer;
+// Amount of buffered data that wakes up the writer task
+static uint16_t logBufferWriteThreshold;
 static TaskHandle_t xHandleWriteTask;
 
+// Block under construction by the writer task. The log buffer is filled by the
+// event producers while the write block is written to the card.
+static uint8_t writeBlock[USD_WRITE_BLOCK_SIZE] __attribute__((aligned(4)));
+static uint16_t writeBlockSize;
+
+// Raw records taken from the log buffer by the writer task, waiting to be encoded
+NO_DMA_CCM_SAFE_ZERO_INIT static uint8_t rawRecords[USD_RAW_RECORDS_BUFFER_SIZE];
+static uint16_t rawRecordsSize;
+NO_DMA_CCM_SAFE_ZERO_INIT static usdEncoderEvent_t encoderEvents[MAX_USD_LOG_EVENTS];
+NO_DMA_CCM_SAFE_ZERO_INIT static uint8_t encoderBuffer[USD_ENCODER_BUFFER_SIZE];
+static usdEncoderBlock_t encoder;
+
 static bool enableLogging;
 static uint32_t lastFileSize = 0;
 static crc32Context_t crcContext;
@@ -486,18 +523,18 @@ static void usddeckWriteEventData(const usdLogEventConfig_t* cfg, const uint8_t*
 
   xSemaphoreTake(logBufferMutex, portMAX_DELAY);
 
-  // trigger writing once there is some data
-  if (logBuffer.size > 0 && xHandleWriteTask) {
+  // trigger writing once there is enough data to fill a write block
+  if (logBuffer.size >= logBufferWriteThreshold && xHandleWriteTask) {
     vTaskResume(xHandleWriteTask);
   }
 
-  int dataSize = sizeof(cfg->eventId) + sizeof(ticks) + payloadSize + cfg->numBytes;
+  int dataSize = USD_RAW_RECORD_HEADER_SIZE + payloadSize + cfg->numBytes;
 
   // only write if we have enough space
   if (ringBuffer_availableSpace(&logBuffer) >= dataSize) {
     /* write data into buffer */
-    uint16_t event_id = cfg->eventId;
-    ringBuffer_push(&logBuffer, &event_id, sizeof(event_id));
+    uint8_t eventIndex = cfg - usdLogConfig.eventConfigs;
+    ringBuffer_push(&logBuffer, &eventIndex, sizeof(eventIndex));
     ringBuffer_push(&logBuffer, &ticks, sizeof(ticks));
     if (payloadSize) {
       ringBuffer_push(&logBuffer, payload, payloadSize);
@@ -634,10 +671,18 @@ static void usdLogTask(void* prm)
           // Add log variables
           cfg->numVars = 0;
           cfg->numBytes = 0;
+          cfg->deltaVars = 0;
           while (true) {
             line = f_gets_without_comments(readBuffer, sizeof(readBuffer), &logFile);
             if (!line || strncmp(line, "on:", 3) == 0)
               break;
+            // variables can be delta encoded by adding the suffix ":delta"
+            bool isDelta = false;
+            char *suffix = strchr(line, ':');
+            if (suffix) {
+              isDelta = (strcmp(suffix, USD_DELTA_SUFFIX) == 0);
+              *suffix = 0;
+            }
             char *group = line;
             char *name = 0;
             for (int i = 0; i < strlen(line); ++i) {
@@ -653,7 +698,14 @@ static void usdLogTask(void* prm)
               DEBUG_PRINT("Unknown log variable %s.%s\n", group, name);
               continue;
             }
+            if (isDelta && logGetType(varid) == LOG_FLOAT) {
+              DEBUG_PRINT("Can not delta encode float %s.%s\n", group, name);
+              isDelta = false;
+            }
             if (cfg->numVars < MAX_USD_LOG_VARIABLES_PER_EVENT) {
+              if (isDelta) {
+                cfg->deltaVars |= (1 << cfg->numVars);
+              }
               cfg->varIds[cfg->numVars] = varid;
               ++cfg->numVars;
               cfg->numBytes += logVarSize(logGetType(varid));
@@ -702,6 +754,10 @@ static void usdLogTask(void* prm)
       break;
     }
     ringBuffer_init(&logBuffer, logBufferData, usdLogConfig.bufferSize);
+    logBufferWriteThreshold = usdLogConfig.bufferSize / 2;
+    if (logBufferWriteThreshold > USD_WRITE_BLOCK_SIZE) {
+      logBufferWriteThreshold = USD_WRITE_BLOCK_SIZE;
+    }
 
     /* create queue to hand over pointer to usdLogData */
     // usdLogQueue = xQueueCreate(usdLogConfig.queueSize, sizeof(uint8_t*));
@@ -799,13 +855,111 @@ static bool handleMemRead(const uint32_t memAddr, const uint8_t readLen, uint8_t
   return result;
 }
 
-static void usdWriteData(const void *data, size_t size)
+// Writes the write block to the file
+static void usdFlushWriteBlock(void)
 {
+  if (writeBlockSize == 0) {
+    return;
+  }
+
+  const uint64_t start = usecTimestamp();
+
   UINT bytesWritten;
-  FRESULT status = f_write(&logFile, data, size, &bytesWritten);
+  FRESULT status = f_write(&logFile, writeBlock, writeBlockSize, &bytesWritten);
   ASSERT(status == FR_OK);
-  crc32Update(&crcContext, data, size);
+  crc32Update(&crcContext, writeBlock, writeBlockSize);
   STATS_CNT_RATE_MULTI_EVENT(&fatWriteRate, bytesWritten);
+  writeBlockSize = 0;
+
+  const uint64_t now = usecTimestamp();
+  const uint32_t latency = now - start;
+  if (latency > usdWriteStats.maxLatency) {
+    usdWriteStats.maxLatency = latency;
+  }
+  usdWriteStats.bytesWritten += bytesWritten;
+  if (now > usdWriteStats.startTime) {
+    usdWriteStats.throughput = (uint64_t)usdWriteStats.bytesWritten * 1000000 / (now - usdWriteStats.startTime);
+  }
+}
+
+// Appends data to the write block, the block is written to the file when full
+static void usdWriteData(const void *data, size_t size)
+{
+  const uint8_t* dataTyped = (const uint8_t*)data;
+  while (size > 0) {
+    size_t chunk = USD_WRITE_BLOCK_SIZE - writeBlockSize;
+    if (chunk > size) {
+      chunk = size;
+    }
+    memcpy(&writeBlock[writeBlockSize], dataTyped, chunk);
+    writeBlockSize += chunk;
+    dataTyped += chunk;
+    size -= chunk;
+
+    if (writeBlockSize == USD_WRITE_BLOCK_SIZE) {
+      usdFlushWriteBlock();
+    }
+  }
+}
+
+// Writes the encoded block to the file
+static void usdWriteEncodedBlock(void)
+{
+  const uint16_t length = usdEncoderFinish(&encoder);
+  usdWriteData(encoderBuffer, length);
+}
+
+// Encodes whole raw records, returns the number of bytes used
+static uint16_t usdEncodeRecords(const uint8_t* data, uint16_t size)
+{
+  uint16_t used = 0;
+  while (used + USD_RAW_RECORD_HEADER_SIZE <= size) {
+    const uint8_t eventIndex = data[used];
+    ASSERT(eventIndex < usdLogConfig.numEventConfigs);
+    const usdEncoderEvent_t* event = &encoderEvents[eventIndex];
+    const uint16_t recordSize = USD_RAW_RECORD_HEADER_SIZE + event->payloadSize + usdEncoderRawVariablesSize(event);
+    if (used + recordSize > size) {
+      break;
+    }
+
+    uint64_t timestamp;
+    memcpy(&timestamp, &data[used + 1], sizeof(timestamp));
+    const uint8_t* payload = &data[used + USD_RAW_RECORD_HEADER_SIZE];
+    const uint8_t* variables = payload + event->payloadSize;
+    bool isAppended = usdEncoderAppend(&encoder, eventIndex, timestamp, payload, variables);
+    if (!isAppended && !usdEncoderIsEmpty(&encoder)) {
+      // The block is full, retry in a new block
+      usdWriteEncodedBlock();
+      isAppended = usdEncoderAppend(&encoder, eventIndex, timestamp, payload, variables);
+    }
+    if (!isAppended) {
+      // Does not fit an empty block
+      usdWriteStats.recordsDropped++;
+    }
+    used += recordSize;
+  }
+  return used;
+}
+
+// Encodes the records in the log buffer, the mutex is only held while
+// copying. Full blocks are written to the file.
+static void usdWriteBufferedData(void)
+{
+  while (true) {
+    xSemaphoreTake(logBufferMutex, portMAX_DELAY);
+    const uint16_t size = ringBuffer_pop(&logBuffer, &rawRecords[rawRecordsSize], sizeof(rawRecords) - rawRecordsSize);
+    xSemaphoreGive(logBufferMutex);
+    rawRecordsSize += size;
+
+    // keep a partial record until the rest has been popped
+    const uint16_t used = usdEncodeRecords(rawRecords, rawRecordsSize);
+    memmove(rawRecords, &rawRecords[used], rawRecordsSize - used);
+    rawRecordsSize -= used;
+
+    if (size == 0) {
+      break;
+    }
+  }
 }
 
 static void usdWriteTask(void* prm)
@@ -823,6 +977,7 @@ static void usdWriteTask(void* prm)
       // reset stats
       usdLogStats.eventsRequested = 0;
       usdLogStats.eventsWritten = 0;
+      memset(&usdWriteStats, 0, sizeof(usdWriteStats));
 
       // reset the buffer
       xSemaphoreTake(logBufferMutex, portMAX_DELAY);
@@ -859,14 +1014,37 @@ static void usdWriteTask(void* prm)
 
         DEBUG_PRINT("Logging to: %s\n", usdLogConfig.filename);
 
-        // iniatialize crc
+#if CONFIG_DECK_USD_PREALLOCATE_KB > 0
+        // Allocate a contiguous cluster chain up front to avoid updating the FAT while logging.
+        // If there is no contiguous space, clusters are allocated as the file grows.
+        if (f_expand(&logFile, (FSIZE_t)CONFIG_DECK_USD_PREALLOCATE_KB * 1024, 1) != FR_OK) {
+          DEBUG_PRINT("Failed to preallocate %d kB\n", CONFIG_DECK_USD_PREALLOCATE_KB);
+        }
+#endif
+
+        // iniatialize crc, write block and encoder
         crc32ContextInit(&crcContext);
+        writeBlockSize = 0;
+        rawRecordsSize = 0;
+        for (int i = 0; i < usdLogConfig.numEventConfigs; ++i) {
+          usdLogEventConfig_t* cfg = &usdLogConfig.eventConfigs[i];
+          const eventtrigger *et = eventtriggerGetById(cfg->eventId);
+          usdEncoderEvent_t* event = &encoderEvents[i];
+          event->payloadSize = et ? et->payloadSize : 0;
+          event->numVariables = cfg->numVars;
+          event->deltaVariables = cfg->deltaVars;
+          for (int j = 0; j < cfg->numVars; ++j) {
+            event->variableTypes[j] = logGetType(cfg->varIds[j]);
+          }
+        }
+        usdEncoderInit(&encoder, encoderBuffer, sizeof(encoderBuffer), encoderEvents, usdLogConfig.numEventConfigs);
+        usdWriteStats.startTime = usecTimestamp();
 
         // write header
         uint8_t magic = 0xBC;
         usdWriteData(&magic, sizeof(magic));
 
-        uint16_t version = 2;
+        uint16_t version = USD_LOG_FORMAT_VERSION;
         usdWriteData(&version, sizeof(version));
 
         uint16_t numEventTypes = usdLogConfig.numEventConfigs;
@@ -960,7 +1138,11 @@ static void usdWriteTask(void* prm)
               ASSERT(false);
             }
             usdWriteData(&typeChar, 1);
-            usdWriteData(")", 2);
+            if (cfg->deltaVars & (1 << j)) {
+              usdWriteData(",delta)", 8);
+            } else {
+              usdWriteData(")", 2);
+            }
           }
         }
 
@@ -968,40 +1150,20 @@ static void usdWriteTask(void* prm)
           /* sleep */
           vTaskSuspend(NULL);
 
-          // check if we have anything to write
-          xSemaphoreTake(logBufferMutex, portMAX_DELAY);
-          const uint8_t* buf;
-          uint16_t size;
-          bool hasData = ringBuffer_pop_start(&logBuffer, &buf, &size);
-          xSemaphoreGive(logBufferMutex);
-
-          // execute the actual write operation
-          if (hasData) {
-            usdWriteData(buf, size);
-
-            xSemaphoreTake(logBufferMutex, portMAX_DELAY);
-            ringBuffer_pop_done(&logBuffer);
-            xSemaphoreGive(logBufferMutex);
-          }
+          usdWriteBufferedData();
         }
         // write everything that's still in the buffer
-        xSemaphoreTake(logBufferMutex, portMAX_DELAY);
-        while (true) {
-          const uint8_t *buf;
-          uint16_t size;
-          bool hasData = ringBuffer_pop_start(&logBuffer, &buf, &size);
-          if (hasData) {
-            usdWriteData(buf, size);
-            ringBuffer_pop_done(&logBuffer);
-          } else {
-            break;
-          }
-        }
-        xSemaphoreGive(logBufferMutex);
+        usdWriteBufferedData();
+        usdWriteEncodedBlock();
 
         // write CRC
+        usdFlushWriteBlock();
         uint32_t crcValue = crc32Out(&crcContext);
         usdWriteData(&crcValue, sizeof(crcValue));
+        usdFlushWriteBlock();
+
+        // release the part of the preallocated area that was not used
+        f_truncate(&logFile);
 
         // close file
         f_close(&logFile);
@@ -1115,4 +1277,16 @@ STATS_CNT_RATE_LOG_ADD(spiReBps, &spiReadRate)
  * @brief Data write rate to the SD card [bytes/s]
  */
 STATS_CNT_RATE_LOG_ADD(fatWrBps, &fatWriteRate)
+/**
+ * @brief Average data write rate to the SD card since logging started [bytes/s]
+ */
+LOG_ADD(LOG_UINT32, fatWrAvgBps, &usdWriteStats.throughput)
+/**
+ * @brief Longest time to write one block to the SD card since logging started [us]
+ */
+LOG_ADD(LOG_UINT32, fatWrMaxUs, &usdWriteStats.maxLatency)
+/**
+ * @brief Number of records dropped since logging started, since they did not fit an empty block
+ */
+LOG_ADD(LOG_UINT32, recDropped, &usdWriteStats.recordsDropped)
 LOG_GROUP_STOP(usd)
@@ -0,0 +1,177 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2022 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * usddeck_encoder.c - Encoder for blocks of the version 3 uSD log format
+ */
+
+#include <string.h>
+
+#include "usddeck_encoder.h"
+#include "log.h"
+#include "crc32.h"
+
+#define MAX_VARINT_SIZE_32 (5)
+#define MAX_VARINT_SIZE_64 (10)
+
+static uint8_t variableSize(const uint8_t type) {
+  switch (type) {
+    case LOG_UINT8:
+    case LOG_INT8:
+      return 1;
+    case LOG_UINT16:
+    case LOG_INT16:
+      return 2;
+    default:
+      return 4;
+  }
+}
+
+// Reads a raw value, signed types are sign extended to make small negative differences small
+static uint32_t readValue(const uint8_t* data, const uint8_t type) {
+  switch (type) {
+    case LOG_UINT8: { uint8_t v; memcpy(&v, data, sizeof(v)); return v; }
+    case LOG_INT8: { int8_t v; memcpy(&v, data, sizeof(v)); return (int32_t)v; }
+    case LOG_UINT16: { uint16_t v; memcpy(&v, data, sizeof(v)); return v; }
+    case LOG_INT16: { int16_t v; memcpy(&v, data, sizeof(v)); return (int32_t)v; }
+    default: { uint32_t v; memcpy(&v, data, sizeof(v)); return v; }
+  }
+}
+
+static uint16_t writeVarint(uint8_t* buffer, uint64_t value) {
+  uint16_t length = 0;
+  while (value >= 0x80) {
+    buffer[length++] = (value & 0x7f) | 0x80;
+    value >>= 7;
+  }
+  buffer[length++] = value;
+  return length;
+}
+
+static uint16_t maxRecordSize(const usdEncoderEvent_t* event) {
+  uint16_t size = 1 + MAX_VARINT_SIZE_64 + event->payloadSize;
+  for (int i = 0; i < event->numVariables; i++) {
+    if (event->deltaVariables & (1 << i)) {
+      size += MAX_VARINT_SIZE_32;
+    } else {
+      size += variableSize(event->variableTypes[i]);
+    }
+  }
+  return size;
+}
+
+void usdEncoderInit(usdEncoderBlock_t* block, uint8_t* buffer, uint16_t capacity, usdEncoderEvent_t* events, uint8_t numEvents) {
+  memset(block, 0, sizeof(usdEncoderBlock_t));
+  block->buffer = buffer;
+  block->capacity = capacity;
+  block->events = events;
+  block->numEvents = numEvents;
+}
+
+uint16_t usdEncoderRawVariablesSize(const usdEncoderEvent_t* event) {
+  uint16_t size = 0;
+  for (int i = 0; i < event->numVariables; i++) {
+    size += variableSize(event->variableTypes[i]);
+  }
+  return size;
+}
+
+bool usdEncoderAppend(usdEncoderBlock_t* block, uint8_t eventIndex, uint64_t timestamp, const uint8_t* payload, const uint8_t* variables) {
+  if (eventIndex >= block->numEvents) {
+    return false;
+  }
+  usdEncoderEvent_t* event = &block->events[eventIndex];
+
+  if (block->numRecords == 0) {
+    // Start a new block, all deltas are relative to the start of the block
+    block->length = USD_ENCODER_BLOCK_HEADER_SIZE;
+    block->baseTimestamp = timestamp;
+    block->previousTimestamp = timestamp;
+    for (int i = 0; i < block->numEvents; i++) {
+      memset(block->events[i].previousValues, 0, sizeof(block->events[i].previousValues));
+    }
+  }
+
+  if (block->length + maxRecordSize(event) + USD_ENCODER_BLOCK_CRC_SIZE > block->capacity) {
+    return false;
+  }
+
+  uint8_t* record = &block->buffer[block->length];
+  uint16_t length = 0;
+
+  record[length++] = eventIndex;
+
+  const int64_t timestampDelta = (int64_t)(timestamp - block->previousTimestamp);
+  length += writeVarint(&record[length], ((uint64_t)timestampDelta << 1) ^ (uint64_t)(timestampDelta >> 63));
+  block->previousTimestamp = timestamp;
+
+  memcpy(&record[length], payload, event->payloadSize);
+  length += event->payloadSize;
+
+  // Raw variables first, followed by the delta encoded
+  const uint8_t* value = variables;
+  for (int i = 0; i < event->numVariables; i++) {
+    const uint8_t size = variableSize(event->variableTypes[i]);
+    if ((event->deltaVariables & (1 << i)) == 0) {
+      memcpy(&record[length], value, size);
+      length += size;
+    }
+    value += size;
+  }
+
+  value = variables;
+  for (int i = 0; i < event->numVariables; i++) {
+    const uint8_t type = event->variableTypes[i];
+    if (event->deltaVariables & (1 << i)) {
+      const uint32_t current = readValue(value, type);
+      const int32_t delta = (int32_t)(current - event->previousValues[i]);
+      length += writeVarint(&record[length], ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));
+      event->previousValues[i] = current;
+    }
+    value += variableSize(type);
+  }
+
+  block->length += length;
+  block->numRecords++;
+  return true;
+}
+
+uint16_t usdEncoderFinish(usdEncoderBlock_t* block) {
+  if (block->numRecords == 0) {
+    return 0;
+  }
+
+  uint8_t* header = block->buffer;
+  const uint16_t payloadLength = block->length - USD_ENCODER_BLOCK_HEADER_SIZE;
+  header[0] = USD_ENCODER_BLOCK_MARKER;
+  memcpy(&header[1], &block->numRecords, sizeof(block->numRecords));
+  memcpy(&header[3], &payloadLength, sizeof(payloadLength));
+  memcpy(&header[5], &block->baseTimestamp, sizeof(block->baseTimestamp));
+
+  const uint32_t crc = crc32CalculateBuffer(block->buffer, block->length);
+  memcpy(&block->buffer[block->length], &crc, sizeof(crc));
+
+  const uint16_t length = block->length + USD_ENCODER_BLOCK_CRC_SIZE;
+  block->numRecords = 0;
+  block->length = 0;
+  return length;
+}
@@ -250,6 +250,19 @@ int8_t bmm150_get_sensor_settings(struct bmm150_dev *dev);
  */
 int8_t bmm150_read_mag_data(struct bmm150_dev *dev);
 
+/*!
+ * @brief This API parses the magnetometer data registers 0x42 to 0x49, read
+ * by the user, and updates the dev structure with compensated mag data in
+ * micro-tesla. See bmm150_read_mag_data for the output format.
+ *
+ * @param[in] reg_data   :   BMM150_XYZR_DATA_LEN bytes read from BMM150_DATA_X_LSB.
+ * @param[in,out] dev     :   Structure instance of bmm150_dev.
+ *
+ * @return Result of API execution status
+ * @retval zero -> Success / +ve value -> Warning / -ve value -> Error
+ */
+int8_t bmm150_parse_mag_data(const uint8_t *reg_data, struct bmm150_dev *dev);
+
 /*!
  * @brief This API is used to perform the complete self test
  * (both normal and advanced) for the BMM150 sensor
@@ -184,6 +184,23 @@ int8_t bmp3_get_op_mode(uint8_t *op_mode, const struct bmp3_dev *dev);
  */
 int8_t bmp3_get_sensor_data(uint8_t sensor_comp, struct bmp3_data *data, struct bmp3_dev *dev);
 
+/*!
+ * @brief This API parses the pressure and temperature data registers, read
+ * by the user from BMP3_DATA_ADDR, compensates the data and store it in the
+ * bmp3_data structure instance passed by the user.
+ *
+ * @param[in] sensor_comp : Variable which selects which data to be compensated,
+ * see bmp3_get_sensor_data.
+ * @param[in] reg_data : BMP3_P_T_DATA_LEN bytes read from BMP3_DATA_ADDR.
+ * @param[out] data : Structure instance of bmp3_data.
+ * @param[in] dev : Structure instance of bmp3_dev.
+ *
+ * @return Result of API execution status
+ * @retval zero -> Success / +ve value -> Warning / -ve value -> Error
+ */
+int8_t bmp3_parse_sensor_data(uint8_t sensor_comp, const uint8_t *reg_data, struct bmp3_data *data,
+				struct bmp3_dev *dev);
+
 /*!
  * @brief This API writes the given data to the register address
  * of the sensor.
@@ -822,9 +822,7 @@ int8_t bmm150_get_sensor_settings(struct bmm150_dev *dev)
 int8_t bmm150_read_mag_data(struct bmm150_dev *dev)
 {
 	int8_t rslt;
-	int16_t msb_data;
 	uint8_t reg_data[BMM150_XYZR_DATA_LEN] = {0};
-	struct bmm150_raw_mag_data raw_mag_data;
 
 	/* Check for null pointer in the device structure*/
 	rslt = null_ptr_check(dev);
@@ -833,42 +831,66 @@ int8_t bmm150_read_mag_data(struct bmm150_dev *dev)
 		/*Read the mag data registers */
 		rslt = bmm150_get_regs(BMM150_DATA_X_LSB, reg_data, BMM150_XYZR_DATA_LEN, dev);
 		if (rslt ==  BMM150_OK) {
-			/* Mag X axis data */
-			reg_data[0] = BMM150_GET_BITS(reg_data[0], BMM150_DATA_X);
-			/* Shift the MSB data to left by 5 bits */
-			/* Multiply by 32 to get the shift left by 5 value */
-			msb_data = ((int16_t)((int8_t)reg_data[1])) * 32;
-			/* Raw mag X axis data */
-			raw_mag_data.raw_datax = (int16_t)(msb_data | reg_data[0]);
-			/* Mag Y axis data */
-			reg_data[2] = BMM150_GET_BITS(reg_data[2], BMM150_DATA_Y);
-			/* Shift the MSB data to left by 5 bits */
-			/* Multiply by 32 to get the shift left by 5 value */
-			msb_data = ((int16_t)((int8_t)reg_data[3])) * 32;
-			/* Raw mag Y axis data */
-			raw_mag_data.raw_datay = (int16_t)(msb_data | reg_data[2]);
-			/* Mag Z axis data */
-			reg_data[4] = BMM150_GET_BITS(reg_data[4], BMM150_DATA_Z);
-			/* Shift the MSB data to left by 7 bits */
-			/* Multiply by 128 to get the shift left by 7 value */
-			msb_data = ((int16_t)((int8_t)reg_data[5])) * 128;
-			/* Raw mag Z axis data */
-			raw_mag_data.raw_dataz = (int16_t)(msb_data | reg_data[4]);
-			/* Mag R-HALL data */
-			reg_data[6] = BMM150_GET_BITS(reg_data[6], BMM150_DATA_RHALL);
-			raw_mag_data.raw_data_r = (uint16_t)(((uint16_t)reg_data[7] << 6) | reg_data[6]);
-			/* Compensated Mag X data in int16_t format */
-			dev->data.x = compensate_x(raw_mag_data.raw_datax, raw_mag_data.raw_data_r, dev);
-			/* Compensated Mag Y data in int16_t format */
-			dev->data.y = compensate_y(raw_mag_data.raw_datay, raw_mag_data.raw_data_r, dev);
-			/* Compensated Mag Z data in int16_t format */
-			dev->data.z = compensate_z(raw_mag_data.raw_dataz, raw_mag_data.raw_data_r, dev);
+			rslt = bmm150_parse_mag_data(reg_data, dev);
 		}
 	}
 
 	return rslt;
 }
 
+/*!
+ * @brief This API is used to parse the magnetometer data registers 0x42 to
+ * 0x49, read by the user, and update the dev structure with the
+ * compensated mag data in micro-tesla.
+ */
+int8_t bmm150_parse_mag_data(const uint8_t *reg_data, struct bmm150_dev *dev)
+{
+	int8_t rslt;
+	int16_t msb_data;
+	uint8_t lsb_data;
+	struct bmm150_raw_mag_data raw_mag_data;
+
+	/* Check for null pointer in the device structure*/
+	rslt = null_ptr_check(dev);
+	/* Proceed if null check is fine */
+	if ((rslt ==  BMM150_OK) && (reg_data != NULL)) {
+		/* Mag X axis data */
+		lsb_data = BMM150_GET_BITS(reg_data[0], BMM150_DATA_X);
+		/* Shift the MSB data to left by 5 bits */
+		/* Multiply by 32 to get the shift left by 5 value */
+		msb_data = ((int16_t)((int8_t)reg_data[1])) * 32;
+		/* Raw mag X axis data */
+		raw_mag_data.raw_datax = (int16_t)(msb_data | lsb_data);
+		/* Mag Y axis data */
+		lsb_data = BMM150_GET_BITS(reg_data[2], BMM150_DATA_Y);
+		/* Shift the MSB data to left by 5 bits */
+		/* Multiply by 32 to get the shift left by 5 value */
+		msb_data = ((int16_t)((int8_t)reg_data[3])) * 32;
+		/* Raw mag Y axis data */
+		raw_mag_data.raw_datay = (int16_t)(msb_data | lsb_data);
+		/* Mag Z axis data */
+		lsb_data = BMM150_GET_BITS(reg_data[4], BMM150_DATA_Z);
+		/* Shift the MSB data to left by 7 bits */
+		/* Multiply by 128 to get the shift left by 7 value */
+		msb_data = ((int16_t)((int8_t)reg_data[5])) * 128;
+		/* Raw mag Z axis data */
+		raw_mag_data.raw_dataz = (int16_t)(msb_data | lsb_data);
+		/* Mag R-HALL data */
+		lsb_data = BMM150_GET_BITS(reg_data[6], BMM150_DATA_RHALL);
+		raw_mag_data.raw_data_r = (uint16_t)(((uint16_t)reg_data[7] << 6) | lsb_data);
+		/* Compensated Mag X data in int16_t format */
+		dev->data.x = compensate_x(raw_mag_data.raw_datax, raw_mag_data.raw_data_r, dev);
+		/* Compensated Mag Y data in int16_t format */
+		dev->data.y = compensate_y(raw_mag_data.raw_datay, raw_mag_data.raw_data_r, dev);
+		/* Compensated Mag Z data in int16_t format */
+		dev->data.z = compensate_z(raw_mag_data.raw_dataz, raw_mag_data.raw_data_r, dev);
+	} else {
+		rslt = BMM150_E_NULL_PTR;
+	}
+
+	return rslt;
+}
+
 /*!
  * @brief This API is used to perform the complete self test
  * (both normal and advanced) for the BMM150 sensor
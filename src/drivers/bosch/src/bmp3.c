@@ -1209,7 +1209,6 @@ int8_t bmp3_get_sensor_data(uint8_t sensor_comp, struct bmp3_data *comp_data, st
 	/* Array to store the pressure and temperature data read from
 	the sensor */
 	uint8_t reg_data[BMP3_P_T_DATA_LEN] = {0};
-	struct bmp3_uncomp_data uncomp_data = {0};
 
 	/* Check for null pointer in the device structure*/
 	rslt = null_ptr_check(dev);
@@ -1219,11 +1218,8 @@ int8_t bmp3_get_sensor_data(uint8_t sensor_comp, struct bmp3_data *comp_data, st
 		rslt = bmp3_get_regs(BMP3_DATA_ADDR, reg_data, BMP3_P_T_DATA_LEN, dev);
 
 		if (rslt == BMP3_OK) {
-			/* Parse the read data from the sensor */
-			parse_sensor_data(reg_data, &uncomp_data);
-			/* Compensate the pressure/temperature/both data read
-			   from the sensor */
-			rslt = compensate_data(sensor_comp, &uncomp_data, comp_data, &dev->calib_data);
+			/* Parse and compensate the read data from the sensor */
+			rslt = bmp3_parse_sensor_data(sensor_comp, reg_data, comp_data, dev);
 		}
 	} else {
 		rslt = BMP3_E_NULL_PTR;
@@ -1232,6 +1228,33 @@ int8_t bmp3_get_sensor_data(uint8_t sensor_comp, struct bmp3_data *comp_data, st
 	return rslt;
 }
 
+/*!
+ * @brief This API parses the pressure and temperature data registers, read
+ * by the user, compensates the data and store it in the bmp3_data structure
+ * instance passed by the user.
+ */
+int8_t bmp3_parse_sensor_data(uint8_t sensor_comp, const uint8_t *reg_data, struct bmp3_data *comp_data,
+				struct bmp3_dev *dev)
+{
+	int8_t rslt;
+	struct bmp3_uncomp_data uncomp_data = {0};
+
+	/* Check for null pointer in the device structure*/
+	rslt = null_ptr_check(dev);
+
+	if ((rslt == BMP3_OK) && (reg_data != NULL) && (comp_data != NULL)) {
+		/* Parse the read data from the sensor */
+		parse_sensor_data(reg_data, &uncomp_data);
+		/* Compensate the pressure/temperature/both data read
+		   from the sensor */
+		rslt = compensate_data(sensor_comp, &uncomp_data, comp_data, &dev->calib_data);
+	} else {
+		rslt = BMP3_E_NULL_PTR;
+	}
+
+	return rslt;
+}
+
 /****************** Static Function Definitions *******************************/
 /*!
  * @brief This internal API converts the no. of frames required by the user to
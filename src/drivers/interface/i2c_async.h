@@ -0,0 +1,67 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2023 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * i2c_async.h - Non-blocking I2C requests with completion callbacks
+ */
+#ifndef I2C_ASYNC_H
+#define I2C_ASYNC_H
+
+#include <stdbool.h>
+#include "i2c_drv.h"
+
+/**
+ * Called when a request has been transferred, or has failed.
+ *
+ * The callback runs in the context of the worker task of the bus, not in the
+ * context of the task that submitted the request. It must not block for any
+ * longer time since it delays the callbacks of the requests after it.
+ *
+ * @param success  true if the transfer succeeded, false otherwise.
+ * @param arg      The argument passed to i2cAsyncSubmit().
+ */
+typedef void (*I2cAsyncCallback)(bool success, void* arg);
+
+/**
+ * Start one worker task per I2C bus, calling the callbacks and restarting
+ * the bus if it hangs. Must be called after the busses have been initialized.
+ */
+void i2cAsyncInit(void);
+
+bool i2cAsyncTest(void);
+
+/**
+ * Queue up a message to be transferred without blocking the caller, see
+ * i2cdrvTransactionSubmit() for chained messages. The message is copied, but
+ * the buffer it points to must be kept valid, and not be touched, until the
+ * callback has been called.
+ *
+ * @param i2c       i2c bus to use.
+ * @param message   The message to transfer, see i2cdrvCreateMessage().
+ * @param callback  Called when the transfer is done, may be NULL.
+ * @param arg       Passed to the callback.
+ * @return          true if the request was queued, false if the queue of the
+ *                  bus is full.
+ */
+bool i2cAsyncSubmit(I2cDrv* i2c, const I2cMessage* message, I2cAsyncCallback callback, void* arg);
+
+#endif // I2C_ASYNC_H
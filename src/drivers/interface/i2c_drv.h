@@ -4,8 +4,16 @@
 #include "FreeRTOS.h"
 #include "semphr.h"
 #include "queue.h"
+#include "task.h"
 /* ST includes */
+#ifndef UNIT_TEST_MODE
 #include "stm32fxxx.h"
+#else
+// Simulated peripheral, see test/testSupport
+#include "i2cPeripheralMocks.h"
+#endif
+
+#include "statsCnt.h"
 
 #define I2C_NO_INTERNAL_ADDRESS   0xFFFF
 
@@ -38,6 +46,35 @@ typedef struct _I2cMessage
   uint8_t          *buffer;           //< Pointer to the buffer from where data will be read for transmission, or into which received data will be placed.
 } I2cMessage;
 
+typedef struct _I2cTransaction I2cTransaction;
+
+/**
+ * Called when a transaction is done. It is always called from the I2C
+ * interrupt, also for transactions aborted on a hanged bus, so only the
+ * FromISR versions of the FreeRTOS functions may be used.
+ */
+typedef void (*I2cTransactionCallback)(I2cTransaction* transaction);
+
+/**
+ * A chain of messages that are transferred back to back from the I2C
+ * interrupt, without involving the owner between the messages. The chain is
+ * stopped at the first message that is not acked.
+ *
+ * The transaction, the messages and their buffers are owned by the driver
+ * from i2cdrvTransactionSubmit() until the transaction is done.
+ */
+struct _I2cTransaction
+{
+  I2cMessage             *messages;       //< Messages to transfer in order. The status of each transferred message is updated.
+  uint32_t               nbrOfMessages;   //< Number of messages in the chain.
+  I2cTransactionCallback callback;        //< Called when done, may be NULL.
+  TaskHandle_t           notifyTask;      //< Task to notify with xTaskNotifyGive when done, may be NULL.
+  void                   *arg;            //< For use by the owner of the transaction.
+  volatile bool          isDone;          //< Set by the driver when the transaction is done.
+  bool                   isSuccessful;    //< Set by the driver, true if all messages were acked.
+  I2cTransaction         *next;           //< Next transaction in the queue of the bus.
+};
+
 typedef struct
 {
   I2C_TypeDef*        i2cPort;
@@ -74,6 +111,20 @@ typedef struct
   SemaphoreHandle_t isBusFreeMutex;     //< Mutex to protect bus
   StaticSemaphore_t isBusFreeMutexBuffer;
   DMA_InitTypeDef DMAStruct;            //< DMA configuration structure used during transfer setup.
+  I2cTransaction* transaction;          //< Transaction in progress, NULL if the bus is idle
+  uint32_t transactionMessageIndex;     //< Index in the transaction of the message in progress
+  uint64_t transactionStartTime;        //< When the transaction in progress was started (us)
+  I2cTransaction* queueHead;            //< Transactions waiting for the bus
+  I2cTransaction* queueTail;
+  uint16_t queueDepth;                  //< Number of submitted transactions that are not done
+  uint16_t queueDepthMax;               //< Highest queue depth since start
+  uint16_t nbrOfTimeouts;               //< Number of hanged transactions that have been aborted
+  uint16_t nbrOfHungRestarts;           //< Number of restarts that did not free the bus
+  bool isRecovering;                    //< The bus is being restarted after a hanged transaction
+  volatile bool isAborting;             //< The event ISR is pended to fail the transaction in progress
+  bool isHung;                          //< The bus is held low, transactions fail until it is restarted
+  uint64_t restartTime;                 //< When the bus was last restarted (us)
+  statsCntRateLogger_t busyTime;        //< Time spent transferring (us)
 } I2cDrv;
 
 // Definitions of i2c busses found in c file.
@@ -97,6 +148,33 @@ void i2cdrvInit(I2cDrv* i2c);
  */
 bool i2cdrvMessageTransfer(I2cDrv* i2c, I2cMessage* message);
 
+/**
+ * Queue up a transaction on the bus and return without waiting for it. The
+ * transactions of a bus are transferred in order, each one started from the
+ * interrupt that ends the previous one. Must be called from a task, not from
+ * a transaction callback. Starting a transaction on an idle bus waits for the
+ * stop of the previous one with interrupts masked, for at most 100 us on a
+ * hanged bus, see I2C_CR1_CLEAR_TIMEOUT_US.
+ *
+ * @param i2c          i2c bus to use.
+ * @param transaction  The transaction to transfer. The owner is told that it
+ *                     is done through the callback, the task notification or
+ *                     by polling isDone.
+ */
+void i2cdrvTransactionSubmit(I2cDrv* i2c, I2cTransaction* transaction);
+
+/**
+ * Abort the transaction in progress if it has hanged, and restart the bus.
+ * The aborted transaction is completed from the I2C interrupt with
+ * isSuccessful set to false. If the restart does not free the bus, the
+ * queued and new transactions fail at once until a later call frees it. Must
+ * be called regularly, from a task, by users of i2cdrvTransactionSubmit() to
+ * recover from a hanged bus.
+ *
+ * @param i2c  i2c bus to check.
+ */
+void i2cdrvCheckTimeout(I2cDrv* i2c);
+
 
 /**
  * Create a message to transfer
@@ -55,6 +55,11 @@
 
 #define UART2_RX_QUEUE_LENGTH 128
 
+#define UART2_RX_DMA_STREAM     DMA1_Stream5
+#define UART2_RX_DMA_CH         DMA_Channel_4
+// Power of two, so that indexes can wrap with a mask
+#define UART2_RX_DMA_BUFFER_SIZE 1024
+
 /**
  * Initialize the UART.
  */
@@ -137,6 +142,35 @@ bool uart2GetCharWithDefaultTimeout(uint8_t *c);
  */
 void uart2Getchar(char * ch);
 
+#ifdef CONFIG_UART2_RX_DMA
+/**
+ * Get received data that has not been consumed yet, to parse it in place in
+ * the circular DMA buffer. Consumed data stays valid until another
+ * UART2_RX_DMA_BUFFER_SIZE bytes have been received.
+ *
+ * @param[out] buffer  Set to the circular receive buffer
+ * @param[out] readIndex  Set to the index in buffer of the first unconsumed byte
+ *
+ * @return number of unconsumed bytes, they wrap around at the end of buffer
+ */
+uint32_t uart2RxDmaPeek(const uint8_t** buffer, uint32_t* readIndex);
+
+/**
+ * Mark received data as consumed.
+ *
+ * @param[in] size  Number of bytes from the read index to consume
+ */
+void uart2RxDmaConsume(uint32_t size);
+
+/**
+ * Wait until the line goes idle after receiving data.
+ *
+ * @param[in] timeoutTicks timeout in ticks
+ * @return true if the line went idle, false if the timeout was reached.
+ */
+bool uart2RxDmaWaitIdle(const uint32_t timeoutTicks);
+#endif
+
 /**
  * Returns true if an overrun condition has happened since initialization or
  * since the last call to this function.
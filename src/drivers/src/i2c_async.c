@@ -0,0 +1,213 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2023 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * i2c_async.c - Non-blocking I2C requests with completion callbacks
+ *
+ * The requests are submitted as transactions to the queue of the bus in the
+ * I2C driver, and transferred back to back from the I2C interrupt. Each bus
+ * has a task that calls the completion callbacks, so that they can use the
+ * normal FreeRTOS API, and restarts the bus if it hangs.
+ */
+#define DEBUG_MODULE "I2CASYNC"
+
+#include <stddef.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+#include "i2c_async.h"
+#include "config.h"
+#include "static_mem.h"
+#include "cfassert.h"
+#include "log.h"
+
+#define I2C_ASYNC_QUEUE_LENGTH 8
+// How often to check for a hanged bus when no request is done
+#define I2C_ASYNC_TIMEOUT_CHECK_PERIOD M2T(500)
+
+typedef struct
+{
+  I2cTransaction transaction;
+  I2cMessage message;
+  I2cAsyncCallback callback;
+  void* arg;
+} I2cAsyncRequest;
+
+typedef struct
+{
+  I2cDrv* i2c;
+  I2cAsyncRequest requests[I2C_ASYNC_QUEUE_LENGTH];
+  xQueueHandle freeQueue;
+  xQueueHandle doneQueue;
+  uint32_t dropped;
+  uint32_t failed;
+} I2cAsyncBus;
+
+static bool isInit = false;
+
+static I2cAsyncBus deckAsyncBus = { .i2c = &deckBus };
+static I2cAsyncBus sensorsAsyncBus = { .i2c = &sensorsBus };
+
+// The queues hold pointers to the requests of the bus
+STATIC_MEM_QUEUE_ALLOC(deckFreeQueue, I2C_ASYNC_QUEUE_LENGTH, sizeof(I2cAsyncRequest*));
+STATIC_MEM_QUEUE_ALLOC(deckDoneQueue, I2C_ASYNC_QUEUE_LENGTH, sizeof(I2cAsyncRequest*));
+STATIC_MEM_QUEUE_ALLOC(sensorsFreeQueue, I2C_ASYNC_QUEUE_LENGTH, sizeof(I2cAsyncRequest*));
+STATIC_MEM_QUEUE_ALLOC(sensorsDoneQueue, I2C_ASYNC_QUEUE_LENGTH, sizeof(I2cAsyncRequest*));
+
+STATIC_MEM_TASK_ALLOC(deckTask, I2C_ASYNC_TASK_STACKSIZE);
+STATIC_MEM_TASK_ALLOC(sensorsTask, I2C_ASYNC_TASK_STACKSIZE);
+
+// Called from the I2C interrupt
+static void i2cAsyncTransactionDone(I2cTransaction* transaction)
+{
+  I2cAsyncBus* bus = transaction->arg;
+  I2cAsyncRequest* request = (I2cAsyncRequest*)transaction;
+  portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+
+  xQueueSendFromISR(bus->doneQueue, &request, &xHigherPriorityTaskWoken);
+  portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+static void i2cAsyncTask(void* param)
+{
+  I2cAsyncBus* bus = param;
+  I2cAsyncRequest* request;
+
+  while (true)
+  {
+    if (xQueueReceive(bus->doneQueue, &request, I2C_ASYNC_TIMEOUT_CHECK_PERIOD) == pdTRUE)
+    {
+      if (!request->transaction.isSuccessful)
+      {
+        bus->failed++;
+      }
+
+      if (request->callback)
+      {
+        request->callback(request->transaction.isSuccessful, request->arg);
+      }
+
+      xQueueSend(bus->freeQueue, &request, 0);
+    }
+
+    // Also when requests are done, they fail at once on a hung bus that
+    // must be restarted again
+    i2cdrvCheckTimeout(bus->i2c);
+  }
+}
+
+static I2cAsyncBus* getBus(I2cDrv* i2c)
+{
+  if (i2c == &deckBus)
+  {
+    return &deckAsyncBus;
+  }
+  else if (i2c == &sensorsBus)
+  {
+    return &sensorsAsyncBus;
+  }
+
+  return NULL;
+}
+
+static void i2cAsyncBusInit(I2cAsyncBus* bus)
+{
+  for (int i = 0; i < I2C_ASYNC_QUEUE_LENGTH; i++)
+  {
+    I2cAsyncRequest* request = &bus->requests[i];
+    request->transaction.messages = &request->message;
+    request->transaction.nbrOfMessages = 1;
+    request->transaction.callback = i2cAsyncTransactionDone;
+    request->transaction.arg = bus;
+    xQueueSend(bus->freeQueue, &request, 0);
+  }
+}
+
+void i2cAsyncInit(void)
+{
+  if (isInit)
+  {
+    return;
+  }
+
+  deckAsyncBus.freeQueue = STATIC_MEM_QUEUE_CREATE(deckFreeQueue);
+  deckAsyncBus.doneQueue = STATIC_MEM_QUEUE_CREATE(deckDoneQueue);
+  sensorsAsyncBus.freeQueue = STATIC_MEM_QUEUE_CREATE(sensorsFreeQueue);
+  sensorsAsyncBus.doneQueue = STATIC_MEM_QUEUE_CREATE(sensorsDoneQueue);
+  i2cAsyncBusInit(&deckAsyncBus);
+  i2cAsyncBusInit(&sensorsAsyncBus);
+
+  STATIC_MEM_TASK_CREATE(deckTask, i2cAsyncTask, I2C_ASYNC_DECK_TASK_NAME, &deckAsyncBus, I2C_ASYNC_TASK_PRI);
+  STATIC_MEM_TASK_CREATE(sensorsTask, i2cAsyncTask, I2C_ASYNC_SENSORS_TASK_NAME, &sensorsAsyncBus, I2C_ASYNC_TASK_PRI);
+
+  isInit = true;
+}
+
+bool i2cAsyncTest(void)
+{
+  return isInit;
+}
+
+bool i2cAsyncSubmit(I2cDrv* i2c, const I2cMessage* message, I2cAsyncCallback callback, void* arg)
+{
+  I2cAsyncBus* bus = getBus(i2c);
+  ASSERT(bus);
+  ASSERT_DMA_SAFE(message->buffer);
+
+  I2cAsyncRequest* request;
+  if (xQueueReceive(bus->freeQueue, &request, 0) != pdTRUE)
+  {
+    bus->dropped++;
+    return false;
+  }
+
+  request->message = *message;
+  request->callback = callback;
+  request->arg = arg;
+  i2cdrvTransactionSubmit(i2c, &request->transaction);
+
+  return true;
+}
+
+/**
+ * Non-blocking I2C requests, see also the i2c log group for the bus queues
+ */
+LOG_GROUP_START(i2cAsync)
+/**
+ * @brief Number of requests dropped since all deck bus requests were in use
+ */
+LOG_ADD(LOG_UINT32, deckDropped, &deckAsyncBus.dropped)
+/**
+ * @brief Number of failed transfers on the deck bus
+ */
+LOG_ADD(LOG_UINT32, deckFailed, &deckAsyncBus.failed)
+/**
+ * @brief Number of requests dropped since all sensors bus requests were in use
+ */
+LOG_ADD(LOG_UINT32, sensorsDropped, &sensorsAsyncBus.dropped)
+/**
+ * @brief Number of failed transfers on the sensors bus
+ */
+LOG_ADD(LOG_UINT32, sensorsFailed, &sensorsAsyncBus.failed)
+LOG_GROUP_STOP(i2cAsync)
@@ -50,11 +50,8 @@
 #include "sleepus.h"
 
 #include "autoconf.h"
-
-//DEBUG
-#ifdef I2CDRV_DEBUG_LOG_EVENTS
 #include "usec_time.h"
-#endif
+#include "log.h"
 
 // Definitions of sensors I2C bus
 #define I2C_DEFAULT_SENSORS_CLOCK_SPEED             400000
@@ -67,6 +64,21 @@
 #define I2C_SLAVE_ADDRESS7      0x30
 #define I2C_MAX_RETRIES         2
 #define I2C_MESSAGE_TIMEOUT     M2T(1000)
+// A transaction taking longer than this has hanged the bus. A bus that is
+// still hanged after a restart is restarted again at most this often.
+#define I2C_TRANSACTION_TIMEOUT_US (500 * 1000)
+// The peripheral clears a start or stop request in CR1 within a few bit times,
+// about 5 us at 400 kHz, plus any clock stretching by the device.
+//
+// The driver busy-waits for it in the event ISR, and in i2cdrvTransactionSubmit()
+// with all interrupts up to configMAX_SYSCALL_INTERRUPT_PRIORITY masked, which
+// includes the sensor, radio and UART interrupts. The whole timeout is only
+// spent when a device holds the bus, and then once per hang: the bus is marked
+// hung and later transactions fail without waiting until a restart frees it.
+// 100 us of added interrupt latency in that case is well within the 1 ms
+// stabilizer period. Deferring the start to a later event or a timer would
+// instead delay every chained message.
+#define I2C_CR1_CLEAR_TIMEOUT_US 100
 
 // Helpers to unlock bus
 #define I2CDEV_CLK_TS (10)
@@ -122,6 +134,19 @@ static void i2cdrvErrorIsrHandler(I2cDrv* i2c);
  * DMA interrupt service routine
  */
 static void i2cdrvDmaIsrHandler(I2cDrv* i2c);
+/**
+ * Start the first transaction in the queue, if any. Interrupts must be masked.
+ */
+static void i2cdrvStartNextTransaction(I2cDrv* i2c);
+/**
+ * End the transaction in progress and notify its owner. Only called from the ISRs.
+ */
+static void i2cdrvFinishTransaction(I2cDrv* i2c, bool isSuccessful, portBASE_TYPE* xHigherPriorityTaskWoken);
+/**
+ * Let the event ISR fail the transaction in progress, and the queued ones if
+ * the bus is hanged. Interrupts must be masked.
+ */
+static void i2cdrvAbort(I2cDrv* i2c);
 
 // Cost definitions of busses
 static const I2cDef sensorBusDef =
@@ -191,10 +216,35 @@ I2cDrv deckBus =
 };
 
 
+// Bounded wait for the peripheral to clear a start or stop request, returns false on timeout
+static bool i2cdrvWaitForCR1Clear(I2cDrv *i2c, uint16_t mask)
+{
+  const uint64_t start = usecTimestamp();
+  while (i2c->def->i2cPort->CR1 & mask)
+  {
+    if (usecTimestamp() - start > I2C_CR1_CLEAR_TIMEOUT_US)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
 static void i2cdrvStartTransfer(I2cDrv *i2c)
 {
   ASSERT_DMA_SAFE(i2c->txMessage.buffer);
 
+  // The stop of the previous message must be generated before the next start,
+  // see the note at the top of this file. If it never is, SCL is held low.
+  if (!i2cdrvWaitForCR1Clear(i2c, I2C_CR1_STOP))
+  {
+    i2c->isHung = true;
+    i2c->txMessage.status = i2cNack;
+    i2cdrvAbort(i2c);
+    return;
+  }
+
   if (i2c->txMessage.direction == i2cRead)
   {
     i2c->DMAStruct.DMA_BufferSize = i2c->txMessage.messageLength;
@@ -208,19 +258,133 @@ static void i2cdrvStartTransfer(I2cDrv *i2c)
   i2c->def->i2cPort->CR1 = (I2C_CR1_START | I2C_CR1_PE);
 }
 
-static void i2cTryNextMessage(I2cDrv* i2c)
+static void i2cdrvStartMessage(I2cDrv* i2c)
 {
-  i2c->def->i2cPort->CR1 = (I2C_CR1_STOP | I2C_CR1_PE);
+  memcpy((char*)&i2c->txMessage, (char*)&i2c->transaction->messages[i2c->transactionMessageIndex], sizeof(I2cMessage));
+  i2cdrvStartTransfer(i2c);
+}
+
+static void i2cdrvStartNextTransaction(I2cDrv* i2c)
+{
+  I2cTransaction* transaction = i2c->queueHead;
+  if (transaction == NULL || i2c->isRecovering || i2c->isAborting)
+  {
+    return;
+  }
+
+  if (i2c->isHung)
+  {
+    // Fail fast until the bus has been restarted
+    i2cdrvAbort(i2c);
+    return;
+  }
+
+  i2c->queueHead = transaction->next;
+  if (i2c->queueHead == NULL)
+  {
+    i2c->queueTail = NULL;
+  }
+
+  i2c->transaction = transaction;
+  i2c->transactionMessageIndex = 0;
+  i2c->transactionStartTime = usecTimestamp();
+  i2cdrvStartMessage(i2c);
+}
+
+static void i2cdrvAbort(I2cDrv* i2c)
+{
+  i2c->isAborting = true;
   I2C_ITConfig(i2c->def->i2cPort, I2C_IT_EVT | I2C_IT_BUF, DISABLE);
+  NVIC_SetPendingIRQ((IRQn_Type)i2c->def->i2cEVIRQn);
 }
 
-static void i2cNotifyClient(I2cDrv* i2c)
+// Called from the event ISR when an abort is pending
+static void i2cdrvCompleteAbort(I2cDrv* i2c)
 {
   portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
-  xSemaphoreGiveFromISR(i2c->isBusFreeSemaphore, &xHigherPriorityTaskWoken);
+
+  i2c->isAborting = false;
+  if (i2c->transaction)
+  {
+    i2c->transaction->messages[i2c->transactionMessageIndex].status = i2cNack;
+    i2cdrvFinishTransaction(i2c, false, &xHigherPriorityTaskWoken);
+  }
+
+  while (i2c->isHung && i2c->queueHead)
+  {
+    i2c->transaction = i2c->queueHead;
+    i2c->queueHead = i2c->queueHead->next;
+    i2c->transactionMessageIndex = 0;
+    i2c->transactionStartTime = usecTimestamp();
+    i2c->transaction->messages[0].status = i2cNack;
+    i2cdrvFinishTransaction(i2c, false, &xHigherPriorityTaskWoken);
+  }
+  if (i2c->queueHead == NULL)
+  {
+    i2c->queueTail = NULL;
+  }
+
+  i2cdrvStartNextTransaction(i2c);
   portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
 }
 
+static void i2cdrvFinishTransaction(I2cDrv* i2c, bool isSuccessful, portBASE_TYPE* xHigherPriorityTaskWoken)
+{
+  I2cTransaction* transaction = i2c->transaction;
+  I2cTransactionCallback callback = transaction->callback;
+  TaskHandle_t notifyTask = transaction->notifyTask;
+
+  i2c->transaction = NULL;
+  i2c->queueDepth--;
+  STATS_CNT_RATE_MULTI_EVENT(&i2c->busyTime, (uint32_t)(usecTimestamp() - i2c->transactionStartTime));
+
+  transaction->isSuccessful = isSuccessful;
+  transaction->isDone = true;
+
+  // The owner may reuse the transaction from here on
+  if (callback)
+  {
+    callback(transaction);
+  }
+  if (notifyTask)
+  {
+    vTaskNotifyGiveFromISR(notifyTask, xHigherPriorityTaskWoken);
+  }
+}
+
+/**
+ * Called from the ISRs when the message in progress is done, acked or not.
+ * Generates a stop and continues with the next message in the chain, or the
+ * next transaction in the queue.
+ */
+static void i2cTryNextMessage(I2cDrv* i2c)
+{
+  i2c->def->i2cPort->CR1 = (I2C_CR1_STOP | I2C_CR1_PE);
+  I2C_ITConfig(i2c->def->i2cPort, I2C_IT_EVT | I2C_IT_BUF, DISABLE);
+
+  I2cTransaction* transaction = i2c->transaction;
+  if (transaction == NULL || i2c->isRecovering || i2c->isAborting)
+  {
+    return;
+  }
+
+  I2cMessage* message = &transaction->messages[i2c->transactionMessageIndex];
+  message->status = i2c->txMessage.status;
+  i2c->transactionMessageIndex++;
+
+  if (message->status == i2cAck && i2c->transactionMessageIndex < transaction->nbrOfMessages)
+  {
+    i2cdrvStartMessage(i2c);
+  }
+  else
+  {
+    portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+    i2cdrvFinishTransaction(i2c, message->status == i2cAck, &xHigherPriorityTaskWoken);
+    i2cdrvStartNextTransaction(i2c);
+    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+  }
+}
+
 static void i2cdrvTryToRestartBus(I2cDrv* i2c)
 {
   I2C_InitTypeDef I2C_InitStructure;
@@ -317,6 +481,7 @@ static void i2cdrvInitBus(I2cDrv* i2c)
 
   i2c->isBusFreeSemaphore = xSemaphoreCreateBinaryStatic(&i2c->isBusFreeSemaphoreBuffer);
   i2c->isBusFreeMutex = xSemaphoreCreateMutexStatic(&i2c->isBusFreeMutexBuffer);
+  STATS_CNT_RATE_INIT(&i2c->busyTime, 1000);
 }
 
 static void i2cdrvdevUnlockBus(GPIO_TypeDef* portSCL, GPIO_TypeDef* portSDA, uint16_t pinSCL, uint16_t pinSDA)
@@ -399,32 +564,120 @@ void i2cdrvCreateMessageIntAddr(I2cMessage *message,
   message->nbrOfRetries = I2C_MAX_RETRIES;
 }
 
+static void i2cdrvMessageTransferDone(I2cTransaction* transaction)
+{
+  I2cDrv* i2c = transaction->arg;
+  portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+  xSemaphoreGiveFromISR(i2c->isBusFreeSemaphore, &xHigherPriorityTaskWoken);
+  portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
 bool i2cdrvMessageTransfer(I2cDrv* i2c, I2cMessage* message)
 {
-  bool status = false;
+  I2cTransaction transaction =
+  {
+    .messages = message,
+    .nbrOfMessages = 1,
+    .callback = i2cdrvMessageTransferDone,
+    .arg = i2c,
+  };
+
+  // Only one blocking transfer at a time, they share the semaphore
+  xSemaphoreTake(i2c->isBusFreeMutex, portMAX_DELAY);
+  // Retries the restart of a hung bus, the transfer fails at once otherwise
+  i2cdrvCheckTimeout(i2c);
+  i2cdrvTransactionSubmit(i2c, &transaction);
+  // Wait for transaction to be done. It is always done in the end since a
+  // hanged transaction is aborted.
+  while (xSemaphoreTake(i2c->isBusFreeSemaphore, I2C_MESSAGE_TIMEOUT) != pdTRUE)
+  {
+    i2cdrvCheckTimeout(i2c);
+  }
+  xSemaphoreGive(i2c->isBusFreeMutex);
 
-  xSemaphoreTake(i2c->isBusFreeMutex, portMAX_DELAY); // Protect message data
-  // Copy message
-  memcpy((char*)&i2c->txMessage, (char*)message, sizeof(I2cMessage));
-  // We can now start the ISR sending this message.
-  i2cdrvStartTransfer(i2c);
-  // Wait for transaction to be done
-  if (xSemaphoreTake(i2c->isBusFreeSemaphore, I2C_MESSAGE_TIMEOUT) == pdTRUE)
+  return transaction.isSuccessful;
+}
+
+void i2cdrvTransactionSubmit(I2cDrv* i2c, I2cTransaction* transaction)
+{
+  ASSERT(transaction->nbrOfMessages > 0);
+
+  transaction->isDone = false;
+  transaction->isSuccessful = false;
+  transaction->next = NULL;
+
+  taskENTER_CRITICAL();
+  if (i2c->queueTail)
   {
-    if (i2c->txMessage.status == i2cAck)
+    i2c->queueTail->next = transaction;
+  }
+  else
+  {
+    i2c->queueHead = transaction;
+  }
+  i2c->queueTail = transaction;
+
+  i2c->queueDepth++;
+  if (i2c->queueDepth > i2c->queueDepthMax)
+  {
+    i2c->queueDepthMax = i2c->queueDepth;
+  }
+
+  if (i2c->transaction == NULL)
+  {
+    i2cdrvStartNextTransaction(i2c);
+  }
+  taskEXIT_CRITICAL();
+}
+
+void i2cdrvCheckTimeout(I2cDrv* i2c)
+{
+  bool isHanged = false;
+
+  taskENTER_CRITICAL();
+  const uint64_t now = usecTimestamp();
+  if (!i2c->isRecovering && !i2c->isAborting)
+  {
+    if (i2c->transaction && now - i2c->transactionStartTime > I2C_TRANSACTION_TIMEOUT_US)
+    {
+      i2c->nbrOfTimeouts++;
+      isHanged = true;
+    }
+    else if (i2c->isHung && now - i2c->restartTime > I2C_TRANSACTION_TIMEOUT_US)
     {
-      status = true;
+      isHanged = true;
     }
   }
-  else
+
+  if (isHanged)
   {
-    i2cdrvClearDMA(i2c);
-    i2cdrvTryToRestartBus(i2c);
-    //TODO: If bus is really hanged... fail safe
+    // Keep the ISRs from touching the transaction while the bus is restarted
+    i2c->isRecovering = true;
+    I2C_ITConfig(i2c->def->i2cPort, I2C_IT_EVT | I2C_IT_BUF, DISABLE);
   }
-  xSemaphoreGive(i2c->isBusFreeMutex);
+  taskEXIT_CRITICAL();
+
+  if (!isHanged)
+  {
+    return;
+  }
+
+  i2cdrvClearDMA(i2c);
+  i2cdrvTryToRestartBus(i2c);
 
-  return status;
+  // Fail safe: if a device still holds SDA or SCL low, fail the transactions
+  // at once instead of timing out each one, until a restart frees the bus
+  taskENTER_CRITICAL();
+  i2c->restartTime = usecTimestamp();
+  i2c->isHung = (I2C_GetFlagStatus(i2c->def->i2cPort, I2C_FLAG_BUSY) == SET);
+  if (i2c->isHung)
+  {
+    i2c->nbrOfHungRestarts++;
+  }
+  i2c->isRecovering = false;
+  // The ISR completes the transactions, so the callbacks always run in interrupt context
+  i2cdrvAbort(i2c);
+  taskEXIT_CRITICAL();
 }
 
 
@@ -433,6 +686,12 @@ static void i2cdrvEventIsrHandler(I2cDrv* i2c)
   uint16_t SR1;
   uint16_t SR2;
 
+  if (i2c->isAborting)
+  {
+    i2cdrvCompleteAbort(i2c);
+    return;
+  }
+
   // read the status register first
   SR1 = i2c->def->i2cPort->SR1;
 
@@ -525,8 +784,7 @@ static void i2cdrvEventIsrHandler(I2cDrv* i2c)
       }
       else
       {
-        i2cNotifyClient(i2c);
-        // Are there any other messages to transact? If so stop else repeated start.
+        // Are there any other messages to transact?
         i2cTryNextMessage(i2c);
       }
     }
@@ -536,14 +794,13 @@ static void i2cdrvEventIsrHandler(I2cDrv* i2c)
       i2c->txMessage.buffer[i2c->messageIndex++] = I2C_ReceiveData(i2c->def->i2cPort);
       if(i2c->messageIndex == i2c->txMessage.messageLength)
       {
-        i2cNotifyClient(i2c);
         // Are there any other messages to transact?
         i2cTryNextMessage(i2c);
       }
     }
-    // A second BTF interrupt might occur if we don't wait for it to clear.
-    // TODO Implement better method.
-    while (i2c->def->i2cPort->CR1 & 0x0100) { ; }
+    // A second BTF interrupt might occur if we don't wait for the start to be
+    // generated. A bus that never generates it is restarted by i2cdrvCheckTimeout().
+    i2cdrvWaitForCR1Clear(i2c, I2C_CR1_START);
   }
   // Byte received
   else if (SR1 & I2C_SR1_RXNE) // Should not happen when we use DMA for reception.
@@ -593,7 +850,6 @@ static void i2cdrvErrorIsrHandler(I2cDrv* i2c)
     {
       // Failed so notify client and try next message if any.
       i2c->txMessage.status = i2cNack;
-      i2cNotifyClient(i2c);
       i2cTryNextMessage(i2c);
     }
     I2C_ClearFlag(i2c->def->i2cPort, I2C_FLAG_AF);
@@ -626,7 +882,6 @@ static void i2cdrvDmaIsrHandler(I2cDrv* i2c)
   if (DMA_GetFlagStatus(i2c->def->dmaRxStream, i2c->def->dmaRxTCFlag)) // Transfer complete
   {
     i2cdrvClearDMA(i2c);
-    i2cNotifyClient(i2c);
     // Are there any other messages to transact?
     i2cTryNextMessage(i2c);
   }
@@ -635,7 +890,6 @@ static void i2cdrvDmaIsrHandler(I2cDrv* i2c)
     DMA_ClearITPendingBit(i2c->def->dmaRxStream, i2c->def->dmaRxTEFlag);
     //TODO: Best thing we could do?
     i2c->txMessage.status = i2cNack;
-    i2cNotifyClient(i2c);
     i2cTryNextMessage(i2c);
   }
 }
@@ -674,3 +928,49 @@ void __attribute__((used)) DMA1_Stream2_IRQHandler(void)
 {
   i2cdrvDmaIsrHandler(&sensorsBus);
 }
+
+/**
+ * Queues of transactions on the I2C busses
+ */
+LOG_GROUP_START(i2c)
+/**
+ * @brief Number of transactions submitted to the deck bus that are not done
+ */
+LOG_ADD(LOG_UINT16, deckQueue, &deckBus.queueDepth)
+/**
+ * @brief Highest number of transactions queued on the deck bus
+ */
+LOG_ADD(LOG_UINT16, deckQueueMax, &deckBus.queueDepthMax)
+/**
+ * @brief Time the deck bus is busy transferring [us/s], 1000000 is full utilization
+ */
+STATS_CNT_RATE_LOG_ADD(deckBusy, &deckBus.busyTime)
+/**
+ * @brief Number of hanged transactions aborted on the deck bus
+ */
+LOG_ADD(LOG_UINT16, deckTimeouts, &deckBus.nbrOfTimeouts)
+/**
+ * @brief Number of restarts that did not free the deck bus
+ */
+LOG_ADD(LOG_UINT16, deckHung, &deckBus.nbrOfHungRestarts)
+/**
+ * @brief Number of transactions submitted to the sensors bus that are not done
+ */
+LOG_ADD(LOG_UINT16, sensorsQueue, &sensorsBus.queueDepth)
+/**
+ * @brief Highest number of transactions queued on the sensors bus
+ */
+LOG_ADD(LOG_UINT16, sensorsQueueMax, &sensorsBus.queueDepthMax)
+/**
+ * @brief Time the sensors bus is busy transferring [us/s], 1000000 is full utilization
+ */
+STATS_CNT_RATE_LOG_ADD(sensorsBusy, &sensorsBus.busyTime)
+/**
+ * @brief Number of hanged transactions aborted on the sensors bus
+ */
+LOG_ADD(LOG_UINT16, sensorsTimeouts, &sensorsBus.nbrOfTimeouts)
+/**
+ * @brief Number of restarts that did not free the sensors bus
+ */
+LOG_ADD(LOG_UINT16, sensorsHung, &sensorsBus.nbrOfHungRestarts)
+LOG_GROUP_STOP(i2c)
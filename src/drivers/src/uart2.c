@@ -57,7 +57,14 @@ static uint8_t dmaBuffer[UART2_DMA_BUFFER_SIZE];
 static bool    isUartDmaInitialized;
 static uint32_t initialDMACount;
 
+#ifdef CONFIG_UART2_RX_DMA
+static uint8_t rxDmaBuffer[UART2_RX_DMA_BUFFER_SIZE];
+static uint32_t rxReadIndex;
+static xSemaphoreHandle rxIdle;
+static StaticSemaphore_t rxIdleBuffer;
+#else
 static StreamBufferHandle_t rxStream;
+#endif
 static EventGroupHandle_t isrEvents;
 
 static bool hasOverrun = false;
@@ -95,6 +102,36 @@ static void uart2DmaInit(void)
   NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = NVIC_MID_PRI;
   NVIC_Init(&NVIC_InitStructure);
 
+#ifdef CONFIG_UART2_RX_DMA
+  // USART RX DMA Stream Config. The stream is circular and never stopped,
+  // the receiver is woken up by the idle line interrupt instead.
+  DMA_InitTypeDef DMA_InitStructureRX;
+  DMA_InitStructureRX.DMA_PeripheralBaseAddr = (uint32_t)&UART2_TYPE->DR;
+  DMA_InitStructureRX.DMA_Memory0BaseAddr = (uint32_t)rxDmaBuffer;
+  DMA_InitStructureRX.DMA_MemoryInc = DMA_MemoryInc_Enable;
+  DMA_InitStructureRX.DMA_MemoryBurst = DMA_MemoryBurst_Single;
+  DMA_InitStructureRX.DMA_MemoryDataSize = DMA_MemoryDataSize_Byte;
+  DMA_InitStructureRX.DMA_BufferSize = UART2_RX_DMA_BUFFER_SIZE;
+  DMA_InitStructureRX.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+  DMA_InitStructureRX.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Byte;
+  DMA_InitStructureRX.DMA_PeripheralBurst = DMA_PeripheralBurst_Single;
+  DMA_InitStructureRX.DMA_DIR = DMA_DIR_PeripheralToMemory;
+  DMA_InitStructureRX.DMA_Mode = DMA_Mode_Circular;
+  DMA_InitStructureRX.DMA_FIFOMode = DMA_FIFOMode_Disable;
+  DMA_InitStructureRX.DMA_FIFOThreshold = DMA_FIFOThreshold_1QuarterFull;
+  DMA_InitStructureRX.DMA_Channel = UART2_RX_DMA_CH;
+  DMA_InitStructureRX.DMA_Priority = DMA_Priority_High;
+
+  // The UART is re-initialized when changing baudrate
+  DMA_Cmd(UART2_RX_DMA_STREAM, DISABLE);
+  while(DMA_GetCmdStatus(UART2_RX_DMA_STREAM) != DISABLE);
+  DMA_Init(UART2_RX_DMA_STREAM, &DMA_InitStructureRX);
+  rxReadIndex = 0;
+
+  USART_DMACmd(UART2_TYPE, USART_DMAReq_Rx, ENABLE);
+  DMA_Cmd(UART2_RX_DMA_STREAM, ENABLE);
+#endif
+
   isUartDmaInitialized = true;
 }
 
@@ -109,6 +146,9 @@ void uart2Init(const uint32_t baudrate)
   waitUntilSendDone = xSemaphoreCreateBinaryStatic(&waitUntilSendDoneBuffer); // initialized as blocking
   uartBusy = xSemaphoreCreateBinaryStatic(&uartBusyBuffer); // initialized as blocking
   xSemaphoreGive(uartBusy); // but we give it because the uart isn't busy at initialization
+#ifdef CONFIG_UART2_RX_DMA
+  rxIdle = xSemaphoreCreateBinaryStatic(&rxIdleBuffer);
+#endif
 
   /* Enable GPIO and USART clock */
   RCC_AHB1PeriphClockCmd(UART2_GPIO_PERIF, ENABLE);
@@ -148,17 +188,25 @@ void uart2Init(const uint32_t baudrate)
   NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = NVIC_UART_PRI;
   NVIC_Init(&NVIC_InitStructure);
 
+#ifdef CONFIG_UART2_RX_DMA
+  USART_ITConfig(UART2_TYPE, USART_IT_IDLE, ENABLE);
+#else
   USART_ITConfig(UART2_TYPE, USART_IT_RXNE, ENABLE);
+#endif
 
   //Enable UART
   USART_Cmd(UART2_TYPE, ENABLE);
 
+#ifndef CONFIG_UART2_RX_DMA
   USART_ITConfig(UART2_TYPE, USART_IT_RXNE, ENABLE);
+#endif
 
   isrEvents = xEventGroupCreate();
 
+#ifndef CONFIG_UART2_RX_DMA
   rxStream = xStreamBufferCreate( 200, 1);
   ASSERT(rxStream);
+#endif
 
   isInit = true;
 }
@@ -247,6 +295,66 @@ void uart2Getchar(char * ch)
   uart2GetData(1, (uint8_t*) ch);
 }
 
+#ifdef CONFIG_UART2_RX_DMA
+uint32_t uart2RxDmaPeek(const uint8_t** buffer, uint32_t* readIndex)
+{
+  const uint32_t mask = UART2_RX_DMA_BUFFER_SIZE - 1;
+  const uint32_t writeIndex = (UART2_RX_DMA_BUFFER_SIZE - DMA_GetCurrDataCounter(UART2_RX_DMA_STREAM)) & mask;
+
+  *buffer = rxDmaBuffer;
+  *readIndex = rxReadIndex;
+  return (writeIndex - rxReadIndex) & mask;
+}
+
+void uart2RxDmaConsume(uint32_t size)
+{
+  rxReadIndex = (rxReadIndex + size) & (UART2_RX_DMA_BUFFER_SIZE - 1);
+}
+
+bool uart2RxDmaWaitIdle(const uint32_t timeoutTicks)
+{
+  return xSemaphoreTake(rxIdle, timeoutTicks) == pdTRUE;
+}
+
+static size_t uart2RxDmaRead(size_t size, uint8_t * buffer)
+{
+  const uint8_t* rxBuffer;
+  uint32_t readIndex;
+  size_t available = uart2RxDmaPeek(&rxBuffer, &readIndex);
+  if (available > size) {
+    available = size;
+  }
+
+  for (size_t i = 0; i < available; i++) {
+    buffer[i] = rxBuffer[(readIndex + i) & (UART2_RX_DMA_BUFFER_SIZE - 1)];
+  }
+  uart2RxDmaConsume(available);
+
+  return available;
+}
+
+int uart2GetDataWithTimeout(size_t size, uint8_t * buffer, const uint32_t timeoutTicks) {
+  uint32_t timeoutEnd = xTaskGetTickCount() + timeoutTicks;
+  size_t sizeLeft = size - uart2RxDmaRead(size, buffer);
+  while (sizeLeft > 0 && timeoutEnd > xTaskGetTickCount()) {
+    // The line does not go idle in a continuous stream, poll every tick as well
+    uart2RxDmaWaitIdle(1);
+    sizeLeft -= uart2RxDmaRead(sizeLeft, &buffer[size-sizeLeft]);
+  }
+
+  return size - sizeLeft;
+}
+
+int uart2GetData(size_t size, uint8_t * buffer) {
+  size_t sizeLeft = size - uart2RxDmaRead(size, buffer);
+  while (sizeLeft > 0) {
+    uart2RxDmaWaitIdle(1);
+    sizeLeft -= uart2RxDmaRead(sizeLeft, &buffer[size-sizeLeft]);
+  }
+
+  return size;
+}
+#else
 int uart2GetDataWithTimeout(size_t size, uint8_t * buffer, const uint32_t timeoutTicks) {
   size_t sizeLeft = size;
   uint32_t timeoutEnd = xTaskGetTickCount() + timeoutTicks;
@@ -268,6 +376,7 @@ int uart2GetData(size_t size, uint8_t * buffer) {
 
   return size;
 }
+#endif
 
 bool uart2DidOverrun()
 {
@@ -297,6 +406,18 @@ void __attribute__((used)) USART2_IRQHandler(void)
 {
 
   uint32_t status = UART2_TYPE->SR;
+#ifdef CONFIG_UART2_RX_DMA
+  if ((status & USART_FLAG_IDLE) != 0)
+  {
+    // IDLE is cleared by reading SR followed by DR. The DMA has already
+    // moved the last byte, so no data is lost by reading DR.
+    asm volatile ("" : "=m" (UART2_TYPE->DR) : "r" (UART2_TYPE->DR));
+
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    xSemaphoreGiveFromISR(rxIdle, &xHigherPriorityTaskWoken);
+    portYIELD_FROM_ISR( xHigherPriorityTaskWoken );
+  }
+#else
   if ((UART2_TYPE->SR & USART_FLAG_RXNE) != 0) 
   {
     BaseType_t xHigherPriorityTaskWoken = pdFALSE;
@@ -304,6 +425,7 @@ void __attribute__((used)) USART2_IRQHandler(void)
     xStreamBufferSendFromISR(rxStream, &rxData, 1, &xHigherPriorityTaskWoken );
     portYIELD_FROM_ISR( xHigherPriorityTaskWoken );
   }
+#endif
 
   if ((UART2_TYPE->SR & USART_FLAG_TXE) != 0)
   {
@@ -0,0 +1,82 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2023 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * sensors_bmi088_fifo.h - Parsing of the bmi088 FIFO data
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include "imu_types.h"
+
+/* Parsing of the data read from the bmi088 FIFOs
+ *
+ * The gyro FIFO holds frames of x, y and z (6 bytes, little endian) without
+ * headers. The accelerometer FIFO holds frames with a one byte header: data
+ * frames (x, y and z), skip frames, sensor time frames and configuration
+ * change frames. Reading past the fill level returns over-read frames.
+ */
+
+#define SENSORS_BMI088_FIFO_GYRO_FRAME_LENGTH 6
+#define SENSORS_BMI088_FIFO_ACCEL_FRAME_LENGTH 7
+
+/**
+ * @brief Parse gyro FIFO data
+ *
+ * @param data data read from the gyro FIFO
+ * @param length number of bytes
+ * @param samples the parsed samples
+ * @param maxSamples size of samples
+ * @return number of samples
+ */
+uint32_t sensorsBmi088FifoParseGyro(const uint8_t* data, uint32_t length, Axis3i16* samples, uint32_t maxSamples);
+
+/**
+ * @brief Parse accelerometer FIFO data
+ *
+ * Frames that are not data frames are skipped, parsing stops at an over-read
+ * frame or an incomplete frame.
+ *
+ * @param data data read from the accelerometer FIFO
+ * @param length number of bytes
+ * @param samples the parsed samples
+ * @param maxSamples size of samples
+ * @return number of samples
+ */
+uint32_t sensorsBmi088FifoParseAccel(const uint8_t* data, uint32_t length, Axis3i16* samples, uint32_t maxSamples);
+
+/**
+ * @brief Reconstruct the time of a sample read from a FIFO
+ *
+ * The samples are equally spaced. The time of one of the samples is known,
+ * for the gyro it is the time of the watermark interrupt, which is raised when
+ * sample (watermark - 1) is written. Samples after the reference were written
+ * after it.
+ *
+ * @param referenceTime time of the reference sample [us]
+ * @param referenceIndex index of the reference sample
+ * @param index index of the sample
+ * @param period sample period [us]
+ * @return time of the sample [us]
+ */
+uint64_t sensorsBmi088FifoSampleTime(uint64_t referenceTime, uint32_t referenceIndex, uint32_t index, uint32_t period);
@@ -32,6 +32,8 @@
 #include <stdbool.h>
 #include <stddef.h>
 
+#include "kve/kve.h"
+
 /**
  * Initialize the storage subsystem.
  *
@@ -64,6 +66,25 @@ bool storageTest();
  */
 bool storageStore(const char* key, const void* buffer, size_t length);
 
+typedef kveItem_t storageItem_t;
+
+/**
+ * Store a number of buffers in one pass. Existing keys are replaced.
+ *
+ * This is faster than calling storageStore() for each buffer. The free space is
+ * checked first and if the buffers do not fit, nothing is written. New keys
+ * and buffers that change size are committed together, a reset during the
+ * call stores all or none of them. Buffers that keep their size are written
+ * in place after the commit.
+ *
+ * @param[items] The keys and buffers to store. Each key must only be used
+ *               once, nothing is written otherwise.
+ * @param[count] Number of items
+ *
+ * @return true in case of success, false otherwise.
+ */
+bool storageStoreBatch(const storageItem_t* items, size_t count);
+
 /**
  * Fetch a buffer from the memory at some key.
  *
@@ -86,6 +107,31 @@ size_t storageFetch(const char *key, void* buffer, size_t length);
  */
 bool storageDelete(const char* key);
 
+typedef kveStats_t storageStats_t;
+
+/**
+ * Get the space accounting of the storage.
+ *
+ * Deleted or resized buffers leave holes in the memory. The holes are compacted
+ * a few items at a time by the worker when the free length gets low.
+ *
+ * @param[stats] Filled with the used, hole and free lengths in bytes
+ *
+ * @return true in case of success. false if the memory is corrupted.
+ */
+bool storageGetStats(storageStats_t* stats);
+
+/**
+ * Check if storing a buffer would compact the full memory before writing it.
+ * The compaction blocks the caller for the time of many EEPROM page writes.
+ *
+ * @param[key] Null terminated string for the key.
+ * @param[length] Length of the buffer to store
+ *
+ * @return true if the store would compact the memory.
+ */
+bool storageStoreNeedsCompaction(const char* key, size_t length);
+
 // A user function that can be supplied to storageForeach, see below
 typedef bool (*storageFunc_t)(const char *key, void *buffer, size_t length);
 
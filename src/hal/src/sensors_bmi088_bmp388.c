@@ -47,13 +47,18 @@
 #include "sound.h"
 #include "filter.h"
 #include "i2cdev.h"
+#include "i2c_async.h"
 #include "bmi088.h"
 #include "bmp3.h"
 #include "bstdr_types.h"
 #include "static_mem.h"
 #include "estimator.h"
+#include "usec_time.h"
 
 #include "sensors_bmi088_common.h"
+#ifdef CONFIG_SENSORS_BMI088_FIFO
+#include "sensors_bmi088_fifo.h"
+#endif
 
 #define GYRO_ADD_RAW_AND_VARIANCE_LOG_VALUES
 
@@ -89,6 +94,25 @@
 
 #define SENSORS_ACC_SCALE_SAMPLES  200
 
+#ifdef CONFIG_SENSORS_BMI088_FIFO
+// The gyro FIFO watermark wakes up the sensors task at SENSORS_READ_RATE_HZ
+#define SENSORS_FIFO_GYRO_RATE_HZ       2000
+#define SENSORS_FIFO_ACCEL_RATE_HZ      1600
+#define SENSORS_FIFO_GYRO_PERIOD_US     (1000000 / SENSORS_FIFO_GYRO_RATE_HZ)
+#define SENSORS_FIFO_ACCEL_PERIOD_US    (1000000 / SENSORS_FIFO_ACCEL_RATE_HZ)
+#define SENSORS_FIFO_GYRO_WATERMARK     (SENSORS_FIFO_GYRO_RATE_HZ / SENSORS_READ_RATE_HZ)
+// Max number of frames read from a FIFO in one burst. A larger gyro backlog is read in more bursts, the
+// rest of the accelerometer FIFO in the next round
+#define SENSORS_FIFO_MAX_FRAMES         16
+
+#define SENSORS_FIFO_GYRO_INT_CTRL_FIFO_EN    0x40
+#define SENSORS_FIFO_GYRO_INT3_FIFO           0x04
+#define SENSORS_FIFO_GYRO_WM_INT_EN           0x88
+#define SENSORS_FIFO_GYRO_MODE_STREAM         0x80
+#define SENSORS_FIFO_ACCEL_MODE_STREAM        0x02
+#define SENSORS_FIFO_ACCEL_CONFIG_ACC_EN      0x50
+#endif
+
 typedef struct
 {
   Axis3f     bias;
@@ -112,6 +136,9 @@ static xQueueHandle magnetometerDataQueue;
 STATIC_MEM_QUEUE_ALLOC(magnetometerDataQueue, 1, sizeof(Axis3f));
 static xQueueHandle barometerDataQueue;
 STATIC_MEM_QUEUE_ALLOC(barometerDataQueue, 1, sizeof(baro_t));
+// Barometer samples from the asynchronous read, to be enqueued by the sensors task
+static xQueueHandle barometerSampleQueue;
+STATIC_MEM_QUEUE_ALLOC(barometerSampleQueue, 1, sizeof(baro_t));
 
 static xSemaphoreHandle sensorsDataReady;
 static StaticSemaphore_t sensorsDataReadyBuffer;
@@ -144,6 +171,37 @@ static void applyAxis3fLpf(lpf2pData *data, Axis3f* in);
 
 static bool isBarometerPresent = false;
 static uint8_t baroMeasDelayMin = SENSORS_DELAY_BARO;
+// Read by DMA through an asynchronous I2C request, must not be in CCM
+static uint8_t baroRegData[BMP3_P_T_DATA_LEN];
+static volatile bool isBaroReadPending = false;
+
+// Time from the IMU interrupt to the data being delivered to the stabilizer
+static uint32_t deliveryLatency;
+static uint32_t deliveryJitter;
+static uint32_t deliveryLatencyMin = UINT32_MAX;
+static uint32_t deliveryLatencyMax;
+static uint16_t deliveryLatencyCount;
+
+// Rate of the samples through the low pass filters
+static uint16_t gyroSampleRate = SENSORS_READ_RATE_HZ;
+static uint16_t accSampleRate = SENSORS_READ_RATE_HZ;
+
+#ifdef CONFIG_SENSORS_BMI088_FIFO
+static bool useFifo = false;
+// The task was woken up to read frames left in the gyro FIFO, not by the watermark interrupt
+static uint64_t latestGyroSampleTime;
+
+NO_DMA_CCM_SAFE_ZERO_INIT static uint8_t fifoData[SENSORS_FIFO_MAX_FRAMES * SENSORS_BMI088_FIFO_ACCEL_FRAME_LENGTH];
+NO_DMA_CCM_SAFE_ZERO_INIT static Axis3i16 fifoGyroSamples[SENSORS_FIFO_MAX_FRAMES];
+NO_DMA_CCM_SAFE_ZERO_INIT static uint64_t fifoGyroTimes[SENSORS_FIFO_MAX_FRAMES];
+NO_DMA_CCM_SAFE_ZERO_INIT static Axis3i16 fifoAccSamples[SENSORS_FIFO_MAX_FRAMES];
+NO_DMA_CCM_SAFE_ZERO_INIT static uint64_t fifoAccTimes[SENSORS_FIFO_MAX_FRAMES];
+
+static uint8_t fifoGyroFrames;
+static uint8_t fifoAccFrames;
+static uint32_t fifoGyroOverruns;
+static uint32_t fifoBacklogs;
+#endif
 
 // Precalculated values for IMU alignment
 static float sphi   = sinf(IMU_PHI * (float) M_PI / 180);
@@ -285,14 +343,262 @@ bool sensorsBmi088Bmp388AreCalibrated()
   return gyroBiasFound;
 }
 
-static void sensorsTask(void *param)
+static void processGyroSample(const Axis3i16* raw, const uint64_t timestamp)
 {
-  systemWaitStart();
-
   Axis3f gyroScaledIMU;
+  measurement_t measurement;
+
+  gyroRaw = *raw;
+
+  /* calibrate if necessary */
+#ifdef GYRO_BIAS_LIGHT_WEIGHT
+  gyroBiasFound = processGyroBiasNoBuffer(gyroRaw.x, gyroRaw.y, gyroRaw.z, &gyroBias);
+#else
+  gyroBiasFound = processGyroBias(gyroRaw.x, gyroRaw.y, gyroRaw.z, &gyroBias);
+#endif
+
+  gyroScaledIMU.x =  (gyroRaw.x - gyroBias.x) * SENSORS_BMI088_DEG_PER_LSB_CFG;
+  gyroScaledIMU.y =  (gyroRaw.y - gyroBias.y) * SENSORS_BMI088_DEG_PER_LSB_CFG;
+  gyroScaledIMU.z =  (gyroRaw.z - gyroBias.z) * SENSORS_BMI088_DEG_PER_LSB_CFG;
+  sensorsAlignToAirframe(&gyroScaledIMU, &sensorData.gyro);
+  applyAxis3fLpf((lpf2pData*)(&gyroLpf), &sensorData.gyro);
+
+  measurement.type = MeasurementTypeGyroscope;
+  measurement.data.gyroscope.gyro = sensorData.gyro;
+  estimatorEnqueueAt(&measurement, timestamp);
+}
+
+static void processAccSample(const Axis3i16* raw, const uint64_t timestamp)
+{
   Axis3f accScaledIMU;
   Axis3f accScaled;
   measurement_t measurement;
+
+  accelRaw = *raw;
+
+  if (gyroBiasFound)
+  {
+     processAccScale(accelRaw.x, accelRaw.y, accelRaw.z);
+  }
+
+  accScaledIMU.x = accelRaw.x * SENSORS_BMI088_G_PER_LSB_CFG / accScale;
+  accScaledIMU.y = accelRaw.y * SENSORS_BMI088_G_PER_LSB_CFG / accScale;
+  accScaledIMU.z = accelRaw.z * SENSORS_BMI088_G_PER_LSB_CFG / accScale;
+  sensorsAlignToAirframe(&accScaledIMU, &accScaled);
+  sensorsAccAlignToGravity(&accScaled, &sensorData.acc);
+  applyAxis3fLpf((lpf2pData*)(&accLpf), &sensorData.acc);
+
+  measurement.type = MeasurementTypeAcceleration;
+  measurement.data.acceleration.acc = sensorData.acc;
+  estimatorEnqueueAt(&measurement, timestamp);
+}
+
+#ifdef CONFIG_SENSORS_BMI088_FIFO
+/**
+ * Read up to SENSORS_FIFO_MAX_FRAMES frames of the gyro FIFO. The watermark
+ * interrupt is raised when frame (watermark - 1) is written, which gives the
+ * time of all frames in the FIFO. Frames of a continued read follow the latest
+ * frame of the previous read. isBacklogged is set if frames are left in the
+ * FIFO.
+ */
+static uint32_t readGyroFifo(const bool isContinued, bool* isBacklogged)
+{
+  uint8_t status = 0;
+  bmi088_get_gyro_regs(BMI088_GYRO_FIFO_STAT_REG, &status, 1, &bmi088Dev);
+  if (status & BMI088_GYRO_FIFO_OVERRUN_MASK)
+  {
+    fifoGyroOverruns++;
+  }
+
+  uint32_t frames = status & BMI088_GYRO_FIFO_COUNTER_MASK;
+  *isBacklogged = false;
+  if (frames > SENSORS_FIFO_MAX_FRAMES)
+  {
+    frames = SENSORS_FIFO_MAX_FRAMES;
+    *isBacklogged = true;
+  }
+
+  if (frames == 0)
+  {
+    return 0;
+  }
+
+  bmi088_get_gyro_regs(BMI088_GYRO_FIFO_DATA_REG, fifoData, frames * SENSORS_BMI088_FIFO_GYRO_FRAME_LENGTH, &bmi088Dev);
+  const uint32_t count = sensorsBmi088FifoParseGyro(fifoData, frames * SENSORS_BMI088_FIFO_GYRO_FRAME_LENGTH, fifoGyroSamples, SENSORS_FIFO_MAX_FRAMES);
+
+  for (uint32_t i = 0; i < count; i++)
+  {
+    if (isContinued)
+    {
+      fifoGyroTimes[i] = sensorsBmi088FifoSampleTime(latestGyroSampleTime, 0, i + 1, SENSORS_FIFO_GYRO_PERIOD_US);
+    }
+    else
+    {
+      fifoGyroTimes[i] = sensorsBmi088FifoSampleTime(imuIntTimestamp, SENSORS_FIFO_GYRO_WATERMARK - 1, i, SENSORS_FIFO_GYRO_PERIOD_US);
+    }
+  }
+
+  latestGyroSampleTime = fifoGyroTimes[count - 1];
+
+  return count;
+}
+
+/**
+ * Read the accelerometer FIFO. The accelerometer does not raise interrupts,
+ * the frames are timed back from the time of the read, assuming that the
+ * latest frame was written half a period before.
+ */
+static uint32_t readAccFifo(void)
+{
+  const uint64_t readTime = usecTimestamp();
+
+  uint8_t length[2] = {0};
+  bmi088_get_accel_regs(BMI088_ACCEL_FIFO_LENGTH_0_REG, length, 2, &bmi088Dev);
+  uint32_t bytes = length[0] | ((length[1] & 0x3F) << 8);
+  if (bytes > sizeof(fifoData))
+  {
+    // A frame that is not read completely is read again in the next round
+    bytes = sizeof(fifoData);
+    fifoBacklogs++;
+  }
+
+  if (bytes == 0)
+  {
+    return 0;
+  }
+
+  bmi088_get_accel_regs(BMI088_ACCEL_FIFO_DATA_REG, fifoData, bytes, &bmi088Dev);
+  const uint32_t count = sensorsBmi088FifoParseAccel(fifoData, bytes, fifoAccSamples, SENSORS_FIFO_MAX_FRAMES);
+
+  const uint64_t latestSampleTime = readTime - SENSORS_FIFO_ACCEL_PERIOD_US / 2;
+  for (uint32_t i = 0; i < count; i++)
+  {
+    fifoAccTimes[i] = sensorsBmi088FifoSampleTime(latestSampleTime, count - 1, i, SENSORS_FIFO_ACCEL_PERIOD_US);
+  }
+
+  return count;
+}
+
+/**
+ * Drain the FIFOs in one round. The watermark interrupt is not raised again
+ * while the gyro FIFO is above the watermark, so a backlog is read in bursts of
+ * SENSORS_FIFO_MAX_FRAMES until it is gone. The bursts are read faster than
+ * the FIFO fills up.
+ */
+static void readFifos(void)
+{
+  const uint32_t accCount = readAccFifo();
+  fifoAccFrames = accCount;
+
+  // Pass the samples on in time order
+  uint32_t accIndex = 0;
+  uint32_t gyroFrames = 0;
+  bool isBacklogged = false;
+  do
+  {
+    const uint32_t gyroCount = readGyroFifo(isBacklogged, &isBacklogged);
+    gyroFrames += gyroCount;
+    if (isBacklogged)
+    {
+      fifoBacklogs++;
+    }
+
+    uint32_t gyroIndex = 0;
+    while (gyroIndex < gyroCount)
+    {
+      if (accIndex < accCount && fifoAccTimes[accIndex] < fifoGyroTimes[gyroIndex])
+      {
+        processAccSample(&fifoAccSamples[accIndex], fifoAccTimes[accIndex]);
+        accIndex++;
+      }
+      else
+      {
+        processGyroSample(&fifoGyroSamples[gyroIndex], fifoGyroTimes[gyroIndex]);
+        gyroIndex++;
+      }
+    }
+  } while (isBacklogged);
+  fifoGyroFrames = gyroFrames;
+
+  while (accIndex < accCount)
+  {
+    processAccSample(&fifoAccSamples[accIndex], fifoAccTimes[accIndex]);
+    accIndex++;
+  }
+}
+#endif
+
+static void baroReadDone(bool success, void* arg)
+{
+  if (success)
+  {
+    struct bmp3_data data;
+    if (bmp3_parse_sensor_data(BMP3_PRESS | BMP3_TEMP, baroRegData, &data, &bmp388Dev) == BMP3_OK)
+    {
+      baro_t baro;
+      sensorsScaleBaro(&baro, data.pressure, data.temperature);
+      xQueueOverwrite(barometerSampleQueue, &baro);
+    }
+  }
+
+  isBaroReadPending = false;
+}
+
+/**
+ * Start reading the barometer without blocking the IMU, the result is picked
+ * up by the sensors task in a later round.
+ */
+static void startBaroRead(void)
+{
+  if (isBaroReadPending)
+  {
+    return;
+  }
+
+  I2cMessage message;
+  i2cdrvCreateMessageIntAddr(&message, bmp388Dev.dev_id, false, BMP3_DATA_ADDR,
+                             i2cRead, sizeof(baroRegData), baroRegData);
+
+  isBaroReadPending = true;
+  if (!i2cAsyncSubmit(I2C3_DEV, &message, baroReadDone, NULL))
+  {
+    isBaroReadPending = false;
+  }
+}
+
+/**
+ * Track the latency from the IMU interrupt to the delivery of the data, and
+ * its spread (max - min) over the last second.
+ */
+static void updateDeliveryLatency(const uint64_t interruptTimestamp)
+{
+  const uint32_t latency = usecTimestamp() - interruptTimestamp;
+
+  deliveryLatency = latency;
+  if (latency < deliveryLatencyMin)
+  {
+    deliveryLatencyMin = latency;
+  }
+  if (latency > deliveryLatencyMax)
+  {
+    deliveryLatencyMax = latency;
+  }
+
+  if (++deliveryLatencyCount >= SENSORS_READ_RATE_HZ)
+  {
+    deliveryJitter = deliveryLatencyMax - deliveryLatencyMin;
+    deliveryLatencyMin = UINT32_MAX;
+    deliveryLatencyMax = 0;
+    deliveryLatencyCount = 0;
+  }
+}
+
+static void sensorsTask(void *param)
+{
+  systemWaitStart();
+
+  Axis3i16 raw;
+  measurement_t measurement;
   /* wait an additional second the keep bus free
    * this is only required by the z-ranger, since the
    * configuration will be done after system start-up */
@@ -303,43 +609,20 @@ static void sensorsTask(void *param)
     {
       sensorData.interruptTimestamp = imuIntTimestamp;
 
-      /* get data from chosen sensors */
-      sensorsGyroGet(&gyroRaw);
-      sensorsAccelGet(&accelRaw);
-
-      /* calibrate if necessary */
-#ifdef GYRO_BIAS_LIGHT_WEIGHT
-      gyroBiasFound = processGyroBiasNoBuffer(gyroRaw.x, gyroRaw.y, gyroRaw.z, &gyroBias);
-#else
-      gyroBiasFound = processGyroBias(gyroRaw.x, gyroRaw.y, gyroRaw.z, &gyroBias);
+#ifdef CONFIG_SENSORS_BMI088_FIFO
+      if (useFifo)
+      {
+        readFifos();
+      }
+      else
 #endif
-      if (gyroBiasFound)
       {
-         processAccScale(accelRaw.x, accelRaw.y, accelRaw.z);
+        /* get data from chosen sensors */
+        sensorsGyroGet(&raw);
+        processGyroSample(&raw, imuIntTimestamp);
+        sensorsAccelGet(&raw);
+        processAccSample(&raw, imuIntTimestamp);
       }
-
-      /* Gyro */
-      gyroScaledIMU.x =  (gyroRaw.x - gyroBias.x) * SENSORS_BMI088_DEG_PER_LSB_CFG;
-      gyroScaledIMU.y =  (gyroRaw.y - gyroBias.y) * SENSORS_BMI088_DEG_PER_LSB_CFG;
-      gyroScaledIMU.z =  (gyroRaw.z - gyroBias.z) * SENSORS_BMI088_DEG_PER_LSB_CFG;
-      sensorsAlignToAirframe(&gyroScaledIMU, &sensorData.gyro);
-      applyAxis3fLpf((lpf2pData*)(&gyroLpf), &sensorData.gyro);
-
-      measurement.type = MeasurementTypeGyroscope;
-      measurement.data.gyroscope.gyro = sensorData.gyro;
-      estimatorEnqueue(&measurement);
-      
-      /* Acelerometer */
-      accScaledIMU.x = accelRaw.x * SENSORS_BMI088_G_PER_LSB_CFG / accScale;
-      accScaledIMU.y = accelRaw.y * SENSORS_BMI088_G_PER_LSB_CFG / accScale;
-      accScaledIMU.z = accelRaw.z * SENSORS_BMI088_G_PER_LSB_CFG / accScale;
-      sensorsAlignToAirframe(&accScaledIMU, &accScaled);
-      sensorsAccAlignToGravity(&accScaled, &sensorData.acc);
-      applyAxis3fLpf((lpf2pData*)(&accLpf), &sensorData.acc);
-
-      measurement.type = MeasurementTypeAcceleration;
-      measurement.data.acceleration.acc = sensorData.acc;
-      estimatorEnqueue(&measurement);
     }
 
     if (isBarometerPresent)
@@ -347,18 +630,15 @@ static void sensorsTask(void *param)
       static uint8_t baroMeasDelay = SENSORS_DELAY_BARO;
       if (--baroMeasDelay == 0)
       {
-        uint8_t sensor_comp = BMP3_PRESS | BMP3_TEMP;
-        struct bmp3_data data;
-        baro_t* baro388 = &sensorData.baro;
-        /* Temperature and Pressure data are read and stored in the bmp3_data instance */
-        bmp3_get_sensor_data(sensor_comp, &data, &bmp388Dev);
-        sensorsScaleBaro(baro388, data.pressure, data.temperature);
+        startBaroRead();
+        baroMeasDelay = baroMeasDelayMin;
+      }
 
+      if (pdTRUE == xQueueReceive(barometerSampleQueue, &sensorData.baro, 0))
+      {
         measurement.type = MeasurementTypeBarometer;
         measurement.data.barometer.baro = sensorData.baro;
         estimatorEnqueue(&measurement);
-
-        baroMeasDelay = baroMeasDelayMin;
       }
     }
     xQueueOverwrite(accelerometerDataQueue, &sensorData.acc);
@@ -368,6 +648,7 @@ static void sensorsTask(void *param)
       xQueueOverwrite(barometerDataQueue, &sensorData.baro);
     }
 
+    updateDeliveryLatency(sensorData.interruptTimestamp);
     xSemaphoreGive(dataReady);
   }
 }
@@ -377,6 +658,50 @@ void sensorsBmi088Bmp388WaitDataReady(void)
   xSemaphoreTake(dataReady, portMAX_DELAY);
 }
 
+#ifdef CONFIG_SENSORS_BMI088_FIFO
+/**
+ * Run the gyro at 2 kHz and the accelerometer at 1.6 kHz through their FIFOs
+ * in stream mode. The data ready interrupt of the gyro is replaced by the FIFO
+ * watermark interrupt on the same pin.
+ */
+static bool sensorsFifoInit(void)
+{
+  bstdr_ret_t rslt = BSTDR_OK;
+  uint8_t reg;
+
+  bmi088Dev.gyro_cfg.bw = BMI088_GYRO_BW_230_ODR_2000_HZ;
+  bmi088Dev.gyro_cfg.odr = BMI088_GYRO_BW_230_ODR_2000_HZ;
+  rslt |= bmi088_set_gyro_meas_conf(&bmi088Dev);
+
+  reg = SENSORS_FIFO_GYRO_WATERMARK;
+  rslt |= bmi088_set_gyro_regs(BMI088_GYRO_FIFO_CONFIG_0_REG, &reg, 1, &bmi088Dev);
+  reg = SENSORS_FIFO_GYRO_MODE_STREAM;
+  rslt |= bmi088_set_gyro_regs(BMI088_GYRO_FIFO_CONFIG_1_REG, &reg, 1, &bmi088Dev);
+  reg = SENSORS_FIFO_GYRO_WM_INT_EN;
+  rslt |= bmi088_set_gyro_regs(BMI088_GYRO_INT_EN_REG, &reg, 1, &bmi088Dev);
+  reg = SENSORS_FIFO_GYRO_INT3_FIFO;
+  rslt |= bmi088_set_gyro_regs(BMI088_GYRO_INT3_INT4_IO_MAP_REG, &reg, 1, &bmi088Dev);
+  reg = SENSORS_FIFO_GYRO_INT_CTRL_FIFO_EN;
+  rslt |= bmi088_set_gyro_regs(BMI088_GYRO_INT_CTRL_REG, &reg, 1, &bmi088Dev);
+
+  reg = SENSORS_FIFO_ACCEL_MODE_STREAM;
+  rslt |= bmi088_set_accel_regs(BMI088_ACCEL_FIFO_CONFIG_0_REG, &reg, 1, &bmi088Dev);
+  reg = SENSORS_FIFO_ACCEL_CONFIG_ACC_EN;
+  rslt |= bmi088_set_accel_regs(BMI088_ACCEL_FIFO_CONFIG_1_REG, &reg, 1, &bmi088Dev);
+
+  if (rslt != BSTDR_OK)
+  {
+    DEBUG_PRINT("BMI088 FIFO config [FAIL]\n");
+    return false;
+  }
+
+  gyroSampleRate = SENSORS_FIFO_GYRO_RATE_HZ;
+  accSampleRate = SENSORS_FIFO_ACCEL_RATE_HZ;
+  DEBUG_PRINT("BMI088 FIFO config [OK]\n");
+  return true;
+}
+#endif
+
 static void sensorsDeviceInit(void)
 {
   if (isInit)
@@ -521,11 +846,18 @@ static void sensorsDeviceInit(void)
 #endif
   }
 
+#ifdef CONFIG_SENSORS_BMI088_FIFO
+  if (bmi088Dev.interface == BMI088_SPI_INTF)
+  {
+    useFifo = sensorsFifoInit();
+  }
+#endif
+
   // Init second order filer for accelerometer and gyro
   for (uint8_t i = 0; i < 3; i++)
   {
-    lpf2pInit(&gyroLpf[i], 1000, GYRO_LPF_CUTOFF_FREQ);
-    lpf2pInit(&accLpf[i],  1000, ACCEL_LPF_CUTOFF_FREQ);
+    lpf2pInit(&gyroLpf[i], gyroSampleRate, GYRO_LPF_CUTOFF_FREQ);
+    lpf2pInit(&accLpf[i],  accSampleRate, ACCEL_LPF_CUTOFF_FREQ);
   }
 
   cosPitch = cosf(configblockGetCalibPitch() * (float) M_PI / 180);
@@ -542,6 +874,7 @@ static void sensorsTaskInit(void)
   gyroDataQueue = STATIC_MEM_QUEUE_CREATE(gyroDataQueue);
   magnetometerDataQueue = STATIC_MEM_QUEUE_CREATE(magnetometerDataQueue);
   barometerDataQueue = STATIC_MEM_QUEUE_CREATE(barometerDataQueue);
+  barometerSampleQueue = STATIC_MEM_QUEUE_CREATE(barometerSampleQueue);
 
   STATIC_MEM_TASK_CREATE(sensorsTask, sensorsTask, SENSORS_TASK_NAME, NULL, SENSORS_TASK_PRI);
 }
@@ -935,7 +1268,7 @@ void sensorsBmi088Bmp388SetAccMode(accModes accMode)
       }
       for (uint8_t i = 0; i < 3; i++)
       {
-        lpf2pInit(&accLpf[i],  1000, 500);
+        lpf2pInit(&accLpf[i],  accSampleRate, 500);
       }
       break;
     case ACC_MODE_FLIGHT:
@@ -950,7 +1283,7 @@ void sensorsBmi088Bmp388SetAccMode(accModes accMode)
       }
       for (uint8_t i = 0; i < 3; i++)
       {
-        lpf2pInit(&accLpf[i],  1000, ACCEL_LPF_CUTOFF_FREQ);
+        lpf2pInit(&accLpf[i],  accSampleRate, ACCEL_LPF_CUTOFF_FREQ);
       }
       break;
   }
@@ -986,6 +1319,44 @@ LOG_ADD(LOG_FLOAT, zVariance, &gyroBiasRunning.variance.z)
 LOG_GROUP_STOP(gyro)
 #endif
 
+#ifdef CONFIG_SENSORS_BMI088_FIFO
+/**
+ * Reading of the bmi088 through its FIFOs, see CONFIG_SENSORS_BMI088_FIFO
+ */
+LOG_GROUP_START(imuFifo)
+/**
+ * @brief Number of gyro samples read in the latest round
+ */
+LOG_ADD(LOG_UINT8, gyroFrames, &fifoGyroFrames)
+/**
+ * @brief Number of accelerometer samples read in the latest round
+ */
+LOG_ADD(LOG_UINT8, accFrames, &fifoAccFrames)
+/**
+ * @brief Number of times the gyro FIFO has been full and lost samples
+ */
+LOG_ADD(LOG_UINT32, gyroOverruns, &fifoGyroOverruns)
+/**
+ * @brief Number of times a FIFO held more samples than can be read in one burst
+ */
+LOG_ADD(LOG_UINT32, backlogs, &fifoBacklogs)
+LOG_GROUP_STOP(imuFifo)
+#endif
+
+/**
+ * Timing of the delivery of IMU data from the sensors task
+ */
+LOG_GROUP_START(imuDelivery)
+/**
+ * @brief Time from the IMU interrupt to the data being delivered [us]
+ */
+LOG_ADD(LOG_UINT32, latency, &deliveryLatency)
+/**
+ * @brief Difference between the max and min latency over the last second [us]
+ */
+LOG_ADD(LOG_UINT32, jitter, &deliveryJitter)
+LOG_GROUP_STOP(imuDelivery)
+
 PARAM_GROUP_START(imu_sensors)
 
 /**
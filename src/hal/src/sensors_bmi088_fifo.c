@@ -0,0 +1,92 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2023 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * sensors_bmi088_fifo.c - Parsing of the bmi088 FIFO data
+ */
+
+#include "sensors_bmi088_fifo.h"
+
+// Accelerometer FIFO frame headers, the two lowest bits of data frames are interrupt tags
+#define ACCEL_HEADER_TAG_MASK 0xFC
+#define ACCEL_HEADER_DATA 0x84
+#define ACCEL_HEADER_SKIP 0x40
+#define ACCEL_HEADER_SENSOR_TIME 0x44
+#define ACCEL_HEADER_CONFIG_CHANGE 0x48
+#define ACCEL_HEADER_DROP 0x50
+
+static void parseAxes(const uint8_t* data, Axis3i16* sample) {
+  sample->x = (int16_t)(data[0] | (data[1] << 8));
+  sample->y = (int16_t)(data[2] | (data[3] << 8));
+  sample->z = (int16_t)(data[4] | (data[5] << 8));
+}
+
+uint32_t sensorsBmi088FifoParseGyro(const uint8_t* data, uint32_t length, Axis3i16* samples, uint32_t maxSamples) {
+  uint32_t count = 0;
+  for (uint32_t i = 0; i + SENSORS_BMI088_FIFO_GYRO_FRAME_LENGTH <= length && count < maxSamples; i += SENSORS_BMI088_FIFO_GYRO_FRAME_LENGTH) {
+    parseAxes(&data[i], &samples[count]);
+    count++;
+  }
+
+  return count;
+}
+
+uint32_t sensorsBmi088FifoParseAccel(const uint8_t* data, uint32_t length, Axis3i16* samples, uint32_t maxSamples) {
+  uint32_t count = 0;
+  uint32_t i = 0;
+  while (i < length && count < maxSamples) {
+    const uint8_t header = data[i];
+    uint32_t frameLength;
+
+    if ((header & ACCEL_HEADER_TAG_MASK) == ACCEL_HEADER_DATA) {
+      frameLength = SENSORS_BMI088_FIFO_ACCEL_FRAME_LENGTH;
+    } else if (header == ACCEL_HEADER_SENSOR_TIME) {
+      frameLength = 4;
+    } else if (header == ACCEL_HEADER_SKIP || header == ACCEL_HEADER_CONFIG_CHANGE || header == ACCEL_HEADER_DROP) {
+      frameLength = 2;
+    } else {
+      // Over-read or unknown header, the rest of the data can not be parsed
+      break;
+    }
+
+    if (i + frameLength > length) {
+      break;
+    }
+
+    if (frameLength == SENSORS_BMI088_FIFO_ACCEL_FRAME_LENGTH) {
+      parseAxes(&data[i + 1], &samples[count]);
+      count++;
+    }
+
+    i += frameLength;
+  }
+
+  return count;
+}
+
+uint64_t sensorsBmi088FifoSampleTime(uint64_t referenceTime, uint32_t referenceIndex, uint32_t index, uint32_t period) {
+  if (index >= referenceIndex) {
+    return referenceTime + (uint64_t)(index - referenceIndex) * period;
+  }
+
+  return referenceTime - (uint64_t)(referenceIndex - index) * period;
+}
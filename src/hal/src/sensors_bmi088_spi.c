@@ -40,7 +40,12 @@
 
 /* Defines and buffers for full duplex SPI DMA transactions */
 /* The buffers must not be placed in CCM */
+#ifdef CONFIG_SENSORS_BMI088_FIFO
+// Room for the FIFO reads in sensors_bmi088_bmp388.c
+#define SPI_MAX_DMA_TRANSACTION_SIZE    128
+#else
 #define SPI_MAX_DMA_TRANSACTION_SIZE    15
+#endif
 static uint8_t spiTxBuffer[SPI_MAX_DMA_TRANSACTION_SIZE + 1];
 static uint8_t spiRxBuffer[SPI_MAX_DMA_TRANSACTION_SIZE + 1];
 static xSemaphoreHandle spiTxDMAComplete;
@@ -115,7 +120,7 @@ static void spiDMATransaction(uint8_t reg_addr,
                               uint8_t *reg_data,
                               uint16_t len)
 {
-  ASSERT(len < SPI_MAX_DMA_TRANSACTION_SIZE);
+  ASSERT(len <= SPI_MAX_DMA_TRANSACTION_SIZE);
 
   // Disable peripheral before setting up for duplex DMA
   SPI_Cmd(BMI088_SPI, DISABLE);
@@ -60,6 +60,8 @@
 #include "bmp280.h"
 #include "bmp3.h"
 #include "bstdr_comm_support.h"
+#include "i2cdev.h"
+#include "i2c_async.h"
 #include "static_mem.h"
 #include "estimator.h"
 
@@ -164,6 +166,9 @@ static xQueueHandle baroPrimDataQueue;
 STATIC_MEM_QUEUE_ALLOC(baroPrimDataQueue, 1, sizeof(Axis3f));
 static xQueueHandle magPrimDataQueue;
 STATIC_MEM_QUEUE_ALLOC(magPrimDataQueue, 1, sizeof(baro_t));
+// Magnetometer samples from the asynchronous read, picked up by the sensors task
+static xQueueHandle magSampleQueue;
+STATIC_MEM_QUEUE_ALLOC(magSampleQueue, 1, sizeof(Axis3f));
 
 static xSemaphoreHandle dataReady;
 static StaticSemaphore_t dataReadyBuffer;
@@ -178,6 +183,9 @@ static uint8_t sensorsAccLpfAttFactor;
 static bool isBarometerPresent = false;
 static bool isMagnetometerPresent = false;
 static uint8_t baroMeasDelayMin = SENSORS_DELAY_BARO;
+// Read by DMA through an asynchronous I2C request, must not be in CCM
+static uint8_t magRegData[BMM150_XYZR_DATA_LEN];
+static volatile bool isMagReadPending = false;
 
 // Pre-calculated values for accelerometer alignment
 static float cosPitch;
@@ -394,6 +402,7 @@ static void sensorsTaskInit(void)
   gyroSecDataQueue= STATIC_MEM_QUEUE_CREATE(gyroSecDataQueue);
 #endif
   magPrimDataQueue = STATIC_MEM_QUEUE_CREATE(magPrimDataQueue);
+  magSampleQueue = STATIC_MEM_QUEUE_CREATE(magSampleQueue);
   baroPrimDataQueue = STATIC_MEM_QUEUE_CREATE(baroPrimDataQueue);
 
   STATIC_MEM_TASK_CREATE(sensorsTask, sensorsTask, SENSORS_TASK_NAME, NULL, SENSORS_TASK_PRI);
@@ -483,6 +492,42 @@ sensorsAccelCalibrate(BiasObj* accel, BiasObj* gyro, uint8_t type) {
     }
 }
 
+static void sensorsMagReadDone(bool success, void* arg)
+{
+  if (success && bmm150_parse_mag_data(magRegData, &bmm150Dev) == BMM150_OK)
+    {
+      Axis3f mag;
+      mag.x = bmm150Dev.data.x;
+      mag.y = bmm150Dev.data.y;
+      mag.z = bmm150Dev.data.z;
+      xQueueOverwrite(magSampleQueue, &mag);
+    }
+
+  isMagReadPending = false;
+}
+
+/**
+ * Start reading the magnetometer without blocking the sensors task, the
+ * result is picked up in a later round.
+ */
+static void sensorsStartMagRead(void)
+{
+  if (isMagReadPending)
+    {
+      return;
+    }
+
+  I2cMessage message;
+  i2cdrvCreateMessageIntAddr(&message, bmm150Dev.id, false, BMM150_DATA_X_LSB,
+                             i2cRead, sizeof(magRegData), magRegData);
+
+  isMagReadPending = true;
+  if (!i2cAsyncSubmit(I2C1_DEV, &message, sensorsMagReadDone, NULL))
+    {
+      isMagReadPending = false;
+    }
+}
+
 static void sensorsTask(void *param)
 {
   measurement_t measurement;
@@ -628,12 +673,11 @@ static void sensorsTask(void *param)
 
           if (--magMeasDelay == 0)
             {
-              bmm150_read_mag_data(&bmm150Dev);
-              sensors.mag.x = bmm150Dev.data.x;
-              sensors.mag.y = bmm150Dev.data.y;
-              sensors.mag.z = bmm150Dev.data.z;
+              sensorsStartMagRead();
               magMeasDelay = SENSORS_DELAY_MAG;
             }
+
+          xQueueReceive(magSampleQueue, &sensors.mag, 0);
         }
 
       if (isBarometerPresent)
@@ -35,6 +35,8 @@
 
 #include "i2cdev.h"
 #include "eeprom.h"
+#include "static_mem.h"
+#include "worker.h"
 
 #include <string.h>
 
@@ -53,6 +55,16 @@
 #define KVE_PARTITION_START (1024)
 #define KVE_PARTITION_LENGTH (7*1024)
 
+// Number of items in the RAM index of the storage, if there are more items the
+// storage falls back to scanning the EEPROM.
+#define KVE_INDEX_CAPACITY (128)
+
+// Holes left by deleted items are compacted in the background, a few items at
+// a time, when the free space at the end of the table gets low. Compacting
+// early would rewrite the EEPROM more than needed.
+#define COMPACTION_FREE_LENGTH_THRESHOLD (1024)
+#define COMPACTION_STEP_LENGTH (64)
+
 static SemaphoreHandle_t storageMutex;
 
 static size_t readEeprom(size_t address, void* data, size_t length)
@@ -110,16 +122,52 @@ static void flushEeprom(void)
   // NOP for now, lets fix the EEPROM write first!
 }
 
+NO_DMA_CCM_SAFE_ZERO_INIT static kveIndexEntry_t kveIndexEntries[KVE_INDEX_CAPACITY];
+
+static kveIndex_t kveIndex = {
+  .entries = kveIndexEntries,
+  .capacity = KVE_INDEX_CAPACITY,
+};
+
 static kveMemory_t kve = {
   .memorySize = KVE_PARTITION_LENGTH,
   .read = readEeprom,
   .write = writeEeprom,
   .flush = flushEeprom,
+  .index = &kveIndex,
 };
 
 // Public API
 
 static bool isInit = false;
+static bool isCompactionScheduled = false;
+
+static void compactionWorker(void* arg)
+{
+  xSemaphoreTake(storageMutex, portMAX_DELAY);
+  bool isDone = kveDefragStep(&kve, COMPACTION_STEP_LENGTH);
+
+  // Reschedule to let other work run between the steps. The flag is only
+  // changed with the mutex taken, as in scheduleCompactionIfNeeded()
+  if (isDone || workerSchedule(compactionWorker, NULL) != 0) {
+    isCompactionScheduled = false;
+  }
+  xSemaphoreGive(storageMutex);
+}
+
+// Must be called with the storage mutex taken
+static void scheduleCompactionIfNeeded()
+{
+  kveStats_t stats;
+
+  if (isCompactionScheduled || !kveGetStats(&kve, &stats)) {
+    return;
+  }
+
+  if (stats.holeLength > 0 && stats.freeLength < COMPACTION_FREE_LENGTH_THRESHOLD) {
+    isCompactionScheduled = (workerSchedule(compactionWorker, NULL) == 0);
+  }
+}
 
 void storageInit()
 {
@@ -159,12 +207,28 @@ bool storageStore(const char* key, const void* buffer, size_t length)
   xSemaphoreTake(storageMutex, portMAX_DELAY);
 
   bool result = kveStore(&kve, key, buffer, length);
+  scheduleCompactionIfNeeded();
 
   xSemaphoreGive(storageMutex);
 
   return result;
 }
 
+bool storageStoreBatch(const storageItem_t* items, size_t count)
+{
+  if (!isInit) {
+    return false;
+  }
+
+  xSemaphoreTake(storageMutex, portMAX_DELAY);
+
+  bool result = kveStoreBatch(&kve, items, count);
+  scheduleCompactionIfNeeded();
+
+  xSemaphoreGive(storageMutex);
+
+  return result;
+}
 
 bool storageForeach(const char *prefix, storageFunc_t func)
 {
@@ -205,6 +269,37 @@ bool storageDelete(const char* key)
   xSemaphoreTake(storageMutex, portMAX_DELAY);
 
   bool result = kveDelete(&kve, key);
+  scheduleCompactionIfNeeded();
+
+  xSemaphoreGive(storageMutex);
+
+  return result;
+}
+
+bool storageGetStats(storageStats_t* stats)
+{
+  if (!isInit) {
+    return false;
+  }
+
+  xSemaphoreTake(storageMutex, portMAX_DELAY);
+
+  bool result = kveGetStats(&kve, stats);
+
+  xSemaphoreGive(storageMutex);
+
+  return result;
+}
+
+bool storageStoreNeedsCompaction(const char* key, size_t length)
+{
+  if (!isInit) {
+    return false;
+  }
+
+  xSemaphoreTake(storageMutex, portMAX_DELAY);
+
+  bool result = kveStoreNeedsDefrag(&kve, key, length);
 
   xSemaphoreGive(storageMutex);
 
@@ -51,6 +51,7 @@ static uint8_t sendBuffer[64];
 static int usblinkSendPacket(CRTPPacket *p);
 static int usblinkSetEnable(bool enable);
 static int usblinkReceivePacket(CRTPPacket *p);
+static int usblinkSendFrame(uint8_t *data, uint32_t length);
 
 STATIC_MEM_TASK_ALLOC(usblinkTask, USBLINK_TASK_STACKSIZE);
 
@@ -59,6 +60,10 @@ static struct crtpLinkOperations usblinkOp =
   .setEnable         = usblinkSetEnable,
   .sendPacket        = usblinkSendPacket,
   .receivePacket     = usblinkReceivePacket,
+  .sendFrame         = usblinkSendFrame,
+  // One USB transfer. This holds one full size packet or two packets of up to
+  // 29 data bytes, so only smaller packets gain from aggregation on USB.
+  .maxFrameSize      = USB_RX_TX_PACKET_SIZE,
 };
 
 /* Radio task handles the CRTP packet transfers as well as the radio link
@@ -112,6 +117,15 @@ static int usblinkSendPacket(CRTPPacket *p)
   return usbSendData(dataSize, sendBuffer);
 }
 
+static int usblinkSendFrame(uint8_t *data, uint32_t length)
+{
+  ASSERT(length <= USB_RX_TX_PACKET_SIZE);
+
+  ledseqRun(&seq_linkDown);
+
+  return usbSendData(length, data);
+}
+
 static int usblinkSetEnable(bool enable)
 {
   return 0;
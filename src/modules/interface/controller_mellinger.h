@@ -28,7 +28,10 @@
 
 #include "stabilizer_types.h"
 
+// Resets the controller, and clears the previous angular rates of the D term
 void controllerMellingerInit(void);
+// Clears the integrators, also done by the controller when the thrust setpoint is zero
+void controllerMellingerReset(void);
 bool controllerMellingerTest(void);
 void controllerMellinger(control_t *control, setpoint_t *setpoint,
                                          const sensorData_t *sensors,
@@ -29,6 +29,9 @@
 #include "stabilizer_types.h"
 
 void controllerPidInit(void);
+// Clears the PID and filter states, and the attitude, rate and thrust setpoints that are kept between calls. Not
+// done by controllerPidInit(), used to run independent simulations with the python bindings.
+void controllerPidReset(void);
 bool controllerPidTest(void);
 void controllerPid(control_t *control, setpoint_t *setpoint,
                                          const sensorData_t *sensors,
@@ -27,6 +27,10 @@
 
 #include "cpx.h"
 
+// Length of each of the three queues of pool packets: to external targets,
+// to CRTP and to the other functions
+#define CPX_INTERNAL_ROUTER_QUEUE_LENGTH 4
+
 /**
  * @brief Initialize the internal router
  * 
@@ -40,7 +44,9 @@ void cpxInternalRouterInit(void);
  * @brief Send a CPX packet
  *
  * This will send a packet to the ESP32 to be routed using CPX. This
- * will block until the packet can be queued up for sending.
+ * will block until the packet can be queued up for sending. Any number of
+ * tasks may send, they share the TX packets of the pool while received
+ * packets use a reserve, see CPX_PACKET_POOL_TX.
  *
  * @param packet packet to be sent
  */
@@ -66,15 +72,16 @@ void cpxInternalRouterReceiveOthers(CPXPacket_t * packet);
  * @brief Send a CPX packet from the external router into the internal
  * router
  * 
- * @param packet CPX packet to send
+ * @param packet CPX packet from the packet pool, the reference is handed
+ * over to the internal router
  */
-void cpxInternalRouterRouteIn(const CPXRoutablePacket_t* packet);
+void cpxInternalRouterRouteIn(CPXRoutablePacket_t* packet);
 
 /**
  * @brief Retrieve a CPX packet from the internal router to be
  * routed externally.
  * 
- * @param packet CPX packet where retrieved packet is stored
+ * @return CPX packet from the packet pool, the caller owns the reference
  */
-void cpxInternalRouterRouteOut(CPXRoutablePacket_t* packet);
+CPXRoutablePacket_t* cpxInternalRouterRouteOut(void);
 
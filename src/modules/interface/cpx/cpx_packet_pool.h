@@ -0,0 +1,88 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2022 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "cpx.h"
+#include "cpx_internal_router.h"
+#include "cpx_uart_transport.h"
+
+/* Pool of CPX packets shared by the routers and transports
+ *
+ * Packets are passed between routes as pointers into the pool. The holder of
+ * a packet owns it, passing a packet on to a route hands it over. The last
+ * holder releases the packet back to the pool.
+ */
+
+// Packets reserved for receiving from the UART. A received packet can wait in
+// the CRTP queue or the queue of the other functions of the internal router,
+// or be held by the router from the UART while it waits for room in them. The
+// ESP32 routes the packets between its other targets, so packets from the UART
+// are not routed back to it.
+#define CPX_PACKET_POOL_RX_RESERVED (2 * CPX_INTERNAL_ROUTER_QUEUE_LENGTH + 1)
+
+// Packets for sending. A sent packet can wait in the TX queue of the internal
+// router or the UART TX queue, or be held by the router from the internal
+// router while it waits for room, or by the UART TX task while it sends. One
+// more each for the CRTP TX and AI deck tasks lets them fill the queues.
+#define CPX_PACKET_POOL_TX (CPX_INTERNAL_ROUTER_QUEUE_LENGTH + CPX_UART_TRANSPORT_TX_QUEUE_LENGTH + 4)
+
+// Receiving never waits for the senders, so the UART keeps parsing RX and CTS
+// and the sent packets are always delivered. Any number of tasks may send with
+// cpxSendPacketBlocking(), they only wait for each other for TX packets.
+#define CPX_PACKET_POOL_SIZE (CPX_PACKET_POOL_RX_RESERVED + CPX_PACKET_POOL_TX)
+
+/**
+ * @brief Initialize the packet pool
+ *
+ * Must be called before any of the CPX routers or transports are initialized.
+ */
+void cpxPacketPoolInit(void);
+
+/**
+ * @brief Allocate a packet to send from the pool
+ *
+ * Blocks until a TX packet is free.
+ *
+ * @return a packet owned by the caller
+ */
+CPXRoutablePacket_t* cpxPacketPoolAllocate(void);
+
+/**
+ * @brief Allocate a packet for receiving from the reserve of the pool
+ *
+ * Blocks until a reserved packet is free, which does not depend on the
+ * senders. Only to be used by the UART transport.
+ *
+ * @return a packet owned by the caller
+ */
+CPXRoutablePacket_t* cpxPacketPoolAllocateRx(void);
+
+/**
+ * @brief Return a packet to the pool
+ *
+ * Releasing a packet that is not allocated is an error.
+ *
+ * @param packet packet from the pool
+ */
+void cpxPacketPoolRelease(CPXRoutablePacket_t* packet);
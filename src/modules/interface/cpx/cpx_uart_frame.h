@@ -0,0 +1,93 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2022 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <stdint.h>
+
+/* Framing of CPX packets on the UART
+ *
+ * A frame is a start byte (0xFF), the payload length, the payload and a
+ * checksum that is the XOR of all bytes before it. A frame without payload
+ * (and without checksum) is a clear-to-send from the other side.
+ *
+ * Frames are parsed in place in a circular buffer, that has a size that is a
+ * power of two. Indexes wrap around at the end of the buffer.
+ */
+
+#define CPX_UART_FRAME_START 0xFF
+#define CPX_UART_FRAME_HEADER_LENGTH 2
+#define CPX_UART_FRAME_CHECKSUM_LENGTH 1
+
+typedef enum {
+  cpxUartFrameIncomplete,
+  cpxUartFrameClearToSend,
+  cpxUartFramePacket,
+  cpxUartFrameBadChecksum,
+} cpxUartFrameResult_t;
+
+typedef struct {
+  // Index in the circular buffer of the first payload byte
+  uint32_t payloadIndex;
+  uint8_t payloadLength;
+  // Number of bytes consumed by the parser, including any garbage before the frame
+  uint32_t consumed;
+} cpxUartFrame_t;
+
+/**
+ * @brief Calculate the XOR checksum of data, a word at the time
+ *
+ * @param data data to calculate the checksum of
+ * @param length number of bytes
+ * @param checksum checksum of preceding data, 0 for the first call
+ * @return the checksum
+ */
+uint8_t cpxUartChecksum(const uint8_t* data, uint32_t length, uint8_t checksum);
+
+/**
+ * @brief Parse the first frame in a circular buffer
+ *
+ * Bytes before the start byte are skipped. If the frame is incomplete, the
+ * skipped bytes are consumed and parsing should be retried when more data is
+ * available. If the checksum is bad, only the start byte is consumed since
+ * the length may be corrupt, parsing should continue to find the next frame.
+ *
+ * @param buffer the circular buffer
+ * @param bufferSize size of the buffer, a power of two
+ * @param index index of the first byte to parse
+ * @param available number of bytes available from index
+ * @param frame the parsed frame
+ * @return the result of the parsing
+ */
+cpxUartFrameResult_t cpxUartFrameParse(const uint8_t* buffer, uint32_t bufferSize, uint32_t index, uint32_t available, cpxUartFrame_t* frame);
+
+/**
+ * @brief Copy data out of a circular buffer
+ *
+ * @param dest destination
+ * @param buffer the circular buffer
+ * @param bufferSize size of the buffer, a power of two
+ * @param index index of the first byte to copy
+ * @param length number of bytes to copy
+ */
+void cpxUartFrameCopy(uint8_t* dest, const uint8_t* buffer, uint32_t bufferSize, uint32_t index, uint32_t length);
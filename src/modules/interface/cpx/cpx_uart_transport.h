@@ -26,6 +26,8 @@
 #include "cpx.h"
 
 #define CPX_UART_TRANSPORT_MTU 100
+// Length of the queue of pool packets to send
+#define CPX_UART_TRANSPORT_TX_QUEUE_LENGTH 4
 
 /**
  * @brief Initialize the UART transport
@@ -51,9 +53,10 @@ void cpxUARTTransportDeinit();
  * This will send a CPX packet, packing it according to the
  * specification for the link.
  * 
- * @param packet CPX packet to send
+ * @param packet CPX packet from the packet pool to send, the reference is
+ * handed over to the transport and released when the packet has been sent
  */
-void cpxUARTTransportSend(const CPXRoutablePacket_t* packet);
+void cpxUARTTransportSend(CPXRoutablePacket_t* packet);
 
 /**
  * @brief Receive a CPX packet via the UART transport
@@ -61,6 +64,6 @@ void cpxUARTTransportSend(const CPXRoutablePacket_t* packet);
  * This will receive a CPX packet, unpacking it according to the
  * specification for the link.
  * 
- * @param packet CPX packet where received packet will be stored
+ * @return CPX packet from the packet pool, the caller owns the reference
  */
-void cpxUARTTransportReceive(CPXRoutablePacket_t* packet);
\ No newline at end of file
+CPXRoutablePacket_t* cpxUARTTransportReceive(void);
\ No newline at end of file
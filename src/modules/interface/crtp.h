@@ -36,6 +36,14 @@
 
 #define CRTP_IS_NULL_PACKET(P) ((P.header&0xF3)==0xF3)
 
+// Out of band link control in the data of null packets, the first data byte is the command
+#define CRTP_NULL_PACKET_HEADER CRTP_HEADER(0x0F, 0x03)
+#define CRTP_LINK_CTRL_TX_AGGREGATION 0x01
+#define CRTP_LINK_CTRL_FRAME 0x02
+
+// Overhead of an aggregated frame, the null packet header and the frame command
+#define CRTP_FRAME_HEADER_SIZE 2
+
 typedef enum {
   CRTP_PORT_CONSOLE          = 0x00,
   CRTP_PORT_PARAM            = 0x02,
@@ -105,7 +113,8 @@ void crtpRegisterPortCB(int port, CrtpCallback cb);
 /**
  * Put a packet in the TX task
  *
- * If the TX stack is full, the oldest lowest priority packet is dropped
+ * The packet is queued in the priority lane of its port. If the lane is
+ * full, the packet is dropped.
  *
  * @param[in] p CRTPPacket to send
  */
@@ -114,7 +123,7 @@ int crtpSendPacket(CRTPPacket *p);
 /**
  * Put a packet in the TX task
  *
- * If the TX stack is full, the function block until one place is free (Good for console implementation)
+ * If the priority lane of the port is full, the function block until one place is free (Good for console implementation)
  */
 int crtpSendPacketBlock(CRTPPacket *p);
 
@@ -146,6 +155,17 @@ int crtpReceivePacketWait(CRTPPort taskId, CRTPPacket *p, int wait);
  */
 int crtpGetFreeTxQueuePackets(void);
 
+/**
+ * Get the number of packets that can be queued on a port without being
+ * dropped. Producers of periodic data can use this to skip a sample when
+ * the link can not keep up, instead of having packets dropped.
+ *
+ * @param[in] port The CRTP port
+ *
+ * @return Number of free packets in the priority lane of the port
+ */
+int crtpGetTxCredits(CRTPPort port);
+
 /**
  * Wait for a packet to arrive for the specified taskID
  *
@@ -167,6 +187,9 @@ struct crtpLinkOperations
   int (*receivePacket)(CRTPPacket *pk);
   bool (*isConnected)(void);
   int (*reset)(void);
+  // Optional, send several packets aggregated in one transfer of up to maxFrameSize bytes
+  int (*sendFrame)(uint8_t *data, uint32_t length);
+  uint32_t maxFrameSize;
 };
 
 void crtpSetLink(struct crtpLinkOperations * lk);
@@ -187,4 +210,25 @@ bool crtpIsConnected(void);
  */
 int crtpReset(void);
 
+/**
+ * Enable or disable aggregation of TX packets on the current link.
+ *
+ * When enabled, queued packets are packed into frames that fill the MTU of
+ * the link. A frame is sent as a null packet with the command
+ * CRTP_LINK_CTRL_FRAME followed by the packets, each as one length byte
+ * (header and data) and the raw packet. Aggregation is only supported by
+ * links with a sendFrame() operation and is disabled when the link changes
+ * or the CRTP communication is reset.
+ *
+ * Aggregation is switched off immediately. When enabling, it is switched on
+ * by the TX task after it has sent the next link control reply
+ * (a null packet with the command CRTP_LINK_CTRL_TX_AGGREGATION) as a single
+ * packet, so the client always gets the reply unaggregated.
+ *
+ * @param[in] enable true to enable aggregation
+ *
+ * @return true if aggregation is enabled
+ */
+bool crtpSetTxAggregation(bool enable);
+
 #endif /*CRTP_H_*/
@@ -0,0 +1,64 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2023 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "crtp.h"
+
+/* Packing of CRTP packets into aggregated TX frames
+ *
+ * A frame is a null packet with the command CRTP_LINK_CTRL_FRAME, followed
+ * by the packets. Each packet is one length byte (header and data) and the
+ * raw packet, starting with its header.
+ */
+
+// Bytes used in a frame by a packet with dataSize bytes of data
+#define CRTP_FRAME_PACKET_SIZE(dataSize) (1 + 1 + (dataSize))
+
+typedef struct {
+  uint8_t* buffer;
+  uint32_t maxSize;
+  uint32_t length;
+  uint32_t packetCount;
+} crtpFrame_t;
+
+/**
+ * @brief Start an empty frame in a buffer
+ *
+ * @param frame the frame
+ * @param buffer where the frame is written, at least maxSize bytes
+ * @param maxSize max length of the frame, including the frame header
+ */
+void crtpFrameInit(crtpFrame_t* frame, uint8_t* buffer, uint32_t maxSize);
+
+/**
+ * @brief Add a packet at the end of a frame
+ *
+ * @param frame the frame
+ * @param p the packet to add
+ * @return true if the packet was added, false if it does not fit in the frame
+ */
+bool crtpFrameAdd(crtpFrame_t* frame, const CRTPPacket* p);
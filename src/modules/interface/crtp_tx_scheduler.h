@@ -0,0 +1,65 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2023 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <stdint.h>
+
+/* Weighted round robin scheduling of the CRTP TX lanes
+ *
+ * Each lane has a weight, the number of packets it may send in a round. A
+ * lane with packets and credits left is served before the lanes after it,
+ * so the first lane has the lowest latency. When all lanes with packets have
+ * used their credits a new round is started. This gives every lane a
+ * guaranteed share of the link when it is saturated, while an idle link is
+ * never held back.
+ */
+
+typedef enum {
+  crtpTxLaneHigh = 0,
+  crtpTxLaneNormal,
+  crtpTxLaneLow,
+  CRTP_TX_LANE_COUNT,
+} crtpTxLane_t;
+
+typedef struct {
+  uint8_t weights[CRTP_TX_LANE_COUNT];
+  uint8_t credits[CRTP_TX_LANE_COUNT];
+} crtpTxScheduler_t;
+
+/**
+ * @brief Initialize a scheduler and start the first round
+ *
+ * @param scheduler the scheduler
+ * @param weights number of packets each lane may send in a round, must be at least 1
+ */
+void crtpTxSchedulerInit(crtpTxScheduler_t* scheduler, const uint8_t weights[CRTP_TX_LANE_COUNT]);
+
+/**
+ * @brief Pick the lane to send the next packet from
+ *
+ * @param scheduler the scheduler
+ * @param pending number of packets waiting in each lane
+ * @return the lane to send from, or -1 if all lanes are empty
+ */
+int crtpTxSchedulerNext(crtpTxScheduler_t* scheduler, const uint32_t pending[CRTP_TX_LANE_COUNT]);
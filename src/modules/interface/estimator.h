@@ -58,6 +58,7 @@ typedef enum {
 typedef struct
 {
   MeasurementType type;
+  uint64_t timestamp; // Time of the measurement (us, see usecTimestamp()), set by estimatorEnqueue() or estimatorEnqueueAt()
   union
   {
     tdoaMeasurement_t tdoa;
@@ -83,7 +84,20 @@ StateEstimatorType getStateEstimator(void);
 const char* stateEstimatorGetName();
 
 // Support to incorporate additional sensors into the state estimate via the following functions
+//
+// Measurements are passed to the estimator through rings, one per measurement source:
+// - IMU: gyroscope, acceleration and barometer (sensors task)
+// - Lighthouse: sweep angles, yaw error and positions with source MeasurementSourceLighthouse (lighthouse task)
+// - Loco: TDOA, distance and absolute height (loco deck task)
+// - Flow: flow (flow deck task)
+// - Range: TOF (z-ranger task)
+// - External: other positions and pose (CRTP localization service, apps)
+// All rings but the external ring are lock free single producer rings, all measurements of one of these sources must be
+// enqueued from the same task or interrupt. The external ring may be fed from any task or interrupt.
 void estimatorEnqueue(const measurement_t *measurement);
+// Enqueue a measurement that was sampled at a known time (us, see usecTimestamp()), for instance samples read from a
+// sensor FIFO. The timestamps from one source must not decrease.
+void estimatorEnqueueAt(const measurement_t *measurement, const uint64_t timestamp);
 
 // These helper functions simplify the caller code, but cause additional memory copies
 static inline void estimatorEnqueueTDOA(const tdoaMeasurement_t *tdoa)
@@ -158,6 +172,63 @@ static inline void estimatorEnqueueSweepAngles(const sweepAngleMeasurement_t *sw
   estimatorEnqueue(&m);
 }
 
+// Helpers for measurements with a known capture time (us, see usecTimestamp())
+static inline void estimatorEnqueueTDOAAt(const tdoaMeasurement_t *tdoa, const uint64_t timestamp)
+{
+  measurement_t m;
+  m.type = MeasurementTypeTDOA;
+  m.data.tdoa = *tdoa;
+  estimatorEnqueueAt(&m, timestamp);
+}
+
+static inline void estimatorEnqueuePositionAt(const positionMeasurement_t *position, const uint64_t timestamp)
+{
+  measurement_t m;
+  m.type = MeasurementTypePosition;
+  m.data.position = *position;
+  estimatorEnqueueAt(&m, timestamp);
+}
+
+static inline void estimatorEnqueueDistanceAt(const distanceMeasurement_t *distance, const uint64_t timestamp)
+{
+  measurement_t m;
+  m.type = MeasurementTypeDistance;
+  m.data.distance = *distance;
+  estimatorEnqueueAt(&m, timestamp);
+}
+
+static inline void estimatorEnqueueAbsoluteHeightAt(const heightMeasurement_t *height, const uint64_t timestamp)
+{
+  measurement_t m;
+  m.type = MeasurementTypeAbsoluteHeight;
+  m.data.height = *height;
+  estimatorEnqueueAt(&m, timestamp);
+}
+
+static inline void estimatorEnqueueFlowAt(const flowMeasurement_t *flow, const uint64_t timestamp)
+{
+  measurement_t m;
+  m.type = MeasurementTypeFlow;
+  m.data.flow = *flow;
+  estimatorEnqueueAt(&m, timestamp);
+}
+
+static inline void estimatorEnqueueYawErrorAt(const yawErrorMeasurement_t *yawError, const uint64_t timestamp)
+{
+  measurement_t m;
+  m.type = MeasurementTypeYawError;
+  m.data.yawError = *yawError;
+  estimatorEnqueueAt(&m, timestamp);
+}
+
+static inline void estimatorEnqueueSweepAnglesAt(const sweepAngleMeasurement_t *sweepAngle, const uint64_t timestamp)
+{
+  measurement_t m;
+  m.type = MeasurementTypeSweepAngle;
+  m.data.sweepAngle = *sweepAngle;
+  estimatorEnqueueAt(&m, timestamp);
+}
+
 // Helper function for state estimators
 bool estimatorDequeue(measurement_t *measurement);
 
@@ -95,6 +95,53 @@ typedef struct {
   float initialQuaternion[4];
 } kalmanCoreData_t;
 
+// The max number of scalar measurements that can be folded into the filter in one batch update
+#define KC_MAX_BATCH_SIZE 16
+
+// Scalar measurements collected to be folded into the filter in one batch update
+typedef struct {
+  float h[KC_MAX_BATCH_SIZE][KC_STATE_DIM];
+  float error[KC_MAX_BATCH_SIZE];
+  float stdMeasNoise[KC_MAX_BATCH_SIZE];
+  int count;
+} kalmanCoreBatch_t;
+
+// The time span covered by the state history, used to fuse delayed measurements (us). Measurements are time stamped
+// when they are captured and can be several rotations of a lighthouse base station or several UWB packets old when
+// they reach the estimator. Older measurements are fused with the state at the start of the history.
+#define KC_HISTORY_DURATION_US 160000
+
+// Predictions are merged into history entries of at least this length (us), so that the time span of the history does
+// not depend on the prediction rate
+#define KC_HISTORY_ENTRY_DURATION_US 10000
+
+#define KC_HISTORY_LENGTH (KC_HISTORY_DURATION_US / KC_HISTORY_ENTRY_DURATION_US)
+
+// The change of the state over one or more consecutive predictions
+typedef struct {
+  uint64_t timestamp; // Time of the latest prediction (us)
+  uint64_t start;     // Time of the state before the first prediction (us)
+  float dPos[3];      // Change of position, global frame
+  float dVel[3];      // Change of velocity, body frame
+  float dq[4];        // Rotation of the body, q_after = q_before * dq [w,x,y,z]
+} kalmanCoreHistoryEntry_t;
+
+// A short history of the predictions, newest first at head
+typedef struct {
+  kalmanCoreHistoryEntry_t entries[KC_HISTORY_LENGTH];
+  int head;
+  int count;
+} kalmanCoreHistory_t;
+
+// The current position, velocity and attitude, saved while the state is retrodicted
+typedef struct {
+  bool isActive;
+  float S[KC_STATE_D0];
+  float q[4];
+  float R[3][3];
+  float retrodictedS[KC_STATE_D0];
+} kalmanCoreRetrodiction_t;
+
 // The parameters used by the filter
 typedef struct {
   // Initial variances, uncertain of position, but know we're stationary and roughly flat
@@ -143,8 +190,41 @@ void kalmanCoreUpdateWithBaro(kalmanCoreData_t *this, const kalmanCoreParams_t *
  *  - Predicting the current state forward */
 void kalmanCorePredict(kalmanCoreData_t *this, Axis3f *acc, Axis3f *gyro, float dt, bool quadIsFlying);
 
+/*  - The two parts of the prediction. The state can be predicted at a higher rate than the covariance, the covariance
+ *    prediction is the expensive part. The covariance must be predicted before the state for the same time step. */
+void kalmanCorePredictCovariance(kalmanCoreData_t *this, Axis3f *gyro, float dt);
+void kalmanCorePredictState(kalmanCoreData_t *this, Axis3f *acc, Axis3f *gyro, float dt, bool quadIsFlying);
+
 void kalmanCoreAddProcessNoise(kalmanCoreData_t *this, const kalmanCoreParams_t *params, float dt);
 
+/**
+ * Delayed measurements
+ *
+ * The change of the state over the latest predictions is kept in a history. A measurement that is older than the
+ * latest prediction is fused by retrodicting the position, velocity and attitude to the time of the measurement,
+ * running the normal measurement update on the retrodicted state and applying the resulting correction to the current
+ * state. The covariance is not retrodicted, the current covariance is used for the update.
+ *
+ *   kalmanCoreRetrodictionStart(&coreData, &history, measurementTimestamp, &retrodiction);
+ *   kalmanCoreUpdateWithPosition(&coreData, &position);
+ *   kalmanCoreRetrodictionEnd(&coreData, &retrodiction);
+ */
+void kalmanCoreHistoryInit(kalmanCoreHistory_t* history);
+
+// Predict the state forward (see kalmanCorePredict()) and add the change of the state to the history.
+void kalmanCorePredictWithHistory(kalmanCoreData_t *this, kalmanCoreHistory_t* history, Axis3f *acc, Axis3f *gyro, float dt, bool quadIsFlying, uint64_t timestamp);
+
+// Predict the state, but not the covariance (see kalmanCorePredictState()), and add the change of the state to the history.
+void kalmanCorePredictStateWithHistory(kalmanCoreData_t *this, kalmanCoreHistory_t* history, Axis3f *acc, Axis3f *gyro, float dt, bool quadIsFlying, uint64_t timestamp);
+
+// Retrodict the state to the time of a measurement. Returns false, and leaves the state as is, if the measurement is
+// not older than the latest prediction. If the measurement is older than the history, the state is retrodicted to
+// the start of the history.
+bool kalmanCoreRetrodictionStart(kalmanCoreData_t* this, const kalmanCoreHistory_t* history, uint64_t timestamp, kalmanCoreRetrodiction_t* retrodiction);
+
+// Move the correction of the retrodicted state to the current state and restore the current attitude
+void kalmanCoreRetrodictionEnd(kalmanCoreData_t* this, const kalmanCoreRetrodiction_t* retrodiction);
+
 /*  - Finalization to incorporate attitude error into body attitude */
 void kalmanCoreFinalize(kalmanCoreData_t* this, uint32_t tick);
 
@@ -155,4 +235,19 @@ void kalmanCoreDecoupleXY(kalmanCoreData_t* this);
 
 void kalmanCoreScalarUpdate(kalmanCoreData_t* this, arm_matrix_instance_f32 *Hm, float error, float stdMeasNoise);
 
+/**
+ * Batch updates
+ *
+ * Scalar measurements that are linearized around the same state can be collected in a batch and folded into
+ * the filter with one symmetric rank-k update of the covariance, instead of one full covariance update per measurement.
+ * The measurement noise of the measurements in a batch is assumed to be uncorrelated.
+ */
+void kalmanCoreBatchInit(kalmanCoreBatch_t* batch);
+
+// Add a scalar measurement to a batch. Returns false if the batch is full, in which case the measurement is not added.
+bool kalmanCoreBatchAdd(kalmanCoreBatch_t* batch, const arm_matrix_instance_f32 *Hm, float error, float stdMeasNoise);
+
+// Fold all measurements in the batch into the filter and empty the batch
+void kalmanCoreBatchUpdate(kalmanCoreData_t* this, kalmanCoreBatch_t* batch);
+
 void kalmanCoreUpdateWithPKE(kalmanCoreData_t* this, arm_matrix_instance_f32 *Hm, arm_matrix_instance_f32 *Km, arm_matrix_instance_f32 *P_w_m, float error);
@@ -30,3 +30,7 @@
 
 // Measurement of sweep angles from a Lighthouse base station
 void kalmanCoreUpdateWithSweepAngles(kalmanCoreData_t *this, sweepAngleMeasurement_t *angles, const uint32_t tick, OutlierFilterLhState_t* sweepOutlierFilterState);
+
+// Linearize a sweep angle measurement and add it to a batch, to be folded into the filter later with kalmanCoreBatchUpdate().
+// Returns true if the measurement was added.
+bool kalmanCoreBatchAddSweepAngles(const kalmanCoreData_t *this, kalmanCoreBatch_t* batch, sweepAngleMeasurement_t *angles, const uint32_t tick, OutlierFilterLhState_t* sweepOutlierFilterState);
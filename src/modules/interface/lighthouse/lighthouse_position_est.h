@@ -48,5 +48,6 @@ void lighthousePositionSetGeometryData(const uint8_t baseStation, const baseStat
  */
 void lighthousePositionCalibrationDataWritten(const uint8_t baseStation);
 
-void lighthousePositionEstimatePoseCrossingBeams(const pulseProcessor_t *state, pulseProcessorResult_t* angles, int baseStation);
-void lighthousePositionEstimatePoseSweeps(const pulseProcessor_t *state, pulseProcessorResult_t* angles, int baseStation);
+// The timestamp is the capture time of the angles (us, see usecTimestamp()) and is passed on to the estimator
+void lighthousePositionEstimatePoseCrossingBeams(const pulseProcessor_t *state, pulseProcessorResult_t* angles, int baseStation, const uint64_t timestamp);
+void lighthousePositionEstimatePoseSweeps(const pulseProcessor_t *state, pulseProcessorResult_t* angles, int baseStation, const uint64_t timestamp);
@@ -42,6 +42,18 @@
  */
 bool lighthouseStoragePersistData(const uint8_t baseStation, const bool geoData, const bool calibData);
 
+/**
+ * @brief Copy current data in RAM for a number of base stations to permanent storage,
+ *        in one pass over the storage. If the data does not fit, nothing is stored.
+ *        Note: persisting data may take a long time, this function should
+ *        not be used if the task must not be locked.
+ *
+ * @param geoDataBsField    A bit field indicating for which base stations to store geometry data
+ * @param calibDataBsField  A bit field indicating for which base stations to store calibration data
+ * @return true if data was stored
+ */
+bool lighthouseStoragePersistDataForBaseStations(const uint16_t geoDataBsField, const uint16_t calibDataBsField);
+
 /**
  * @brief Copy current calibration data for one base station in RAM to permanent storage.
  *        This function runns as a worker and will return imediatley.
@@ -0,0 +1,93 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * log_program.h - Compiled log block packing
+ *
+ * A log block is compiled into a flat list of ops when it is changed. Running
+ * the list packs the variables into the log packet, variables that are
+ * adjacent in memory and need no conversion are copied in one go.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "log.h"
+
+// Length in bytes of the log types, indexed by type
+extern const uint8_t logTypeLength[];
+
+typedef enum {
+  logProgramOpCopy = 0,  // Copy from memory, no conversion
+  logProgramOpConvert,   // Read from memory and convert
+  logProgramOpFunction,  // Acquire by function and convert
+} logProgramOpKind_t;
+
+typedef struct {
+  const void * src;
+  uint8_t dstOffset;
+  uint8_t size;
+  uint8_t kind;
+  uint8_t storageType : 4;
+  uint8_t logType     : 4;
+} logProgramOp_t;
+
+typedef struct {
+  logProgramOp_t * ops;
+  uint16_t capacity;
+  uint16_t length;
+  uint8_t dataLength;
+  uint8_t maxDataLength;
+} logProgram_t;
+
+/**
+ * Initialize an empty program
+ *
+ * @param program The program to initialize
+ * @param ops Storage for the ops of the program
+ * @param capacity Number of ops that fit in the storage
+ * @param maxDataLength Max number of bytes written by logProgramRun()
+ */
+void logProgramInit(logProgram_t* program, logProgramOp_t* ops, uint16_t capacity, uint8_t maxDataLength);
+
+/**
+ * Append a variable to a program
+ *
+ * @param program The program
+ * @param variable Address of the variable, or of its logByFunction_t
+ * @param storageType Type of the variable in memory
+ * @param logType Type of the variable in the log packet
+ * @param isAcquiredByFunction True if variable points to a logByFunction_t
+ * @return false if the variable does not fit in the program
+ */
+bool logProgramAppend(logProgram_t* program, const void* variable, uint8_t storageType, uint8_t logType, bool isAcquiredByFunction);
+
+/**
+ * Run a program
+ *
+ * @param program The program
+ * @param data Destination of the packed variables, program->dataLength bytes are written
+ * @param timestamp Timestamp passed to the variables that are acquired by function
+ */
+void logProgramRun(const logProgram_t* program, uint8_t* data, uint32_t timestamp);
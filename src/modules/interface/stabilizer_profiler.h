@@ -0,0 +1,84 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2023 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * stabilizer_profiler.h - execution time of the stabilizer loop stages
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "autoconf.h"
+#include "cycleStats.h"
+
+typedef enum {
+  stabilizerStageSensors = 0,
+  stabilizerStageEstimator,
+  stabilizerStageHighLevelCommander,
+  stabilizerStageCommander,
+  stabilizerStageCollisionAvoidance,
+  stabilizerStageController,
+  stabilizerStageSupervisor,
+  stabilizerStagePowerDistribution,
+  // The full loop, from sensor data ready to motor output
+  stabilizerStageLoop,
+  stabilizerStageCount,
+} stabilizerStage_t;
+
+#ifdef CONFIG_DEBUG_STABILIZER_PROFILER
+  void stabilizerProfilerInit(void);
+
+  /**
+   * @brief Start measuring a stage. Must only be called from the stabilizer task.
+   */
+  void stabilizerProfilerStart(const stabilizerStage_t stage);
+
+  /**
+   * @brief Stop measuring a stage and record the number of cycles since it
+   * was started. Must only be called from the stabilizer task.
+   */
+  void stabilizerProfilerStop(const stabilizerStage_t stage);
+
+  /**
+   * @brief Get a copy of the statistics of a stage, accumulated since start up
+   * or the latest reset.
+   *
+   * @return false if the stage does not exist
+   */
+  bool stabilizerProfilerGetStats(const stabilizerStage_t stage, cycleStats_t* stats);
+
+  /**
+   * @brief Request the accumulated statistics of all stages to be cleared. The
+   * reset is done by the stabilizer task at the start of the next loop.
+   */
+  void stabilizerProfilerReset(void);
+
+  #define STABILIZER_PROFILER_INIT() stabilizerProfilerInit()
+  #define STABILIZER_PROFILER_START(stage) stabilizerProfilerStart(stage)
+  #define STABILIZER_PROFILER_STOP(stage) stabilizerProfilerStop(stage)
+#else
+  #define STABILIZER_PROFILER_INIT()
+  #define STABILIZER_PROFILER_START(stage)
+  #define STABILIZER_PROFILER_STOP(stage)
+#endif // CONFIG_DEBUG_STABILIZER_PROFILER
@@ -308,7 +308,28 @@ typedef struct
 #define ATTITUDE_RATE RATE_500_HZ
 #define POSITION_RATE RATE_100_HZ
 #define RATE_HL_COMMANDER RATE_100_HZ
+#define ESTIMATOR_ATTITUDE_RATE RATE_250_HZ
+#define ESTIMATOR_POSITION_RATE RATE_100_HZ
+
+// Schedule of the sub loops of the stabilizer. A loop runs in the ticks where
+// (tick % (RATE_MAIN_LOOP / rate)) equals its phase. The phases stagger the
+// loops so that their CPU cost is spread over the ticks instead of adding up
+// in the same tick. The attitude controller and the attitude estimator run in
+// the even ticks, the attitude estimator just before the controller to keep
+// the latency low. The position estimate, the high level commander and the
+// position controller feed each other and run together in an odd tick, so
+// that the attitude controller uses their output 1 ms after the state they
+// were computed from. The uSD trigger runs alone in another odd tick.
+#define ATTITUDE_PHASE 0
+#define ESTIMATOR_ATTITUDE_PHASE 0
+#define ESTIMATOR_POSITION_PHASE 1
+#define HL_COMMANDER_PHASE 1
+#define POSITION_PHASE 1
+#define USDDECK_PHASE 7
 
 #define RATE_DO_EXECUTE(RATE_HZ, TICK) ((TICK % (RATE_MAIN_LOOP / RATE_HZ)) == 0)
+// The phase is wrapped to the period, to also work for rates set at run time
+#define RATE_DO_EXECUTE_PHASED(RATE_HZ, PHASE, TICK) \
+  (((TICK) % (RATE_MAIN_LOOP / (RATE_HZ))) == ((PHASE) % (RATE_MAIN_LOOP / (RATE_HZ))))
 
 #endif
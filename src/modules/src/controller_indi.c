@@ -149,7 +149,7 @@ void controllerINDI(control_t *control, setpoint_t *setpoint,
 {
 
 	//The z_distance decoder adds a negative sign to the yaw command, the position decoder doesn't
-	if (RATE_DO_EXECUTE(ATTITUDE_RATE, tick)) {
+	if (RATE_DO_EXECUTE_PHASED(ATTITUDE_RATE, ATTITUDE_PHASE, tick)) {
 		// Rate-controled YAW is moving YAW angle setpoint
 		if (setpoint->mode.yaw == modeVelocity) {
 			attitudeDesired.yaw += setpoint->attitudeRate.yaw * ATTITUDE_UPDATE_DT; //if line 140 (or the other setpoints) in crtp_commander_generic.c has the - sign remove add a -sign here to convert the crazyfly coords (ENU) to INDI  body coords (NED)
@@ -166,14 +166,14 @@ void controllerINDI(control_t *control, setpoint_t *setpoint,
 		}
 	}
 
-	if (RATE_DO_EXECUTE(POSITION_RATE, tick) && !outerLoopActive) {
+	if (RATE_DO_EXECUTE_PHASED(POSITION_RATE, POSITION_PHASE, tick) && !outerLoopActive) {
 		positionController(&actuatorThrust, &attitudeDesired, setpoint, state);
 	}
 
 	/*
 	 * Skipping calls faster than ATTITUDE_RATE
 	 */
-	if (RATE_DO_EXECUTE(ATTITUDE_RATE, tick)) {
+	if (RATE_DO_EXECUTE_PHASED(ATTITUDE_RATE, ATTITUDE_PHASE, tick)) {
 
 		// Call outer loop INDI (position controller)
 		if (outerLoopActive) {
@@ -114,6 +114,11 @@ void controllerMellingerReset(void)
 void controllerMellingerInit(void)
 {
   controllerMellingerReset();
+
+  prev_omega_roll = 0;
+  prev_omega_pitch = 0;
+  prev_setpoint_omega_roll = 0;
+  prev_setpoint_omega_pitch = 0;
 }
 
 bool controllerMellingerTest(void)
@@ -138,7 +143,7 @@ void controllerMellinger(control_t *control, setpoint_t *setpoint,
   float dt;
   float desiredYaw = 0; //deg
 
-  if (!RATE_DO_EXECUTE(ATTITUDE_RATE, tick)) {
+  if (!RATE_DO_EXECUTE_PHASED(ATTITUDE_RATE, ATTITUDE_PHASE, tick)) {
     return;
   }
 
@@ -30,6 +30,17 @@ void controllerPidInit(void)
   positionControllerInit();
 }
 
+void controllerPidReset(void)
+{
+  attitudeControllerResetAllPID();
+  positionControllerResetAllPID();
+  positionControllerResetAllfilters();
+
+  attitudeDesired = (attitude_t){0};
+  rateDesired = (attitude_t){0};
+  actuatorThrust = 0;
+}
+
 bool controllerPidTest(void)
 {
   bool pass = true;
@@ -58,7 +69,7 @@ void controllerPid(control_t *control, setpoint_t *setpoint,
                                          const state_t *state,
                                          const uint32_t tick)
 {
-  if (RATE_DO_EXECUTE(ATTITUDE_RATE, tick)) {
+  if (RATE_DO_EXECUTE_PHASED(ATTITUDE_RATE, ATTITUDE_PHASE, tick)) {
     // Rate-controled YAW is moving YAW angle setpoint
     if (setpoint->mode.yaw == modeVelocity) {
       attitudeDesired.yaw = capAngle(attitudeDesired.yaw + setpoint->attitudeRate.yaw * ATTITUDE_UPDATE_DT);
@@ -82,11 +93,11 @@ void controllerPid(control_t *control, setpoint_t *setpoint,
     attitudeDesired.yaw = capAngle(attitudeDesired.yaw);
   }
 
-  if (RATE_DO_EXECUTE(POSITION_RATE, tick)) {
+  if (RATE_DO_EXECUTE_PHASED(POSITION_RATE, POSITION_PHASE, tick)) {
     positionController(&actuatorThrust, &attitudeDesired, setpoint, state);
   }
 
-  if (RATE_DO_EXECUTE(ATTITUDE_RATE, tick)) {
+  if (RATE_DO_EXECUTE_PHASED(ATTITUDE_RATE, ATTITUDE_PHASE, tick)) {
     // Switch between manual and automatic position control
     if (setpoint->mode.z == modeDisable) {
       actuatorThrust = setpoint->thrust;
@@ -41,19 +41,9 @@
 #include "cpx_external_router.h"
 #include "cpx_internal_router.h"
 #include "cpx_uart_transport.h"
+#include "cpx_packet_pool.h"
 
-typedef struct {
-  CPXRoutablePacket_t txp;
-} RouteContext_t;
-
-static RouteContext_t internal_task_context;
-static CPXRoutablePacket_t internalRxBuf;
-
-static RouteContext_t uart_task_context;
-static CPXRoutablePacket_t uartRxBuf;
-
-typedef void (*Receiver_t)(CPXRoutablePacket_t* packet);
-typedef void (*Sender_t)(const CPXRoutablePacket_t* packet);
+typedef CPXRoutablePacket_t* (*Receiver_t)(void);
 
 static const int START_UP_UART_ROUTER_RUNNING = (1<<0);
 static const int START_UP_RADIO_ROUTER_RUNNING = (1<<1);
@@ -61,52 +51,30 @@ static const int START_UP_INTERNAL_ROUTER_RUNNING = (1<<2);
 
 static EventGroupHandle_t startUpEventGroup;
 
-static void splitAndSend(const CPXRoutablePacket_t* rxp, RouteContext_t* context, Sender_t sender, const uint16_t mtu) {
-  CPXRoutablePacket_t* txp = &context->txp;
-
-  txp->route = rxp->route;
-
-  uint16_t remainingToSend = rxp->dataLength;
-  const uint8_t* startOfDataToSend = rxp->data;
-  while (remainingToSend > 0) {
-    uint16_t toSend = remainingToSend;
-    bool lastPacket = rxp->route.lastPacket;
-    if (toSend > mtu) {
-      toSend = mtu;
-      lastPacket = false;
-    }
-
-    memcpy(txp->data, startOfDataToSend, toSend);
-    txp->dataLength = toSend;
-    txp->route.lastPacket = lastPacket;
-    sender(txp);
-
-    remainingToSend -= toSend;
-    startOfDataToSend += toSend;
-  }
-}
-
-static void route(Receiver_t receive, CPXRoutablePacket_t* rxp, RouteContext_t* context, const char* routerName) {
+// Packets are pointers to the packet pool and are passed on to the next
+// route without copying. The packets in the pool always fit the UART MTU.
+static void route(Receiver_t receive, const char* routerName) {
   while(1) {
-    receive(rxp);
+    CPXRoutablePacket_t* packet = receive();
 
-    const CPXTarget_t source = rxp->route.source;
-    const CPXTarget_t destination = rxp->route.destination;
-    const uint16_t cpxDataLength = rxp->dataLength;
+    const CPXTarget_t source = packet->route.source;
+    const CPXTarget_t destination = packet->route.destination;
+    const uint16_t cpxDataLength = packet->dataLength;
 
     switch (destination) {
       case CPX_T_WIFI_HOST:
       case CPX_T_ESP32:
       case CPX_T_GAP8:
         //DEBUG_PRINT("%s [0x%02X] -> UART2 [0x%02X] (%u)\n", routerName, source, destination, cpxDataLength);
-        splitAndSend(rxp, context, cpxUARTTransportSend, CPX_UART_TRANSPORT_MTU - CPX_ROUTING_PACKED_SIZE);
+        cpxUARTTransportSend(packet);
         break;
       case CPX_T_STM32:
         //DEBUG_PRINT("%s [0x%02X] -> STM32 [0x%02X] (%u)\n", routerName, source, destination, cpxDataLength);
-        splitAndSend(rxp, context, cpxInternalRouterRouteIn, CPX_UART_TRANSPORT_MTU - CPX_ROUTING_PACKED_SIZE);
+        cpxInternalRouterRouteIn(packet);
         break;
       default:
         DEBUG_PRINT("Cannot route from %s [0x%02X] to [0x%02X](%u)\n", routerName, source, destination, cpxDataLength);
+        cpxPacketPoolRelease(packet);
         break;
     }
   }
@@ -114,12 +82,12 @@ static void route(Receiver_t receive, CPXRoutablePacket_t* rxp, RouteContext_t*
 
 static void router_from_uart(void* _param) {
   xEventGroupSetBits(startUpEventGroup, START_UP_UART_ROUTER_RUNNING);
-  route(cpxUARTTransportReceive, &internalRxBuf, &internal_task_context, "UART2");
+  route(cpxUARTTransportReceive, "UART2");
 }
 
 static void router_from_internal(void* _param) {
   xEventGroupSetBits(startUpEventGroup, START_UP_INTERNAL_ROUTER_RUNNING);
-  route(cpxInternalRouterRouteOut, &uartRxBuf, &uart_task_context, "STM32");
+  route(cpxInternalRouterRouteOut, "STM32");
 }
 
 void cpxExternalRouterInit() {
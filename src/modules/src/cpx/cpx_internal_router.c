@@ -26,6 +26,8 @@
 
 #define DEBUG_MODULE "CPX-INT-ROUTER"
 
+#include <string.h>
+
 #include "FreeRTOS.h"
 #include "config.h"
 #include "debug.h"
@@ -33,32 +35,70 @@
 
 #include "crtp.h"
 #include "cpx_internal_router.h"
+#include "cpx_packet_pool.h"
 #include "cpx.h"
 
-#define QUEUE_LENGTH (2)
+// The queues hold pointers to packets in the packet pool
+#define QUEUE_LENGTH CPX_INTERNAL_ROUTER_QUEUE_LENGTH
 
 static xQueueHandle crtpQueue;
 static xQueueHandle mixedQueue;
 
 static xQueueHandle txq;
 
+static void unpackAndRelease(CPXRoutablePacket_t* routable, CPXPacket_t * packet) {
+  packet->route = routable->route;
+  packet->dataLength = routable->dataLength;
+  memcpy(packet->data, routable->data, routable->dataLength);
+  cpxPacketPoolRelease(routable);
+}
+
 int cpxInternalRouterReceiveCRTP(CPXPacket_t * packet) {
-  return xQueueReceive(crtpQueue, packet, M2T(100));
+  CPXRoutablePacket_t* routable;
+  if (xQueueReceive(crtpQueue, &routable, M2T(100)) != pdTRUE) {
+    return pdFALSE;
+  }
+
+  unpackAndRelease(routable, packet);
+  return pdTRUE;
 }
 
 void cpxInternalRouterReceiveOthers(CPXPacket_t * packet) {
-  xQueueReceive(mixedQueue, packet, (TickType_t)portMAX_DELAY);
+  CPXRoutablePacket_t* routable;
+  xQueueReceive(mixedQueue, &routable, (TickType_t)portMAX_DELAY);
+  unpackAndRelease(routable, packet);
 }
 
 void cpxSendPacketBlocking(const CPXPacket_t * packet) {
-  xQueueSend(txq, packet, portMAX_DELAY);
+  // Split the data into as many pool packets as needed
+  uint16_t remainingToSend = packet->dataLength;
+  const uint8_t* startOfDataToSend = packet->data;
+  while (remainingToSend > 0) {
+    CPXRoutablePacket_t* txp = cpxPacketPoolAllocate();
+
+    uint16_t toSend = remainingToSend;
+    bool lastPacket = packet->route.lastPacket;
+    if (toSend > sizeof(txp->data)) {
+      toSend = sizeof(txp->data);
+      lastPacket = false;
+    }
+
+    txp->route = packet->route;
+    txp->route.lastPacket = lastPacket;
+    txp->dataLength = toSend;
+    memcpy(txp->data, startOfDataToSend, toSend);
+    xQueueSend(txq, &txp, portMAX_DELAY);
+
+    remainingToSend -= toSend;
+    startOfDataToSend += toSend;
+  }
 }
 
 bool cpxSendPacket(const CPXPacket_t * packet, uint32_t timeout) {
   return true;
 }
 
-void cpxInternalRouterRouteIn(const CPXRoutablePacket_t* packet) {
+void cpxInternalRouterRouteIn(CPXRoutablePacket_t* packet) {
 
   switch (packet->route.function) {
     case CPX_F_SYSTEM:
@@ -66,23 +106,26 @@ void cpxInternalRouterRouteIn(const CPXRoutablePacket_t* packet) {
     case CPX_F_WIFI_CTRL:
     case CPX_F_BOOTLOADER:
     case CPX_F_TEST:
-      xQueueSend(mixedQueue, packet, portMAX_DELAY);
+      xQueueSend(mixedQueue, &packet, portMAX_DELAY);
       break;
     case CPX_F_CRTP:
-      xQueueSend(crtpQueue, packet, portMAX_DELAY);
+      xQueueSend(crtpQueue, &packet, portMAX_DELAY);
       break;
     default:
       DEBUG_PRINT("Message on function which is not handled (0x%X)\n", packet->route.function);
+      cpxPacketPoolRelease(packet);
   }
 }
 
 // Route from STM to external targets
-void cpxInternalRouterRouteOut(CPXRoutablePacket_t* packet) {
-  xQueueReceive(txq, packet, (TickType_t)portMAX_DELAY);
+CPXRoutablePacket_t* cpxInternalRouterRouteOut(void) {
+  CPXRoutablePacket_t* packet;
+  xQueueReceive(txq, &packet, (TickType_t)portMAX_DELAY);
+  return packet;
 }
 
 void cpxInternalRouterInit(void) {
-  txq = xQueueCreate(QUEUE_LENGTH, sizeof(CPXPacket_t));
-  crtpQueue = xQueueCreate(QUEUE_LENGTH, sizeof(CPXPacket_t));;
-  mixedQueue = xQueueCreate(QUEUE_LENGTH, sizeof(CPXPacket_t));;
+  txq = xQueueCreate(QUEUE_LENGTH, sizeof(CPXRoutablePacket_t*));
+  crtpQueue = xQueueCreate(QUEUE_LENGTH, sizeof(CPXRoutablePacket_t*));
+  mixedQueue = xQueueCreate(QUEUE_LENGTH, sizeof(CPXRoutablePacket_t*));
 }
@@ -0,0 +1,167 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2022 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Pool of CPX packets */
+
+#define DEBUG_MODULE "CPX-POOL"
+
+#include <stdbool.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "static_mem.h"
+#include "cfassert.h"
+#include "usec_time.h"
+#include "log.h"
+
+#include "cpx_packet_pool.h"
+
+typedef struct {
+  // Must be first, packets are handed out as pointers to it
+  CPXRoutablePacket_t packet;
+  uint32_t allocationTime;
+  bool isAllocated;
+} poolEntry_t;
+
+// The packets are only accessed by the CPU, the transports copy to/from their DMA buffers
+NO_DMA_CCM_SAFE_ZERO_INIT static poolEntry_t pool[CPX_PACKET_POOL_SIZE];
+
+// The first packets of the pool are the reserve for receiving
+#define IS_RX_RESERVED(ENTRY) ((ENTRY) < &pool[CPX_PACKET_POOL_RX_RESERVED])
+
+STATIC_MEM_QUEUE_ALLOC(freeRxPackets, CPX_PACKET_POOL_RX_RESERVED, sizeof(poolEntry_t*));
+static xQueueHandle freeRxPackets;
+STATIC_MEM_QUEUE_ALLOC(freeTxPackets, CPX_PACKET_POOL_TX, sizeof(poolEntry_t*));
+static xQueueHandle freeTxPackets;
+
+static bool isInit = false;
+
+static uint8_t usedPackets;
+static uint8_t maxUsedPackets;
+
+// Time from allocation until release, per destination [us]
+#define LATENCY_TARGETS (CPX_T_GAP8 + 1)
+static uint32_t latency[LATENCY_TARGETS];
+
+static poolEntry_t* getEntry(CPXRoutablePacket_t* packet) {
+  poolEntry_t* entry = (poolEntry_t*) packet;
+  ASSERT(entry >= &pool[0] && entry < &pool[CPX_PACKET_POOL_SIZE]);
+  return entry;
+}
+
+void cpxPacketPoolInit(void) {
+  if (isInit) {
+    return;
+  }
+
+  freeRxPackets = STATIC_MEM_QUEUE_CREATE(freeRxPackets);
+  freeTxPackets = STATIC_MEM_QUEUE_CREATE(freeTxPackets);
+  for (int i = 0; i < CPX_PACKET_POOL_SIZE; i++) {
+    poolEntry_t* entry = &pool[i];
+    xQueueSend(IS_RX_RESERVED(entry) ? freeRxPackets : freeTxPackets, &entry, 0);
+  }
+
+  isInit = true;
+}
+
+static CPXRoutablePacket_t* allocateFrom(xQueueHandle freePackets) {
+  ASSERT(isInit);
+
+  poolEntry_t* entry;
+  xQueueReceive(freePackets, &entry, portMAX_DELAY);
+  entry->allocationTime = (uint32_t) usecTimestamp();
+
+  taskENTER_CRITICAL();
+  entry->isAllocated = true;
+  usedPackets++;
+  if (usedPackets > maxUsedPackets) {
+    maxUsedPackets = usedPackets;
+  }
+  taskEXIT_CRITICAL();
+
+  return &entry->packet;
+}
+
+CPXRoutablePacket_t* cpxPacketPoolAllocate(void) {
+  return allocateFrom(freeTxPackets);
+}
+
+CPXRoutablePacket_t* cpxPacketPoolAllocateRx(void) {
+  return allocateFrom(freeRxPackets);
+}
+
+void cpxPacketPoolRelease(CPXRoutablePacket_t* packet) {
+  poolEntry_t* entry = getEntry(packet);
+
+  taskENTER_CRITICAL();
+  // Released twice, or never allocated
+  const bool isAllocated = entry->isAllocated;
+  ASSERT(isAllocated);
+  if (isAllocated) {
+    entry->isAllocated = false;
+    usedPackets--;
+  }
+  taskEXIT_CRITICAL();
+
+  if (isAllocated) {
+    const CPXTarget_t destination = packet->route.destination;
+    if (destination < LATENCY_TARGETS) {
+      latency[destination] = (uint32_t) usecTimestamp() - entry->allocationTime;
+    }
+
+    xQueueSend(IS_RX_RESERVED(entry) ? freeRxPackets : freeTxPackets, &entry, 0);
+  }
+}
+
+/**
+ * Usage of the CPX packet pool and the time packets spend in CPX, from
+ * being received or sent until delivered.
+ */
+LOG_GROUP_START(cpxPool)
+/**
+ * @brief Number of packets in use
+ */
+LOG_ADD(LOG_UINT8, used, &usedPackets)
+/**
+ * @brief Maximum number of packets in use since start up
+ */
+LOG_ADD(LOG_UINT8, maxUsed, &maxUsedPackets)
+/**
+ * @brief Latency of the latest packet to the STM32 [us]
+ */
+LOG_ADD(LOG_UINT32, latStm32, &latency[CPX_T_STM32])
+/**
+ * @brief Latency of the latest packet to the ESP32 [us]
+ */
+LOG_ADD(LOG_UINT32, latEsp32, &latency[CPX_T_ESP32])
+/**
+ * @brief Latency of the latest packet to the WiFi host [us]
+ */
+LOG_ADD(LOG_UINT32, latHost, &latency[CPX_T_WIFI_HOST])
+/**
+ * @brief Latency of the latest packet to the GAP8 [us]
+ */
+LOG_ADD(LOG_UINT32, latGap8, &latency[CPX_T_GAP8])
+LOG_GROUP_STOP(cpxPool)
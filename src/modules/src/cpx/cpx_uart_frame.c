@@ -0,0 +1,116 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2022 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Framing of CPX packets on the UART */
+
+#include <string.h>
+
+#include "cpx_uart_frame.h"
+
+uint8_t cpxUartChecksum(const uint8_t* data, uint32_t length, uint8_t checksum) {
+  while (length > 0 && ((uintptr_t)data & 0x3) != 0) {
+    checksum ^= *data++;
+    length--;
+  }
+
+  // XOR is done per byte lane, the lanes are folded together at the end
+  uint32_t lanes = 0;
+  for (; length >= 4; length -= 4) {
+    uint32_t word;
+    memcpy(&word, data, sizeof(word));
+    lanes ^= word;
+    data += 4;
+  }
+  lanes ^= lanes >> 16;
+  lanes ^= lanes >> 8;
+  checksum ^= (uint8_t)lanes;
+
+  while (length > 0) {
+    checksum ^= *data++;
+    length--;
+  }
+
+  return checksum;
+}
+
+static uint8_t checksumCircular(const uint8_t* buffer, uint32_t bufferSize, uint32_t index, uint32_t length) {
+  uint32_t toEnd = bufferSize - index;
+  if (length <= toEnd) {
+    return cpxUartChecksum(&buffer[index], length, 0);
+  }
+
+  uint8_t checksum = cpxUartChecksum(&buffer[index], toEnd, 0);
+  return cpxUartChecksum(buffer, length - toEnd, checksum);
+}
+
+cpxUartFrameResult_t cpxUartFrameParse(const uint8_t* buffer, uint32_t bufferSize, uint32_t index, uint32_t available, cpxUartFrame_t* frame) {
+  const uint32_t mask = bufferSize - 1;
+
+  uint32_t skipped = 0;
+  while (skipped < available && buffer[(index + skipped) & mask] != CPX_UART_FRAME_START) {
+    skipped++;
+  }
+  frame->consumed = skipped;
+  index = (index + skipped) & mask;
+  available -= skipped;
+
+  if (available < CPX_UART_FRAME_HEADER_LENGTH) {
+    return cpxUartFrameIncomplete;
+  }
+
+  const uint8_t payloadLength = buffer[(index + 1) & mask];
+  if (payloadLength == 0) {
+    frame->consumed += CPX_UART_FRAME_HEADER_LENGTH;
+    return cpxUartFrameClearToSend;
+  }
+
+  const uint32_t checkedLength = CPX_UART_FRAME_HEADER_LENGTH + payloadLength;
+  if (available < checkedLength + CPX_UART_FRAME_CHECKSUM_LENGTH) {
+    return cpxUartFrameIncomplete;
+  }
+
+  frame->payloadIndex = (index + CPX_UART_FRAME_HEADER_LENGTH) & mask;
+  frame->payloadLength = payloadLength;
+
+  const uint8_t checksum = buffer[(index + checkedLength) & mask];
+  if (checksum != checksumCircular(buffer, bufferSize, index, checkedLength)) {
+    // The length may be the corrupt part, only skip the start byte to not
+    // swallow valid frames after it
+    frame->consumed += 1;
+    return cpxUartFrameBadChecksum;
+  }
+
+  frame->consumed += checkedLength + CPX_UART_FRAME_CHECKSUM_LENGTH;
+  return cpxUartFramePacket;
+}
+
+void cpxUartFrameCopy(uint8_t* dest, const uint8_t* buffer, uint32_t bufferSize, uint32_t index, uint32_t length) {
+  uint32_t toEnd = bufferSize - index;
+  if (length <= toEnd) {
+    memcpy(dest, &buffer[index], length);
+  } else {
+    memcpy(dest, &buffer[index], toEnd);
+    memcpy(&dest[toEnd], buffer, length - toEnd);
+  }
+}
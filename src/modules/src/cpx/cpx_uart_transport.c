@@ -51,13 +51,19 @@
 #include "stm32fxxx.h"
 #include "system.h"
 #include "autoconf.h"
+#include "usec_time.h"
+#include "statsCnt.h"
 
 #include "cpx.h"
 #include "cpx_uart_transport.h"
+#include "cpx_uart_frame.h"
+#include "cpx_packet_pool.h"
 
-#define UART_TX_QUEUE_LENGTH 4
+#define UART_TX_QUEUE_LENGTH CPX_UART_TRANSPORT_TX_QUEUE_LENGTH
 #define UART_RX_QUEUE_LENGTH 4
 
+#define ONE_SECOND 1000
+
 static xQueueHandle uartTxQueue;
 static xQueueHandle uartRxQueue;
 
@@ -84,10 +90,46 @@ typedef struct {
     uint8_t crcPlaceHolder; // Not actual position. CRC is added after the last byte of payload
 } __attribute__((packed)) uart_transport_packet_t;
 
-// Used when sending/receiving data on the UART
+// Used when sending data on the UART
 static uart_transport_packet_t uartTxp;
-static CPXPacket_t cpxTxp;
-static uart_transport_packet_t uartRxp;
+
+// Received frames are parsed in place in a circular buffer and queued by
+// reference. A frame is consumed from the buffer when it is queued, before
+// cpxUARTTransportReceive() has copied it out, so the payload is only safe as
+// long as the buffer is not wrapped around while the frame is waiting.
+//
+// The ESP only sends a packet after being told clear-to-receive, which is done
+// when the previous packet has been queued. The frames that can be waiting in
+// the buffer are the ones in the queue, the one being copied out by the
+// receiver and the one the RX task is blocked on while queueing it. Each frame
+// may be followed by a clear-to-send frame from the ESP.
+#ifdef CONFIG_UART2_RX_DMA
+#define UART_RX_BUFFER_SIZE UART2_RX_DMA_BUFFER_SIZE
+#else
+#define UART_RX_BUFFER_SIZE 1024
+static uint8_t rxBuffer[UART_RX_BUFFER_SIZE];
+static uint32_t rxReadIndex;
+static uint32_t rxWriteIndex;
+#endif
+
+#define UART_RX_FRAMES_IN_BUFFER (UART_RX_QUEUE_LENGTH + 2)
+#define UART_RX_MAX_FRAME_LENGTH (CPX_UART_TRANSPORT_MTU + UART_META_LENGTH + CPX_UART_FRAME_HEADER_LENGTH)
+_Static_assert(UART_RX_FRAMES_IN_BUFFER * UART_RX_MAX_FRAME_LENGTH <= UART_RX_BUFFER_SIZE,
+               "The UART RX buffer can not hold the frames waiting to be delivered");
+
+typedef struct {
+  const uint8_t* buffer;
+  uint32_t payloadIndex;
+  uint8_t payloadLength;
+  uint64_t timestamp;
+} uartRxFrame_t;
+
+static STATS_CNT_RATE_DEFINE(rxByteRate, ONE_SECOND);
+static STATS_CNT_RATE_DEFINE(rxPacketRate, ONE_SECOND);
+static STATS_CNT_RATE_DEFINE(txByteRate, ONE_SECOND);
+static uint32_t rxErrors;
+static uint32_t rxLatencyUs;
+static uint32_t rxLatencyMaxUs;
 
 static EventGroupHandle_t evGroup;
 /* Used to signal when ESP has said clear-to-send */
@@ -108,19 +150,41 @@ static bool shutdownTransport = false;
 
 static bool isInit = false;
 
-static uint8_t calcCrc(const uart_transport_packet_t* packet) {
-  const uint8_t* start = (const uint8_t*) packet;
-  const uint8_t* end = &packet->payload[packet->payloadLength];
+#ifdef CONFIG_UART2_RX_DMA
+static uint32_t rxPeek(const uint8_t** buffer, uint32_t* readIndex) {
+  return uart2RxDmaPeek(buffer, readIndex);
+}
+
+static void rxConsume(uint32_t size) {
+  uart2RxDmaConsume(size);
+}
 
-  uint8_t crc = 0;
-  for (const uint8_t* p = start; p < end; p++) {
-    crc ^= *p;
+static bool rxWait(const uint32_t timeoutTicks) {
+  return uart2RxDmaWaitIdle(timeoutTicks);
+}
+#else
+static uint32_t rxPeek(const uint8_t** buffer, uint32_t* readIndex) {
+  *buffer = rxBuffer;
+  *readIndex = rxReadIndex;
+  return (rxWriteIndex - rxReadIndex) & (UART_RX_BUFFER_SIZE - 1);
+}
+
+static void rxConsume(uint32_t size) {
+  rxReadIndex = (rxReadIndex + size) & (UART_RX_BUFFER_SIZE - 1);
+}
+
+// Without DMA the data is received a byte at the time into the buffer
+static bool rxWait(const uint32_t timeoutTicks) {
+  if (!uart2GetCharWithTimeout(&rxBuffer[rxWriteIndex], timeoutTicks)) {
+    return false;
   }
 
-  return crc;
+  rxWriteIndex = (rxWriteIndex + 1) & (UART_RX_BUFFER_SIZE - 1);
+  return true;
 }
+#endif
 
-static void assemblePacket(const CPXPacket_t *packet, uart_transport_packet_t * txp) {
+static void assemblePacket(const CPXRoutablePacket_t *packet, uart_transport_packet_t * txp) {
   ASSERT((packet->route.destination >> 4) == 0);
   ASSERT((packet->route.source >> 4) == 0);
   ASSERT((packet->route.function >> 8) == 0);
@@ -132,41 +196,83 @@ static void assemblePacket(const CPXPacket_t *packet, uart_transport_packet_t *
   txp->routablePayload.route.lastPacket = packet->route.lastPacket;
   txp->routablePayload.route.function = packet->route.function;
   memcpy(txp->routablePayload.data, &packet->data, packet->dataLength);
-  txp->payload[txp->payloadLength] = calcCrc(txp);
+  txp->payload[txp->payloadLength] = cpxUartChecksum((const uint8_t*) txp, UART_HEADER_LENGTH + txp->payloadLength, 0);
+}
+
+// Parse the received frames, returns true if an incomplete frame is left
+static bool parseReceivedFrames() {
+  const uint8_t* buffer;
+  uint32_t index;
+  uint32_t available = rxPeek(&buffer, &index);
+  bool isCorruptFrameReceived = false;
+  bool hasIncompleteFrame = false;
+
+  while (available > 0) {
+    cpxUartFrame_t frame;
+    const cpxUartFrameResult_t result = cpxUartFrameParse(buffer, UART_RX_BUFFER_SIZE, index, available, &frame);
+    rxConsume(frame.consumed);
+    if (result == cpxUartFrameIncomplete) {
+      hasIncompleteFrame = available > frame.consumed;
+      break;
+    }
+
+    index = (index + frame.consumed) & (UART_RX_BUFFER_SIZE - 1);
+    available -= frame.consumed;
+    STATS_CNT_RATE_MULTI_EVENT(&rxByteRate, frame.consumed);
+
+    if (result == cpxUartFrameClearToSend) {
+      xEventGroupSetBits(evGroup, ESP_CTS_EVENT);
+    } else if (result == cpxUartFrameBadChecksum) {
+      // Only the start byte was consumed, the rest of the frame is searched
+      // for the next start byte
+      rxErrors++;
+      isCorruptFrameReceived = true;
+    } else {
+      const bool isValidLength = frame.payloadLength >= CPX_ROUTING_PACKED_SIZE && frame.payloadLength <= CPX_UART_TRANSPORT_MTU;
+      if (isValidLength) {
+        const uartRxFrame_t rxFrame = {
+          .buffer = buffer,
+          .payloadIndex = frame.payloadIndex,
+          .payloadLength = frame.payloadLength,
+          .timestamp = usecTimestamp(),
+        };
+        xQueueSend(uartRxQueue, &rxFrame, portMAX_DELAY);
+        STATS_CNT_RATE_EVENT(&rxPacketRate);
+      } else {
+        rxErrors++;
+      }
+      xEventGroupSetBits(evGroup, ESP_CTR_EVENT);
+      isCorruptFrameReceived = false;
+    }
+  }
+
+  // The ESP is waiting for clear-to-receive after the corrupt frame, tell it
+  // once when the rest of the frame has been searched
+  if (isCorruptFrameReceived && !hasIncompleteFrame) {
+    xEventGroupSetBits(evGroup, ESP_CTR_EVENT);
+  }
+
+  return hasIncompleteFrame;
 }
 
 static void CPX_UART_RX(void *param)
 {
   systemWaitStart();
 
+  bool hasIncompleteFrame = false;
   while (shutdownTransport == false)
   {
-    // Wait for start!
-    uartRxp.start = 0x00;
-    do
+    const bool hasReceived = rxWait(M2T(200));
+    if (!hasReceived && hasIncompleteFrame)
     {
-      uart2GetDataWithTimeout(1, &uartRxp.start, M2T(200));
-    } while (uartRxp.start != 0xFF && shutdownTransport == false);
-
-    if (uartRxp.start == 0xFF) {
-      uart2GetData(1, &uartRxp.payloadLength);
-
-      if (uartRxp.payloadLength == 0)
-      {
-        xEventGroupSetBits(evGroup, ESP_CTS_EVENT);
-      }
-      else
-      {
-        uart2GetData(uartRxp.payloadLength, (uint8_t*) &uartRxp.payload);
-
-        uint8_t crc;
-        uart2GetData(1, &crc);
-        ASSERT(crc == calcCrc(&uartRxp));
-
-        xQueueSend(uartRxQueue, &uartRxp, portMAX_DELAY);
-        xEventGroupSetBits(evGroup, ESP_CTR_EVENT);
-      }
+      // The rest of the frame never came, probably a corrupt length. Skip the
+      // start byte to find the next frame and tell the ESP to continue.
+      rxConsume(1);
+      rxErrors++;
+      xEventGroupSetBits(evGroup, ESP_CTR_EVENT);
     }
+
+    hasIncompleteFrame = parseReceivedFrames();
   }
 
   xEventGroupSetBits(evGroup, RX_DEINIT_EVENT);
@@ -214,9 +320,10 @@ static void CPX_UART_TX(void *param)
     if (uxQueueMessagesWaiting(uartTxQueue) > 0)
     {
       // Dequeue and wait for either CTS or CTR
+      CPXRoutablePacket_t* cpxTxp;
       xQueueReceive(uartTxQueue, &cpxTxp, 0);
       uartTxp.start = 0xFF;
-      assemblePacket(&cpxTxp, &uartTxp);
+      assemblePacket(cpxTxp, &uartTxp);
       do
       {
         evBits = xEventGroupWaitBits(evGroup,
@@ -229,7 +336,15 @@ static void CPX_UART_TX(void *param)
           uart2SendData(sizeof(ctr), (uint8_t *)&ctr);
         }
       } while ((evBits & ESP_CTS_EVENT) != ESP_CTS_EVENT);
-      uart2SendData((uint32_t) uartTxp.payloadLength + UART_META_LENGTH, (uint8_t *)&uartTxp);
+      const uint32_t size = (uint32_t) uartTxp.payloadLength + UART_META_LENGTH;
+#ifdef CONFIG_MOTORS_ESC_PROTOCOL_DSHOT
+      // The UART2 TX DMA stream is used by the motors
+      uart2SendData(size, (uint8_t *)&uartTxp);
+#else
+      uart2SendDataDmaBlocking(size, (uint8_t *)&uartTxp);
+#endif
+      STATS_CNT_RATE_MULTI_EVENT(&txByteRate, size);
+      cpxPacketPoolRelease(cpxTxp);
     }
   }
 
@@ -237,29 +352,38 @@ static void CPX_UART_TX(void *param)
   vTaskDelete(NULL);
 }
 
-void cpxUARTTransportSend(const CPXRoutablePacket_t* packet) {
+void cpxUARTTransportSend(CPXRoutablePacket_t* packet) {
   ASSERT(isInit == true && shutdownTransport == false);
   ASSERT(packet);
 
-  xQueueSend(uartTxQueue, packet, portMAX_DELAY);
+  xQueueSend(uartTxQueue, &packet, portMAX_DELAY);
   xEventGroupSetBits(evGroup, ESP_TXQ_EVENT);
 }
 
-void cpxUARTTransportReceive(CPXRoutablePacket_t* packet) {
+CPXRoutablePacket_t* cpxUARTTransportReceive(void) {
   ASSERT(isInit == true && shutdownTransport == false);
-  ASSERT(packet);
 
-  static uart_transport_packet_t cpxRxp;
-
-  xQueueReceive(uartRxQueue, &cpxRxp, portMAX_DELAY);
-
-  packet->dataLength = (uint32_t) cpxRxp.payloadLength - CPX_ROUTING_PACKED_SIZE;
-  packet->route.destination = cpxRxp.routablePayload.route.destination;
-  packet->route.source = cpxRxp.routablePayload.route.source;
-  packet->route.function = cpxRxp.routablePayload.route.function;
-  packet->route.lastPacket = cpxRxp.routablePayload.route.lastPacket;
-  memcpy(&packet->data, cpxRxp.routablePayload.data, packet->dataLength);
+  uartRxFrame_t frame;
+  xQueueReceive(uartRxQueue, &frame, portMAX_DELAY);
+  CPXRoutablePacket_t* packet = cpxPacketPoolAllocateRx();
+
+  // Unpack straight from the receive buffer
+  CPXRoutingPacked_t route;
+  cpxUartFrameCopy((uint8_t*) &route, frame.buffer, UART_RX_BUFFER_SIZE, frame.payloadIndex, CPX_ROUTING_PACKED_SIZE);
+  packet->dataLength = (uint32_t) frame.payloadLength - CPX_ROUTING_PACKED_SIZE;
+  packet->route.destination = route.destination;
+  packet->route.source = route.source;
+  packet->route.function = route.function;
+  packet->route.lastPacket = route.lastPacket;
+  const uint32_t dataIndex = (frame.payloadIndex + CPX_ROUTING_PACKED_SIZE) & (UART_RX_BUFFER_SIZE - 1);
+  cpxUartFrameCopy(packet->data, frame.buffer, UART_RX_BUFFER_SIZE, dataIndex, packet->dataLength);
+
+  rxLatencyUs = (uint32_t)(usecTimestamp() - frame.timestamp);
+  if (rxLatencyUs > rxLatencyMaxUs) {
+    rxLatencyMaxUs = rxLatencyUs;
+  }
 
+  return packet;
 }
 
 void cpxUARTTransportInit() {
@@ -268,8 +392,8 @@ void cpxUARTTransportInit() {
   // since the procedure will reset the Crazyflie after ESP has been bootloaded
   ASSERT(shutdownTransport==false);
 
-  uartTxQueue = xQueueCreate(UART_TX_QUEUE_LENGTH, sizeof(CPXPacket_t));
-  uartRxQueue = xQueueCreate(UART_RX_QUEUE_LENGTH, sizeof(uart_transport_packet_t));
+  uartTxQueue = xQueueCreate(UART_TX_QUEUE_LENGTH, sizeof(CPXRoutablePacket_t*));
+  uartRxQueue = xQueueCreate(UART_RX_QUEUE_LENGTH, sizeof(uartRxFrame_t));
 
   evGroup = xEventGroupCreate();
 
@@ -295,3 +419,33 @@ void cpxUARTTransportDeinit() {
                       pdTRUE, // Wait for all bits
                       portMAX_DELAY);
 }
+
+/**
+ * Statistics of the CPX transport on UART2 (to the AI-deck)
+ */
+LOG_GROUP_START(cpxUart)
+/**
+ * @brief Received bytes per second
+ */
+STATS_CNT_RATE_LOG_ADD(rxRate, &rxByteRate)
+/**
+ * @brief Received packets per second
+ */
+STATS_CNT_RATE_LOG_ADD(rxPkt, &rxPacketRate)
+/**
+ * @brief Sent bytes per second
+ */
+STATS_CNT_RATE_LOG_ADD(txRate, &txByteRate)
+/**
+ * @brief Number of dropped frames, with a bad checksum or length
+ */
+LOG_ADD(LOG_UINT32, rxErr, &rxErrors)
+/**
+ * @brief Time from parsing a received packet until it was handed to the router [us]
+ */
+LOG_ADD(LOG_UINT32, rxLat, &rxLatencyUs)
+/**
+ * @brief Maximum of rxLat since start up [us]
+ */
+LOG_ADD(LOG_UINT32, rxLatMax, &rxLatencyMaxUs)
+LOG_GROUP_STOP(cpxUart)
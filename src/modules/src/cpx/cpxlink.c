@@ -45,6 +45,7 @@
 #include "cpx_internal_router.h"
 #include "cpxlink.h"
 #include "debug.h"
+#include "cfassert.h"
 
 static bool isInit = false;
 
@@ -57,13 +58,17 @@ static int cpxlinkSendPacket(CRTPPacket *p);
 static int cpxlinkSetEnable(bool enable);
 static int cpxlinkReceivePacket(CRTPPacket *p);
 static bool cpxlinkIsConnected(void);
+static int cpxlinkSendFrame(uint8_t *data, uint32_t length);
 
 static struct crtpLinkOperations cpxlinkOp =
 {
   .setEnable         = cpxlinkSetEnable,
   .sendPacket        = cpxlinkSendPacket,
   .receivePacket     = cpxlinkReceivePacket,
-  .isConnected       = cpxlinkIsConnected
+  .isConnected       = cpxlinkIsConnected,
+  .sendFrame         = cpxlinkSendFrame,
+  // Fit a frame in one CPX packet on the UART
+  .maxFrameSize      = CPX_MAX_PAYLOAD_SIZE - CPX_ROUTING_PACKED_SIZE,
 };
 
 static int cpxlinkReceivePacket(CRTPPacket *p)
@@ -95,6 +100,21 @@ static int cpxlinkSendPacket(CRTPPacket *p)
   return true;
 }
 
+static int cpxlinkSendFrame(uint8_t *data, uint32_t length)
+{
+  ASSERT(length <= CPX_MAX_PAYLOAD_SIZE - CPX_ROUTING_PACKED_SIZE);
+
+  ledseqRun(&seq_linkDown);
+
+  cpxInitRoute(CPX_T_STM32, CPX_T_WIFI_HOST, CPX_F_CRTP, &cpxTx.route);
+
+  memcpy(&cpxTx.data, data, length);
+  cpxTx.dataLength = length;
+  cpxSendPacketBlocking(&cpxTx);
+
+  return true;
+}
+
 static int cpxlinkSetEnable(bool enable)
 {
   return 0;
@@ -25,6 +25,7 @@
  */
 
 #include <stdbool.h>
+#include <string.h>
 #include <errno.h>
 
 /*FreeRtos includes*/
@@ -40,6 +41,9 @@
 #include "cfassert.h"
 #include "queuemonitor.h"
 #include "static_mem.h"
+#include "usec_time.h"
+#include "crtp_tx_scheduler.h"
+#include "crtp_frame.h"
 
 #include "log.h"
 
@@ -60,19 +64,61 @@ static struct {
   uint32_t rxCount;
   uint32_t txCount;
 
+  uint32_t txFrameCount;
+  uint32_t txByteCount;
+
   uint16_t rxRate;
   uint16_t txRate;
+  uint16_t txFrameRate;
+  uint32_t txByteRate;
 
   uint32_t nextStatisticsTime;
   uint32_t previousStatisticsTime;
+
+  // Per TX lane
+  uint32_t txDropped[CRTP_TX_LANE_COUNT];
+  uint32_t txLatency[CRTP_TX_LANE_COUNT];
 } stats;
 
-static xQueueHandle  txQueue;
+typedef struct {
+  CRTPPacket packet;
+  uint32_t enqueueTime;
+} crtpTxItem_t;
+
+// The TX packets are queued in lanes by priority, the TX task picks the lane
+// to send from with a weighted round robin scheduler. Latency critical replies
+// (link, setpoint and high level commander acks, params) are never stuck
+// behind a burst of log data.
+static xQueueHandle txQueues[CRTP_TX_LANE_COUNT];
+// Given once for every queued packet, the TX task waits on it
+static xSemaphoreHandle txPending;
+static crtpTxScheduler_t txScheduler;
+
+// Aggregation of TX packets into frames on links with a large MTU, requested by
+// the client through link control. It is switched on by the TX task once the
+// reply to the request has been sent, the reply itself is never aggregated.
+#define CRTP_TX_FRAME_BUFFER_SIZE 128
+static volatile bool txAggregation = false;
+static volatile bool txAggregationRequested = false;
+NO_DMA_CCM_SAFE_ZERO_INIT static uint8_t txFrame[CRTP_TX_FRAME_BUFFER_SIZE];
 
 #define CRTP_NBR_OF_PORTS 16
 #define CRTP_TX_QUEUE_SIZE 120
 #define CRTP_RX_QUEUE_SIZE 16
 
+static const uint8_t txLaneSize[CRTP_TX_LANE_COUNT] = {
+  [crtpTxLaneHigh] = 16,
+  [crtpTxLaneNormal] = 40,
+  [crtpTxLaneLow] = CRTP_TX_QUEUE_SIZE - 16 - 40,
+};
+
+// Packets sent per lane in a round when the link is saturated
+static const uint8_t txLaneWeight[CRTP_TX_LANE_COUNT] = {
+  [crtpTxLaneHigh] = 8,
+  [crtpTxLaneNormal] = 4,
+  [crtpTxLaneLow] = 2,
+};
+
 static void crtpTxTask(void *param);
 static void crtpRxTask(void *param);
 
@@ -88,8 +134,12 @@ void crtpInit(void)
   if(isInit)
     return;
 
-  txQueue = xQueueCreate(CRTP_TX_QUEUE_SIZE, sizeof(CRTPPacket));
-  DEBUG_QUEUE_MONITOR_REGISTER(txQueue);
+  for (int lane = 0; lane < CRTP_TX_LANE_COUNT; lane++) {
+    txQueues[lane] = xQueueCreate(txLaneSize[lane], sizeof(crtpTxItem_t));
+    DEBUG_QUEUE_MONITOR_REGISTER(txQueues[lane]);
+  }
+  txPending = xSemaphoreCreateCounting(CRTP_TX_QUEUE_SIZE, 0);
+  crtpTxSchedulerInit(&txScheduler, txLaneWeight);
 
   STATIC_MEM_TASK_CREATE(crtpTxTask, crtpTxTask, CRTP_TX_TASK_NAME, NULL, CRTP_TX_TASK_PRI);
   STATIC_MEM_TASK_CREATE(crtpRxTask, crtpRxTask, CRTP_RX_TASK_NAME, NULL, CRTP_RX_TASK_PRI);
@@ -135,29 +185,161 @@ int crtpReceivePacketWait(CRTPPort portId, CRTPPacket *p, int wait)
   return xQueueReceive(queues[portId], p, M2T(wait));
 }
 
+static crtpTxLane_t getTxLane(uint8_t port)
+{
+  switch (port)
+  {
+    case CRTP_PORT_LINK:
+    case CRTP_PORT_PLATFORM:
+    case CRTP_PORT_SETPOINT:
+    case CRTP_PORT_SETPOINT_GENERIC:
+    case CRTP_PORT_SETPOINT_HL:
+    case CRTP_PORT_PARAM:
+      return crtpTxLaneHigh;
+    case CRTP_PORT_LOG:
+      return crtpTxLaneLow;
+    default:
+      return crtpTxLaneNormal;
+  }
+}
+
 int crtpGetFreeTxQueuePackets(void)
 {
-  return (CRTP_TX_QUEUE_SIZE - uxQueueMessagesWaiting(txQueue));
+  int freePackets = 0;
+  for (int lane = 0; lane < CRTP_TX_LANE_COUNT; lane++) {
+    freePackets += txLaneSize[lane] - uxQueueMessagesWaiting(txQueues[lane]);
+  }
+
+  return freePackets;
+}
+
+int crtpGetTxCredits(CRTPPort port)
+{
+  const crtpTxLane_t lane = getTxLane(port);
+  return txLaneSize[lane] - uxQueueMessagesWaiting(txQueues[lane]);
+}
+
+// Take the next packet to send from the lanes, returns the lane or -1
+static int receiveTxItem(crtpTxItem_t *item, TickType_t wait)
+{
+  uint32_t pending[CRTP_TX_LANE_COUNT];
+
+  if (xSemaphoreTake(txPending, wait) != pdTRUE)
+  {
+    return -1;
+  }
+
+  for (int lane = 0; lane < CRTP_TX_LANE_COUNT; lane++) {
+    pending[lane] = uxQueueMessagesWaiting(txQueues[lane]);
+  }
+
+  // The lanes may be empty after a reset
+  const int lane = crtpTxSchedulerNext(&txScheduler, pending);
+  if (lane < 0 || xQueueReceive(txQueues[lane], item, 0) != pdTRUE)
+  {
+    return -1;
+  }
+
+  stats.txLatency[lane] = (uint32_t)usecTimestamp() - item->enqueueTime;
+  stats.txCount++;
+  return lane;
+}
+
+static bool isTxAggregationReply(const CRTPPacket *p)
+{
+  return CRTP_IS_NULL_PACKET((*p)) && p->size >= 1 && p->data[0] == CRTP_LINK_CTRL_TX_AGGREGATION;
+}
+
+static void sendSingle(crtpTxItem_t *item)
+{
+  // Keep testing, if the link changes to USB it will go though
+  while (link->sendPacket(&item->packet) == false)
+  {
+    // Relaxation time
+    vTaskDelay(M2T(10));
+  }
+  stats.txByteCount += item->packet.size + 1;
+  updateStats();
+
+  if (txAggregationRequested && isTxAggregationReply(&item->packet))
+  {
+    txAggregationRequested = false;
+    txAggregation = true;
+  }
+}
+
+static bool isAggregationSupported(struct crtpLinkOperations *lk)
+{
+  // A frame must fit at least one full packet
+  return lk->sendFrame &&
+    lk->maxFrameSize >= CRTP_FRAME_HEADER_SIZE + CRTP_FRAME_PACKET_SIZE(CRTP_MAX_DATA_SIZE);
+}
+
+// Pack the item and any packets queued behind it into as few frames as possible
+static void sendAggregated(crtpTxItem_t *item)
+{
+  // The link may change while sending
+  struct crtpLinkOperations *frameLink = link;
+  if (!isAggregationSupported(frameLink))
+  {
+    sendSingle(item);
+    return;
+  }
+
+  uint32_t maxFrameSize = frameLink->maxFrameSize;
+  if (maxFrameSize > CRTP_TX_FRAME_BUFFER_SIZE)
+  {
+    maxFrameSize = CRTP_TX_FRAME_BUFFER_SIZE;
+  }
+
+  crtpFrame_t frame;
+  bool hasItem = true;
+  // Stop packing as soon as aggregation is switched off, the reply to the
+  // link control request must be sent on its own
+  while (hasItem && txAggregation)
+  {
+    crtpFrameInit(&frame, txFrame, maxFrameSize);
+    while (hasItem && txAggregation && crtpFrameAdd(&frame, &item->packet))
+    {
+      hasItem = (receiveTxItem(item, 0) >= 0);
+    }
+
+    if (frame.packetCount > 0)
+    {
+      while (frameLink->sendFrame(frame.buffer, frame.length) == false)
+      {
+        vTaskDelay(M2T(10));
+      }
+      stats.txFrameCount++;
+      stats.txByteCount += frame.length;
+      updateStats();
+    }
+  }
+
+  if (hasItem)
+  {
+    sendSingle(item);
+  }
 }
 
 void crtpTxTask(void *param)
 {
-  CRTPPacket p;
+  crtpTxItem_t item;
 
   while (true)
   {
     if (link != &nopLink)
     {
-      if (xQueueReceive(txQueue, &p, portMAX_DELAY) == pdTRUE)
+      if (receiveTxItem(&item, portMAX_DELAY) >= 0)
       {
-        // Keep testing, if the link changes to USB it will go though
-        while (link->sendPacket(&p) == false)
+        if (txAggregation)
         {
-          // Relaxation time
-          vTaskDelay(M2T(10));
+          sendAggregated(&item);
+        }
+        else
+        {
+          sendSingle(&item);
         }
-        stats.txCount++;
-        updateStats();
       }
     }
     else
@@ -207,25 +389,44 @@ void crtpRegisterPortCB(int port, CrtpCallback cb)
   callbacks[port] = cb;
 }
 
-int crtpSendPacket(CRTPPacket *p)
+static int enqueueTxPacket(CRTPPacket *p, TickType_t wait)
 {
   ASSERT(p);
   ASSERT(p->size <= CRTP_MAX_DATA_SIZE);
 
-  return xQueueSend(txQueue, p, 0);
+  const crtpTxLane_t lane = getTxLane(p->port);
+  crtpTxItem_t item = {
+    .packet = *p,
+    .enqueueTime = (uint32_t)usecTimestamp(),
+  };
+
+  int result = xQueueSend(txQueues[lane], &item, wait);
+  if (result == pdTRUE) {
+    xSemaphoreGive(txPending);
+  } else {
+    stats.txDropped[lane]++;
+  }
+
+  return result;
 }
 
-int crtpSendPacketBlock(CRTPPacket *p)
+int crtpSendPacket(CRTPPacket *p)
 {
-  ASSERT(p);
-  ASSERT(p->size <= CRTP_MAX_DATA_SIZE);
+  return enqueueTxPacket(p, 0);
+}
 
-  return xQueueSend(txQueue, p, portMAX_DELAY);
+int crtpSendPacketBlock(CRTPPacket *p)
+{
+  return enqueueTxPacket(p, portMAX_DELAY);
 }
 
 int crtpReset(void)
 {
-  xQueueReset(txQueue);
+  txAggregation = false;
+  txAggregationRequested = false;
+  for (int lane = 0; lane < CRTP_TX_LANE_COUNT; lane++) {
+    xQueueReset(txQueues[lane]);
+  }
   if (link->reset) {
     link->reset();
   }
@@ -240,8 +441,23 @@ bool crtpIsConnected(void)
   return true;
 }
 
+bool crtpSetTxAggregation(bool enable)
+{
+  const bool enabled = enable && isAggregationSupported(link);
+
+  // Switched off until the reply to the client has been sent
+  txAggregation = false;
+  txAggregationRequested = enabled;
+
+  return enabled;
+}
+
 void crtpSetLink(struct crtpLinkOperations * lk)
 {
+  // The client negotiates aggregation again on the new link
+  txAggregation = false;
+  txAggregationRequested = false;
+
   if(link)
     link->setEnable(false);
 
@@ -262,6 +478,8 @@ static void clearStats()
 {
   stats.rxCount = 0;
   stats.txCount = 0;
+  stats.txFrameCount = 0;
+  stats.txByteCount = 0;
 }
 
 static void updateStats()
@@ -271,6 +489,8 @@ static void updateStats()
     float interval = now - stats.previousStatisticsTime;
     stats.rxRate = (uint16_t)(1000.0f * stats.rxCount / interval);
     stats.txRate = (uint16_t)(1000.0f * stats.txCount / interval);
+    stats.txFrameRate = (uint16_t)(1000.0f * stats.txFrameCount / interval);
+    stats.txByteRate = (uint32_t)(1000.0f * stats.txByteCount / interval);
 
     clearStats();
     stats.previousStatisticsTime = now;
@@ -278,7 +498,51 @@ static void updateStats()
   }
 }
 
+/**
+ * CRTP packet rates, and drops and latency of the TX lanes. Packets are
+ * queued in the high (link, platform, setpoints, high level commander and
+ * params), normal (console, mem, localization and other ports) or low (log)
+ * priority lane.
+ */
 LOG_GROUP_START(crtp)
+/**
+ * @brief Received packets [packets/s]
+ */
 LOG_ADD(LOG_UINT16, rxRate, &stats.rxRate)
+/**
+ * @brief Sent packets [packets/s]
+ */
 LOG_ADD(LOG_UINT16, txRate, &stats.txRate)
+/**
+ * @brief Sent aggregated frames [frames/s]
+ */
+LOG_ADD(LOG_UINT16, txFrameRate, &stats.txFrameRate)
+/**
+ * @brief Bytes sent on the link, including framing [bytes/s]
+ */
+LOG_ADD(LOG_UINT32, txByteRate, &stats.txByteRate)
+/**
+ * @brief Packets dropped from the high priority lane since start up
+ */
+LOG_ADD(LOG_UINT32, txDropHi, &stats.txDropped[crtpTxLaneHigh])
+/**
+ * @brief Packets dropped from the normal priority lane since start up
+ */
+LOG_ADD(LOG_UINT32, txDropNorm, &stats.txDropped[crtpTxLaneNormal])
+/**
+ * @brief Packets dropped from the low priority lane since start up
+ */
+LOG_ADD(LOG_UINT32, txDropLow, &stats.txDropped[crtpTxLaneLow])
+/**
+ * @brief Time the latest packet of the high priority lane was queued [us]
+ */
+LOG_ADD(LOG_UINT32, txLatHi, &stats.txLatency[crtpTxLaneHigh])
+/**
+ * @brief Time the latest packet of the normal priority lane was queued [us]
+ */
+LOG_ADD(LOG_UINT32, txLatNorm, &stats.txLatency[crtpTxLaneNormal])
+/**
+ * @brief Time the latest packet of the low priority lane was queued [us]
+ */
+LOG_ADD(LOG_UINT32, txLatLow, &stats.txLatency[crtpTxLaneLow])
 LOG_GROUP_STOP(crtp)
@@ -300,7 +300,7 @@ int crtpCommanderHighLevelDisable()
 
 bool crtpCommanderHighLevelGetSetpoint(setpoint_t* setpoint, const state_t *state, uint32_t tick)
 {
-  if (!RATE_DO_EXECUTE(RATE_HL_COMMANDER, tick)) {
+  if (!RATE_DO_EXECUTE_PHASED(RATE_HL_COMMANDER, HL_COMMANDER_PHASE, tick)) {
     return false;
   }
 
@@ -0,0 +1,50 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2023 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "crtp_frame.h"
+
+void crtpFrameInit(crtpFrame_t* frame, uint8_t* buffer, uint32_t maxSize) {
+  frame->buffer = buffer;
+  frame->maxSize = maxSize;
+  frame->length = 0;
+  frame->packetCount = 0;
+
+  frame->buffer[frame->length++] = CRTP_NULL_PACKET_HEADER;
+  frame->buffer[frame->length++] = CRTP_LINK_CTRL_FRAME;
+}
+
+bool crtpFrameAdd(crtpFrame_t* frame, const CRTPPacket* p) {
+  if (frame->length + CRTP_FRAME_PACKET_SIZE(p->size) > frame->maxSize) {
+    return false;
+  }
+
+  frame->buffer[frame->length++] = p->size + 1;
+  memcpy(&frame->buffer[frame->length], p->raw, p->size + 1);
+  frame->length += p->size + 1;
+  frame->packetCount++;
+
+  return true;
+}
@@ -253,17 +253,7 @@ static void lhPersistDataWorker(void* arg) {
 #ifdef CONFIG_DECK_LIGHTHOUSE
   LhPersistArgs_t* args = (LhPersistArgs_t*) &arg;
 
-  bool result = true;
-
-  for (int baseStation = 0; baseStation < CONFIG_DECK_LIGHTHOUSE_MAX_N_BS; baseStation++) {
-    uint16_t mask = 1 << baseStation;
-    bool storeGeo = (args->geoDataBsField & mask) != 0;
-    bool storeCalibration = (args->calibrationDataBsField & mask) != 0;
-    if (! lighthouseStoragePersistData(baseStation, storeGeo, storeCalibration)) {
-      result = false;
-      break;
-    }
-  }
+  bool result = lighthouseStoragePersistDataForBaseStations(args->geoDataBsField, args->calibrationDataBsField);
 #else
   bool result = false;
 #endif
@@ -0,0 +1,54 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2023 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "crtp_tx_scheduler.h"
+
+void crtpTxSchedulerInit(crtpTxScheduler_t* scheduler, const uint8_t weights[CRTP_TX_LANE_COUNT]) {
+  memcpy(scheduler->weights, weights, sizeof(scheduler->weights));
+  memcpy(scheduler->credits, weights, sizeof(scheduler->credits));
+}
+
+static int takeCredit(crtpTxScheduler_t* scheduler, const uint32_t pending[CRTP_TX_LANE_COUNT]) {
+  for (int lane = 0; lane < CRTP_TX_LANE_COUNT; lane++) {
+    if (pending[lane] > 0 && scheduler->credits[lane] > 0) {
+      scheduler->credits[lane]--;
+      return lane;
+    }
+  }
+
+  return -1;
+}
+
+int crtpTxSchedulerNext(crtpTxScheduler_t* scheduler, const uint32_t pending[CRTP_TX_LANE_COUNT]) {
+  int lane = takeCredit(scheduler, pending);
+  if (lane < 0) {
+    // All lanes with packets are out of credits (or all lanes are empty), start a new round
+    memcpy(scheduler->credits, scheduler->weights, sizeof(scheduler->credits));
+    lane = takeCredit(scheduler, pending);
+  }
+
+  return lane;
+}
@@ -41,6 +41,8 @@ typedef enum {
   linkEcho   = 0x00,
   linkSource = 0x01,
   linkSink   = 0x02,
+  // Null packets, used for out of band link control on links that deliver them
+  linkNull   = 0x03,
 } LinkNbr;
 
 
@@ -92,6 +94,15 @@ static void crtpSrvTask(void* prm)
       case linkSink:
         /* Ignore packet */
         break;
+      case linkNull:
+        if (p.size >= 2 && p.data[0] == CRTP_LINK_CTRL_TX_AGGREGATION) {
+          // Reply with the resulting state. The reply is sent as a single packet,
+          // aggregation is switched on once it has been sent.
+          p.data[1] = crtpSetTxAggregation(p.data[1] != 0);
+          p.size = 2;
+          crtpSendPacketBlock(&p);
+        }
+        break;
       default:
         break;
     }
@@ -1,5 +1,5 @@
 #include "FreeRTOS.h"
-#include "queue.h"
+#include "task.h"
 #include "static_mem.h"
 
 #define DEBUG_MODULE "ESTIMATOR"
@@ -13,14 +13,65 @@
 #include "statsCnt.h"
 #include "eventtrigger.h"
 #include "quatcompress.h"
+#include "usec_time.h"
 
 #define DEFAULT_ESTIMATOR complementaryEstimator
 static StateEstimatorType currentEstimator = anyEstimator;
 
 
-#define MEASUREMENTS_QUEUE_SIZE (20)
-static xQueueHandle measurementsQueue;
-STATIC_MEM_QUEUE_ALLOC(measurementsQueue, MEASUREMENTS_QUEUE_SIZE, sizeof(measurement_t));
+static bool isInit = false;
+
+// Measurements are passed to the estimator through lock free single producer/single consumer rings, one ring per
+// producing task. The estimator is the only consumer and merges the rings in the order the measurements were enqueued.
+// The external ring is fed from several tasks (CRTP localization service, apps), pushes to it are serialized with a
+// critical section.
+typedef enum {
+  measurementRingImu,
+  measurementRingLighthouse,
+  measurementRingLoco,
+  measurementRingFlow,
+  measurementRingRange,
+  measurementRingExternal,
+  measurementRingCount,
+} measurementRingId_t;
+
+typedef struct {
+  measurement_t* slots;
+  uint32_t size; // Must be a power of 2
+  uint32_t head; // Only written by the producer
+  uint32_t tail; // Only written by the consumer
+  uint8_t highWaterMark;
+  uint32_t dropped;
+  bool isMultiProducer;
+} measurementRing_t;
+
+#ifdef CONFIG_SENSORS_BMI088_FIFO
+// Gyro samples at 2 kHz and accelerometer samples at 1.6 kHz
+#define MEASUREMENT_RING_SIZE_IMU (32)
+#else
+#define MEASUREMENT_RING_SIZE_IMU (16)
+#endif
+#define MEASUREMENT_RING_SIZE_LIGHTHOUSE (16)
+#define MEASUREMENT_RING_SIZE_LOCO (8)
+#define MEASUREMENT_RING_SIZE_FLOW (4)
+#define MEASUREMENT_RING_SIZE_RANGE (4)
+#define MEASUREMENT_RING_SIZE_EXTERNAL (8)
+
+NO_DMA_CCM_SAFE_ZERO_INIT static measurement_t imuSlots[MEASUREMENT_RING_SIZE_IMU];
+NO_DMA_CCM_SAFE_ZERO_INIT static measurement_t lighthouseSlots[MEASUREMENT_RING_SIZE_LIGHTHOUSE];
+NO_DMA_CCM_SAFE_ZERO_INIT static measurement_t locoSlots[MEASUREMENT_RING_SIZE_LOCO];
+NO_DMA_CCM_SAFE_ZERO_INIT static measurement_t flowSlots[MEASUREMENT_RING_SIZE_FLOW];
+NO_DMA_CCM_SAFE_ZERO_INIT static measurement_t rangeSlots[MEASUREMENT_RING_SIZE_RANGE];
+NO_DMA_CCM_SAFE_ZERO_INIT static measurement_t externalSlots[MEASUREMENT_RING_SIZE_EXTERNAL];
+
+static measurementRing_t measurementRings[measurementRingCount] = {
+  [measurementRingImu] = {.slots = imuSlots, .size = MEASUREMENT_RING_SIZE_IMU},
+  [measurementRingLighthouse] = {.slots = lighthouseSlots, .size = MEASUREMENT_RING_SIZE_LIGHTHOUSE},
+  [measurementRingLoco] = {.slots = locoSlots, .size = MEASUREMENT_RING_SIZE_LOCO},
+  [measurementRingFlow] = {.slots = flowSlots, .size = MEASUREMENT_RING_SIZE_FLOW},
+  [measurementRingRange] = {.slots = rangeSlots, .size = MEASUREMENT_RING_SIZE_RANGE},
+  [measurementRingExternal] = {.slots = externalSlots, .size = MEASUREMENT_RING_SIZE_EXTERNAL, .isMultiProducer = true},
+};
 
 // Statistics
 #define ONE_SECOND 1000
@@ -90,7 +141,7 @@ static EstimatorFcns estimatorFunctions[] = {
 };
 
 void stateEstimatorInit(StateEstimatorType estimator) {
-  measurementsQueue = STATIC_MEM_QUEUE_CREATE(measurementsQueue);
+  isInit = true;
   stateEstimatorSwitchTo(estimator);
 }
 
@@ -156,24 +207,83 @@ const char* stateEstimatorGetName() {
 }
 
 
+// All rings but the external ring must only be fed from one task, see the measurement sources in estimator.h
+static measurementRingId_t getMeasurementRing(const measurement_t *measurement) {
+  switch (measurement->type) {
+    case MeasurementTypeGyroscope:
+    case MeasurementTypeAcceleration:
+    case MeasurementTypeBarometer:
+      return measurementRingImu;
+    case MeasurementTypeSweepAngle:
+    case MeasurementTypeYawError:
+      return measurementRingLighthouse;
+    case MeasurementTypePosition:
+      if (measurement->data.position.source == MeasurementSourceLighthouse) {
+        return measurementRingLighthouse;
+      }
+      return measurementRingExternal;
+    case MeasurementTypeTDOA:
+    case MeasurementTypeDistance:
+    case MeasurementTypeAbsoluteHeight:
+      return measurementRingLoco;
+    case MeasurementTypeFlow:
+      return measurementRingFlow;
+    case MeasurementTypeTOF:
+      return measurementRingRange;
+    default:
+      return measurementRingExternal;
+  }
+}
+
+static bool measurementRingPush(measurementRing_t* ring, const measurement_t *measurement, const uint64_t timestamp) {
+  const uint32_t head = ring->head;
+  const uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+  const uint32_t used = head - tail;
+
+  if (used >= ring->size) {
+    ring->dropped++;
+    return false;
+  }
+
+  measurement_t* slot = &ring->slots[head & (ring->size - 1)];
+  *slot = *measurement;
+  slot->timestamp = timestamp;
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+
+  if (used + 1 > ring->highWaterMark) {
+    ring->highWaterMark = used + 1;
+  }
+
+  return true;
+}
+
 void estimatorEnqueue(const measurement_t *measurement) {
-  if (!measurementsQueue) {
+  estimatorEnqueueAt(measurement, usecTimestamp());
+}
+
+void estimatorEnqueueAt(const measurement_t *measurement, const uint64_t timestamp) {
+  if (!isInit) {
     return;
   }
 
-  portBASE_TYPE result;
-  bool isInInterrupt = (SCB->ICSR & SCB_ICSR_VECTACTIVE_Msk) != 0;
-  if (isInInterrupt) {
-    portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
-    result = xQueueSendFromISR(measurementsQueue, measurement, &xHigherPriorityTaskWoken);
-    if (xHigherPriorityTaskWoken == pdTRUE) {
-      portYIELD();
+  measurementRing_t* ring = &measurementRings[getMeasurementRing(measurement)];
+  bool isPushed;
+  if (ring->isMultiProducer) {
+    bool isInInterrupt = (SCB->ICSR & SCB_ICSR_VECTACTIVE_Msk) != 0;
+    if (isInInterrupt) {
+      UBaseType_t savedInterruptStatus = taskENTER_CRITICAL_FROM_ISR();
+      isPushed = measurementRingPush(ring, measurement, timestamp);
+      taskEXIT_CRITICAL_FROM_ISR(savedInterruptStatus);
+    } else {
+      taskENTER_CRITICAL();
+      isPushed = measurementRingPush(ring, measurement, timestamp);
+      taskEXIT_CRITICAL();
     }
   } else {
-    result = xQueueSend(measurementsQueue, measurement, 0);
+    isPushed = measurementRingPush(ring, measurement, timestamp);
   }
 
-  if (result == pdTRUE) {
+  if (isPushed) {
     STATS_CNT_RATE_EVENT(&measurementAppendedCounter);
   } else {
     STATS_CNT_RATE_EVENT(&measurementNotAppendedCounter);
@@ -243,10 +353,93 @@ void estimatorEnqueue(const measurement_t *measurement) {
 }
 
 bool estimatorDequeue(measurement_t *measurement) {
-  return pdTRUE == xQueueReceive(measurementsQueue, measurement, 0);
+  measurementRing_t* oldestRing = 0;
+  uint64_t oldestTimestamp = 0;
+
+  for (int i = 0; i < measurementRingCount; i++) {
+    measurementRing_t* ring = &measurementRings[i];
+    const uint32_t tail = ring->tail;
+    const uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    if (head != tail) {
+      const uint64_t timestamp = ring->slots[tail & (ring->size - 1)].timestamp;
+      if (oldestRing == 0 || timestamp < oldestTimestamp) {
+        oldestRing = ring;
+        oldestTimestamp = timestamp;
+      }
+    }
+  }
+
+  if (oldestRing == 0) {
+    return false;
+  }
+
+  const uint32_t tail = oldestRing->tail;
+  *measurement = oldestRing->slots[tail & (oldestRing->size - 1)];
+  __atomic_store_n(&oldestRing->tail, tail + 1, __ATOMIC_RELEASE);
+
+  return true;
 }
 
+/**
+ * Measurements passed to the estimator. Measurements are queued in one ring per producer, the high water mark is the
+ * max number of measurements that has been waiting in a ring and the drop counters are the total number of
+ * measurements that were lost because a ring was full.
+ */
 LOG_GROUP_START(estimator)
+  /**
+   * @brief Rate of measurements added to the estimator [1/s]
+   */
   STATS_CNT_RATE_LOG_ADD(rtApnd, &measurementAppendedCounter)
+  /**
+   * @brief Rate of measurements rejected because the estimator could not keep up [1/s]
+   */
   STATS_CNT_RATE_LOG_ADD(rtRej, &measurementNotAppendedCounter)
+  /**
+   * @brief High water mark of the IMU (gyro, accelerometer, barometer) ring
+   */
+  LOG_ADD(LOG_UINT8, hwImu, &measurementRings[measurementRingImu].highWaterMark)
+  /**
+   * @brief High water mark of the lighthouse ring
+   */
+  LOG_ADD(LOG_UINT8, hwLh, &measurementRings[measurementRingLighthouse].highWaterMark)
+  /**
+   * @brief High water mark of the loco positioning ring
+   */
+  LOG_ADD(LOG_UINT8, hwLoco, &measurementRings[measurementRingLoco].highWaterMark)
+  /**
+   * @brief High water mark of the flow ring
+   */
+  LOG_ADD(LOG_UINT8, hwFlow, &measurementRings[measurementRingFlow].highWaterMark)
+  /**
+   * @brief High water mark of the range (ToF) ring
+   */
+  LOG_ADD(LOG_UINT8, hwRange, &measurementRings[measurementRingRange].highWaterMark)
+  /**
+   * @brief High water mark of the ring for external position and pose
+   */
+  LOG_ADD(LOG_UINT8, hwExt, &measurementRings[measurementRingExternal].highWaterMark)
+  /**
+   * @brief Number of dropped IMU measurements
+   */
+  LOG_ADD(LOG_UINT32, dropImu, &measurementRings[measurementRingImu].dropped)
+  /**
+   * @brief Number of dropped lighthouse measurements
+   */
+  LOG_ADD(LOG_UINT32, dropLh, &measurementRings[measurementRingLighthouse].dropped)
+  /**
+   * @brief Number of dropped loco positioning measurements
+   */
+  LOG_ADD(LOG_UINT32, dropLoco, &measurementRings[measurementRingLoco].dropped)
+  /**
+   * @brief Number of dropped flow measurements
+   */
+  LOG_ADD(LOG_UINT32, dropFlow, &measurementRings[measurementRingFlow].dropped)
+  /**
+   * @brief Number of dropped range measurements
+   */
+  LOG_ADD(LOG_UINT32, dropRange, &measurementRings[measurementRingRange].dropped)
+  /**
+   * @brief Number of dropped external position and pose measurements
+   */
+  LOG_ADD(LOG_UINT32, dropExt, &measurementRings[measurementRingExternal].dropped)
 LOG_GROUP_STOP(estimator)
@@ -43,10 +43,10 @@ static Axis3f acc;
 static baro_t baro;
 static tofMeasurement_t tof;
 
-#define ATTITUDE_UPDATE_RATE RATE_250_HZ
+#define ATTITUDE_UPDATE_RATE ESTIMATOR_ATTITUDE_RATE
 #define ATTITUDE_UPDATE_DT 1.0/ATTITUDE_UPDATE_RATE
 
-#define POS_UPDATE_RATE RATE_100_HZ
+#define POS_UPDATE_RATE ESTIMATOR_POSITION_RATE
 #define POS_UPDATE_DT 1.0/POS_UPDATE_RATE
 
     void
@@ -89,7 +89,7 @@ void estimatorComplementary(state_t *state, const uint32_t tick)
   }
 
   // Update filter
-  if (RATE_DO_EXECUTE(ATTITUDE_UPDATE_RATE, tick)) {
+  if (RATE_DO_EXECUTE_PHASED(ATTITUDE_UPDATE_RATE, ESTIMATOR_ATTITUDE_PHASE, tick)) {
     sensfusion6UpdateQ(gyro.x, gyro.y, gyro.z,
                         acc.x, acc.y, acc.z,
                         ATTITUDE_UPDATE_DT);
@@ -112,7 +112,7 @@ void estimatorComplementary(state_t *state, const uint32_t tick)
     positionUpdateVelocity(state->acc.z, ATTITUDE_UPDATE_DT);
   }
 
-  if (RATE_DO_EXECUTE(POS_UPDATE_RATE, tick)) {
+  if (RATE_DO_EXECUTE_PHASED(POS_UPDATE_RATE, ESTIMATOR_POSITION_PHASE, tick)) {
     positionEstimate(state, &baro, &tof, POS_UPDATE_DT, tick);
   }
 }
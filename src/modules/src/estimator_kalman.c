@@ -76,6 +76,7 @@
 
 #include "statsCnt.h"
 #include "rateSupervisor.h"
+#include "usec_time.h"
 
 // Measurement models
 #include "mm_distance.h"
@@ -110,7 +111,20 @@ static StaticSemaphore_t dataMutexBuffer;
 /**
  * Tuning parameters
  */
-#define PREDICT_RATE RATE_100_HZ // this is slower than the IMU update rate of 500Hz
+#ifdef CONFIG_ESTIMATOR_KALMAN_PREDICT_RATE
+#define PREDICT_RATE CONFIG_ESTIMATOR_KALMAN_PREDICT_RATE
+#else
+#define PREDICT_RATE RATE_100_HZ
+#endif
+#define PREDICT_INTERVAL_US (1000000 / PREDICT_RATE)
+
+// The prediction of the covariance is the expensive part of the prediction step. At prediction rates above this
+// rate, the state is predicted at every step while the covariance is predicted at this rate.
+#define COVARIANCE_PREDICT_RATE RATE_100_HZ
+#define PREDICTIONS_PER_COVARIANCE_PREDICTION ((PREDICT_RATE + COVARIANCE_PREDICT_RATE - 1) / COVARIANCE_PREDICT_RATE)
+
+// Expected time between IMU samples (us), the actual interval is measured
+#define IMU_SAMPLE_INTERVAL_US 1000
 // The bounds on the covariance, these shouldn't be hit, but sometimes are... why?
 #define MAX_COVARIANCE (100)
 #define MIN_COVARIANCE (1e-6f)
@@ -120,6 +134,14 @@ static StaticSemaphore_t dataMutexBuffer;
 static bool robustTwr = false;
 static bool robustTdoa = false;
 
+// Fold all queued lighthouse sweep angles into the filter with one batch update, instead of one update per angle.
+// On by default, can be turned off through a parameter.
+static bool batchSweepAngles = true;
+
+// Fuse measurements that are older than the latest prediction at the time they were taken, by retrodicting the state.
+// On by default, can be turned off through a parameter.
+static bool retrodictMeasurements = true;
+
 /**
  * Quadrocopter State
  *
@@ -148,6 +170,29 @@ static Axis3f gyroLatest;
 static bool quadIsFlying = false;
 
 static OutlierFilterLhState_t sweepOutlierFilterState;
+NO_DMA_CCM_SAFE_ZERO_INIT static kalmanCoreBatch_t sweepAngleBatch;
+// The sweep angles of a batch are taken at the same time and are linearized at the state retrodicted to it
+static bool isSweepAngleBatchOpen;
+static uint64_t sweepAngleBatchTimestamp;
+static kalmanCoreRetrodiction_t sweepAngleBatchRetrodiction;
+NO_DMA_CCM_SAFE_ZERO_INIT static kalmanCoreHistory_t history;
+
+// The age of the latest fused measurement (us)
+static uint32_t measurementAge;
+
+// Predictions are triggered by the arrival of IMU samples
+static uint64_t lastPrediction;
+static uint64_t nextPrediction;
+static uint64_t lastAccTimestamp;
+static uint32_t accSampleInterval;
+
+// Gyro integrated since the latest covariance prediction (rad)
+static Axis3f covarianceGyroAccumulator;
+static float covarianceDt;
+static uint32_t predictionsSinceCovariancePrediction;
+
+// Filtered execution time of the prediction step (us)
+static float predictionTime;
 
 // Indicates that the internal state is corrupt and should be reset
 bool resetEstimation = false;
@@ -162,6 +207,8 @@ static state_t taskEstimatorState; // The estimator state produced by the task,
 static STATS_CNT_RATE_DEFINE(updateCounter, ONE_SECOND);
 static STATS_CNT_RATE_DEFINE(predictionCounter, ONE_SECOND);
 static STATS_CNT_RATE_DEFINE(finalizeCounter, ONE_SECOND);
+static STATS_CNT_RATE_DEFINE(batchUpdateCounter, ONE_SECOND);
+static STATS_CNT_RATE_DEFINE(retrodictionCounter, ONE_SECOND);
 // static STATS_CNT_RATE_DEFINE(measurementAppendedCounter, ONE_SECOND);
 // static STATS_CNT_RATE_DEFINE(measurementNotAppendedCounter, ONE_SECOND);
 
@@ -177,7 +224,7 @@ static const bool useBaroUpdate = false;
 #endif
 
 static void kalmanTask(void* parameters);
-static bool predictStateForward(uint32_t osTick, float dt);
+static bool predictStateForward(uint64_t timestamp);
 static bool updateQueuedMeasurements(const uint32_t tick);
 
 STATIC_MEM_TASK_ALLOC_STACK_NO_DMA_CCM_SAFE(kalmanTask, 3 * configMINIMAL_STACK_SIZE);
@@ -204,11 +251,10 @@ bool estimatorKalmanTaskTest() {
 static void kalmanTask(void* parameters) {
   systemWaitStart();
 
-  uint32_t lastPrediction = xTaskGetTickCount();
-  uint32_t nextPrediction = xTaskGetTickCount();
   uint32_t lastPNUpdate = xTaskGetTickCount();
 
-  rateSupervisorInit(&rateSupervisorContext, xTaskGetTickCount(), ONE_SECOND, PREDICT_RATE - 1, PREDICT_RATE + 1, 1);
+  // The predictions are validated with their timestamps (us, see usecTimestamp()), in ms
+  rateSupervisorInit(&rateSupervisorContext, (uint32_t)(usecTimestamp() / 1000), ONE_SECOND, PREDICT_RATE - 1, PREDICT_RATE + 1, 1);
 
   while (true) {
     xSemaphoreTake(runTaskSemaphore, portMAX_DELAY);
@@ -222,28 +268,12 @@ static void kalmanTask(void* parameters) {
     // Tracks whether an update to the state has been made, and the state therefore requires finalization
     bool doneUpdate = false;
 
-    uint32_t osTick = xTaskGetTickCount(); // would be nice if this had a precision higher than 1ms...
+    uint32_t osTick = xTaskGetTickCount();
 
   #ifdef KALMAN_DECOUPLE_XY
     kalmanCoreDecoupleXY(&coreData);
   #endif
 
-    // Run the system dynamics to predict the state forward.
-    if (osTick >= nextPrediction) { // update at the PREDICT_RATE
-      float dt = T2S(osTick - lastPrediction);
-      if (predictStateForward(osTick, dt)) {
-        lastPrediction = osTick;
-        doneUpdate = true;
-        STATS_CNT_RATE_EVENT(&predictionCounter);
-      }
-
-      nextPrediction = osTick + S2T(1.0f / PREDICT_RATE);
-
-      if (!rateSupervisorValidate(&rateSupervisorContext, T2M(osTick))) {
-        DEBUG_PRINT("WARNING: Kalman prediction rate low (%lu)\n", rateSupervisorLatestCount(&rateSupervisorContext));
-      }
-    }
-
     /**
      * Add process noise every loop, rather than every prediction
      */
@@ -255,6 +285,10 @@ static void kalmanTask(void* parameters) {
       }
     }
 
+    /**
+     * Process the queued measurements. The system dynamics are run to predict the state forward at the PREDICT_RATE,
+     * driven by the time stamps of the IMU samples.
+     */
     {
       if(updateQueuedMeasurements(osTick)) {
         doneUpdate = true;
@@ -307,13 +341,33 @@ void estimatorKalman(state_t *state, const uint32_t tick)
   xSemaphoreGive(runTaskSemaphore);
 }
 
-static bool predictStateForward(uint32_t osTick, float dt) {
+// Called for every accelerometer sample, the accelerometer sample is the last part of an IMU sample
+static bool isPredictionDue(const uint64_t timestamp) {
+  if (lastAccTimestamp != 0) {
+    accSampleInterval = (7 * accSampleInterval + (uint32_t)(timestamp - lastAccTimestamp)) / 8;
+  }
+  lastAccTimestamp = timestamp;
+
+  if (lastPrediction == 0) {
+    lastPrediction = timestamp;
+    nextPrediction = timestamp + PREDICT_INTERVAL_US;
+    return false;
+  }
+
+  // Predict on the sample closest to the scheduled time
+  return timestamp + accSampleInterval / 2 >= nextPrediction;
+}
+
+static bool predictStateForward(uint64_t timestamp) {
   if (gyroAccumulatorCount == 0
       || accAccumulatorCount == 0)
   {
     return false;
   }
 
+  const uint64_t start = usecTimestamp();
+  const float dt = (timestamp - lastPrediction) / 1e6f;
+
   // gyro is in deg/sec but the estimator requires rad/sec
   Axis3f gyroAverage;
   gyroAverage.x = gyroAccumulator.x * DEG_TO_RAD / gyroAccumulatorCount;
@@ -333,12 +387,69 @@ static bool predictStateForward(uint32_t osTick, float dt) {
   gyroAccumulatorCount = 0;
 
   quadIsFlying = supervisorIsFlying();
-  kalmanCorePredict(&coreData, &accAverage, &gyroAverage, dt, quadIsFlying);
+
+  covarianceGyroAccumulator.x += gyroAverage.x * dt;
+  covarianceGyroAccumulator.y += gyroAverage.y * dt;
+  covarianceGyroAccumulator.z += gyroAverage.z * dt;
+  covarianceDt += dt;
+  predictionsSinceCovariancePrediction++;
+
+  if (predictionsSinceCovariancePrediction >= PREDICTIONS_PER_COVARIANCE_PREDICTION && covarianceDt > 0.0f) {
+    Axis3f covarianceGyro;
+    covarianceGyro.x = covarianceGyroAccumulator.x / covarianceDt;
+    covarianceGyro.y = covarianceGyroAccumulator.y / covarianceDt;
+    covarianceGyro.z = covarianceGyroAccumulator.z / covarianceDt;
+    kalmanCorePredictCovariance(&coreData, &covarianceGyro, covarianceDt);
+
+    covarianceGyroAccumulator = (Axis3f){.axis={0}};
+    covarianceDt = 0.0f;
+    predictionsSinceCovariancePrediction = 0;
+  }
+
+  kalmanCorePredictStateWithHistory(&coreData, &history, &accAverage, &gyroAverage, dt, quadIsFlying, timestamp);
+
+  lastPrediction = timestamp;
+  nextPrediction += PREDICT_INTERVAL_US;
+  if (nextPrediction <= timestamp) {
+    nextPrediction = timestamp + PREDICT_INTERVAL_US;
+  }
+
+  predictionTime += ((float)(usecTimestamp() - start) - predictionTime) / 16.0f;
+  STATS_CNT_RATE_EVENT(&predictionCounter);
+  if (!rateSupervisorValidate(&rateSupervisorContext, (uint32_t)(timestamp / 1000))) {
+    DEBUG_PRINT("WARNING: Kalman prediction rate low (%lu)\n", rateSupervisorLatestCount(&rateSupervisorContext));
+  }
 
   return true;
 }
 
 
+static void openSweepAngleBatch(const uint64_t timestamp) {
+  isSweepAngleBatchOpen = true;
+  sweepAngleBatchTimestamp = timestamp;
+  if (retrodictMeasurements && kalmanCoreRetrodictionStart(&coreData, &history, timestamp, &sweepAngleBatchRetrodiction)) {
+    STATS_CNT_RATE_EVENT(&retrodictionCounter);
+  }
+}
+
+// Folds the batch into the state it was linearized at, and moves the correction to the current state
+static bool flushSweepAngleBatch() {
+  if (!isSweepAngleBatchOpen) {
+    return false;
+  }
+
+  const bool isUpdated = (sweepAngleBatch.count > 0);
+  if (isUpdated) {
+    kalmanCoreBatchUpdate(&coreData, &sweepAngleBatch);
+    STATS_CNT_RATE_EVENT(&batchUpdateCounter);
+  }
+
+  kalmanCoreRetrodictionEnd(&coreData, &sweepAngleBatchRetrodiction);
+  sweepAngleBatchRetrodiction.isActive = false;
+  isSweepAngleBatchOpen = false;
+  return isUpdated;
+}
+
 static bool updateQueuedMeasurements(const uint32_t tick) {
   bool doneUpdate = false;
   /**
@@ -349,6 +460,26 @@ static bool updateQueuedMeasurements(const uint32_t tick) {
   // Pull the latest sensors values of interest; discard the rest
   measurement_t m;
   while (estimatorDequeue(&m)) {
+    const bool isBatched = (m.type == MeasurementTypeSweepAngle && batchSweepAngles);
+
+    // Batched sweep angles must be folded into the filter before any other measurement updates the state,
+    // IMU data is only accumulated and does not break the batch
+    if (!isBatched && m.type != MeasurementTypeGyroscope && m.type != MeasurementTypeAcceleration) {
+      if (flushSweepAngleBatch()) {
+        doneUpdate = true;
+      }
+    }
+
+    // Measurements that were taken before the latest prediction are fused with the state at the time of the
+    // measurement. Batched sweep angles share the retrodiction of their batch.
+    kalmanCoreRetrodiction_t retrodiction = {.isActive = false};
+    if (m.type != MeasurementTypeGyroscope && m.type != MeasurementTypeAcceleration) {
+      measurementAge = (uint32_t)(usecTimestamp() - m.timestamp);
+      if (!isBatched && retrodictMeasurements && kalmanCoreRetrodictionStart(&coreData, &history, m.timestamp, &retrodiction)) {
+        STATS_CNT_RATE_EVENT(&retrodictionCounter);
+      }
+    }
+
     switch (m.type) {
       case MeasurementTypeTDOA:
         if(robustTdoa){
@@ -395,7 +526,18 @@ static bool updateQueuedMeasurements(const uint32_t tick) {
         doneUpdate = true;
         break;
       case MeasurementTypeSweepAngle:
-        kalmanCoreUpdateWithSweepAngles(&coreData, &m.data.sweepAngle, tick, &sweepOutlierFilterState);
+        if (isBatched) {
+          // Sweep angles taken at another time are linearized at another state and start a new batch
+          if (isSweepAngleBatchOpen && (sweepAngleBatch.count >= KC_MAX_BATCH_SIZE || m.timestamp != sweepAngleBatchTimestamp)) {
+            flushSweepAngleBatch();
+          }
+          if (!isSweepAngleBatchOpen) {
+            openSweepAngleBatch(m.timestamp);
+          }
+          kalmanCoreBatchAddSweepAngles(&coreData, &sweepAngleBatch, &m.data.sweepAngle, tick, &sweepOutlierFilterState);
+        } else {
+          kalmanCoreUpdateWithSweepAngles(&coreData, &m.data.sweepAngle, tick, &sweepOutlierFilterState);
+        }
         doneUpdate = true;
         break;
       case MeasurementTypeGyroscope:
@@ -411,6 +553,16 @@ static bool updateQueuedMeasurements(const uint32_t tick) {
         accAccumulator.z += m.data.acceleration.acc.z;
         accLatest = m.data.acceleration.acc;
         accAccumulatorCount++;
+
+        if (isPredictionDue(m.timestamp)) {
+          // The batch was linearized around the current state and must be folded in before the state is moved
+          if (flushSweepAngleBatch()) {
+            doneUpdate = true;
+          }
+          if (predictStateForward(m.timestamp)) {
+            doneUpdate = true;
+          }
+        }
         break;
       case MeasurementTypeBarometer:
         if (useBaroUpdate) {
@@ -421,6 +573,12 @@ static bool updateQueuedMeasurements(const uint32_t tick) {
       default:
         break;
     }
+
+    kalmanCoreRetrodictionEnd(&coreData, &retrodiction);
+  }
+
+  if (flushSweepAngleBatch()) {
+    doneUpdate = true;
   }
 
   return doneUpdate;
@@ -435,6 +593,17 @@ void estimatorKalmanInit(void)
   accAccumulatorCount = 0;
   gyroAccumulatorCount = 0;
   outlierFilterReset(&sweepOutlierFilterState, 0);
+  kalmanCoreBatchInit(&sweepAngleBatch);
+  isSweepAngleBatchOpen = false;
+  sweepAngleBatchRetrodiction.isActive = false;
+  kalmanCoreHistoryInit(&history);
+
+  lastPrediction = 0;
+  lastAccTimestamp = 0;
+  accSampleInterval = IMU_SAMPLE_INTERVAL_US;
+  covarianceGyroAccumulator = (Axis3f){.axis = {0}};
+  covarianceDt = 0.0f;
+  predictionsSinceCovariancePrediction = 0;
 
   kalmanCoreInit(&coreData, &coreParams);
 }
@@ -576,6 +745,22 @@ LOG_GROUP_START(kalman)
   * @brief Statistics rate full estimation step
   */
   STATS_CNT_RATE_LOG_ADD(rtFinal, &finalizeCounter)
+  /**
+  * @brief Statistics rate of batch updates of lighthouse sweep angles
+  */
+  STATS_CNT_RATE_LOG_ADD(rtBatch, &batchUpdateCounter)
+  /**
+  * @brief Statistics rate of measurements fused with a retrodicted state
+  */
+  STATS_CNT_RATE_LOG_ADD(rtRetro, &retrodictionCounter)
+  /**
+  * @brief Age of the latest fused measurement [us]
+  */
+  LOG_ADD(LOG_UINT32, mAge, &measurementAge)
+  /**
+  * @brief Filtered execution time of the prediction step [us]
+  */
+  LOG_ADD(LOG_FLOAT, tPred, &predictionTime)
 LOG_GROUP_STOP(kalman)
 
 LOG_GROUP_START(outlierf)
@@ -600,6 +785,14 @@ PARAM_GROUP_START(kalman)
  * @brief Nonzero to use robust TWR method (default: 0)
  */
   PARAM_ADD_CORE(PARAM_UINT8, robustTwr, &robustTwr)
+/**
+ * @brief Nonzero to fold lighthouse sweep angles into the filter in batches (default: 1)
+ */
+  PARAM_ADD(PARAM_UINT8, batchLh, &batchSweepAngles)
+/**
+ * @brief Nonzero to fuse delayed measurements with the state retrodicted to the time of the measurement (default: 1)
+ */
+  PARAM_ADD(PARAM_UINT8, retro, &retrodictMeasurements)
 /**
  * @brief Process noise for x and y acceleration
  */
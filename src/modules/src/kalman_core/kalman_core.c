@@ -123,6 +123,77 @@ static void assertStateNotNaN(const kalmanCoreData_t* this)
 // Small number epsilon, to prevent dividing by zero
 #define EPS (1e-6f)
 
+// Smallest accepted pivot of the Cholesky factorization in batch updates, relative to the diagonal element
+#define BATCH_PIVOT_TOLERANCE (1e-6f)
+
+/**
+ * Propagate the covariance through the linearized dynamics, P = A P A'
+ *
+ * The linearized dynamics used by the prediction and the finalization are block upper triangular, and most
+ * of A is the identity. Instead of two dense KC_STATE_DIM x KC_STATE_DIM matrix multiplications, the structure of
+ * A is described per row by firstCol: all elements to the left of firstCol[row] are the identity (one on the
+ * diagonal, zero elsewhere) and are not read from A, elements from firstCol[row] and onwards are read from A.
+ * Since P is symmetric, only the upper triangle of the result is computed and then mirrored.
+ */
+static void covariancePropagate(kalmanCoreData_t* this, const float A[KC_STATE_DIM][KC_STATE_DIM], const uint8_t firstCol[KC_STATE_DIM])
+{
+  NO_DMA_CCM_SAFE_ZERO_INIT static float AP[KC_STATE_DIM][KC_STATE_DIM];
+
+  // A P
+  for (int i=0; i<KC_STATE_DIM; i++) {
+    const int k0 = firstCol[i];
+    for (int j=0; j<KC_STATE_DIM; j++) {
+      float sum = (k0 > i) ? this->P[i][j] : 0.0f;
+      for (int k=k0; k<KC_STATE_DIM; k++) {
+        sum += A[i][k] * this->P[k][j];
+      }
+      AP[i][j] = sum;
+    }
+  }
+
+  // (A P) A', upper triangle only
+  for (int j=0; j<KC_STATE_DIM; j++) {
+    const int k0 = firstCol[j];
+    for (int i=0; i<=j; i++) {
+      float sum = (k0 > j) ? AP[i][j] : 0.0f;
+      for (int k=k0; k<KC_STATE_DIM; k++) {
+        sum += AP[i][k] * A[j][k];
+      }
+      this->P[i][j] = this->P[j][i] = sum;
+    }
+  }
+}
+
+static void updateRotationMatrix(kalmanCoreData_t* this)
+{
+  this->R[0][0] = this->q[0] * this->q[0] + this->q[1] * this->q[1] - this->q[2] * this->q[2] - this->q[3] * this->q[3];
+  this->R[0][1] = 2 * this->q[1] * this->q[2] - 2 * this->q[0] * this->q[3];
+  this->R[0][2] = 2 * this->q[1] * this->q[3] + 2 * this->q[0] * this->q[2];
+
+  this->R[1][0] = 2 * this->q[1] * this->q[2] + 2 * this->q[0] * this->q[3];
+  this->R[1][1] = this->q[0] * this->q[0] - this->q[1] * this->q[1] + this->q[2] * this->q[2] - this->q[3] * this->q[3];
+  this->R[1][2] = 2 * this->q[2] * this->q[3] - 2 * this->q[0] * this->q[1];
+
+  this->R[2][0] = 2 * this->q[1] * this->q[3] - 2 * this->q[0] * this->q[2];
+  this->R[2][1] = 2 * this->q[2] * this->q[3] + 2 * this->q[0] * this->q[1];
+  this->R[2][2] = this->q[0] * this->q[0] - this->q[1] * this->q[1] - this->q[2] * this->q[2] + this->q[3] * this->q[3];
+}
+
+// Hamilton product r = a * b of quaternions in [w,x,y,z] order
+static void quaternionMultiply(const float a[4], const float b[4], float r[4])
+{
+  r[0] = a[0] * b[0] - a[1] * b[1] - a[2] * b[2] - a[3] * b[3];
+  r[1] = a[0] * b[1] + a[1] * b[0] + a[2] * b[3] - a[3] * b[2];
+  r[2] = a[0] * b[2] - a[1] * b[3] + a[2] * b[0] + a[3] * b[1];
+  r[3] = a[0] * b[3] + a[1] * b[2] - a[2] * b[1] + a[3] * b[0];
+}
+
+static void quaternionNormalize(float q[4])
+{
+  float norm = arm_sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]) + EPS;
+  for (int i = 0; i < 4; i++) { q[i] /= norm; }
+}
+
 void kalmanCoreDefaultParams(kalmanCoreParams_t* params)
 {
   // Initial variances, uncertain of position, but know we're stationary and roughly flat
@@ -276,6 +347,168 @@ void kalmanCoreScalarUpdate(kalmanCoreData_t* this, arm_matrix_instance_f32 *Hm,
   assertStateNotNaN(this);
 }
 
+void kalmanCoreBatchInit(kalmanCoreBatch_t* batch)
+{
+  batch->count = 0;
+}
+
+bool kalmanCoreBatchAdd(kalmanCoreBatch_t* batch, const arm_matrix_instance_f32 *Hm, float error, float stdMeasNoise)
+{
+  ASSERT(Hm->numRows == 1);
+  ASSERT(Hm->numCols == KC_STATE_DIM);
+
+  if (batch->count >= KC_MAX_BATCH_SIZE) {
+    return false;
+  }
+
+  const int n = batch->count;
+  memcpy(batch->h[n], Hm->pData, sizeof(batch->h[n]));
+  batch->error[n] = error;
+  batch->stdMeasNoise[n] = stdMeasNoise;
+  batch->count++;
+
+  return true;
+}
+
+// Fold the measurements of a batch into the filter one by one. The errors in the batch are relative to the state
+// before the first update, the innovation of each measurement is corrected for the updates done before it.
+static void batchSequentialUpdate(kalmanCoreData_t* this, kalmanCoreBatch_t* batch)
+{
+  float S0[KC_STATE_DIM];
+  memcpy(S0, this->S, sizeof(S0));
+
+  for (int m=0; m<batch->count; m++) {
+    float correction = 0.0f;
+    for (int j=0; j<KC_STATE_DIM; j++) {
+      correction += batch->h[m][j] * (this->S[j] - S0[j]);
+    }
+
+    arm_matrix_instance_f32 H = {1, KC_STATE_DIM, batch->h[m]};
+    kalmanCoreScalarUpdate(this, &H, batch->error[m] - correction, batch->stdMeasNoise[m]);
+  }
+}
+
+void kalmanCoreBatchUpdate(kalmanCoreData_t* this, kalmanCoreBatch_t* batch)
+{
+  /**
+   * With H (k x N), the innovation covariance S = H P H' + R is factorized as S = L L' (Cholesky). Using
+   * U = P H' and W = U L'^-1 the update becomes
+   *   state: x = x + W (L^-1 e)
+   *   covariance: P = P - U S^-1 U' = P - W W'
+   * where the covariance update is a symmetric rank-k update of P, only the upper triangle is computed.
+   */
+  NO_DMA_CCM_SAFE_ZERO_INIT static float U[KC_STATE_DIM][KC_MAX_BATCH_SIZE];
+  NO_DMA_CCM_SAFE_ZERO_INIT static float L[KC_MAX_BATCH_SIZE][KC_MAX_BATCH_SIZE];
+  float z[KC_MAX_BATCH_SIZE];
+
+  const int k = batch->count;
+  if (k == 0) {
+    return;
+  }
+
+  // ====== INNOVATION COVARIANCE ======
+
+  // U = P H'
+  for (int i=0; i<KC_STATE_DIM; i++) {
+    for (int m=0; m<k; m++) {
+      float sum = 0.0f;
+      for (int j=0; j<KC_STATE_DIM; j++) {
+        sum += this->P[i][j] * batch->h[m][j];
+      }
+      U[i][m] = sum;
+    }
+  }
+
+  // S = H U + R, stored in the lower triangle of L and factorized in place
+  for (int m=0; m<k; m++) {
+    for (int n=0; n<=m; n++) {
+      float sum = 0.0f;
+      for (int j=0; j<KC_STATE_DIM; j++) {
+        sum += batch->h[m][j] * U[j][n];
+      }
+      L[m][n] = sum;
+    }
+    L[m][m] += batch->stdMeasNoise[m] * batch->stdMeasNoise[m];
+  }
+
+  for (int m=0; m<k; m++) {
+    for (int n=0; n<=m; n++) {
+      float sum = L[m][n];
+      for (int j=0; j<n; j++) {
+        sum -= L[m][j] * L[n][j];
+      }
+
+      if (m == n) {
+        // The tolerance is relative to the diagonal of S, the measurement noise of for instance lighthouse sweep
+        // angles is far below any absolute limit. L[m][m] still holds the diagonal of S here.
+        if (isnan(sum) || sum <= BATCH_PIVOT_TOLERANCE * L[m][m]) {
+          // Not positive definite, the measurements are (close to) linearly dependent. Fall back to sequential
+          // scalar updates.
+          batchSequentialUpdate(this, batch);
+          batch->count = 0;
+          return;
+        }
+        L[m][m] = arm_sqrt(sum);
+      } else {
+        L[m][n] = sum / L[n][n];
+      }
+    }
+  }
+
+  // W = U L'^-1, solved row by row with forward substitution. W is stored in place in U.
+  for (int i=0; i<KC_STATE_DIM; i++) {
+    for (int m=0; m<k; m++) {
+      float sum = U[i][m];
+      for (int n=0; n<m; n++) {
+        sum -= L[m][n] * U[i][n];
+      }
+      U[i][m] = sum / L[m][m];
+    }
+  }
+
+  // z = L^-1 e
+  for (int m=0; m<k; m++) {
+    float sum = batch->error[m];
+    for (int n=0; n<m; n++) {
+      sum -= L[m][n] * z[n];
+    }
+    z[m] = sum / L[m][m];
+  }
+
+  // ====== MEASUREMENT UPDATE ======
+  for (int i=0; i<KC_STATE_DIM; i++) {
+    float sum = 0.0f;
+    for (int m=0; m<k; m++) {
+      sum += U[i][m] * z[m];
+    }
+    this->S[i] += sum;
+  }
+  assertStateNotNaN(this);
+
+  // ====== COVARIANCE UPDATE ======
+  // P = P - W W', and ensure boundedness and symmetry
+  for (int i=0; i<KC_STATE_DIM; i++) {
+    for (int j=i; j<KC_STATE_DIM; j++) {
+      float ww = 0.0f;
+      for (int m=0; m<k; m++) {
+        ww += U[i][m] * U[j][m];
+      }
+      float p = 0.5f*this->P[i][j] + 0.5f*this->P[j][i] - ww;
+      if (isnan(p) || p > MAX_COVARIANCE) {
+        this->P[i][j] = this->P[j][i] = MAX_COVARIANCE;
+      } else if ( i==j && p < MIN_COVARIANCE ) {
+        this->P[i][j] = this->P[j][i] = MIN_COVARIANCE;
+      } else {
+        this->P[i][j] = this->P[j][i] = p;
+      }
+    }
+  }
+
+  assertStateNotNaN(this);
+
+  batch->count = 0;
+}
+
 void kalmanCoreUpdateWithPKE(kalmanCoreData_t* this, arm_matrix_instance_f32 *Hm, arm_matrix_instance_f32 *Km, arm_matrix_instance_f32 *P_w_m, float error)
 {
     // kalman filter update with weighted covariance matrix P_w_m, kalman gain Km, and innovation error
@@ -329,6 +562,12 @@ void kalmanCoreUpdateWithBaro(kalmanCoreData_t *this, const kalmanCoreParams_t *
 }
 
 void kalmanCorePredict(kalmanCoreData_t* this, Axis3f *acc, Axis3f *gyro, float dt, bool quadIsFlying)
+{
+  kalmanCorePredictCovariance(this, gyro, dt);
+  kalmanCorePredictState(this, acc, gyro, dt, quadIsFlying);
+}
+
+void kalmanCorePredictCovariance(kalmanCoreData_t* this, Axis3f *gyro, float dt)
 {
   /* Here we discretize (euler forward) and linearise the quadrocopter dynamics in order
    * to push the covariance forward.
@@ -353,16 +592,14 @@ void kalmanCorePredict(kalmanCoreData_t* this, Axis3f *acc, Axis3f *gyro, float
 
   // The linearized update matrix
   NO_DMA_CCM_SAFE_ZERO_INIT static float A[KC_STATE_DIM][KC_STATE_DIM];
-  static __attribute__((aligned(4))) arm_matrix_instance_f32 Am = { KC_STATE_DIM, KC_STATE_DIM, (float *)A}; // linearized dynamics for covariance update;
-
-  // Temporary matrices for the covariance updates
-  NO_DMA_CCM_SAFE_ZERO_INIT static float tmpNN1d[KC_STATE_DIM * KC_STATE_DIM];
-  static __attribute__((aligned(4))) arm_matrix_instance_f32 tmpNN1m = { KC_STATE_DIM, KC_STATE_DIM, tmpNN1d};
-
-  NO_DMA_CCM_SAFE_ZERO_INIT static float tmpNN2d[KC_STATE_DIM * KC_STATE_DIM];
-  static __attribute__((aligned(4))) arm_matrix_instance_f32 tmpNN2m = { KC_STATE_DIM, KC_STATE_DIM, tmpNN2d};
 
-  float dt2 = dt*dt;
+  // Structure of A: position rows are the identity plus the velocity and attitude error columns, velocity rows
+  // only depend on velocity and attitude error, attitude error rows only on attitude error
+  static const uint8_t firstCol[KC_STATE_DIM] = {
+    KC_STATE_PX, KC_STATE_PX, KC_STATE_PX,
+    KC_STATE_PX, KC_STATE_PX, KC_STATE_PX,
+    KC_STATE_D0, KC_STATE_D0, KC_STATE_D0,
+  };
 
   // ====== DYNAMICS LINEARIZATION ======
   // Initialize as the identity
@@ -464,10 +701,13 @@ void kalmanCorePredict(kalmanCoreData_t* this, Axis3f *acc, Axis3f *gyro, float
 
 
   // ====== COVARIANCE UPDATE ======
-  mat_mult(&Am, &this->Pm, &tmpNN1m); // A P
-  mat_trans(&Am, &tmpNN2m); // A'
-  mat_mult(&tmpNN1m, &tmpNN2m, &this->Pm); // A P A'
+  covariancePropagate(this, A, firstCol); // A P A'
   // Process noise is added after the return from the prediction step
+}
+
+void kalmanCorePredictState(kalmanCoreData_t* this, Axis3f *acc, Axis3f *gyro, float dt, bool quadIsFlying)
+{
+  float dt2 = dt*dt;
 
   // ====== PREDICTION STEP ======
   // The prediction depends on whether we're on the ground, or in flight.
@@ -598,18 +838,162 @@ void kalmanCoreAddProcessNoise(kalmanCoreData_t *this, const kalmanCoreParams_t
 
 
 
+void kalmanCoreHistoryInit(kalmanCoreHistory_t* history)
+{
+  history->head = 0;
+  history->count = 0;
+}
+
+static void predictWithHistory(kalmanCoreData_t *this, kalmanCoreHistory_t* history, Axis3f *acc, Axis3f *gyro, float dt, bool quadIsFlying, uint64_t timestamp, bool predictCovariance)
+{
+  float S[KC_STATE_D0];
+  float q[4];
+  for (int i = 0; i < KC_STATE_D0; i++) { S[i] = this->S[i]; }
+  for (int i = 0; i < 4; i++) { q[i] = this->q[i]; }
+
+  if (predictCovariance) {
+    kalmanCorePredictCovariance(this, gyro, dt);
+  }
+  kalmanCorePredictState(this, acc, gyro, dt, quadIsFlying);
+
+  // dq = q_before^-1 * q_after, with a positive scalar part to get the shortest rotation
+  float dq[4];
+  const float qInv[4] = {q[0], -q[1], -q[2], -q[3]};
+  quaternionMultiply(qInv, this->q, dq);
+  if (dq[0] < 0) {
+    for (int i = 0; i < 4; i++) { dq[i] = -dq[i]; }
+  }
+
+  // Merge the prediction into the latest entry as long as the entry is shorter than KC_HISTORY_ENTRY_DURATION_US
+  kalmanCoreHistoryEntry_t* entry = &history->entries[history->head];
+  if (history->count > 0 && timestamp > entry->timestamp && (timestamp - entry->start) <= KC_HISTORY_ENTRY_DURATION_US) {
+    entry->timestamp = timestamp;
+    for (int i = 0; i < 3; i++) {
+      entry->dPos[i] += this->S[KC_STATE_X + i] - S[KC_STATE_X + i];
+      entry->dVel[i] += this->S[KC_STATE_PX + i] - S[KC_STATE_PX + i];
+    }
+
+    float tmp[4];
+    quaternionMultiply(entry->dq, dq, tmp);
+    quaternionNormalize(tmp);
+    for (int i = 0; i < 4; i++) { entry->dq[i] = tmp[i]; }
+    return;
+  }
+
+  history->head = (history->head + 1) % KC_HISTORY_LENGTH;
+  if (history->count < KC_HISTORY_LENGTH) {
+    history->count++;
+  }
+
+  entry = &history->entries[history->head];
+  entry->timestamp = timestamp;
+  const uint64_t duration = (uint64_t)(dt * 1e6f + 0.5f);
+  entry->start = (timestamp > duration) ? timestamp - duration : 0;
+  for (int i = 0; i < 3; i++) {
+    entry->dPos[i] = this->S[KC_STATE_X + i] - S[KC_STATE_X + i];
+    entry->dVel[i] = this->S[KC_STATE_PX + i] - S[KC_STATE_PX + i];
+  }
+  for (int i = 0; i < 4; i++) { entry->dq[i] = dq[i]; }
+}
+
+void kalmanCorePredictWithHistory(kalmanCoreData_t *this, kalmanCoreHistory_t* history, Axis3f *acc, Axis3f *gyro, float dt, bool quadIsFlying, uint64_t timestamp)
+{
+  predictWithHistory(this, history, acc, gyro, dt, quadIsFlying, timestamp, true);
+}
+
+void kalmanCorePredictStateWithHistory(kalmanCoreData_t *this, kalmanCoreHistory_t* history, Axis3f *acc, Axis3f *gyro, float dt, bool quadIsFlying, uint64_t timestamp)
+{
+  predictWithHistory(this, history, acc, gyro, dt, quadIsFlying, timestamp, false);
+}
+
+bool kalmanCoreRetrodictionStart(kalmanCoreData_t* this, const kalmanCoreHistory_t* history, uint64_t timestamp, kalmanCoreRetrodiction_t* retrodiction)
+{
+  retrodiction->isActive = false;
+
+  if (history->count == 0 || timestamp >= history->entries[history->head].timestamp) {
+    return false;
+  }
+
+  // Accumulate the change of the state from the time of the measurement to the latest prediction
+  float dPos[3] = {0};
+  float dVel[3] = {0};
+  float rotation[4] = {1, 0, 0, 0};
+
+  for (int i = 0; i < history->count; i++) {
+    const kalmanCoreHistoryEntry_t* entry = &history->entries[(history->head - i + KC_HISTORY_LENGTH) % KC_HISTORY_LENGTH];
+    if (entry->timestamp <= timestamp) {
+      break;
+    }
+
+    // The part of the entry that is after the measurement
+    float fraction = 1.0f;
+    const uint64_t duration = entry->timestamp - entry->start;
+    if (duration > 0 && (entry->timestamp - timestamp) < duration) {
+      fraction = (float)(entry->timestamp - timestamp) / (float)duration;
+    }
+
+    for (int j = 0; j < 3; j++) {
+      dPos[j] += fraction * entry->dPos[j];
+      dVel[j] += fraction * entry->dVel[j];
+    }
+
+    // Small angle interpolation of the rotation
+    float dq[4] = {1.0f - fraction * (1.0f - entry->dq[0]), fraction * entry->dq[1], fraction * entry->dq[2], fraction * entry->dq[3]};
+    quaternionNormalize(dq);
+
+    float tmp[4];
+    quaternionMultiply(dq, rotation, tmp);
+    for (int j = 0; j < 4; j++) { rotation[j] = tmp[j]; }
+  }
+
+  for (int i = 0; i < KC_STATE_D0; i++) { retrodiction->S[i] = this->S[i]; }
+  for (int i = 0; i < 4; i++) { retrodiction->q[i] = this->q[i]; }
+  memcpy(retrodiction->R, this->R, sizeof(this->R));
+
+  for (int i = 0; i < 3; i++) {
+    this->S[KC_STATE_X + i] -= dPos[i];
+    this->S[KC_STATE_PX + i] -= dVel[i];
+  }
+
+  // q_measurement = q_current * rotation^-1
+  const float rotationInv[4] = {rotation[0], -rotation[1], -rotation[2], -rotation[3]};
+  quaternionMultiply(retrodiction->q, rotationInv, this->q);
+  quaternionNormalize(this->q);
+  updateRotationMatrix(this);
+
+  for (int i = 0; i < KC_STATE_D0; i++) { retrodiction->retrodictedS[i] = this->S[i]; }
+  retrodiction->isActive = true;
+
+  return true;
+}
+
+void kalmanCoreRetrodictionEnd(kalmanCoreData_t* this, const kalmanCoreRetrodiction_t* retrodiction)
+{
+  if (! retrodiction->isActive) {
+    return;
+  }
+
+  // The attitude error is kept as is and is moved into the current attitude by the finalization
+  for (int i = 0; i < KC_STATE_D0; i++) {
+    this->S[i] = retrodiction->S[i] + (this->S[i] - retrodiction->retrodictedS[i]);
+  }
+  for (int i = 0; i < 4; i++) { this->q[i] = retrodiction->q[i]; }
+  memcpy(this->R, retrodiction->R, sizeof(this->R));
+
+  assertStateNotNaN(this);
+}
+
 void kalmanCoreFinalize(kalmanCoreData_t* this, uint32_t tick)
 {
   // Matrix to rotate the attitude covariances once updated
   NO_DMA_CCM_SAFE_ZERO_INIT static float A[KC_STATE_DIM][KC_STATE_DIM];
-  static arm_matrix_instance_f32 Am = {KC_STATE_DIM, KC_STATE_DIM, (float *)A};
 
-  // Temporary matrices for the covariance updates
-  NO_DMA_CCM_SAFE_ZERO_INIT static float tmpNN1d[KC_STATE_DIM * KC_STATE_DIM];
-  static arm_matrix_instance_f32 tmpNN1m = {KC_STATE_DIM, KC_STATE_DIM, tmpNN1d};
-
-  NO_DMA_CCM_SAFE_ZERO_INIT static float tmpNN2d[KC_STATE_DIM * KC_STATE_DIM];
-  static arm_matrix_instance_f32 tmpNN2m = {KC_STATE_DIM, KC_STATE_DIM, tmpNN2d};
+  // Structure of A: the identity, except for the attitude error block
+  static const uint8_t firstCol[KC_STATE_DIM] = {
+    KC_STATE_DIM, KC_STATE_DIM, KC_STATE_DIM,
+    KC_STATE_DIM, KC_STATE_DIM, KC_STATE_DIM,
+    KC_STATE_D0, KC_STATE_D0, KC_STATE_D0,
+  };
 
   // Incorporate the attitude error (Kalman filter state) with the attitude
   float v0 = this->S[KC_STATE_D0];
@@ -652,14 +1036,6 @@ void kalmanCoreFinalize(kalmanCoreData_t* this, uint32_t tick)
     float d1 = v1/2; // so we use a first order approximation to d0 = tan(|v0|/2)*v0/|v0|
     float d2 = v2/2;
 
-    A[KC_STATE_X][KC_STATE_X] = 1;
-    A[KC_STATE_Y][KC_STATE_Y] = 1;
-    A[KC_STATE_Z][KC_STATE_Z] = 1;
-
-    A[KC_STATE_PX][KC_STATE_PX] = 1;
-    A[KC_STATE_PY][KC_STATE_PY] = 1;
-    A[KC_STATE_PZ][KC_STATE_PZ] = 1;
-
     A[KC_STATE_D0][KC_STATE_D0] =  1 - d1*d1/2 - d2*d2/2;
     A[KC_STATE_D0][KC_STATE_D1] =  d2 + d0*d1/2;
     A[KC_STATE_D0][KC_STATE_D2] = -d1 + d0*d2/2;
@@ -672,23 +1048,11 @@ void kalmanCoreFinalize(kalmanCoreData_t* this, uint32_t tick)
     A[KC_STATE_D2][KC_STATE_D1] = -d0 + d1*d2/2;
     A[KC_STATE_D2][KC_STATE_D2] = 1 - d0*d0/2 - d1*d1/2;
 
-    mat_trans(&Am, &tmpNN1m); // A'
-    mat_mult(&Am, &this->Pm, &tmpNN2m); // AP
-    mat_mult(&tmpNN2m, &tmpNN1m, &this->Pm); //APA'
+    covariancePropagate(this, A, firstCol); // A P A'
   }
 
   // convert the new attitude to a rotation matrix, such that we can rotate body-frame velocity and acc
-  this->R[0][0] = this->q[0] * this->q[0] + this->q[1] * this->q[1] - this->q[2] * this->q[2] - this->q[3] * this->q[3];
-  this->R[0][1] = 2 * this->q[1] * this->q[2] - 2 * this->q[0] * this->q[3];
-  this->R[0][2] = 2 * this->q[1] * this->q[3] + 2 * this->q[0] * this->q[2];
-
-  this->R[1][0] = 2 * this->q[1] * this->q[2] + 2 * this->q[0] * this->q[3];
-  this->R[1][1] = this->q[0] * this->q[0] - this->q[1] * this->q[1] + this->q[2] * this->q[2] - this->q[3] * this->q[3];
-  this->R[1][2] = 2 * this->q[2] * this->q[3] - 2 * this->q[0] * this->q[1];
-
-  this->R[2][0] = 2 * this->q[1] * this->q[3] - 2 * this->q[0] * this->q[2];
-  this->R[2][1] = 2 * this->q[2] * this->q[3] + 2 * this->q[0] * this->q[1];
-  this->R[2][2] = this->q[0] * this->q[0] - this->q[1] * this->q[1] - this->q[2] * this->q[2] + this->q[3] * this->q[3];
+  updateRotationMatrix(this);
 
   // reset the attitude error
   this->S[KC_STATE_D0] = 0;
@@ -27,7 +27,8 @@
 #include "outlierFilter.h"
 
 
-void kalmanCoreUpdateWithSweepAngles(kalmanCoreData_t *this, sweepAngleMeasurement_t *sweepInfo, const uint32_t tick, OutlierFilterLhState_t* sweepOutlierFilterState) {
+// Linearize the measurement model around the current state. Returns false if the measurement should not be used.
+static bool sweepAnglesLinearize(const kalmanCoreData_t *this, sweepAngleMeasurement_t *sweepInfo, const uint32_t tick, OutlierFilterLhState_t* sweepOutlierFilterState, float h[KC_STATE_DIM], float* error) {
   // Rotate the sensor position from CF reference frame to global reference frame,
   // using the CF roatation matrix
   vec3d s;
@@ -63,9 +64,9 @@ void kalmanCoreUpdateWithSweepAngles(kalmanCoreData_t *this, sweepAngleMeasureme
 
   const float predictedSweepAngle = sweepInfo->calibrationMeasurementModel(x, y, z, t, sweepInfo->calib);
   const float measuredSweepAngle = sweepInfo->measuredSweepAngle;
-  const float error = measuredSweepAngle - predictedSweepAngle;
+  *error = measuredSweepAngle - predictedSweepAngle;
 
-  if (outlierFilterValidateLighthouseSweep(sweepOutlierFilterState, r, error, tick)) {
+  if (outlierFilterValidateLighthouseSweep(sweepOutlierFilterState, r, *error, tick)) {
     // Calculate H vector (in the rotor reference frame)
     const float z_tan_t = z * tan_t;
     const float qNum = r2 - z_tan_t * z_tan_t;
@@ -82,13 +83,36 @@ void kalmanCoreUpdateWithSweepAngles(kalmanCoreData_t *this, sweepAngleMeasureme
       arm_matrix_instance_f32 g_ = {3, 1, g};
       mat_mult(&Rr_, &gr_, &g_);
 
-      float h[KC_STATE_DIM] = {0};
+      memset(h, 0, KC_STATE_DIM * sizeof(float));
       h[KC_STATE_X] = g[0];
       h[KC_STATE_Y] = g[1];
       h[KC_STATE_Z] = g[2];
 
-      arm_matrix_instance_f32 H = {1, KC_STATE_DIM, h};
-      kalmanCoreScalarUpdate(this, &H, error, sweepInfo->stdDev);
+      return true;
     }
   }
+
+  return false;
+}
+
+void kalmanCoreUpdateWithSweepAngles(kalmanCoreData_t *this, sweepAngleMeasurement_t *sweepInfo, const uint32_t tick, OutlierFilterLhState_t* sweepOutlierFilterState) {
+  float h[KC_STATE_DIM];
+  float error;
+
+  if (sweepAnglesLinearize(this, sweepInfo, tick, sweepOutlierFilterState, h, &error)) {
+    arm_matrix_instance_f32 H = {1, KC_STATE_DIM, h};
+    kalmanCoreScalarUpdate(this, &H, error, sweepInfo->stdDev);
+  }
+}
+
+bool kalmanCoreBatchAddSweepAngles(const kalmanCoreData_t *this, kalmanCoreBatch_t* batch, sweepAngleMeasurement_t *sweepInfo, const uint32_t tick, OutlierFilterLhState_t* sweepOutlierFilterState) {
+  float h[KC_STATE_DIM];
+  float error;
+
+  if (sweepAnglesLinearize(this, sweepInfo, tick, sweepOutlierFilterState, h, &error)) {
+    arm_matrix_instance_f32 H = {1, KC_STATE_DIM, h};
+    return kalmanCoreBatchAdd(batch, &H, error, sweepInfo->stdDev);
+  }
+
+  return false;
 }
@@ -42,6 +42,7 @@
 #define DEBUG_MODULE "LH"
 #include "debug.h"
 #include "uart1.h"
+#include "usec_time.h"
 #include "crtp_localization_service.h"
 
 #include "pulse_processor.h"
@@ -295,13 +296,13 @@ static uint8_t estimationMethod = 1;
 #endif
 
 
-static void usePulseResultCrossingBeams(pulseProcessor_t *appState, pulseProcessorResult_t* angles, int basestation) {
+static void usePulseResultCrossingBeams(pulseProcessor_t *appState, pulseProcessorResult_t* angles, int basestation, const uint64_t timestamp) {
   pulseProcessorClearOutdated(appState, angles, basestation);
 
   if (basestation == 1) {
     STATS_CNT_RATE_EVENT(&cycleRate);
 
-    lighthousePositionEstimatePoseCrossingBeams(appState, angles, 1);
+    lighthousePositionEstimatePoseCrossingBeams(appState, angles, 1, timestamp);
 
     pulseProcessorProcessed(angles, 0);
     pulseProcessorProcessed(angles, 1);
@@ -309,12 +310,12 @@ static void usePulseResultCrossingBeams(pulseProcessor_t *appState, pulseProcess
 }
 
 
-static void usePulseResultSweeps(pulseProcessor_t *appState, pulseProcessorResult_t* angles, int basestation) {
+static void usePulseResultSweeps(pulseProcessor_t *appState, pulseProcessorResult_t* angles, int basestation, const uint64_t timestamp) {
   STATS_CNT_RATE_EVENT(&cycleRate);
 
   pulseProcessorClearOutdated(appState, angles, basestation);
 
-  lighthousePositionEstimatePoseSweeps(appState, angles, basestation);
+  lighthousePositionEstimatePoseSweeps(appState, angles, basestation, timestamp);
 
   pulseProcessorProcessed(angles, basestation);
 }
@@ -335,7 +336,7 @@ static void convertV2AnglesToV1Angles(pulseProcessorResult_t* angles) {
   }
 }
 
-static void usePulseResult(pulseProcessor_t *appState, pulseProcessorResult_t* angles, int basestation, int sweepId) {
+static void usePulseResult(pulseProcessor_t *appState, pulseProcessorResult_t* angles, int basestation, int sweepId, const uint64_t timestamp) {
   const uint16_t basestationBitMap = (1 << basestation);
   baseStationReceivedMapWs |= basestationBitMap;
 
@@ -356,10 +357,10 @@ static void usePulseResult(pulseProcessor_t *appState, pulseProcessorResult_t* a
 
         switch(estimationMethod) {
           case 0:
-            usePulseResultCrossingBeams(appState, angles, basestation);
+            usePulseResultCrossingBeams(appState, angles, basestation, timestamp);
             break;
           case 1:
-            usePulseResultSweeps(appState, angles, basestation);
+            usePulseResultSweeps(appState, angles, basestation, timestamp);
             break;
           default:
             break;
@@ -397,7 +398,9 @@ static void useCalibrationData(pulseProcessor_t *appState) {
   }
 }
 
-static void processFrame(pulseProcessor_t *appState, pulseProcessorResult_t* angles, const lighthouseUartFrame_t* frame) {
+// The timestamp is the time the frame was received (us, see usecTimestamp()), and is used as the capture time of the
+// angles that are completed by the frame
+static void processFrame(pulseProcessor_t *appState, pulseProcessorResult_t* angles, const lighthouseUartFrame_t* frame, const uint64_t timestamp) {
     int basestation;
     int sweepId;
     bool calibDataIsDecoded = false;
@@ -406,7 +409,7 @@ static void processFrame(pulseProcessor_t *appState, pulseProcessorResult_t* ang
 
     if (pulseProcessorProcessPulse(appState, &frame->data, angles, &basestation, &sweepId, &calibDataIsDecoded)) {
         STATS_CNT_RATE_EVENT(bsRates[basestation]);
-        usePulseResult(appState, angles, basestation, sweepId);
+        usePulseResult(appState, angles, basestation, sweepId, timestamp);
     }
 
     if (calibDataIsDecoded) {
@@ -494,6 +497,7 @@ void lighthouseCoreTask(void *param) {
     bool previousWasSyncFrame = false;
 
     while((isUartFrameValid = getUartFrameRaw(&frame))) {
+      const uint64_t frameTimestamp = usecTimestamp();
       const uint32_t now_ms = T2M(xTaskGetTickCount());
 
       // If a sync frame is getting through, we are only receiving sync frames. So nothing else. Reset state
@@ -508,7 +512,7 @@ void lighthouseCoreTask(void *param) {
         deckHealthCheck(&lighthouseCoreState, &frame, now_ms);
         lighthouseUpdateSystemType();
         if (pulseProcessorProcessPulse) {
-          processFrame(&lighthouseCoreState, &angles, &frame);
+          processFrame(&lighthouseCoreState, &angles, &frame, frameTimestamp);
         }
       }
 
@@ -222,7 +222,7 @@ static vec3d position;
 static vec3d positionLog;
 static float deltaLog;
 
-static void estimatePositionCrossingBeams(const pulseProcessor_t *state, pulseProcessorResult_t* angles, int baseStation) {
+static void estimatePositionCrossingBeams(const pulseProcessor_t *state, pulseProcessorResult_t* angles, int baseStation, const uint64_t timestamp) {
   memset(&ext_pos, 0, sizeof(ext_pos));
   uint8_t sensorsUsed = 0;
   float deltaSum = 0;
@@ -267,7 +267,7 @@ static void estimatePositionCrossingBeams(const pulseProcessor_t *state, pulsePr
       ext_pos.stdDev = 0.01;
       ext_pos.source = MeasurementSourceLighthouse;
       #ifndef CONFIG_DECK_LIGHTHOUSE_AS_GROUNDTRUTH
-        estimatorEnqueuePosition(&ext_pos);
+        estimatorEnqueuePositionAt(&ext_pos, timestamp);
       #endif
     }
   } else {
@@ -275,7 +275,7 @@ static void estimatePositionCrossingBeams(const pulseProcessor_t *state, pulsePr
   }
 }
 
-static void estimatePositionSweepsLh1(const pulseProcessor_t* appState, pulseProcessorResult_t* angles, int baseStation) {
+static void estimatePositionSweepsLh1(const pulseProcessor_t* appState, pulseProcessorResult_t* angles, int baseStation, const uint64_t timestamp) {
   const lighthouseCalibration_t* bsCalib = &appState->bsCalibration[baseStation];
   sweepAngleMeasurement_t sweepInfo;
   sweepInfo.stdDev = sweepStd;
@@ -297,7 +297,7 @@ static void estimatePositionSweepsLh1(const pulseProcessor_t* appState, pulsePro
         sweepInfo.calib = &bsCalib->sweep[0];
         sweepInfo.sweepId = 0;
 
-        estimatorEnqueueSweepAngles(&sweepInfo);
+        estimatorEnqueueSweepAnglesAt(&sweepInfo, timestamp);
         STATS_CNT_RATE_EVENT(bsEstRates[baseStation]);
         STATS_CNT_RATE_EVENT(&positionRate);
       }
@@ -310,7 +310,7 @@ static void estimatePositionSweepsLh1(const pulseProcessor_t* appState, pulsePro
         sweepInfo.sweepId = 1;
 
         #ifndef CONFIG_DECK_LIGHTHOUSE_AS_GROUNDTRUTH
-          estimatorEnqueueSweepAngles(&sweepInfo);
+          estimatorEnqueueSweepAnglesAt(&sweepInfo, timestamp);
         #endif
 
         STATS_CNT_RATE_EVENT(bsEstRates[baseStation]);
@@ -320,7 +320,7 @@ static void estimatePositionSweepsLh1(const pulseProcessor_t* appState, pulsePro
   }
 }
 
-static void estimatePositionSweepsLh2(const pulseProcessor_t* appState, pulseProcessorResult_t* angles, int baseStation) {
+static void estimatePositionSweepsLh2(const pulseProcessor_t* appState, pulseProcessorResult_t* angles, int baseStation, const uint64_t timestamp) {
   const lighthouseCalibration_t* bsCalib = &appState->bsCalibration[baseStation];
   sweepAngleMeasurement_t sweepInfo;
   sweepInfo.stdDev = sweepStdLh2;
@@ -342,7 +342,7 @@ static void estimatePositionSweepsLh2(const pulseProcessor_t* appState, pulsePro
         sweepInfo.calib = &bsCalib->sweep[0];
         sweepInfo.sweepId = 0;
         #ifndef CONFIG_DECK_LIGHTHOUSE_AS_GROUNDTRUTH
-          estimatorEnqueueSweepAngles(&sweepInfo);
+          estimatorEnqueueSweepAnglesAt(&sweepInfo, timestamp);
         #endif
         STATS_CNT_RATE_EVENT(bsEstRates[baseStation]);
         STATS_CNT_RATE_EVENT(&positionRate);
@@ -354,7 +354,7 @@ static void estimatePositionSweepsLh2(const pulseProcessor_t* appState, pulsePro
         sweepInfo.calib = &bsCalib->sweep[1];
         sweepInfo.sweepId = 1;
         #ifndef CONFIG_DECK_LIGHTHOUSE_AS_GROUNDTRUTH
-          estimatorEnqueueSweepAngles(&sweepInfo);
+          estimatorEnqueueSweepAnglesAt(&sweepInfo, timestamp);
         #endif
         STATS_CNT_RATE_EVENT(bsEstRates[baseStation]);
         STATS_CNT_RATE_EVENT(&positionRate);
@@ -363,13 +363,13 @@ static void estimatePositionSweepsLh2(const pulseProcessor_t* appState, pulsePro
   }
 }
 
-static void estimatePositionSweeps(const pulseProcessor_t* appState, pulseProcessorResult_t* angles, int baseStation) {
+static void estimatePositionSweeps(const pulseProcessor_t* appState, pulseProcessorResult_t* angles, int baseStation, const uint64_t timestamp) {
   switch(angles->measurementType) {
     case lighthouseBsTypeV1:
-      estimatePositionSweepsLh1(appState, angles, baseStation);
+      estimatePositionSweepsLh1(appState, angles, baseStation, timestamp);
       break;
     case lighthouseBsTypeV2:
-      estimatePositionSweepsLh2(appState, angles, baseStation);
+      estimatePositionSweepsLh2(appState, angles, baseStation, timestamp);
       break;
     default:
       // Do nothing
@@ -421,7 +421,7 @@ static bool estimateYawDeltaOneBaseStation(const int bs, const pulseProcessorRes
   }
 }
 
-static void estimateYaw(const pulseProcessor_t *state, pulseProcessorResult_t* angles, int baseStation) {
+static void estimateYaw(const pulseProcessor_t *state, pulseProcessorResult_t* angles, int baseStation, const uint64_t timestamp) {
   // TODO Most of these calculations should be moved into the estimator instead. It is a
   // bit dirty to get the state from the kalman filer here and calculate the yaw error outside
   // the estimator, but it will do for now.
@@ -444,24 +444,24 @@ static void estimateYaw(const pulseProcessor_t *state, pulseProcessorResult_t* a
   if (estimateYawDeltaOneBaseStation(baseStation, angles, state->bsGeometry, cfPos, n, &RR, &yawDelta)) {
     #ifndef CONFIG_DECK_LIGHTHOUSE_AS_GROUNDTRUTH
       yawErrorMeasurement_t yawDeltaMeasurement = {.yawError = yawDelta, .stdDev = 0.01};
-      estimatorEnqueueYawError(&yawDeltaMeasurement);
+      estimatorEnqueueYawErrorAt(&yawDeltaMeasurement, timestamp);
     #endif
   }
 }
 
-void lighthousePositionEstimatePoseCrossingBeams(const pulseProcessor_t *state, pulseProcessorResult_t* angles, int baseStation) {
+void lighthousePositionEstimatePoseCrossingBeams(const pulseProcessor_t *state, pulseProcessorResult_t* angles, int baseStation, const uint64_t timestamp) {
   if (state->bsGeometry[0].valid && state->bsGeometry[1].valid) {
-    estimatePositionCrossingBeams(state, angles, baseStation);
-    estimateYaw(state, angles, baseStation);
+    estimatePositionCrossingBeams(state, angles, baseStation, timestamp);
+    estimateYaw(state, angles, baseStation, timestamp);
   } else {
     deltaLog = 0;
   }
 }
 
-void lighthousePositionEstimatePoseSweeps(const pulseProcessor_t *state, pulseProcessorResult_t* angles, int baseStation) {
+void lighthousePositionEstimatePoseSweeps(const pulseProcessor_t *state, pulseProcessorResult_t* angles, int baseStation, const uint64_t timestamp) {
   if (state->bsGeometry[baseStation].valid) {
-    estimatePositionSweeps(state, angles, baseStation);
-    estimateYaw(state, angles, baseStation);
+    estimatePositionSweeps(state, angles, baseStation, timestamp);
+    estimateYaw(state, angles, baseStation, timestamp);
   }
 }
 
@@ -80,6 +80,32 @@ bool lighthouseStoragePersistData(const uint8_t baseStation, const bool geoData,
   return result;
 }
 
+bool lighthouseStoragePersistDataForBaseStations(const uint16_t geoDataBsField, const uint16_t calibDataBsField) {
+  static char keys[CONFIG_DECK_LIGHTHOUSE_MAX_N_BS * 2][KEY_LEN];
+  static storageItem_t items[CONFIG_DECK_LIGHTHOUSE_MAX_N_BS * 2];
+  int count = 0;
+
+  for (int baseStation = 0; baseStation < CONFIG_DECK_LIGHTHOUSE_MAX_N_BS; baseStation++) {
+    const uint16_t mask = 1 << baseStation;
+    if (geoDataBsField & mask) {
+      generateStorageKey(keys[count], STORAGE_KEY_GEO, baseStation);
+      items[count] = (storageItem_t){keys[count], &lighthouseCoreState.bsGeometry[baseStation], sizeof(lighthouseCoreState.bsGeometry[baseStation])};
+      count++;
+    }
+    if (calibDataBsField & mask) {
+      generateStorageKey(keys[count], STORAGE_KEY_CALIB, baseStation);
+      items[count] = (storageItem_t){keys[count], &lighthouseCoreState.bsCalibration[baseStation], sizeof(lighthouseCoreState.bsCalibration[baseStation])};
+      count++;
+    }
+  }
+
+  if (count == 0) {
+    return true;
+  }
+
+  return storageStoreBatch(items, count);
+}
+
 static void lhPersistDataWorker(void* arg) {
   uint8_t baseStation = (uint32_t)arg;
 
@@ -41,6 +41,7 @@
 #include "config.h"
 #include "crtp.h"
 #include "log.h"
+#include "log_program.h"
 #include "crc32.h"
 #include "worker.h"
 #include "num.h"
@@ -59,17 +60,6 @@
 #endif
 
 
-static const uint8_t typeLength[] = {
-  [LOG_UINT8]  = 1,
-  [LOG_UINT16] = 2,
-  [LOG_UINT32] = 4,
-  [LOG_INT8]   = 1,
-  [LOG_INT16]  = 2,
-  [LOG_INT32]  = 4,
-  [LOG_FLOAT]  = 4,
-  [LOG_FP16]   = 2,
-};
-
 #define LOG_TYPE_MASK (0x0f)
 
 typedef enum {
@@ -97,9 +87,13 @@ struct log_block {
   StaticTimer_t timerBuffer;
   uint32_t droppedPackets;
   struct log_ops * ops;
+  logProgram_t program;
 };
 
 NO_DMA_CCM_SAFE_ZERO_INIT static struct log_ops logOps[LOG_MAX_OPS];
+// The ops of all blocks compiled into flat programs, there is at most one
+// program op per log op
+NO_DMA_CCM_SAFE_ZERO_INIT static logProgramOp_t logProgramOps[LOG_MAX_OPS];
 NO_DMA_CCM_SAFE_ZERO_INIT static struct log_block logBlocks[LOG_MAX_BLOCKS];
 static xSemaphoreHandle logLock;
 static StaticSemaphore_t logLockBuffer;
@@ -153,6 +147,10 @@ static int logsLen;
 static uint32_t logsCrc;
 static uint16_t logsCount = 0;
 
+// Samples of all blocks skipped since start up because the log lane of the
+// TX queue was full
+static uint32_t skippedSamples = 0;
+
 static CRTPPacket p;
 
 static bool isInit = false;
@@ -166,6 +164,7 @@ static int logDeleteBlock(int id);
 static int logStartBlock(int id, unsigned int period);
 static int logStopBlock(int id);
 static void logReset();
+static void logCompileBlocks();
 static acquisitionType_t acquisitionTypeFromLogType(uint8_t logType);
 
 STATIC_MEM_TASK_ALLOC_STACK_NO_DMA_CCM_SAFE(logTask, LOG_TASK_STACKSIZE);
@@ -415,6 +414,9 @@ void logControlProcess()
       break;
   }
 
+  // The blocks might have changed, recompile them before the next run
+  logCompileBlocks();
+
   //Commands answer
   p.data[2] = ret;
   p.size = 3;
@@ -508,7 +510,7 @@ static int logAppendBlock(int id, struct ops_setting * settings, int len)
     struct log_ops * ops;
     int varId;
 
-    if ((currentLength + typeLength[settings[i].logType & LOG_TYPE_MASK])>LOG_MAX_LEN) {
+    if ((currentLength + logTypeLength[settings[i].logType & LOG_TYPE_MASK])>LOG_MAX_LEN) {
       LOG_ERROR("Trying to append a full block. Block id %d.\n", id);
       return E2BIG;
     }
@@ -576,7 +578,7 @@ static int logAppendBlockV2(int id, struct ops_setting_v2 * settings, int len)
     struct log_ops * ops;
     int varId;
 
-    if ((currentLength + typeLength[settings[i].logType & LOG_TYPE_MASK])>LOG_MAX_LEN) {
+    if ((currentLength + logTypeLength[settings[i].logType & LOG_TYPE_MASK])>LOG_MAX_LEN) {
       LOG_ERROR("Trying to append a full block. Block id %d.\n", id);
       return E2BIG;
     }
@@ -702,158 +704,61 @@ void logBlockTimed(xTimerHandle timer)
   workerSchedule(logRunBlock, pvTimerGetTimerID(timer));
 }
 
-/* Appends data to a packet if space is available; returns false on failure. */
-static bool appendToPacket(CRTPPacket * pk, const void * data, size_t n) {
-  if (pk->size <= CRTP_MAX_DATA_SIZE - n)
+/* Compile the ops of all blocks into programs. Must be called with the log lock taken. */
+static void logCompileBlocks()
+{
+  int programOpsUsed = 0;
+
+  for (int i = 0; i < LOG_MAX_BLOCKS; i++)
   {
-    memcpy(&pk->data[pk->size], data, n);
-    pk->size += n;
-    return true;
+    struct log_block *blk = &logBlocks[i];
+
+    logProgramInit(&blk->program, &logProgramOps[programOpsUsed], LOG_MAX_OPS - programOpsUsed, CRTP_MAX_DATA_SIZE - 4);
+
+    if (blk->id == BLOCK_ID_FREE) {
+      continue;
+    }
+
+    for (struct log_ops *ops = blk->ops; ops; ops = ops->next)
+    {
+      // If we run out of space, drop this and subsequent items.
+      if (!logProgramAppend(&blk->program, ops->variable, ops->storageType, ops->logType,
+                            ops->acquisitionType == acqType_function)) {
+        break;
+      }
+    }
+
+    programOpsUsed += blk->program.length;
   }
-  else return false;
 }
 
 /* This function is usually called by the worker subsystem */
 void logRunBlock(void * arg)
 {
   struct log_block *blk = arg;
-  struct log_ops *ops = blk->ops;
   static CRTPPacket pk;
   unsigned int timestamp;
 
+  // Skip the sample if the log lane of the TX queue is full, the next period
+  // will send fresh values instead of a packet that would be dropped.
+  if (crtpIsConnected() && crtpGetTxCredits(CRTP_PORT_LOG) == 0)
+  {
+    skippedSamples++;
+    return;
+  }
+
   xSemaphoreTake(logLock, portMAX_DELAY);
 
   timestamp = ((long long)xTaskGetTickCount())/portTICK_RATE_MS;
 
   pk.header = CRTP_HEADER(CRTP_PORT_LOG, LOG_CH);
-  pk.size = 4;
+  pk.size = 4 + blk->program.dataLength;
   pk.data[0] = blk->id;
   pk.data[1] = timestamp&0x0ff;
   pk.data[2] = (timestamp>>8)&0x0ff;
   pk.data[3] = (timestamp>>16)&0x0ff;
 
-  while (ops)
-  {
-    int valuei = 0;
-    float valuef = 0;
-
-    // FPU instructions must run on aligned data.
-    // We first copy the data to an (aligned) local variable, before assigning it
-    switch(ops->storageType)
-    {
-      case LOG_UINT8:
-      {
-        uint8_t v;
-        if (ops->acquisitionType == acqType_function) {
-          logByFunction_t* logByFunction = (logByFunction_t*)ops->variable;
-          v = logByFunction->acquireUInt8(timestamp, logByFunction->data);
-        } else {
-          memcpy(&v, ops->variable, sizeof(v));
-        }
-        valuei = v;
-        break;
-      }
-      case LOG_INT8:
-      {
-        int8_t v;
-        if (ops->acquisitionType == acqType_function) {
-          logByFunction_t* logByFunction = (logByFunction_t*)ops->variable;
-          v = logByFunction->acquireInt8(timestamp, logByFunction->data);
-        } else {
-          memcpy(&v, ops->variable, sizeof(v));
-        }
-        valuei = v;
-        break;
-      }
-      case LOG_UINT16:
-      {
-        uint16_t v;
-        if (ops->acquisitionType == acqType_function) {
-          logByFunction_t* logByFunction = (logByFunction_t*)ops->variable;
-          v = logByFunction->acquireUInt16(timestamp, logByFunction->data);
-        } else {
-          memcpy(&v, ops->variable, sizeof(v));
-        }
-        valuei = v;
-        break;
-      }
-      case LOG_INT16:
-      {
-        int16_t v;
-        if (ops->acquisitionType == acqType_function) {
-          logByFunction_t* logByFunction = (logByFunction_t*)ops->variable;
-          v = logByFunction->acquireInt16(timestamp, logByFunction->data);
-        } else {
-          memcpy(&v, ops->variable, sizeof(v));
-        }
-        valuei = v;
-        break;
-      }
-      case LOG_UINT32:
-      {
-        uint32_t v;
-        if (ops->acquisitionType == acqType_function) {
-          logByFunction_t* logByFunction = (logByFunction_t*)ops->variable;
-          v = logByFunction->acquireUInt32(timestamp, logByFunction->data);
-        } else {
-          memcpy(&v, ops->variable, sizeof(v));
-        }
-        valuei = v;
-        break;
-      }
-      case LOG_INT32:
-      {
-        int32_t v;
-        if (ops->acquisitionType == acqType_function) {
-          logByFunction_t* logByFunction = (logByFunction_t*)ops->variable;
-          v = logByFunction->acquireInt32(timestamp, logByFunction->data);
-        } else {
-          memcpy(&v, ops->variable, sizeof(v));
-        }
-        valuei = v;
-        break;
-      }
-      case LOG_FLOAT:
-      {
-        float v;
-        if (ops->acquisitionType == acqType_function) {
-          logByFunction_t* logByFunction = (logByFunction_t*)ops->variable;
-          v = logByFunction->aquireFloat(timestamp, logByFunction->data);
-        } else {
-          memcpy(&v, ops->variable, sizeof(valuef));
-        }
-        valuei = v;
-        valuef = v;
-        break;
-      }
-    }
-
-    if (ops->logType == LOG_FLOAT || ops->logType == LOG_FP16)
-    {
-      if (ops->storageType != LOG_FLOAT)
-      {
-        valuef = valuei;
-      }
-
-      // Try to append the next item to the packet.  If we run out of space,
-      // drop this and subsequent items.
-      if (ops->logType == LOG_FLOAT)
-      {
-        if (!appendToPacket(&pk, &valuef, 4)) break;
-      }
-      else
-      {
-        valuei = single2half(valuef);
-        if (!appendToPacket(&pk, &valuei, 2)) break;
-      }
-    }
-    else  //logType is an integer
-    {
-      if (!appendToPacket(&pk, &valuei, typeLength[ops->logType])) break;
-    }
-
-    ops = ops->next;
-  }
+  logProgramRun(&blk->program, &pk.data[4], timestamp);
 
   xSemaphoreGive(logLock);
 
@@ -923,7 +828,7 @@ static int blockCalcLength(struct log_block * block)
   int len = 0;
 
   for (ops = block->ops; ops; ops = ops->next)
-    len += typeLength[ops->logType];
+    len += logTypeLength[ops->logType];
 
   return len;
 }
@@ -1025,7 +930,7 @@ void* logGetAddress(logVarId_t varid)
 
 uint8_t logVarSize(int type)
 {
-  return typeLength[type];
+  return logTypeLength[type];
 }
 
 int logGetInt(logVarId_t varid)
@@ -1084,3 +989,13 @@ static acquisitionType_t acquisitionTypeFromLogType(uint8_t logType) {
 
   return acqType_memory;
 }
+
+/**
+ * Log subsystem statistics
+ */
+LOG_GROUP_START(log)
+/**
+ * @brief Samples of log blocks skipped since start up because the log lane of the CRTP TX queue was full
+ */
+LOG_ADD(LOG_UINT32, skipped, &skippedSamples)
+LOG_GROUP_STOP(log)
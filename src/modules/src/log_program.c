@@ -0,0 +1,236 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2021 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * log_program.c - Compiled log block packing
+ */
+
+#include <string.h>
+
+#include "log_program.h"
+#include "num.h"
+
+const uint8_t logTypeLength[] = {
+  [LOG_UINT8]  = 1,
+  [LOG_UINT16] = 2,
+  [LOG_UINT32] = 4,
+  [LOG_INT8]   = 1,
+  [LOG_INT16]  = 2,
+  [LOG_INT32]  = 4,
+  [LOG_FLOAT]  = 4,
+  [LOG_FP16]   = 2,
+};
+
+static bool isIntegerType(uint8_t type) {
+  return type >= LOG_UINT8 && type <= LOG_INT32;
+}
+
+// A variable can be copied as is if the packed value is the same as the bytes
+// in memory. Integers that are logged with the same or a shorter length are
+// truncated, which on a little endian CPU is a copy of the first bytes.
+static bool isCopyOnly(uint8_t storageType, uint8_t logType) {
+  if (storageType == LOG_FLOAT && logType == LOG_FLOAT) {
+    return true;
+  }
+
+  if (isIntegerType(storageType) && isIntegerType(logType)) {
+    return logTypeLength[logType] <= logTypeLength[storageType];
+  }
+
+  return false;
+}
+
+void logProgramInit(logProgram_t* program, logProgramOp_t* ops, uint16_t capacity, uint8_t maxDataLength) {
+  program->ops = ops;
+  program->capacity = capacity;
+  program->length = 0;
+  program->dataLength = 0;
+  program->maxDataLength = maxDataLength;
+}
+
+bool logProgramAppend(logProgram_t* program, const void* variable, uint8_t storageType, uint8_t logType, bool isAcquiredByFunction) {
+  const uint8_t size = logTypeLength[logType];
+
+  if (program->dataLength + size > program->maxDataLength) {
+    return false;
+  }
+
+  uint8_t kind = logProgramOpConvert;
+  if (isAcquiredByFunction) {
+    kind = logProgramOpFunction;
+  } else if (isCopyOnly(storageType, logType)) {
+    kind = logProgramOpCopy;
+  }
+
+  // Merge with the previous copy if the variable follows it in memory
+  if (kind == logProgramOpCopy && program->length > 0) {
+    logProgramOp_t* previous = &program->ops[program->length - 1];
+    if (previous->kind == logProgramOpCopy &&
+        (const uint8_t*)previous->src + previous->size == (const uint8_t*)variable) {
+      previous->size += size;
+      program->dataLength += size;
+      return true;
+    }
+  }
+
+  if (program->length >= program->capacity) {
+    return false;
+  }
+
+  logProgramOp_t* op = &program->ops[program->length];
+  op->src = variable;
+  op->dstOffset = program->dataLength;
+  op->size = size;
+  op->kind = kind;
+  op->storageType = storageType;
+  op->logType = logType;
+
+  program->length++;
+  program->dataLength += size;
+
+  return true;
+}
+
+static void runConvert(const logProgramOp_t* op, uint8_t* dst, uint32_t timestamp) {
+  const bool isAcquiredByFunction = (op->kind == logProgramOpFunction);
+  const logByFunction_t* logByFunction = (const logByFunction_t*)op->src;
+  int valuei = 0;
+  float valuef = 0;
+
+  // FPU instructions must run on aligned data.
+  // We first copy the data to an (aligned) local variable, before assigning it
+  switch(op->storageType)
+  {
+    case LOG_UINT8:
+    {
+      uint8_t v;
+      if (isAcquiredByFunction) {
+        v = logByFunction->acquireUInt8(timestamp, logByFunction->data);
+      } else {
+        memcpy(&v, op->src, sizeof(v));
+      }
+      valuei = v;
+      break;
+    }
+    case LOG_INT8:
+    {
+      int8_t v;
+      if (isAcquiredByFunction) {
+        v = logByFunction->acquireInt8(timestamp, logByFunction->data);
+      } else {
+        memcpy(&v, op->src, sizeof(v));
+      }
+      valuei = v;
+      break;
+    }
+    case LOG_UINT16:
+    {
+      uint16_t v;
+      if (isAcquiredByFunction) {
+        v = logByFunction->acquireUInt16(timestamp, logByFunction->data);
+      } else {
+        memcpy(&v, op->src, sizeof(v));
+      }
+      valuei = v;
+      break;
+    }
+    case LOG_INT16:
+    {
+      int16_t v;
+      if (isAcquiredByFunction) {
+        v = logByFunction->acquireInt16(timestamp, logByFunction->data);
+      } else {
+        memcpy(&v, op->src, sizeof(v));
+      }
+      valuei = v;
+      break;
+    }
+    case LOG_UINT32:
+    {
+      uint32_t v;
+      if (isAcquiredByFunction) {
+        v = logByFunction->acquireUInt32(timestamp, logByFunction->data);
+      } else {
+        memcpy(&v, op->src, sizeof(v));
+      }
+      valuei = v;
+      break;
+    }
+    case LOG_INT32:
+    {
+      int32_t v;
+      if (isAcquiredByFunction) {
+        v = logByFunction->acquireInt32(timestamp, logByFunction->data);
+      } else {
+        memcpy(&v, op->src, sizeof(v));
+      }
+      valuei = v;
+      break;
+    }
+    case LOG_FLOAT:
+    {
+      float v;
+      if (isAcquiredByFunction) {
+        v = logByFunction->aquireFloat(timestamp, logByFunction->data);
+      } else {
+        memcpy(&v, op->src, sizeof(valuef));
+      }
+      valuei = v;
+      valuef = v;
+      break;
+    }
+  }
+
+  if (op->logType == LOG_FLOAT || op->logType == LOG_FP16)
+  {
+    if (op->storageType != LOG_FLOAT)
+    {
+      valuef = valuei;
+    }
+
+    if (op->logType == LOG_FLOAT)
+    {
+      memcpy(dst, &valuef, 4);
+    }
+    else
+    {
+      valuei = single2half(valuef);
+      memcpy(dst, &valuei, 2);
+    }
+  }
+  else  //logType is an integer
+  {
+    memcpy(dst, &valuei, op->size);
+  }
+}
+
+void logProgramRun(const logProgram_t* program, uint8_t* data, uint32_t timestamp) {
+  const logProgramOp_t* end = program->ops + program->length;
+
+  for (const logProgramOp_t* op = program->ops; op < end; op++) {
+    if (op->kind == logProgramOpCopy) {
+      memcpy(&data[op->dstOffset], op->src, op->size);
+    } else {
+      runConvert(op, &data[op->dstOffset], timestamp);
+    }
+  }
+}
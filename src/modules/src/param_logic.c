@@ -23,10 +23,12 @@
  *
  * param.logic.c - Crazy parameter system logic source file.
  */
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 
 #include "config.h"
+#include "static_mem.h"
 #include "param_logic.h"
 #include "storage.h"
 #include "crc32.h"
@@ -65,6 +67,8 @@ static const uint8_t typeLength[] = {
 
 //Private functions
 static int variableGetIndex(int id);
+static const char* paramGetGroupOfIndex(int index);
+static void lookupTableInit(void);
 static char paramWriteByNameProcess(char* group, char* name, int type, void *valptr);
 
 
@@ -85,6 +89,14 @@ static int paramsLen;
 static uint32_t paramsCrc;
 static uint16_t paramsCount = 0;
 
+// Open addressing hash table of all variables, hashed on group and name.
+// Empty slots have an invalid id. The number of slots is the smallest power of
+// two that keeps the table at most 3/4 full, the table is allocated on the heap
+// when the number of params is known.
+static paramVarId_t* lookupTable = 0;
+static uint32_t lookupTableSize = 0;
+static bool isLookupTableValid = false;
+
 // _sdata is from linker script and points to start of data section
 extern int _sdata;
 extern int _edata;
@@ -260,11 +272,14 @@ void paramLogicInit(void)
     paramsCrc = crc32CalculateBuffer(buf, len);
   }
 
+  paramsCount = 0;
   for (i=0; i<paramsLen; i++)
   {
     if(!(params[i].type & PARAM_GROUP))
       paramsCount++;
   }
+
+  lookupTableInit();
 }
 
 void paramTOCProcess(CRTPPacket *p, int command)
@@ -374,29 +389,14 @@ void paramWriteProcess(CRTPPacket *p)
 }
 
 static char paramWriteByNameProcess(char* group, char* name, int type, void *valptr) {
-  int index;
-  char *pgroup = "";
-
-  for (index = 0; index < paramsLen; index++) //Ptr points a group
-  {
-    if (params[index].type & PARAM_GROUP)
-    {
-      if (params[index].type & PARAM_START)
-        pgroup = params[index].name;
-      else
-        pgroup = "";
-    }
-    else                          //Ptr points a variable
-    {
-      if (!strcmp(params[index].name, name) && !strcmp(pgroup, group))
-        break;
-    }
-  }
+  paramVarId_t varId = paramGetVarId(group, name);
 
-  if (index >= paramsLen) {
+  if (!PARAM_VARID_IS_VALID(varId)) {
     return ENOENT;
   }
 
+  int index = varId.index;
+
   if (type != (params[index].type & (~(PARAM_CORE | PARAM_RONLY | PARAM_EXTENDED)))) {
     return EINVAL;
   }
@@ -470,7 +470,73 @@ paramVarId_t paramGetVarIdFromComplete(const char* completeName)
   return paramGetVarId(group, name);
 }
 
-paramVarId_t paramGetVarId(const char* group, const char* name)
+static uint32_t lookupHash(const char* group, const char* name)
+{
+  // FNV-1a of "group.name"
+  uint32_t hash = 2166136261u;
+
+  for (const char* c = group; *c; c++) {
+    hash = (hash ^ (uint8_t)*c) * 16777619u;
+  }
+  hash = (hash ^ (uint8_t)'.') * 16777619u;
+  for (const char* c = name; *c; c++) {
+    hash = (hash ^ (uint8_t)*c) * 16777619u;
+  }
+
+  return hash;
+}
+
+static void lookupTableInit(void)
+{
+  uint16_t id = 0;
+  const char* currgroup = "";
+
+  isLookupTableValid = false;
+
+  // The smallest power of two >= 4/3 * paramsCount
+  const uint32_t minSize = ((uint32_t)paramsCount * 4 + 2) / 3;
+  uint32_t size = 1;
+  while (size < minSize) {
+    size <<= 1;
+  }
+
+  if (size != lookupTableSize) {
+    free(lookupTable);
+    lookupTable = malloc(size * sizeof(paramVarId_t));
+    lookupTableSize = lookupTable ? size : 0;
+  }
+
+  if (!lookupTable) {
+    PARAM_ERROR("No memory for the lookup table of %d params, using linear search\n", paramsCount);
+    return;
+  }
+
+  for (uint32_t slot = 0; slot < lookupTableSize; slot++) {
+    lookupTable[slot] = invalidVarId;
+  }
+
+  for (int index = 0; index < paramsLen; index++) {
+    if (params[index].type & PARAM_GROUP) {
+      if (params[index].type & PARAM_START) {
+        currgroup = params[index].name;
+      }
+      continue;
+    }
+
+    uint32_t slot = lookupHash(currgroup, params[index].name) & (lookupTableSize - 1);
+    while (PARAM_VARID_IS_VALID(lookupTable[slot])) {
+      slot = (slot + 1) & (lookupTableSize - 1);
+    }
+
+    lookupTable[slot].index = index;
+    lookupTable[slot].id = id;
+    id++;
+  }
+
+  isLookupTableValid = true;
+}
+
+static paramVarId_t paramGetVarIdLinear(const char* group, const char* name)
 {
   uint16_t index;
   uint16_t id = 0;
@@ -497,29 +563,50 @@ paramVarId_t paramGetVarId(const char* group, const char* name)
   return invalidVarId;
 }
 
+paramVarId_t paramGetVarId(const char* group, const char* name)
+{
+  if (!isLookupTableValid) {
+    return paramGetVarIdLinear(group, name);
+  }
+
+  uint32_t slot = lookupHash(group, name) & (lookupTableSize - 1);
+  while (PARAM_VARID_IS_VALID(lookupTable[slot])) {
+    const int index = lookupTable[slot].index;
+    if (!strcmp(name, params[index].name) && !strcmp(group, paramGetGroupOfIndex(index))) {
+      return lookupTable[slot];
+    }
+    slot = (slot + 1) & (lookupTableSize - 1);
+  }
+
+  return invalidVarId;
+}
+
 int paramGetType(paramVarId_t varid)
 {
   return params[varid.index].type;
 }
 
+// Groups are contiguous in the param table, the group of a variable is the
+// closest group start before it.
+static const char* paramGetGroupOfIndex(int index)
+{
+  for (int i = index; i >= 0; i--) {
+    if ((params[i].type & PARAM_GROUP) && (params[i].type & PARAM_START)) {
+      return params[i].name;
+    }
+  }
+
+  return "";
+}
+
 void paramGetGroupAndName(paramVarId_t varid, char** group, char** name)
 {
-  char * currgroup = "";
   *group = 0;
   *name = 0;
 
-  for(int index = 0; index < paramsLen; index++) {
-    if (params[index].type & PARAM_GROUP) {
-      if (params[index].type & PARAM_START) {
-        currgroup = params[index].name;
-      }
-    }
-
-    if (index == varid.index) {
-      *group = currgroup;
-      *name = params[index].name;
-      break;
-    }
+  if (varid.index < paramsLen) {
+    *group = (char*)paramGetGroupOfIndex(varid.index);
+    *name = params[varid.index].name;
   }
 }
 
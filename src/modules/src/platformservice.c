@@ -40,6 +40,7 @@
 #include "platform.h"
 #include "app_channel.h"
 #include "static_mem.h"
+#include "stabilizer_profiler.h"
 
 static bool isInit=false;
 STATIC_MEM_TASK_ALLOC_STACK_NO_DMA_CCM_SAFE(platformSrvTask, PLATFORM_SRV_TASK_STACKSIZE);
@@ -51,7 +52,9 @@ typedef enum {
 } Channel;
 
 typedef enum {
-  setContinousWave   = 0x00,
+  setContinousWave       = 0x00,
+  getStabilizerProfile   = 0x01,
+  resetStabilizerProfile = 0x02,
 } PlatformCommand;
 
 typedef enum {
@@ -61,7 +64,7 @@ typedef enum {
 } VersionCommand;
 
 static void platformSrvTask(void*);
-static void platformCommandProcess(uint8_t command, uint8_t *data);
+static void platformCommandProcess(CRTPPacket *p);
 static void versionCommandProcess(CRTPPacket *p);
 
 void platformserviceInit(void)
@@ -94,7 +97,7 @@ static void platformSrvTask(void* prm)
     switch (p.channel)
     {
       case platformCommand:
-        platformCommandProcess(p.data[0], &p.data[1]);
+        platformCommandProcess(&p);
         crtpSendPacketBlock(&p);
         break;
       case versionCommand:
@@ -109,17 +112,52 @@ static void platformSrvTask(void* prm)
   }
 }
 
-static void platformCommandProcess(uint8_t command, uint8_t *data)
+#ifdef CONFIG_DEBUG_STABILIZER_PROFILER
+/* Reply layout: command, stage, min, avg and max in cycles and the histogram
+ * bins (see cycleStats.h). Bin counts saturate at UINT16_MAX, use
+ * resetStabilizerProfile to start a new capture. A reply with only the
+ * command and stage means that the stage does not exist.
+ */
+static void stabilizerProfileProcess(CRTPPacket *p)
+{
+  static cycleStats_t stats;
+  const uint8_t stage = p->data[1];
+
+  p->size = 2;
+  if (stabilizerProfilerGetStats(stage, &stats)) {
+    const uint32_t values[] = {cycleStatsMin(&stats), cycleStatsAverage(&stats), stats.max};
+    memcpy(&p->data[p->size], values, sizeof(values));
+    p->size += sizeof(values);
+
+    for (int i = 0; i < CYCLE_STATS_BIN_COUNT; i++) {
+      const uint16_t count = (stats.bins[i] > UINT16_MAX) ? UINT16_MAX : stats.bins[i];
+      memcpy(&p->data[p->size], &count, sizeof(count));
+      p->size += sizeof(count);
+    }
+  }
+}
+#endif
+
+static void platformCommandProcess(CRTPPacket *p)
 {
   static SyslinkPacket slp;
+  uint8_t *data = &p->data[1];
 
-  switch (command) {
+  switch (p->data[0]) {
     case setContinousWave:
       slp.type = SYSLINK_RADIO_CONTWAVE;
       slp.length = 1;
       slp.data[0] = data[0];
       syslinkSendPacket(&slp);
       break;
+#ifdef CONFIG_DEBUG_STABILIZER_PROFILER
+    case getStabilizerProfile:
+      stabilizerProfileProcess(p);
+      break;
+    case resetStabilizerProfile:
+      stabilizerProfilerReset();
+      break;
+#endif
     default:
       break;
   }
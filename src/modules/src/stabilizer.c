@@ -56,6 +56,7 @@
 #include "statsCnt.h"
 #include "static_mem.h"
 #include "rateSupervisor.h"
+#include "stabilizer_profiler.h"
 
 static bool isInit;
 static bool emergencyStop = false;
@@ -178,6 +179,7 @@ void stabilizerInit(StateEstimatorType estimator)
   powerDistributionInit();
   motorsInit(platformConfigGetMotorMapping());
   collisionAvoidanceInit();
+  STABILIZER_PROFILER_INIT();
   estimatorType = getStateEstimator();
   controllerType = getControllerType();
 
@@ -242,9 +244,12 @@ static void stabilizerTask(void* param)
   while(1) {
     // The sensor should unlock at 1kHz
     sensorsWaitDataReady();
+    STABILIZER_PROFILER_START(stabilizerStageLoop);
 
     // update sensorData struct (for logging variables)
+    STABILIZER_PROFILER_START(stabilizerStageSensors);
     sensorsAcquire(&sensorData, tick);
+    STABILIZER_PROFILER_STOP(stabilizerStageSensors);
 
     if (healthShallWeRunTest()) {
       healthRunTests(&sensorData);
@@ -260,19 +265,29 @@ static void stabilizerTask(void* param)
         controllerType = getControllerType();
       }
 
+      STABILIZER_PROFILER_START(stabilizerStageEstimator);
       stateEstimator(&state, tick);
+      STABILIZER_PROFILER_STOP(stabilizerStageEstimator);
       compressState();
 
+      STABILIZER_PROFILER_START(stabilizerStageHighLevelCommander);
       if (crtpCommanderHighLevelGetSetpoint(&tempSetpoint, &state, tick)) {
         commanderSetSetpoint(&tempSetpoint, COMMANDER_PRIORITY_HIGHLEVEL);
       }
+      STABILIZER_PROFILER_STOP(stabilizerStageHighLevelCommander);
 
+      STABILIZER_PROFILER_START(stabilizerStageCommander);
       commanderGetSetpoint(&setpoint, &state);
+      STABILIZER_PROFILER_STOP(stabilizerStageCommander);
       compressSetpoint();
 
+      STABILIZER_PROFILER_START(stabilizerStageCollisionAvoidance);
       collisionAvoidanceUpdateSetpoint(&setpoint, &sensorData, &state, tick);
+      STABILIZER_PROFILER_STOP(stabilizerStageCollisionAvoidance);
 
+      STABILIZER_PROFILER_START(stabilizerStageController);
       controller(&control, &setpoint, &sensorData, &state, tick);
+      STABILIZER_PROFILER_STOP(stabilizerStageController);
 
       checkEmergencyStopTimeout();
 
@@ -280,8 +295,11 @@ static void stabilizerTask(void* param)
       // The supervisor module keeps track of Crazyflie state such as if
       // we are ok to fly, or if the Crazyflie is in flight.
       //
+      STABILIZER_PROFILER_START(stabilizerStageSupervisor);
       supervisorUpdate(&sensorData);
+      STABILIZER_PROFILER_STOP(stabilizerStageSupervisor);
 
+      STABILIZER_PROFILER_START(stabilizerStagePowerDistribution);
       if (emergencyStop || (systemIsArmed() == false)) {
         motorsStop();
       } else {
@@ -291,12 +309,14 @@ static void stabilizerTask(void* param)
         motorsSetRatio(MOTOR_M3, motorPower.m3);
         motorsSetRatio(MOTOR_M4, motorPower.m4);
       }
+      STABILIZER_PROFILER_STOP(stabilizerStagePowerDistribution);
+      STABILIZER_PROFILER_STOP(stabilizerStageLoop);
 
 #ifdef CONFIG_DECK_USD
       // Log data to uSD card if configured
       if (usddeckLoggingEnabled()
           && usddeckLoggingMode() == usddeckLoggingMode_SynchronousStabilizer
-          && RATE_DO_EXECUTE(usddeckFrequency(), tick)) {
+          && RATE_DO_EXECUTE_PHASED(usddeckFrequency(), USDDECK_PHASE, tick)) {
         usddeckTriggerLogging();
       }
 #endif
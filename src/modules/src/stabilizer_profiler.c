@@ -0,0 +1,222 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2023 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * stabilizer_profiler.c - execution time of the stabilizer loop stages
+ */
+
+#include <string.h>
+
+#include "stm32fxxx.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "stabilizer_profiler.h"
+#include "static_mem.h"
+#include "log.h"
+
+// The first histogram bin holds stages shorter than 2048 cycles, about 12 us
+// at 168 MHz. The last bin holds stages longer than 2048 << 6 cycles, about 780 us.
+#define FIRST_BIN_LIMIT_CYCLES 2048
+
+// Number of loops the log variables are calculated over
+#define LOG_WINDOW_LOOPS 1000
+
+static bool isInit = false;
+static volatile bool isResetRequested = false;
+
+static uint32_t stageStartCycles[stabilizerStageCount];
+NO_DMA_CCM_SAFE_ZERO_INIT static cycleStats_t accumulatedStats[stabilizerStageCount];
+NO_DMA_CCM_SAFE_ZERO_INIT static cycleStats_t windowStats[stabilizerStageCount];
+static uint32_t windowLoops;
+
+// Log variables, in micro seconds
+static uint16_t stageAvgUs[stabilizerStageCount];
+static uint16_t stageMaxUs[stabilizerStageCount];
+
+static uint16_t cyclesToUs(const uint32_t cycles)
+{
+  uint32_t us = cycles / (SystemCoreClock / 1000000);
+  if (us > UINT16_MAX) {
+    us = UINT16_MAX;
+  }
+
+  return us;
+}
+
+static void updateLogVariables()
+{
+  for (int i = 0; i < stabilizerStageCount; i++) {
+    stageAvgUs[i] = cyclesToUs(cycleStatsAverage(&windowStats[i]));
+    stageMaxUs[i] = cyclesToUs(windowStats[i].max);
+    cycleStatsReset(&windowStats[i]);
+  }
+}
+
+void stabilizerProfilerInit(void)
+{
+  if (isInit) {
+    return;
+  }
+
+  for (int i = 0; i < stabilizerStageCount; i++) {
+    cycleStatsInit(&accumulatedStats[i], FIRST_BIN_LIMIT_CYCLES);
+    cycleStatsInit(&windowStats[i], FIRST_BIN_LIMIT_CYCLES);
+  }
+  windowLoops = 0;
+
+  // Enable the DWT cycle counter. The counter is left running if a debugger
+  // already enabled it.
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+  isInit = true;
+}
+
+void stabilizerProfilerStart(const stabilizerStage_t stage)
+{
+  if (stage == stabilizerStageLoop && isResetRequested) {
+    for (int i = 0; i < stabilizerStageCount; i++) {
+      cycleStatsReset(&accumulatedStats[i]);
+    }
+    isResetRequested = false;
+  }
+
+  stageStartCycles[stage] = DWT->CYCCNT;
+}
+
+void stabilizerProfilerStop(const stabilizerStage_t stage)
+{
+  // Unsigned arithmetic handles wrap around of the counter
+  const uint32_t cycles = DWT->CYCCNT - stageStartCycles[stage];
+
+  cycleStatsAdd(&accumulatedStats[stage], cycles);
+  cycleStatsAdd(&windowStats[stage], cycles);
+
+  if (stage == stabilizerStageLoop) {
+    windowLoops++;
+    if (windowLoops >= LOG_WINDOW_LOOPS) {
+      updateLogVariables();
+      windowLoops = 0;
+    }
+  }
+}
+
+bool stabilizerProfilerGetStats(const stabilizerStage_t stage, cycleStats_t* stats)
+{
+  if (stage >= stabilizerStageCount) {
+    return false;
+  }
+
+  // The stabilizer task may preempt us, make sure the copy is consistent
+  taskENTER_CRITICAL();
+  memcpy(stats, &accumulatedStats[stage], sizeof(cycleStats_t));
+  taskEXIT_CRITICAL();
+
+  return true;
+}
+
+void stabilizerProfilerReset(void)
+{
+  isResetRequested = true;
+}
+
+/**
+ * Execution time of the stages of the stabilizer loop, calculated over
+ * 1000 loops. Use the platform service to get the full statistics with
+ * min values and histograms since start up.
+ */
+LOG_GROUP_START(stabProf)
+/**
+ * @brief Average time spent in sensorsAcquire() [us]
+ */
+LOG_ADD(LOG_UINT16, sensorsAvg, &stageAvgUs[stabilizerStageSensors])
+/**
+ * @brief Max time spent in sensorsAcquire() [us]
+ */
+LOG_ADD(LOG_UINT16, sensorsMax, &stageMaxUs[stabilizerStageSensors])
+/**
+ * @brief Average time spent in the state estimator [us]
+ */
+LOG_ADD(LOG_UINT16, estimatorAvg, &stageAvgUs[stabilizerStageEstimator])
+/**
+ * @brief Max time spent in the state estimator [us]
+ */
+LOG_ADD(LOG_UINT16, estimatorMax, &stageMaxUs[stabilizerStageEstimator])
+/**
+ * @brief Average time spent in the high level commander [us]
+ */
+LOG_ADD(LOG_UINT16, hlCommanderAvg, &stageAvgUs[stabilizerStageHighLevelCommander])
+/**
+ * @brief Max time spent in the high level commander [us]
+ */
+LOG_ADD(LOG_UINT16, hlCommanderMax, &stageMaxUs[stabilizerStageHighLevelCommander])
+/**
+ * @brief Average time spent in commanderGetSetpoint() [us]
+ */
+LOG_ADD(LOG_UINT16, commanderAvg, &stageAvgUs[stabilizerStageCommander])
+/**
+ * @brief Max time spent in commanderGetSetpoint() [us]
+ */
+LOG_ADD(LOG_UINT16, commanderMax, &stageMaxUs[stabilizerStageCommander])
+/**
+ * @brief Average time spent in collision avoidance [us]
+ */
+LOG_ADD(LOG_UINT16, collisionAvg, &stageAvgUs[stabilizerStageCollisionAvoidance])
+/**
+ * @brief Max time spent in collision avoidance [us]
+ */
+LOG_ADD(LOG_UINT16, collisionMax, &stageMaxUs[stabilizerStageCollisionAvoidance])
+/**
+ * @brief Average time spent in the controller [us]
+ */
+LOG_ADD(LOG_UINT16, controllerAvg, &stageAvgUs[stabilizerStageController])
+/**
+ * @brief Max time spent in the controller [us]
+ */
+LOG_ADD(LOG_UINT16, controllerMax, &stageMaxUs[stabilizerStageController])
+/**
+ * @brief Average time spent in supervisorUpdate() [us]
+ */
+LOG_ADD(LOG_UINT16, supervisorAvg, &stageAvgUs[stabilizerStageSupervisor])
+/**
+ * @brief Max time spent in supervisorUpdate() [us]
+ */
+LOG_ADD(LOG_UINT16, supervisorMax, &stageMaxUs[stabilizerStageSupervisor])
+/**
+ * @brief Average time spent in power distribution and motor output [us]
+ */
+LOG_ADD(LOG_UINT16, powerAvg, &stageAvgUs[stabilizerStagePowerDistribution])
+/**
+ * @brief Max time spent in power distribution and motor output [us]
+ */
+LOG_ADD(LOG_UINT16, powerMax, &stageMaxUs[stabilizerStagePowerDistribution])
+/**
+ * @brief Average time of the full stabilizer loop [us]
+ */
+LOG_ADD(LOG_UINT16, loopAvg, &stageAvgUs[stabilizerStageLoop])
+/**
+ * @brief Max time of the full stabilizer loop [us]
+ */
+LOG_ADD(LOG_UINT16, loopMax, &stageMaxUs[stabilizerStageLoop])
+LOG_GROUP_STOP(stabProf)
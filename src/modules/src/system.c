@@ -70,6 +70,7 @@
 #include "peer_localization.h"
 #include "cfassert.h"
 #include "i2cdev.h"
+#include "i2c_async.h"
 #include "autoconf.h"
 #include "vcp_esc_passthrough.h"
 #if CONFIG_ENABLE_CPX
@@ -186,6 +187,7 @@ void systemTask(void *arg)
   initUsecTimer();
   i2cdevInit(I2C3_DEV);
   i2cdevInit(I2C1_DEV);
+  i2cAsyncInit();
   passthroughInit();
 
   //Init the high-levels modules
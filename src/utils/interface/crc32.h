@@ -92,3 +92,27 @@ uint32_t crc32Out(const crc32Context_t *context);
  * @return The CRC32 checksum
  */
 uint32_t crc32CalculateBuffer(const void* buffer, size_t size);
+
+/**
+ * @brief Bit reverse a word for the CRC unit of the MCU
+ *
+ * The CRC unit processes words MSB first, the data words and the remainder
+ * of a context are bit reversed to and from the unit. Used by crc32Update()
+ * with CONFIG_CRC32_HARDWARE, public to be tested on the host.
+ *
+ * @param word The word to reverse
+ * @return The bit reversed word
+ */
+uint32_t crc32HardwareReflect(uint32_t word);
+
+/**
+ * @brief Word that brings the CRC unit of the MCU to the remainder of a context
+ *
+ * The CRC unit can only be reset to 0xFFFFFFFF. Writing the returned word
+ * after a reset continues the calculation from remainder. Used by
+ * crc32Update() with CONFIG_CRC32_HARDWARE, public to be tested on the host.
+ *
+ * @param remainder The remainder of a context
+ * @return The word to write to the unit after a reset
+ */
+uint32_t crc32HardwareSeed(uint32_t remainder);
@@ -0,0 +1,86 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2023 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * cycleStats.h - min/avg/max and histogram of execution times
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define CYCLE_STATS_BIN_COUNT 8
+
+/**
+ * Statistics of a series of execution times, typically measured in CPU cycles.
+ *
+ * The histogram bins are logarithmic. Bin 0 holds samples below firstBinLimit,
+ * bin n holds samples in [firstBinLimit << (n - 1), firstBinLimit << n) and the
+ * last bin holds everything above.
+ */
+typedef struct {
+  uint32_t count;
+  uint32_t min;
+  uint32_t max;
+  uint64_t sum;
+  uint32_t firstBinLimit;
+  uint32_t bins[CYCLE_STATS_BIN_COUNT];
+} cycleStats_t;
+
+/**
+ * @brief Initialize a cycleStats_t struct
+ *
+ * @param stats The struct to initialize
+ * @param firstBinLimit The upper (exclusive) limit of the first histogram bin
+ */
+void cycleStatsInit(cycleStats_t* stats, const uint32_t firstBinLimit);
+
+/**
+ * @brief Clear all samples, the bin layout is kept
+ *
+ * @param stats A cycleStats_t
+ */
+void cycleStatsReset(cycleStats_t* stats);
+
+/**
+ * @brief Add one sample
+ *
+ * @param stats A cycleStats_t
+ * @param value The sample
+ */
+void cycleStatsAdd(cycleStats_t* stats, const uint32_t value);
+
+/**
+ * @brief Get the average of the samples
+ *
+ * @param stats A cycleStats_t
+ * @return uint32_t The average, or 0 if there are no samples
+ */
+uint32_t cycleStatsAverage(const cycleStats_t* stats);
+
+/**
+ * @brief Get the minimum of the samples
+ *
+ * @param stats A cycleStats_t
+ * @return uint32_t The minimum, or 0 if there are no samples
+ */
+uint32_t cycleStatsMin(const cycleStats_t* stats);
@@ -35,10 +35,55 @@
 
 typedef bool (*kveFunc_t)(const char *key, void *buffer, size_t length);
 
+typedef struct {
+    size_t usedLength;  // Length of the items in the table
+    size_t holeLength;  // Length of the holes left by deleted items, free after defrag
+    size_t freeLength;  // Length free after the end of the table
+} kveStats_t;
+
 void kveDefrag(kveMemory_t *kve);
 
+/** Do one step of incremental defrag
+ *
+ * Moves the items following the first hole to fill it. Whole items are moved,
+ * up to maxLength bytes but at least one item.
+ *
+ * Return true when there are no holes left in the table
+ */
+bool kveDefragStep(kveMemory_t *kve, size_t maxLength);
+
+/** Get the space accounting of the table
+ *
+ * Return false if the table is corrupted
+ */
+bool kveGetStats(kveMemory_t *kve, kveStats_t *stats);
+
+/** Check if storing a buffer will defrag the table
+ *
+ * Storing a new key, or a buffer of a new length, appends an item of
+ * 3 + strlen(key) + length bytes. If it does not fit in the free length, the
+ * table is defragmented first.
+ */
+bool kveStoreNeedsDefrag(kveMemory_t *kve, const char* key, size_t length);
+
 bool kveStore(kveMemory_t *kve, const char* key, const void* buffer, size_t length);
 
+/** Store a number of items in one pass
+ *
+ * Items that do not exist or that change size are appended after each other
+ * at the end of the table and committed together when the end of the table
+ * is moved, a reset before that leaves the table unchanged. Items that keep
+ * their size are written in place and the old copies of resized items are
+ * released after the commit. If a reset leaves an old copy, it is released
+ * when the index is built.
+ *
+ * If an index is used, the free space is checked before anything is written
+ * and nothing is stored if the items do not fit, including the old copies of
+ * resized items. Without index the items are stored one by one. A batch with
+ * duplicate keys is rejected.
+ */
+bool kveStoreBatch(kveMemory_t *kve, const kveItem_t* items, size_t count);
+
 size_t kveFetch(kveMemory_t *kve, const char* key, void* buffer, size_t bufferLength);
 
 bool kveDelete(kveMemory_t *kve, const char* key);
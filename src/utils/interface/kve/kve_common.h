@@ -29,10 +29,39 @@
 #pragma once
 
 #include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct {
+    uint32_t keyHash;
+    uint16_t address;
+    uint16_t fullLength;
+} kveIndexEntry_t;
+
+// In-RAM index of the items in the memory, used to find items without
+// scanning the table. The index is built on first use and kept up to date
+// by the kve functions. If it overflows it is disabled and the table is
+// scanned instead.
+typedef struct {
+    kveIndexEntry_t *entries;
+    size_t capacity;
+    size_t count;
+    size_t endAddress;
+    size_t usedLength;
+    bool isBuilt;
+    bool isValid;
+} kveIndex_t;
 
 typedef struct {
     size_t memorySize;
     size_t (*read)(size_t address, void* data, size_t length);
     size_t (*write)(size_t address, const void* data, size_t length);
     void (*flush)(void);
+    kveIndex_t *index; // Optional, NULL if no index is used
 } kveMemory_t;
+
+typedef struct {
+    const char *key;
+    const void *buffer;
+    size_t length;
+} kveItem_t;
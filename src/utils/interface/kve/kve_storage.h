@@ -46,6 +46,8 @@
 
 #define END_TAG_LENDTH 2
 
+#define END_TAG (0xffffu)
+
 typedef struct itemHeader_s {
   uint16_t full_length;
   uint8_t key_length;
@@ -60,6 +62,15 @@ typedef struct itemHeader_s {
  */
 int kveStorageWriteItem(kveMemory_t *kve, size_t address, const char* key, const void* buffer, size_t length);
 
+/** Write an item over the end tag, with its header last
+ *
+ * The item is only part of the table once its header replaces the end tag,
+ * so a reset while writing it leaves the table unchanged.
+ *
+ * Return the full length of the item in memory
+ */
+int kveStorageCommitItem(kveMemory_t *kve, size_t address, const char* key, const void* buffer, size_t length);
+
 /** Write holes spanning full_length at address
  * 
  * The hole MUST be at least 3 bytes wide. No check is done in this function!
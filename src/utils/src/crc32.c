@@ -71,8 +71,16 @@
 #include "crc32.h"
 
 #include <stdbool.h>
+#include <string.h>
 
 #include "static_mem.h"
+#include "autoconf.h"
+
+#ifdef CONFIG_CRC32_HARDWARE
+#include "stm32fxxx.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#endif
 
 #define POLYNOMIAL              0xEDB88320
 #define CHECK_VALUE             0xCBF43926
@@ -80,14 +88,30 @@
 #define FINAL_XOR_VALUE         0xFFFFFFFF
 #define RESIDUE                 0xDEBB20e3
 
+// Number of bytes processed per iteration by the table driven calculation,
+// each slice needs a lookup table of 1 kB
+#ifdef CONFIG_CRC32_SLICING_BY_8
+#define CRC_SLICES              8
+#else
+#define CRC_SLICES              1
+#endif
+
 // Internal functions
 static uint32_t crcByByte(const uint8_t* message, uint32_t bytesToProcess,
-              uint32_t remainder, uint32_t* crcTable);
-static uint32_t crcByByte(const uint8_t* message, uint32_t bytesToProcess,
-              uint32_t remainder, uint32_t* crcTable);
-static void crcTableInit(uint32_t* crcTable);
+              uint32_t remainder, const uint32_t* crcTable);
+#ifdef CONFIG_CRC32_SLICING_BY_8
+static uint32_t crcBySlice(const uint8_t* message, uint32_t bytesToProcess,
+              uint32_t remainder, uint32_t crcTable[CRC_SLICES][256]);
+#endif
+static void crcTableInit(uint32_t crcTable[CRC_SLICES][256]);
+#ifdef CONFIG_CRC32_HARDWARE
+static uint32_t crcByHardware(const uint8_t* message, uint32_t bytesToProcess,
+              uint32_t remainder);
+#endif
 
-NO_DMA_CCM_SAFE_ZERO_INIT static uint32_t crcTable[256];
+// crcTable[0] is the classic byte table, crcTable[n] holds the CRC of a byte
+// followed by n zero bytes. 1 kB of CCM, or 8 kB with slicing-by-8.
+NO_DMA_CCM_SAFE_ZERO_INIT static uint32_t crcTable[CRC_SLICES][256];
 static bool crcTableInitialized = false;
 
 // *** Public API ***
@@ -98,6 +122,9 @@ void crc32ContextInit(crc32Context_t *context)
   if (crcTableInitialized == false) {
     // initialize crcTable
     crcTableInit(crcTable);
+#ifdef CONFIG_CRC32_HARDWARE
+    RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_CRC, ENABLE);
+#endif
     crcTableInitialized = true;
   }
 
@@ -106,7 +133,13 @@ void crc32ContextInit(crc32Context_t *context)
 
 void crc32Update(crc32Context_t *context, const void* data, size_t size)
 {
-  context->remainder = crcByByte(data, size, context->remainder, crcTable);
+#ifdef CONFIG_CRC32_HARDWARE
+  context->remainder = crcByHardware(data, size, context->remainder);
+#elif defined(CONFIG_CRC32_SLICING_BY_8)
+  context->remainder = crcBySlice(data, size, context->remainder, crcTable);
+#else
+  context->remainder = crcByByte(data, size, context->remainder, crcTable[0]);
+#endif
 }
 
 uint32_t crc32Out(const crc32Context_t *context)
@@ -150,7 +183,7 @@ static uint32_t crcByBit(const uint8_t* message, uint32_t bytesToProcess,
  * this is factor 8 faster and should be used if multiple crcs
  * have to be calculated */
 static uint32_t crcByByte(const uint8_t* message, uint32_t bytesToProcess,
-              uint32_t remainder, uint32_t* crcTable)
+              uint32_t remainder, const uint32_t* crcTable)
 {
   uint8_t data;
   for (int byte = 0; byte < bytesToProcess; ++byte)
@@ -161,13 +194,128 @@ static uint32_t crcByByte(const uint8_t* message, uint32_t bytesToProcess,
   return remainder;
 }
 
-/* creates a lookup-table which is necessary for the crcByByte function */
-static void crcTableInit(uint32_t* crcTable)
+/* creates the lookup-tables which are necessary for the crcByByte and
+ * crcBySlice functions */
+static void crcTableInit(uint32_t crcTable[CRC_SLICES][256])
 {
   uint8_t dividend = ~0;
   /* fill the table by bit-wise calculations of checksums
    * for each possible dividend */
   do {
-      *(crcTable+dividend) = crcByBit(&dividend, 1, 0);
+      crcTable[0][dividend] = crcByBit(&dividend, 1, 0);
   } while(dividend-- > 0);
+
+  /* each following table adds one zero byte to the previous one */
+  for (int slice = 1; slice < CRC_SLICES; slice++) {
+    for (int i = 0; i < 256; i++) {
+      const uint32_t previous = crcTable[slice - 1][i];
+      crcTable[slice][i] = (previous >> 8) ^ crcTable[0][previous & 0xff];
+    }
+  }
+}
+
+#ifdef CONFIG_CRC32_SLICING_BY_8
+// *** Slicing-by-8 ***
+
+/* Processes 8 bytes per iteration by looking up each byte in its own table
+ * instead of running the byte wise calculation 8 times in sequence. The
+ * words are read in little endian order, which is the order of the CRC bits. */
+static uint32_t crcBySlice(const uint8_t* message, uint32_t bytesToProcess,
+              uint32_t remainder, uint32_t crcTable[CRC_SLICES][256])
+{
+  while (bytesToProcess >= CRC_SLICES) {
+    uint32_t low;
+    uint32_t high;
+    memcpy(&low, message, sizeof(low));
+    memcpy(&high, message + 4, sizeof(high));
+    low ^= remainder;
+
+    remainder = crcTable[7][low & 0xff] ^
+                crcTable[6][(low >> 8) & 0xff] ^
+                crcTable[5][(low >> 16) & 0xff] ^
+                crcTable[4][low >> 24] ^
+                crcTable[3][high & 0xff] ^
+                crcTable[2][(high >> 8) & 0xff] ^
+                crcTable[1][(high >> 16) & 0xff] ^
+                crcTable[0][high >> 24];
+
+    message += CRC_SLICES;
+    bytesToProcess -= CRC_SLICES;
+  }
+
+  return crcByByte(message, bytesToProcess, remainder, crcTable[0]);
+}
+#endif
+
+// *** STM32F4 CRC unit ***
+
+/* The CRC unit uses the same polynomial, but processes 32 bit words MSB
+ * first and can only be reset to 0xFFFFFFFF. The reflected calculation is
+ * obtained by bit reversing the input words and the resulting remainder.
+ * To continue from an arbitrary remainder, a seed word is written after the
+ * reset that brings the unit to the wanted state. */
+
+#define POLYNOMIAL_NORMAL       0x04C11DB7
+#define HW_RESET_STATE          0xFFFFFFFF
+// Number of words processed with interrupts disabled, the CRC unit is shared
+#define HW_WORDS_PER_LOCK       64
+
+uint32_t crc32HardwareReflect(uint32_t word)
+{
+#ifdef CONFIG_CRC32_HARDWARE
+  return __RBIT(word);
+#else
+  uint32_t reflected = 0;
+  for (int bit = 0; bit < 32; bit++) {
+    reflected = (reflected << 1) | ((word >> bit) & 1);
+  }
+  return reflected;
+#endif
+}
+
+uint32_t crc32HardwareSeed(uint32_t remainder)
+{
+  uint32_t state = crc32HardwareReflect(remainder);
+
+  // Undo the 32 shifts that the unit applies to a written word
+  for (int bit = 0; bit < 32; bit++) {
+    if (state & 1) {
+      state = ((state ^ POLYNOMIAL_NORMAL) >> 1) | 0x80000000;
+    } else {
+      state = state >> 1;
+    }
+  }
+  return state ^ HW_RESET_STATE;
+}
+
+#ifdef CONFIG_CRC32_HARDWARE
+static uint32_t crcByHardware(const uint8_t* message, uint32_t bytesToProcess,
+              uint32_t remainder)
+{
+  while (bytesToProcess >= 4) {
+    uint32_t words = bytesToProcess / 4;
+    if (words > HW_WORDS_PER_LOCK) {
+      words = HW_WORDS_PER_LOCK;
+    }
+
+    taskENTER_CRITICAL();
+    CRC->CR = CRC_CR_RESET;
+    // The reset state is the reflected initial remainder
+    if (remainder != INITIAL_REMAINDER) {
+      CRC->DR = crc32HardwareSeed(remainder);
+    }
+    for (uint32_t i = 0; i < words; i++) {
+      uint32_t word;
+      memcpy(&word, message, sizeof(word));
+      CRC->DR = crc32HardwareReflect(word);
+      message += 4;
+    }
+    remainder = crc32HardwareReflect(CRC->DR);
+    taskEXIT_CRITICAL();
+
+    bytesToProcess -= words * 4;
+  }
+
+  return crcByByte(message, bytesToProcess, remainder, crcTable[0]);
 }
+#endif
@@ -0,0 +1,77 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2023 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * cycleStats.c - min/avg/max and histogram of execution times
+ */
+
+#include "cycleStats.h"
+
+void cycleStatsInit(cycleStats_t* stats, const uint32_t firstBinLimit) {
+  stats->firstBinLimit = firstBinLimit;
+  cycleStatsReset(stats);
+}
+
+void cycleStatsReset(cycleStats_t* stats) {
+  stats->count = 0;
+  stats->min = UINT32_MAX;
+  stats->max = 0;
+  stats->sum = 0;
+  for (int i = 0; i < CYCLE_STATS_BIN_COUNT; i++) {
+    stats->bins[i] = 0;
+  }
+}
+
+void cycleStatsAdd(cycleStats_t* stats, const uint32_t value) {
+  stats->count++;
+  stats->sum += value;
+  if (value < stats->min) {
+    stats->min = value;
+  }
+  if (value > stats->max) {
+    stats->max = value;
+  }
+
+  int bin = 0;
+  uint32_t limit = stats->firstBinLimit;
+  while (bin < (CYCLE_STATS_BIN_COUNT - 1) && value >= limit) {
+    bin++;
+    limit <<= 1;
+  }
+  stats->bins[bin]++;
+}
+
+uint32_t cycleStatsAverage(const cycleStats_t* stats) {
+  if (stats->count == 0) {
+    return 0;
+  }
+
+  return stats->sum / stats->count;
+}
+
+uint32_t cycleStatsMin(const cycleStats_t* stats) {
+  if (stats->count == 0) {
+    return 0;
+  }
+
+  return stats->min;
+}
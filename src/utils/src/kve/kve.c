@@ -24,9 +24,185 @@ static size_t min(size_t a, size_t b)
     }
 }
 
+// Index
+
+static uint32_t keyHash(const char* key, size_t keyLength) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < keyLength; i++) {
+        hash = (hash ^ (uint8_t)key[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+static bool indexAdd(kveIndex_t *index, const char* key, size_t keyLength, size_t address, size_t fullLength) {
+    if (index->count >= index->capacity) {
+        DEBUG_PRINT("Warning: index full, using table scans\n");
+        index->isValid = false;
+        return false;
+    }
+
+    kveIndexEntry_t *entry = &index->entries[index->count];
+    entry->keyHash = keyHash(key, keyLength);
+    entry->address = address;
+    entry->fullLength = fullLength;
+
+    index->count++;
+    index->usedLength += fullLength;
+
+    return true;
+}
+
+static void indexRemove(kveIndex_t *index, size_t address) {
+    for (size_t i = 0; i < index->count; i++) {
+        if (index->entries[i].address == address) {
+            index->usedLength -= index->entries[i].fullLength;
+            index->count--;
+            index->entries[i] = index->entries[index->count];
+            return;
+        }
+    }
+}
+
+static kveIndexEntry_t* indexFind(kveMemory_t *kve, kveIndex_t *index, const char* key);
+
+// Scan the table once and record the address of all the items. A key that
+// appears twice is left by a batch store interrupted after its commit, the
+// earlier copy is the old one and is released.
+static void indexBuild(kveMemory_t *kve) {
+    static char keyBuffer[256];
+    kveIndex_t *index = kve->index;
+    size_t address = FIRST_ITEM_ADDRESS;
+
+    index->count = 0;
+    index->usedLength = 0;
+    index->isBuilt = true;
+    index->isValid = false;
+
+    while (address < (kve->memorySize - 2)) {
+        kveItemHeader_t header = kveStorageGetItemInfo(kve, address);
+
+        if (header.full_length == END_TAG) {
+            index->endAddress = address;
+            index->isValid = true;
+            return;
+        }
+
+        // An item must at least have a key of len>=1
+        if (header.full_length < (sizeof(header) + 1)) {
+            return;
+        }
+
+        if (header.key_length != 0) {
+            kveStorageGetKey(kve, address, header, keyBuffer, sizeof(keyBuffer));
+            keyBuffer[header.key_length] = '\0';
+
+            kveIndexEntry_t *oldEntry = indexFind(kve, index, keyBuffer);
+            if (oldEntry) {
+                const size_t oldAddress = oldEntry->address;
+                kveStorageWriteHole(kve, oldAddress, oldEntry->fullLength);
+                indexRemove(index, oldAddress);
+            }
+
+            if (!indexAdd(index, keyBuffer, header.key_length, address, header.full_length)) {
+                return;
+            }
+        }
+
+        address += header.full_length;
+    }
+
+    // This is a corrupted table!
+}
+
+// Return the index, or NULL if the table must be scanned
+static kveIndex_t* getIndex(kveMemory_t *kve) {
+    kveIndex_t *index = kve->index;
+
+    if (index == NULL) {
+        return NULL;
+    }
+
+    if (!index->isBuilt) {
+        indexBuild(kve);
+    }
+
+    return index->isValid ? index : NULL;
+}
+
+static void invalidateIndex(kveMemory_t *kve) {
+    if (kve->index) {
+        kve->index->isBuilt = false;
+    }
+}
+
+static kveIndexEntry_t* indexFind(kveMemory_t *kve, kveIndex_t *index, const char* key) {
+    static char itemBuffer[sizeof(kveItemHeader_t) + 255];
+    const size_t keyLength = strlen(key);
+    const uint32_t hash = keyHash(key, keyLength);
+
+    for (size_t i = 0; i < index->count; i++) {
+        kveIndexEntry_t *entry = &index->entries[i];
+        if (entry->keyHash != hash) {
+            continue;
+        }
+
+        // Verify the key in memory, the hash might collide
+        kve->read(entry->address, itemBuffer, sizeof(kveItemHeader_t) + keyLength);
+        kveItemHeader_t *header = (kveItemHeader_t*)itemBuffer;
+        if (header->key_length == keyLength && !memcmp(key, &itemBuffer[sizeof(kveItemHeader_t)], keyLength)) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+static size_t findItemByKey(kveMemory_t *kve, const char* key) {
+    kveIndex_t *index = getIndex(kve);
+
+    if (index == NULL) {
+        return kveStorageFindItemByKey(kve, FIRST_ITEM_ADDRESS, key);
+    }
+
+    kveIndexEntry_t *entry = indexFind(kve, index, key);
+    return entry ? entry->address : KVE_STORAGE_INVALID_ADDRESS;
+}
+
+static void onItemAppended(kveMemory_t *kve, const char* key, size_t address, size_t fullLength) {
+    kveIndex_t *index = kve->index;
+
+    if (index && index->isBuilt && index->isValid) {
+        if (indexAdd(index, key, strlen(key), address, fullLength)) {
+            index->endAddress = address + fullLength;
+        }
+    }
+}
+
+static void onItemDeleted(kveMemory_t *kve, size_t address) {
+    kveIndex_t *index = kve->index;
+
+    if (index && index->isBuilt && index->isValid) {
+        indexRemove(index, address);
+    }
+}
+
+static size_t findEnd(kveMemory_t *kve, size_t address) {
+    kveIndex_t *index = getIndex(kve);
+
+    if (index) {
+        return index->endAddress;
+    }
+
+    return kveStorageFindEnd(kve, address);
+}
+
 // Utility function
 static bool appendItemToEnd(kveMemory_t *kve, size_t address, const char* key, const void* buffer, size_t length) {
-    size_t itemAddress = kveStorageFindEnd(kve, address);
+    size_t itemAddress = findEnd(kve, address);
+    size_t fullLength;
  
     // If it is over the end of the memory, table corrupted
     // Do not write anything ...
@@ -37,17 +213,19 @@ static bool appendItemToEnd(kveMemory_t *kve, size_t address, const char* key, c
 
     // Test that there is enough space to write the item
     if ((itemAddress + sizeof(kveItemHeader_t) + strlen(key) + length + END_TAG_LENDTH) < kve->memorySize) {
-        itemAddress += kveStorageWriteItem(kve, itemAddress, key, buffer, length);
-        kveStorageWriteEnd(kve, itemAddress);
+        fullLength = kveStorageWriteItem(kve, itemAddress, key, buffer, length);
+        kveStorageWriteEnd(kve, itemAddress + fullLength);
+        onItemAppended(kve, key, itemAddress, fullLength);
     } else {
         // Otherwise, defrag and try to insert again!
         kveDefrag(kve);
 
-        itemAddress = kveStorageFindEnd(kve, FIRST_ITEM_ADDRESS);
+        itemAddress = findEnd(kve, FIRST_ITEM_ADDRESS);
 
         if ((itemAddress + sizeof(kveItemHeader_t) + strlen(key) + length + END_TAG_LENDTH) < kve->memorySize) {
-            itemAddress += kveStorageWriteItem(kve, itemAddress, key, buffer, length);
-            kveStorageWriteEnd(kve, itemAddress);
+            fullLength = kveStorageWriteItem(kve, itemAddress, key, buffer, length);
+            kveStorageWriteEnd(kve, itemAddress + fullLength);
+            onItemAppended(kve, key, itemAddress, fullLength);
         } else {
             // Memory full!
             DEBUG_PRINT("Error: memory full!");
@@ -89,13 +267,148 @@ void kveDefrag(kveMemory_t *kve) {
 
         holeAddress = holeAddress + lenghtToMove;
     }
+
+    // Items have moved, the index is rebuilt on next use
+    invalidateIndex(kve);
+}
+
+// Find the first hole from the index, without reading the memory
+static size_t indexFindFirstHole(kveIndex_t *index) {
+    size_t address = FIRST_ITEM_ADDRESS;
+
+    while (address < index->endAddress) {
+        size_t i;
+        for (i = 0; i < index->count; i++) {
+            if (index->entries[i].address == address) {
+                break;
+            }
+        }
+
+        if (i == index->count) {
+            return address;
+        }
+
+        address += index->entries[i].fullLength;
+    }
+
+    return KVE_STORAGE_INVALID_ADDRESS;
+}
+
+bool kveDefragStep(kveMemory_t *kve, size_t maxLength) {
+    kveIndex_t *index = getIndex(kve);
+    size_t holeAddress;
+
+    if (index) {
+        holeAddress = indexFindFirstHole(index);
+    } else {
+        holeAddress = kveStorageFindHole(kve, FIRST_ITEM_ADDRESS);
+    }
+
+    if (KVE_STORAGE_IS_VALID(holeAddress) == false ||
+        kveStorageGetItemInfo(kve, holeAddress).full_length == END_TAG) {
+        return true;
+    }
+
+    size_t itemAddress = kveStorageFindNextItem(kve, holeAddress);
+
+    if (KVE_STORAGE_IS_VALID(itemAddress) == false) {
+        // Only holes left at the end, lets crop them
+        kveStorageWriteEnd(kve, holeAddress);
+        if (index) {
+            index->endAddress = holeAddress;
+        }
+        return true;
+    }
+
+    // Group the items following the hole, up to maxLength
+    size_t lengthToMove = 0;
+    kveItemHeader_t header = kveStorageGetItemInfo(kve, itemAddress);
+    do {
+        lengthToMove += header.full_length;
+        header = kveStorageGetItemInfo(kve, itemAddress + lengthToMove);
+    } while (header.full_length != END_TAG && header.key_length != 0 &&
+             (lengthToMove + header.full_length) <= maxLength);
+
+    const size_t holeLength = itemAddress - holeAddress;
+
+    kveStorageMoveMemory(kve, itemAddress, holeAddress, lengthToMove);
+
+    kveStorageWriteHole(kve, holeAddress + lengthToMove, holeLength);
+
+    if (index) {
+        for (size_t i = 0; i < index->count; i++) {
+            kveIndexEntry_t *entry = &index->entries[i];
+            if (entry->address >= itemAddress && entry->address < (itemAddress + lengthToMove)) {
+                entry->address -= holeLength;
+            }
+        }
+    }
+
+    return false;
+}
+
+bool kveGetStats(kveMemory_t *kve, kveStats_t *stats) {
+    kveIndex_t *index = getIndex(kve);
+    size_t endAddress;
+
+    if (index) {
+        endAddress = index->endAddress;
+        stats->usedLength = index->usedLength;
+    } else {
+        size_t address = FIRST_ITEM_ADDRESS;
+        stats->usedLength = 0;
+
+        while (true) {
+            if (address >= (kve->memorySize - 2)) {
+                return false;
+            }
+
+            kveItemHeader_t header = kveStorageGetItemInfo(kve, address);
+            if (header.full_length == END_TAG) {
+                break;
+            }
+            if (header.full_length < (sizeof(header) + 1)) {
+                return false;
+            }
+
+            if (header.key_length != 0) {
+                stats->usedLength += header.full_length;
+            }
+            address += header.full_length;
+        }
+
+        endAddress = address;
+    }
+
+    stats->holeLength = endAddress - FIRST_ITEM_ADDRESS - stats->usedLength;
+    stats->freeLength = kve->memorySize - endAddress - END_TAG_LENDTH;
+
+    return true;
+}
+
+bool kveStoreNeedsDefrag(kveMemory_t *kve, const char* key, size_t length) {
+    kveStats_t stats;
+    const size_t fullLength = sizeof(kveItemHeader_t) + strlen(key) + length;
+
+    size_t itemAddress = findItemByKey(kve, key);
+    if (KVE_STORAGE_IS_VALID(itemAddress) &&
+        kveStorageGetItemInfo(kve, itemAddress).full_length == fullLength) {
+        // Written in place
+        return false;
+    }
+
+    if (!kveGetStats(kve, &stats)) {
+        return false;
+    }
+
+    return fullLength >= stats.freeLength;
 }
 
 bool kveStore(kveMemory_t *kve, const char* key, const void* buffer, size_t length) {
     size_t itemAddress;
 
     // Search if the key is already present in the table
-    itemAddress = kveStorageFindItemByKey(kve, FIRST_ITEM_ADDRESS, key);
+    itemAddress = findItemByKey(kve, key);
     if (KVE_STORAGE_IS_VALID(itemAddress) == false) {
         // Item does not exit, find the end of the table to insert it
         return appendItemToEnd(kve, FIRST_ITEM_ADDRESS, key, buffer, length);
@@ -106,6 +419,7 @@ bool kveStore(kveMemory_t *kve, const char* key, const void* buffer, size_t leng
         if (currentItem.full_length != newLength) {
             // If not, delete the item and find the end of the table
             kveStorageWriteHole(kve, itemAddress, currentItem.full_length);
+            onItemDeleted(kve, itemAddress);
             return appendItemToEnd(kve, FIRST_ITEM_ADDRESS, key, buffer, length);
         } else {
             kveStorageWriteItem(kve, itemAddress, key, buffer, length);
@@ -115,6 +429,137 @@ bool kveStore(kveMemory_t *kve, const char* key, const void* buffer, size_t leng
     return true;
 }
 
+static size_t itemFullLength(const kveItem_t* item) {
+    return sizeof(kveItemHeader_t) + strlen(item->key) + item->length;
+}
+
+static bool hasDuplicateKeys(const kveItem_t* items, size_t count) {
+    for (size_t i = 1; i < count; i++) {
+        for (size_t j = 0; j < i; j++) {
+            if (strcmp(items[i].key, items[j].key) == 0) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+// Items that are new or change size are appended, the others are written in place
+static bool isAppended(kveMemory_t *kve, kveIndex_t *index, const kveItem_t* item) {
+    kveIndexEntry_t *entry = indexFind(kve, index, item->key);
+    return entry == NULL || entry->fullLength != itemFullLength(item);
+}
+
+bool kveStoreBatch(kveMemory_t *kve, const kveItem_t* items, size_t count) {
+    if (hasDuplicateKeys(items, count)) {
+        DEBUG_PRINT("Error: duplicate keys in batch!\n");
+        return false;
+    }
+
+    kveIndex_t *index = getIndex(kve);
+
+    if (index == NULL) {
+        for (size_t i = 0; i < count; i++) {
+            if (!kveStore(kve, items[i].key, items[i].buffer, items[i].length)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Check that the items fit before writing anything. The old copies of
+    // resized items are only released once the new ones are committed, so
+    // they still take space while appending.
+    size_t appendLength = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (isAppended(kve, index, &items[i])) {
+            appendLength += itemFullLength(&items[i]);
+        }
+    }
+
+    const size_t freeLength = kve->memorySize - FIRST_ITEM_ADDRESS - END_TAG_LENDTH - index->usedLength;
+    if (appendLength >= freeLength) {
+        DEBUG_PRINT("Error: memory full!");
+        return false;
+    }
+
+    size_t firstAddress = KVE_STORAGE_INVALID_ADDRESS;
+    size_t endAddress = KVE_STORAGE_INVALID_ADDRESS;
+    if (appendLength > 0) {
+        if ((index->endAddress + appendLength + END_TAG_LENDTH) >= kve->memorySize) {
+            kveDefrag(kve);
+            index = getIndex(kve);
+            if (index == NULL) {
+                DEBUG_PRINT("Error: table corrupted!\n");
+                return false;
+            }
+        }
+
+        // The first item is written last, over the end tag. Until then the
+        // table ends where it did and a reset leaves it unchanged.
+        firstAddress = index->endAddress;
+        endAddress = firstAddress;
+        const kveItem_t *firstItem = NULL;
+        for (size_t i = 0; i < count; i++) {
+            if (!isAppended(kve, index, &items[i])) {
+                continue;
+            }
+
+            if (firstItem == NULL) {
+                firstItem = &items[i];
+            } else {
+                kveStorageWriteItem(kve, endAddress, items[i].key, items[i].buffer, items[i].length);
+            }
+            endAddress += itemFullLength(&items[i]);
+        }
+
+        kveStorageWriteEnd(kve, endAddress);
+        kveStorageCommitItem(kve, firstAddress, firstItem->key, firstItem->buffer, firstItem->length);
+    }
+
+    // The appended items are committed. A reset from here on can leave the
+    // old copies of resized items before the new ones, they are released
+    // when the index is built.
+    for (size_t i = 0; i < count; i++) {
+        kveIndexEntry_t *entry = indexFind(kve, index, items[i].key);
+        if (entry && entry->fullLength == itemFullLength(&items[i])) {
+            kveStorageWriteItem(kve, entry->address, items[i].key, items[i].buffer, items[i].length);
+        }
+    }
+
+    if (appendLength == 0) {
+        return true;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        kveIndexEntry_t *entry = indexFind(kve, index, items[i].key);
+        if (entry && entry->fullLength != itemFullLength(&items[i])) {
+            const size_t address = entry->address;
+            kveStorageWriteHole(kve, address, entry->fullLength);
+            indexRemove(index, address);
+        }
+    }
+
+    size_t address = firstAddress;
+    for (size_t i = 0; i < count; i++) {
+        if (!isAppended(kve, index, &items[i])) {
+            continue;
+        }
+
+        const size_t fullLength = itemFullLength(&items[i]);
+        if (!indexAdd(index, items[i].key, strlen(items[i].key), address, fullLength)) {
+            // The index is disabled, the table is still consistent
+            invalidateIndex(kve);
+            return true;
+        }
+        address += fullLength;
+    }
+    index->endAddress = endAddress;
+
+    return true;
+}
+
 //
 // We will use the function kveStorageFindItemByPrefix to find the first item
 // with a key that matches our prefix.
@@ -157,7 +602,7 @@ bool kveForeach(kveMemory_t *kve, const char *prefix, kveFunc_t func)
 
 size_t kveFetch(kveMemory_t *kve, const char* key, void* buffer, size_t bufferLength)
 {
-    size_t itemAddress = kveStorageFindItemByKey(kve, FIRST_ITEM_ADDRESS, key);
+    size_t itemAddress = findItemByKey(kve, key);
 
     if (KVE_STORAGE_IS_VALID(itemAddress)) {
         kveItemHeader_t header = kveStorageGetItemInfo(kve, itemAddress);
@@ -169,11 +614,12 @@ size_t kveFetch(kveMemory_t *kve, const char* key, void* buffer, size_t bufferLe
 }
 
 bool kveDelete(kveMemory_t *kve, const char* key) {
-    size_t itemAddress = kveStorageFindItemByKey(kve, FIRST_ITEM_ADDRESS, key);
+    size_t itemAddress = findItemByKey(kve, key);
 
     if (KVE_STORAGE_IS_VALID(itemAddress)) {
         kveItemHeader_t itemInfo = kveStorageGetItemInfo(kve, itemAddress);
         kveStorageWriteHole(kve, itemAddress, itemInfo.full_length);
+        onItemDeleted(kve, itemAddress);
         return true;
     }
 
@@ -184,6 +630,14 @@ void kveFormat(kveMemory_t *kve) {
     uint8_t version = KVE_VERSION;
     kve->write(VERSION_ADDRESS, &version, 1);
     kveStorageWriteEnd(kve, FIRST_ITEM_ADDRESS);
+
+    if (kve->index) {
+        kve->index->count = 0;
+        kve->index->usedLength = 0;
+        kve->index->endAddress = FIRST_ITEM_ADDRESS;
+        kve->index->isBuilt = true;
+        kve->index->isValid = true;
+    }
 }
 
 bool kveCheck(kveMemory_t *kve) {
@@ -195,7 +649,8 @@ bool kveCheck(kveMemory_t *kve) {
         return false;
     }
 
-    // Check table consistency
+    // Check table consistency, the index is rebuilt from the checked table
+    invalidateIndex(kve);
     size_t endAddress = kveStorageFindEnd(kve, FIRST_ITEM_ADDRESS);
 
     // If it is not possible to get to the end tag, the table is corupted
@@ -40,8 +40,6 @@ static size_t min(size_t a, size_t b)
     }
 }
 
-#define END_TAG (0xffffu)
-
 int kveStorageWriteItem(kveMemory_t *kve, size_t address, const char* key, const void* buffer, size_t length)
 {
   kveItemHeader_t header;
@@ -58,6 +56,23 @@ int kveStorageWriteItem(kveMemory_t *kve, size_t address, const char* key, const
   return header.full_length;
 }
 
+int kveStorageCommitItem(kveMemory_t *kve, size_t address, const char* key, const void* buffer, size_t length)
+{
+  kveItemHeader_t header;
+  header.key_length = strlen(key);
+  header.full_length = 2 + 1 + header.key_length + length;
+
+  // Write key and buffer, then the header over the end tag
+  kve->write(address + sizeof(header), key, header.key_length);
+  kve->write(address + sizeof(header) + header.key_length, buffer, length);
+  kve->flush();
+
+  kve->write(address, &header, sizeof(header));
+  kve->flush();
+
+  return header.full_length;
+}
+
 uint16_t kveStorageWriteHole(kveMemory_t *kve, size_t address, size_t full_length) {
   kveItemHeader_t header;
   header.full_length = full_length;
@@ -0,0 +1,174 @@
+// File under test usddeck_encoder.c
+#include "usddeck_encoder.h"
+
+#include <string.h>
+
+#include "unity.h"
+#include "log.h"
+#include "crc32.h"
+
+#define BUFFER_SIZE 64
+
+static uint8_t buffer[BUFFER_SIZE];
+static usdEncoderEvent_t events[2];
+static usdEncoderBlock_t block;
+
+static const uint8_t noPayload[1];
+
+void setUp(void) {
+  memset(buffer, 0, sizeof(buffer));
+  memset(events, 0, sizeof(events));
+
+  // Event 0: a float and an int16
+  events[0].numVariables = 2;
+  events[0].variableTypes[0] = LOG_FLOAT;
+  events[0].variableTypes[1] = LOG_INT16;
+
+  // Event 1: a 2 byte payload and a delta encoded uint16 and int16
+  events[1].payloadSize = 2;
+  events[1].numVariables = 3;
+  events[1].variableTypes[0] = LOG_INT16;
+  events[1].variableTypes[1] = LOG_UINT8;
+  events[1].variableTypes[2] = LOG_INT16;
+  events[1].deltaVariables = (1 << 0) | (1 << 2);
+
+  usdEncoderInit(&block, buffer, sizeof(buffer), events, 2);
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testThatRawVariablesSizeIsCalculated(void) {
+  // Fixture
+  // Test
+  uint16_t actual0 = usdEncoderRawVariablesSize(&events[0]);
+  uint16_t actual1 = usdEncoderRawVariablesSize(&events[1]);
+
+  // Assert
+  TEST_ASSERT_EQUAL(6, actual0);
+  TEST_ASSERT_EQUAL(5, actual1);
+}
+
+void testThatRawRecordIsAppended(void) {
+  // Fixture
+  const uint8_t variables[] = {1, 2, 3, 4, 5, 6};
+  const uint8_t expected[] = {0, 0, 1, 2, 3, 4, 5, 6};
+
+  // Test
+  bool actual = usdEncoderAppend(&block, 0, 1000, noPayload, variables);
+
+  // Assert
+  TEST_ASSERT_TRUE(actual);
+  TEST_ASSERT_EQUAL(1, block.numRecords);
+  TEST_ASSERT_EQUAL(USD_ENCODER_BLOCK_HEADER_SIZE + sizeof(expected), block.length);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, &buffer[USD_ENCODER_BLOCK_HEADER_SIZE], sizeof(expected));
+}
+
+void testThatTimestampIsZigzagVarintDelta(void) {
+  // Fixture
+  const uint8_t variables[6] = {0};
+  usdEncoderAppend(&block, 0, 1000, noPayload, variables);
+  // +100 us -> 200 -> 0xc8 0x01, -1 us -> 1
+  const uint8_t expected[] = {0, 0xc8, 0x01, 0, 0, 0, 0, 0, 0, 0, 0x01, 0, 0, 0, 0, 0, 0};
+
+  // Test
+  usdEncoderAppend(&block, 0, 1100, noPayload, variables);
+  usdEncoderAppend(&block, 0, 1099, noPayload, variables);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, &buffer[USD_ENCODER_BLOCK_HEADER_SIZE + 8], sizeof(expected));
+}
+
+void testThatDeltaVariablesAreZigzagVarintsAfterRawVariables(void) {
+  // Fixture
+  const uint8_t payload[] = {0xaa, 0xbb};
+  // int16 100, uint8 7, int16 -1
+  const uint8_t variables1[] = {100, 0, 7, 0xff, 0xff};
+  // int16 98, uint8 8, int16 -1
+  const uint8_t variables2[] = {98, 0, 8, 0xff, 0xff};
+  const uint8_t expected[] = {
+    1, 0, 0xaa, 0xbb, 7, 0xc8, 0x01, 0x01,
+    1, 0, 0xaa, 0xbb, 8, 0x03, 0x00,
+  };
+
+  // Test
+  usdEncoderAppend(&block, 1, 1000, payload, variables1);
+  usdEncoderAppend(&block, 1, 1000, payload, variables2);
+
+  // Assert
+  TEST_ASSERT_EQUAL(USD_ENCODER_BLOCK_HEADER_SIZE + sizeof(expected), block.length);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, &buffer[USD_ENCODER_BLOCK_HEADER_SIZE], sizeof(expected));
+}
+
+void testThatAppendFailsWhenBlockIsFull(void) {
+  // Fixture
+  const uint8_t variables[6] = {0};
+  // Each record uses 8 bytes, but there must be room for the worst case of
+  // 1 + 10 + 6 = 17 bytes. 4 records fit in the 47 bytes between header and CRC.
+  for (int i = 0; i < 4; i++) {
+    TEST_ASSERT_TRUE(usdEncoderAppend(&block, 0, 1000, noPayload, variables));
+  }
+
+  // Test
+  bool actual = usdEncoderAppend(&block, 0, 1000, noPayload, variables);
+
+  // Assert
+  TEST_ASSERT_FALSE(actual);
+  TEST_ASSERT_EQUAL(4, block.numRecords);
+}
+
+void testThatAppendFailsForUnknownEvent(void) {
+  // Fixture
+  const uint8_t variables[6] = {0};
+
+  // Test
+  bool actual = usdEncoderAppend(&block, 2, 1000, noPayload, variables);
+
+  // Assert
+  TEST_ASSERT_FALSE(actual);
+  TEST_ASSERT_TRUE(usdEncoderIsEmpty(&block));
+}
+
+void testThatFinishAddsHeaderAndCrc(void) {
+  // Fixture
+  const uint8_t variables[6] = {1, 2, 3, 4, 5, 6};
+  usdEncoderAppend(&block, 0, 0x0102030405060708, noPayload, variables);
+  usdEncoderAppend(&block, 0, 0x0102030405060709, noPayload, variables);
+  const uint8_t expectedHeader[] = {USD_ENCODER_BLOCK_MARKER, 2, 0, 16, 0, 8, 7, 6, 5, 4, 3, 2, 1};
+
+  // Test
+  uint16_t actual = usdEncoderFinish(&block);
+
+  // Assert
+  TEST_ASSERT_EQUAL(USD_ENCODER_BLOCK_HEADER_SIZE + 16 + USD_ENCODER_BLOCK_CRC_SIZE, actual);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expectedHeader, buffer, sizeof(expectedHeader));
+  uint32_t crc;
+  memcpy(&crc, &buffer[actual - USD_ENCODER_BLOCK_CRC_SIZE], sizeof(crc));
+  TEST_ASSERT_EQUAL_HEX32(crc32CalculateBuffer(buffer, actual - USD_ENCODER_BLOCK_CRC_SIZE), crc);
+  TEST_ASSERT_TRUE(usdEncoderIsEmpty(&block));
+}
+
+void testThatFinishOfEmptyBlockReturnsZero(void) {
+  // Fixture
+  // Test
+  uint16_t actual = usdEncoderFinish(&block);
+
+  // Assert
+  TEST_ASSERT_EQUAL(0, actual);
+}
+
+void testThatDeltasRestartInNewBlock(void) {
+  // Fixture
+  const uint8_t payload[] = {0, 0};
+  const uint8_t variables[] = {100, 0, 7, 0, 0};
+  usdEncoderAppend(&block, 1, 1000, payload, variables);
+  usdEncoderFinish(&block);
+  const uint8_t expected[] = {1, 0, 0, 0, 7, 0xc8, 0x01, 0x00};
+
+  // Test
+  usdEncoderAppend(&block, 1, 2000, payload, variables);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, &buffer[USD_ENCODER_BLOCK_HEADER_SIZE], sizeof(expected));
+}
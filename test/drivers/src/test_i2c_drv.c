@@ -0,0 +1,404 @@
+// File under test i2c_drv.c
+#include "i2c_drv.h"
+
+#include <string.h>
+
+#include "unity.h"
+#include "i2cPeripheralMocks.h"
+#include "mock_cfassert.h"
+#include "mock_sleepus.h"
+#include "mock_statsCnt.h"
+
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "semphr.h"
+#include "task.h"
+
+// The ISRs of the sensors bus
+void I2C3_EV_IRQHandler(void);
+void I2C3_ER_IRQHandler(void);
+void DMA1_Stream2_IRQHandler(void);
+
+// Fakes of the FreeRTOS semaphores used by i2cdrvMessageTransfer()
+static int busFreeMutex;
+static int busFreeSemaphore;
+static int busFreeSemaphoreCount;
+
+// Called when a task waits for the bus, stands in for the interrupts during the wait
+static void (*onWaitForBus)(void);
+
+QueueHandle_t xQueueGenericCreateStatic(const UBaseType_t uxQueueLength, const UBaseType_t uxItemSize, uint8_t* pucQueueStorage, StaticQueue_t* pxStaticQueue, const uint8_t ucQueueType) {
+  return (QueueHandle_t)&busFreeSemaphore;
+}
+
+QueueHandle_t xQueueCreateMutexStatic(const uint8_t ucQueueType, StaticQueue_t* pxStaticQueue) {
+  return (QueueHandle_t)&busFreeMutex;
+}
+
+BaseType_t xQueueSemaphoreTake(QueueHandle_t xQueue, TickType_t xTicksToWait) {
+  if (xQueue == (QueueHandle_t)&busFreeMutex) {
+    return pdTRUE;
+  }
+
+  if (busFreeSemaphoreCount == 0 && onWaitForBus) {
+    onWaitForBus();
+  }
+  if (busFreeSemaphoreCount == 0) {
+    // Timed out
+    i2cPeripheralMock.now += (uint64_t)xTicksToWait * 1000;
+    return pdFALSE;
+  }
+
+  busFreeSemaphoreCount--;
+  return pdTRUE;
+}
+
+BaseType_t xQueueGenericSend(QueueHandle_t xQueue, const void* const pvItemToQueue, TickType_t xTicksToWait, const BaseType_t xCopyPosition) {
+  TEST_ASSERT_EQUAL_PTR(&busFreeMutex, xQueue);
+  return pdTRUE;
+}
+
+BaseType_t xQueueGiveFromISR(QueueHandle_t xQueue, BaseType_t* const pxHigherPriorityTaskWoken) {
+  TEST_ASSERT_EQUAL_PTR(&busFreeSemaphore, xQueue);
+  busFreeSemaphoreCount = 1;
+  *pxHigherPriorityTaskWoken = pdTRUE;
+  return pdTRUE;
+}
+
+// Fake of the task notification of transactions
+static TaskHandle_t notifiedTask;
+static int notifyCount;
+
+// The notification API is indexed from FreeRTOS 10.4
+#ifdef tskDEFAULT_INDEX_TO_NOTIFY
+void vTaskGenericNotifyGiveFromISR(TaskHandle_t xTaskToNotify, UBaseType_t uxIndexToNotify, BaseType_t* pxHigherPriorityTaskWoken) {
+#else
+void vTaskNotifyGiveFromISR(TaskHandle_t xTaskToNotify, BaseType_t* pxHigherPriorityTaskWoken) {
+#endif
+  notifiedTask = xTaskToNotify;
+  notifyCount++;
+  *pxHigherPriorityTaskWoken = pdTRUE;
+}
+
+void vPortEnterCritical(void) {}
+void vPortExitCritical(void) {}
+
+// Helpers that play the part of the peripheral and the addressed device //////
+
+static void event(uint16_t sr1, uint16_t sr2) {
+  i2cMockI2c3.SR1 = sr1;
+  i2cMockI2c3.SR2 = sr2;
+  I2C3_EV_IRQHandler();
+}
+
+static void runPendingEventInterrupt() {
+  while (i2cPeripheralMock.isEventInterruptPending) {
+    i2cPeripheralMock.isEventInterruptPending = false;
+    event(0, 0);
+  }
+}
+
+// Acks a write message of length bytes
+static void transferWrite(int length) {
+  event(I2C_SR1_SB, 0);
+  event(I2C_SR1_ADDR, 0);
+  for (int i = 0; i < length; i++) {
+    event(I2C_SR1_TXE, 0);
+  }
+  event(I2C_SR1_BTF, I2C_SR2_TRA);
+}
+
+// Acks a read message with an 8 bit internal address, the data is received by DMA
+static void transferInternalAddressRead() {
+  event(I2C_SR1_SB, 0);
+  event(I2C_SR1_ADDR, 0);
+  event(I2C_SR1_TXE, 0);
+  event(I2C_SR1_BTF, I2C_SR2_TRA);
+  event(I2C_SR1_SB, 0);
+  event(I2C_SR1_ADDR, 0);
+  i2cPeripheralMock.isDmaTransferComplete = true;
+  DMA1_Stream2_IRQHandler();
+}
+
+// The addressed device does not ack the message, nor any of its retries
+static void nack(int nbrOfRetries) {
+  for (int i = 0; i <= nbrOfRetries; i++) {
+    event(I2C_SR1_SB, 0);
+    i2cPeripheralMock.isAckFailure = true;
+    I2C3_ER_IRQHandler();
+  }
+}
+
+static void transferBlockingWrite() {
+  transferWrite(1);
+}
+
+static uint8_t bufferA[4] = {0xA1, 0xA2, 0xA3, 0xA4};
+static uint8_t bufferB[4] = {0xB1, 0xB2, 0xB3, 0xB4};
+static uint8_t bufferC[4];
+static I2cMessage messagesA[2];
+static I2cMessage messagesB[1];
+static I2cMessage messagesC[1];
+static I2cTransaction transactionA;
+static I2cTransaction transactionB;
+static I2cTransaction transactionC;
+
+static void createTransaction(I2cTransaction* transaction, I2cMessage* messages, uint32_t nbrOfMessages) {
+  memset(transaction, 0, sizeof(I2cTransaction));
+  transaction->messages = messages;
+  transaction->nbrOfMessages = nbrOfMessages;
+}
+
+void setUp(void) {
+  sleepus_Ignore();
+  statsCntRateLoggerInit_Ignore();
+
+  i2cPeripheralMockReset();
+  busFreeSemaphoreCount = 0;
+  onWaitForBus = 0;
+  notifiedTask = 0;
+  notifyCount = 0;
+
+  const I2cDef* def = sensorsBus.def;
+  memset(&sensorsBus, 0, sizeof(sensorsBus));
+  sensorsBus.def = def;
+  i2cdrvInit(&sensorsBus);
+  i2cPeripheralMock.restarts = 0;
+
+  i2cdrvCreateMessage(&messagesA[0], 0x10, i2cWrite, 1, bufferA);
+  createTransaction(&transactionA, messagesA, 1);
+  i2cdrvCreateMessage(&messagesB[0], 0x20, i2cWrite, 1, bufferB);
+  createTransaction(&transactionB, messagesB, 1);
+  i2cdrvCreateMessage(&messagesC[0], 0x40, i2cWrite, 1, bufferC);
+  createTransaction(&transactionC, messagesC, 1);
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testThatQueuedTransactionsAreTransferredInOrder() {
+  // Fixture
+  i2cdrvTransactionSubmit(&sensorsBus, &transactionA);
+  i2cdrvTransactionSubmit(&sensorsBus, &transactionB);
+
+  // Test
+  transferWrite(1);
+  const bool isBDoneAfterA = transactionB.isDone;
+  transferWrite(1);
+
+  // Assert
+  TEST_ASSERT_TRUE(transactionA.isDone);
+  TEST_ASSERT_TRUE(transactionA.isSuccessful);
+  TEST_ASSERT_FALSE(isBDoneAfterA);
+  TEST_ASSERT_TRUE(transactionB.isDone);
+  TEST_ASSERT_TRUE(transactionB.isSuccessful);
+
+  const uint8_t expectedAddresses[] = {0x10 << 1, 0x20 << 1};
+  TEST_ASSERT_EQUAL_INT(2, i2cPeripheralMock.addressCount);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expectedAddresses, i2cPeripheralMock.addresses, 2);
+  const uint8_t expectedData[] = {0xA1, 0xB1};
+  TEST_ASSERT_EQUAL_INT(2, i2cPeripheralMock.dataCount);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expectedData, i2cPeripheralMock.data, 2);
+
+  TEST_ASSERT_EQUAL_UINT16(0, sensorsBus.queueDepth);
+  TEST_ASSERT_EQUAL_UINT16(2, sensorsBus.queueDepthMax);
+}
+
+void testThatChainedMessagesAreTransferredInOneTransaction() {
+  // Fixture
+  static int task;
+  i2cdrvCreateMessage(&messagesA[0], 0x30, i2cWrite, 2, bufferA);
+  i2cdrvCreateMessageIntAddr(&messagesA[1], 0x30, false, 0x75, i2cRead, 3, bufferC);
+  createTransaction(&transactionA, messagesA, 2);
+  transactionA.notifyTask = (TaskHandle_t)&task;
+
+  i2cdrvTransactionSubmit(&sensorsBus, &transactionA);
+
+  // Test
+  transferWrite(2);
+  const bool isDoneAfterFirstMessage = transactionA.isDone;
+  transferInternalAddressRead();
+
+  // Assert
+  TEST_ASSERT_FALSE(isDoneAfterFirstMessage);
+  TEST_ASSERT_TRUE(transactionA.isDone);
+  TEST_ASSERT_TRUE(transactionA.isSuccessful);
+  TEST_ASSERT_EQUAL(i2cAck, messagesA[0].status);
+  TEST_ASSERT_EQUAL(i2cAck, messagesA[1].status);
+
+  const uint8_t expectedAddresses[] = {0x30 << 1, 0x30 << 1, (0x30 << 1) | I2C_Direction_Receiver};
+  TEST_ASSERT_EQUAL_INT(3, i2cPeripheralMock.addressCount);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expectedAddresses, i2cPeripheralMock.addresses, 3);
+  const uint8_t expectedData[] = {0xA1, 0xA2, 0x75};
+  TEST_ASSERT_EQUAL_INT(3, i2cPeripheralMock.dataCount);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expectedData, i2cPeripheralMock.data, 3);
+
+  TEST_ASSERT_EQUAL_INT(1, notifyCount);
+  TEST_ASSERT_EQUAL_PTR(&task, notifiedTask);
+}
+
+void testThatChainIsStoppedAtNackAndNextTransactionIsStarted() {
+  // Fixture
+  i2cdrvCreateMessage(&messagesA[1], 0x10, i2cWrite, 1, bufferA);
+  createTransaction(&transactionA, messagesA, 2);
+
+  i2cdrvTransactionSubmit(&sensorsBus, &transactionA);
+  i2cdrvTransactionSubmit(&sensorsBus, &transactionB);
+
+  // Test
+  nack(messagesA[0].nbrOfRetries);
+  transferWrite(1);
+
+  // Assert
+  TEST_ASSERT_TRUE(transactionA.isDone);
+  TEST_ASSERT_FALSE(transactionA.isSuccessful);
+  TEST_ASSERT_EQUAL(i2cNack, messagesA[0].status);
+
+  TEST_ASSERT_TRUE(transactionB.isDone);
+  TEST_ASSERT_TRUE(transactionB.isSuccessful);
+
+  // The first message and its retries, then transaction B
+  const int expectedAddressCount = messagesA[0].nbrOfRetries + 2;
+  TEST_ASSERT_EQUAL_INT(expectedAddressCount, i2cPeripheralMock.addressCount);
+  TEST_ASSERT_EQUAL_UINT8(0x20 << 1, i2cPeripheralMock.addresses[expectedAddressCount - 1]);
+  TEST_ASSERT_EQUAL_INT(1, i2cPeripheralMock.dataCount);
+  TEST_ASSERT_EQUAL_UINT8(0xB1, i2cPeripheralMock.data[0]);
+}
+
+void testThatTransactionIsNotAbortedBeforeTheTimeout() {
+  // Fixture
+  i2cdrvTransactionSubmit(&sensorsBus, &transactionA);
+  i2cPeripheralMock.now += 400 * 1000;
+
+  // Test
+  i2cdrvCheckTimeout(&sensorsBus);
+
+  // Assert
+  TEST_ASSERT_FALSE(i2cPeripheralMock.isEventInterruptPending);
+  TEST_ASSERT_EQUAL_INT(0, i2cPeripheralMock.restarts);
+  TEST_ASSERT_EQUAL_UINT16(0, sensorsBus.nbrOfTimeouts);
+  TEST_ASSERT_FALSE(transactionA.isDone);
+}
+
+void testThatHangedTransactionIsAbortedFromTheInterruptAfterTheTimeout() {
+  // Fixture
+  i2cdrvTransactionSubmit(&sensorsBus, &transactionA);
+  i2cdrvTransactionSubmit(&sensorsBus, &transactionB);
+  i2cPeripheralMock.now += 500 * 1000 + 1;
+
+  // Test
+  i2cdrvCheckTimeout(&sensorsBus);
+  const bool isDoneBeforeInterrupt = transactionA.isDone;
+  runPendingEventInterrupt();
+
+  // Assert
+  TEST_ASSERT_FALSE(isDoneBeforeInterrupt);
+  TEST_ASSERT_TRUE(transactionA.isDone);
+  TEST_ASSERT_FALSE(transactionA.isSuccessful);
+  TEST_ASSERT_EQUAL(i2cNack, messagesA[0].status);
+  TEST_ASSERT_EQUAL_UINT16(1, sensorsBus.nbrOfTimeouts);
+  TEST_ASSERT_EQUAL_INT(1, i2cPeripheralMock.restarts);
+
+  // The restarted bus continues with the next transaction
+  TEST_ASSERT_FALSE(transactionB.isDone);
+  transferWrite(1);
+  TEST_ASSERT_TRUE(transactionB.isSuccessful);
+}
+
+void testThatHungBusFailsTransactionsUntilARestartFreesIt() {
+  // Fixture
+  i2cdrvTransactionSubmit(&sensorsBus, &transactionA);
+  i2cdrvTransactionSubmit(&sensorsBus, &transactionB);
+  i2cPeripheralMock.isBusHeld = true;
+  i2cPeripheralMock.now += 500 * 1000 + 1;
+
+  // Test
+  i2cdrvCheckTimeout(&sensorsBus);
+  runPendingEventInterrupt();
+
+  i2cdrvTransactionSubmit(&sensorsBus, &transactionC);
+  runPendingEventInterrupt();
+
+  // Assert
+  TEST_ASSERT_TRUE(sensorsBus.isHung);
+  TEST_ASSERT_EQUAL_UINT16(1, sensorsBus.nbrOfHungRestarts);
+  TEST_ASSERT_TRUE(transactionA.isDone);
+  TEST_ASSERT_FALSE(transactionA.isSuccessful);
+  TEST_ASSERT_TRUE(transactionB.isDone);
+  TEST_ASSERT_FALSE(transactionB.isSuccessful);
+  TEST_ASSERT_TRUE(transactionC.isDone);
+  TEST_ASSERT_FALSE(transactionC.isSuccessful);
+  TEST_ASSERT_EQUAL_INT(0, i2cPeripheralMock.addressCount);
+  TEST_ASSERT_EQUAL_UINT16(0, sensorsBus.queueDepth);
+
+  // Not restarted again too soon
+  i2cPeripheralMock.now += 1000;
+  i2cdrvCheckTimeout(&sensorsBus);
+  TEST_ASSERT_EQUAL_INT(1, i2cPeripheralMock.restarts);
+
+  // The device lets go of the bus, a later restart frees it
+  i2cPeripheralMock.isBusHeld = false;
+  i2cPeripheralMock.now += 500 * 1000 + 1;
+  i2cdrvCheckTimeout(&sensorsBus);
+  runPendingEventInterrupt();
+  TEST_ASSERT_EQUAL_INT(2, i2cPeripheralMock.restarts);
+  TEST_ASSERT_FALSE(sensorsBus.isHung);
+  TEST_ASSERT_EQUAL_UINT16(1, sensorsBus.nbrOfHungRestarts);
+
+  i2cdrvCreateMessage(&messagesC[0], 0x40, i2cWrite, 1, bufferC);
+  i2cdrvTransactionSubmit(&sensorsBus, &transactionC);
+  transferWrite(1);
+  TEST_ASSERT_TRUE(transactionC.isSuccessful);
+}
+
+void testThatStopThatIsNeverGeneratedFailsTheNextTransactionWithinTheWaitBound() {
+  // Fixture
+  i2cdrvTransactionSubmit(&sensorsBus, &transactionA);
+  i2cdrvTransactionSubmit(&sensorsBus, &transactionB);
+  event(I2C_SR1_SB, 0);
+  event(I2C_SR1_ADDR, 0);
+  event(I2C_SR1_TXE, 0);
+  i2cPeripheralMock.isBusHeld = true;
+  const uint64_t start = i2cPeripheralMock.now;
+
+  // Test
+  event(I2C_SR1_BTF, I2C_SR2_TRA);
+  const uint64_t waitTime = i2cPeripheralMock.now - start;
+  runPendingEventInterrupt();
+
+  // Assert
+  TEST_ASSERT_TRUE(transactionA.isSuccessful);
+  TEST_ASSERT_TRUE(transactionB.isDone);
+  TEST_ASSERT_FALSE(transactionB.isSuccessful);
+  TEST_ASSERT_EQUAL(i2cNack, messagesB[0].status);
+  TEST_ASSERT_TRUE(sensorsBus.isHung);
+  TEST_ASSERT_LESS_OR_EQUAL(110, waitTime);
+}
+
+void testThatBlockingTransferReturnsWhenTheMessageIsAcked() {
+  // Fixture
+  onWaitForBus = transferBlockingWrite;
+
+  // Test
+  const bool actual = i2cdrvMessageTransfer(&sensorsBus, &messagesA[0]);
+
+  // Assert
+  TEST_ASSERT_TRUE(actual);
+  TEST_ASSERT_EQUAL_INT(1, i2cPeripheralMock.dataCount);
+  TEST_ASSERT_EQUAL_UINT16(0, sensorsBus.queueDepth);
+}
+
+void testThatBlockingTransferFailsOnHangedBus() {
+  // Fixture
+  onWaitForBus = runPendingEventInterrupt;
+
+  // Test
+  const bool actual = i2cdrvMessageTransfer(&sensorsBus, &messagesA[0]);
+
+  // Assert
+  TEST_ASSERT_FALSE(actual);
+  TEST_ASSERT_EQUAL(i2cNack, messagesA[0].status);
+  TEST_ASSERT_EQUAL_UINT16(1, sensorsBus.nbrOfTimeouts);
+  TEST_ASSERT_EQUAL_UINT16(0, sensorsBus.queueDepth);
+}
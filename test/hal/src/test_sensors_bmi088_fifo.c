@@ -0,0 +1,166 @@
+// File under test sensors_bmi088_fifo.c
+#include "sensors_bmi088_fifo.h"
+
+#include <string.h>
+
+#include "unity.h"
+
+#define MAX_SAMPLES 8
+
+static Axis3i16 samples[MAX_SAMPLES];
+
+static uint32_t writeAxes(uint8_t* data, int16_t x, int16_t y, int16_t z) {
+  data[0] = x & 0xFF;
+  data[1] = (x >> 8) & 0xFF;
+  data[2] = y & 0xFF;
+  data[3] = (y >> 8) & 0xFF;
+  data[4] = z & 0xFF;
+  data[5] = (z >> 8) & 0xFF;
+  return 6;
+}
+
+static uint32_t writeAccelFrame(uint8_t* data, uint8_t header, int16_t x, int16_t y, int16_t z) {
+  data[0] = header;
+  return 1 + writeAxes(&data[1], x, y, z);
+}
+
+void setUp(void) {
+  memset(samples, 0, sizeof(samples));
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testThatGyroFramesAreParsed(void) {
+  // Fixture
+  uint8_t data[2 * SENSORS_BMI088_FIFO_GYRO_FRAME_LENGTH];
+  uint32_t length = writeAxes(&data[0], 1, -2, 300);
+  length += writeAxes(&data[length], -32768, 32767, 0);
+
+  // Test
+  uint32_t actual = sensorsBmi088FifoParseGyro(data, length, samples, MAX_SAMPLES);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT32(2, actual);
+  TEST_ASSERT_EQUAL_INT16(1, samples[0].x);
+  TEST_ASSERT_EQUAL_INT16(-2, samples[0].y);
+  TEST_ASSERT_EQUAL_INT16(300, samples[0].z);
+  TEST_ASSERT_EQUAL_INT16(-32768, samples[1].x);
+  TEST_ASSERT_EQUAL_INT16(32767, samples[1].y);
+  TEST_ASSERT_EQUAL_INT16(0, samples[1].z);
+}
+
+void testThatIncompleteGyroFrameIsIgnored(void) {
+  // Fixture
+  uint8_t data[2 * SENSORS_BMI088_FIFO_GYRO_FRAME_LENGTH];
+  uint32_t length = writeAxes(&data[0], 1, 2, 3);
+  length += writeAxes(&data[length], 4, 5, 6);
+
+  // Test
+  uint32_t actual = sensorsBmi088FifoParseGyro(data, length - 1, samples, MAX_SAMPLES);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT32(1, actual);
+}
+
+void testThatGyroParsingStopsAtMaxSamples(void) {
+  // Fixture
+  uint8_t data[3 * SENSORS_BMI088_FIFO_GYRO_FRAME_LENGTH] = {0};
+
+  // Test
+  uint32_t actual = sensorsBmi088FifoParseGyro(data, sizeof(data), samples, 2);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT32(2, actual);
+}
+
+void testThatAccelDataFramesAreParsed(void) {
+  // Fixture
+  uint8_t data[32];
+  uint32_t length = writeAccelFrame(&data[0], 0x84, 10, 20, -30);
+  // Data frame with interrupt tags
+  length += writeAccelFrame(&data[length], 0x87, 40, 50, 60);
+
+  // Test
+  uint32_t actual = sensorsBmi088FifoParseAccel(data, length, samples, MAX_SAMPLES);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT32(2, actual);
+  TEST_ASSERT_EQUAL_INT16(10, samples[0].x);
+  TEST_ASSERT_EQUAL_INT16(20, samples[0].y);
+  TEST_ASSERT_EQUAL_INT16(-30, samples[0].z);
+  TEST_ASSERT_EQUAL_INT16(40, samples[1].x);
+  TEST_ASSERT_EQUAL_INT16(60, samples[1].z);
+}
+
+void testThatOtherAccelFramesAreSkipped(void) {
+  // Fixture
+  uint8_t data[32];
+  uint32_t length = 0;
+  // Skip frame
+  data[length++] = 0x40;
+  data[length++] = 0x01;
+  // Configuration change frame
+  data[length++] = 0x48;
+  data[length++] = 0x00;
+  length += writeAccelFrame(&data[length], 0x84, 1, 2, 3);
+  // Sensor time frame
+  data[length++] = 0x44;
+  data[length++] = 0x11;
+  data[length++] = 0x22;
+  data[length++] = 0x33;
+  length += writeAccelFrame(&data[length], 0x84, 4, 5, 6);
+
+  // Test
+  uint32_t actual = sensorsBmi088FifoParseAccel(data, length, samples, MAX_SAMPLES);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT32(2, actual);
+  TEST_ASSERT_EQUAL_INT16(1, samples[0].x);
+  TEST_ASSERT_EQUAL_INT16(4, samples[1].x);
+}
+
+void testThatAccelParsingStopsAtOverRead(void) {
+  // Fixture
+  uint8_t data[32];
+  uint32_t length = writeAccelFrame(&data[0], 0x84, 1, 2, 3);
+  data[length++] = 0x80;
+  data[length++] = 0x00;
+  length += writeAccelFrame(&data[length], 0x84, 4, 5, 6);
+
+  // Test
+  uint32_t actual = sensorsBmi088FifoParseAccel(data, length, samples, MAX_SAMPLES);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT32(1, actual);
+}
+
+void testThatIncompleteAccelFrameIsIgnored(void) {
+  // Fixture
+  uint8_t data[32];
+  uint32_t length = writeAccelFrame(&data[0], 0x84, 1, 2, 3);
+  length += writeAccelFrame(&data[length], 0x84, 4, 5, 6);
+
+  // Test
+  uint32_t actual = sensorsBmi088FifoParseAccel(data, length - 1, samples, MAX_SAMPLES);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT32(1, actual);
+}
+
+void testThatSampleTimesAreReconstructedAroundTheReference(void) {
+  // Fixture
+  const uint64_t referenceTime = 1000000;
+  const uint32_t period = 500;
+
+  // Test
+  uint64_t before = sensorsBmi088FifoSampleTime(referenceTime, 1, 0, period);
+  uint64_t reference = sensorsBmi088FifoSampleTime(referenceTime, 1, 1, period);
+  uint64_t after = sensorsBmi088FifoSampleTime(referenceTime, 1, 3, period);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT64(999500, before);
+  TEST_ASSERT_EQUAL_UINT64(1000000, reference);
+  TEST_ASSERT_EQUAL_UINT64(1001000, after);
+}
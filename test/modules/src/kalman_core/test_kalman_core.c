@@ -0,0 +1,639 @@
+// File under test kalman_core.c
+#include "kalman_core.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+
+#include "physicalConstants.h"
+
+#include "mock_cfassert.h"
+
+// Build the arm dsp math lib and use the "real thing" instead of mocking calls to it
+// @BUILD_LIB ARM_DSP_MATH
+
+static kalmanCoreData_t this;
+static kalmanCoreParams_t params;
+
+static float P0[KC_STATE_DIM][KC_STATE_DIM];
+static float A[KC_STATE_DIM][KC_STATE_DIM];
+static float expectedP[KC_STATE_DIM][KC_STATE_DIM];
+
+// Helpers
+static float randomFloat(float min, float max);
+static void fixtureRandomSymmetricCovariance(kalmanCoreData_t* data);
+static void fixtureAttitude(kalmanCoreData_t* data, float roll, float pitch, float yaw);
+static void fixtureScaleCovariance(kalmanCoreData_t* data, float scale);
+static void sequentialReferenceUpdate(kalmanCoreData_t* data, const kalmanCoreData_t* before, arm_matrix_instance_f32* H, float error, float stdMeasNoise);
+static void fixturePredictionJacobian(const kalmanCoreData_t* data, const Axis3f* gyro, float dt);
+static void fixtureFinalizationJacobian(const kalmanCoreData_t* data);
+static void denseCovarianceUpdate(float P[KC_STATE_DIM][KC_STATE_DIM]);
+static void assertCovarianceEqualWithinTolerance(const float expected[KC_STATE_DIM][KC_STATE_DIM], const float actual[KC_STATE_DIM][KC_STATE_DIM]);
+
+void setUp(void) {
+  srand(4711);
+
+  kalmanCoreDefaultParams(&params);
+  kalmanCoreInit(&this, &params);
+
+  memset(A, 0, sizeof(A));
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testThatPredictionCovarianceMatchesDensePropagationWhenFlying() {
+  // Fixture
+  fixtureAttitude(&this, 0.1f, -0.2f, 0.7f);
+  this.S[KC_STATE_PX] = 0.5f;
+  this.S[KC_STATE_PY] = -0.3f;
+  this.S[KC_STATE_PZ] = 0.2f;
+  fixtureRandomSymmetricCovariance(&this);
+
+  Axis3f acc = {.x = 0.1f, .y = -0.2f, .z = 9.9f};
+  Axis3f gyro = {.x = 0.3f, .y = -0.5f, .z = 1.2f};
+  float dt = 0.01f;
+
+  fixturePredictionJacobian(&this, &gyro, dt);
+  memcpy(expectedP, P0, sizeof(expectedP));
+  denseCovarianceUpdate(expectedP);
+
+  // Test
+  kalmanCorePredict(&this, &acc, &gyro, dt, true);
+
+  // Assert
+  assertCovarianceEqualWithinTolerance(expectedP, this.P);
+}
+
+void testThatPredictionCovarianceMatchesDensePropagationWhenNotFlying() {
+  // Fixture
+  fixtureAttitude(&this, -0.4f, 0.3f, -2.0f);
+  this.S[KC_STATE_PX] = -1.5f;
+  this.S[KC_STATE_PY] = 2.3f;
+  this.S[KC_STATE_PZ] = -0.7f;
+  fixtureRandomSymmetricCovariance(&this);
+
+  Axis3f acc = {.x = 1.1f, .y = 0.4f, .z = 8.1f};
+  Axis3f gyro = {.x = -2.3f, .y = 1.5f, .z = -0.2f};
+  float dt = 0.002f;
+
+  fixturePredictionJacobian(&this, &gyro, dt);
+  memcpy(expectedP, P0, sizeof(expectedP));
+  denseCovarianceUpdate(expectedP);
+
+  // Test
+  kalmanCorePredict(&this, &acc, &gyro, dt, false);
+
+  // Assert
+  assertCovarianceEqualWithinTolerance(expectedP, this.P);
+}
+
+void testThatPredictionKeepsCovarianceSymmetric() {
+  // Fixture
+  fixtureAttitude(&this, 0.2f, 0.1f, 0.3f);
+  this.S[KC_STATE_PX] = 0.5f;
+  fixtureRandomSymmetricCovariance(&this);
+
+  Axis3f acc = {.x = 0.0f, .y = 0.0f, .z = 9.81f};
+  Axis3f gyro = {.x = 0.1f, .y = 0.2f, .z = 0.3f};
+
+  // Test
+  kalmanCorePredict(&this, &acc, &gyro, 0.01f, true);
+
+  // Assert
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    for (int j = 0; j < KC_STATE_DIM; j++) {
+      TEST_ASSERT_EQUAL_FLOAT(this.P[i][j], this.P[j][i]);
+    }
+  }
+}
+
+void testThatStatePredictionDoesNotChangeCovariance() {
+  // Fixture
+  fixtureAttitude(&this, 0.1f, -0.2f, 0.7f);
+  this.S[KC_STATE_PX] = 0.5f;
+  fixtureRandomSymmetricCovariance(&this);
+
+  Axis3f acc = {.x = 0.1f, .y = -0.2f, .z = 9.9f};
+  Axis3f gyro = {.x = 0.3f, .y = -0.5f, .z = 1.2f};
+
+  // Test
+  kalmanCorePredictState(&this, &acc, &gyro, 0.001f, true);
+
+  // Assert
+  assertCovarianceEqualWithinTolerance((const float (*)[KC_STATE_DIM])P0, this.P);
+  TEST_ASSERT_FLOAT_WITHIN(1e-2f, 0.5f, this.S[KC_STATE_PX]);
+  TEST_ASSERT_TRUE(this.S[KC_STATE_X] != 0.0f);
+}
+
+void testThatFinalizeCovarianceMatchesDensePropagation() {
+  // Fixture
+  fixtureAttitude(&this, 0.1f, 0.2f, -0.3f);
+  fixtureRandomSymmetricCovariance(&this);
+  this.S[KC_STATE_D0] = 0.01f;
+  this.S[KC_STATE_D1] = -0.02f;
+  this.S[KC_STATE_D2] = 0.03f;
+
+  fixtureFinalizationJacobian(&this);
+  memcpy(expectedP, P0, sizeof(expectedP));
+  denseCovarianceUpdate(expectedP);
+
+  // Test
+  kalmanCoreFinalize(&this, 0);
+
+  // Assert
+  assertCovarianceEqualWithinTolerance(expectedP, this.P);
+}
+
+void testThatFinalizeDoesNotChangeCovarianceForSmallAttitudeError() {
+  // Fixture
+  fixtureAttitude(&this, 0.1f, 0.2f, -0.3f);
+  fixtureRandomSymmetricCovariance(&this);
+  this.S[KC_STATE_D0] = 0.00001f;
+
+  // Test
+  kalmanCoreFinalize(&this, 0);
+
+  // Assert
+  assertCovarianceEqualWithinTolerance((const float (*)[KC_STATE_DIM])P0, this.P);
+}
+
+void testThatBatchUpdateMatchesSequentialScalarUpdates() {
+  // Fixture
+  const int measurements = 8;
+  kalmanCoreBatch_t batch;
+  kalmanCoreBatchInit(&batch);
+
+  fixtureRandomSymmetricCovariance(&this);
+  kalmanCoreData_t sequential;
+  memcpy(&sequential, &this, sizeof(sequential));
+  sequential.Pm.pData = (float*)sequential.P;
+
+  for (int m = 0; m < measurements; m++) {
+    float h[KC_STATE_DIM];
+    for (int i = 0; i < KC_STATE_DIM; i++) {
+      h[i] = randomFloat(-1.0f, 1.0f);
+    }
+    arm_matrix_instance_f32 H = {1, KC_STATE_DIM, h};
+    float error = randomFloat(-0.1f, 0.1f);
+    float stdMeasNoise = randomFloat(0.1f, 1.0f);
+
+    kalmanCoreBatchAdd(&batch, &H, error, stdMeasNoise);
+
+    // Measurements are linear, the error is relative to the state before the first update
+    float hx0 = 0.0f;
+    float hx = 0.0f;
+    for (int i = 0; i < KC_STATE_DIM; i++) {
+      hx0 += h[i] * this.S[i];
+      hx += h[i] * sequential.S[i];
+    }
+    kalmanCoreScalarUpdate(&sequential, &H, error + hx0 - hx, stdMeasNoise);
+  }
+
+  // Test
+  kalmanCoreBatchUpdate(&this, &batch);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(0, batch.count);
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, sequential.S[i], this.S[i]);
+  }
+  assertCovarianceEqualWithinTolerance((const float (*)[KC_STATE_DIM])sequential.P, this.P);
+}
+
+void testThatBatchUpdateMatchesSequentialScalarUpdatesWithLighthouseNoise() {
+  // Fixture
+  // Sweep angles of the sensors on the deck are close to linearly dependent and have a noise far below the
+  // uncertainty of a converged filter
+  const int measurements = 8;
+  const float stdMeasNoise = 0.0004f;
+  kalmanCoreBatch_t batch;
+  kalmanCoreBatchInit(&batch);
+
+  fixtureRandomSymmetricCovariance(&this);
+  fixtureScaleCovariance(&this, 1e-5f);
+  kalmanCoreData_t sequential;
+  memcpy(&sequential, &this, sizeof(sequential));
+  sequential.Pm.pData = (float*)sequential.P;
+
+  float hBase[KC_STATE_DIM] = {0};
+  hBase[KC_STATE_X] = randomFloat(-1.0f, 1.0f);
+  hBase[KC_STATE_Y] = randomFloat(-1.0f, 1.0f);
+  hBase[KC_STATE_Z] = randomFloat(-1.0f, 1.0f);
+
+  for (int m = 0; m < measurements; m++) {
+    float h[KC_STATE_DIM];
+    for (int i = 0; i < KC_STATE_DIM; i++) {
+      h[i] = hBase[i] + randomFloat(-0.05f, 0.05f);
+    }
+    arm_matrix_instance_f32 H = {1, KC_STATE_DIM, h};
+    float error = randomFloat(-0.001f, 0.001f);
+
+    kalmanCoreBatchAdd(&batch, &H, error, stdMeasNoise);
+    sequentialReferenceUpdate(&sequential, &this, &H, error, stdMeasNoise);
+  }
+
+  // Test
+  kalmanCoreBatchUpdate(&this, &batch);
+
+  // Assert
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, sequential.S[i], this.S[i]);
+  }
+}
+
+void testThatBatchUpdateOfDependentMeasurementsDoesNotReapplyCorrections() {
+  // Fixture
+  // The same measurement twice with a tiny noise, the factorization fails and sequential updates are used
+  const float stdMeasNoise = 0.0003f;
+  const float error = 0.1f;
+  kalmanCoreBatch_t batch;
+  kalmanCoreBatchInit(&batch);
+
+  fixtureRandomSymmetricCovariance(&this);
+  kalmanCoreData_t sequential;
+  memcpy(&sequential, &this, sizeof(sequential));
+  sequential.Pm.pData = (float*)sequential.P;
+
+  float h[KC_STATE_DIM] = {0};
+  h[KC_STATE_X] = 1.0f;
+  arm_matrix_instance_f32 H = {1, KC_STATE_DIM, h};
+
+  for (int m = 0; m < 2; m++) {
+    kalmanCoreBatchAdd(&batch, &H, error, stdMeasNoise);
+    sequentialReferenceUpdate(&sequential, &this, &H, error, stdMeasNoise);
+  }
+
+  // Test
+  kalmanCoreBatchUpdate(&this, &batch);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(0, batch.count);
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, error, this.S[KC_STATE_X]);
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, sequential.S[i], this.S[i]);
+  }
+}
+
+void testThatBatchAddFailsWhenBatchIsFull() {
+  // Fixture
+  kalmanCoreBatch_t batch;
+  kalmanCoreBatchInit(&batch);
+
+  float h[KC_STATE_DIM] = {0};
+  h[KC_STATE_X] = 1.0f;
+  arm_matrix_instance_f32 H = {1, KC_STATE_DIM, h};
+
+  for (int i = 0; i < KC_MAX_BATCH_SIZE; i++) {
+    TEST_ASSERT_TRUE(kalmanCoreBatchAdd(&batch, &H, 0.1f, 0.5f));
+  }
+
+  // Test
+  bool actual = kalmanCoreBatchAdd(&batch, &H, 0.1f, 0.5f);
+
+  // Assert
+  TEST_ASSERT_FALSE(actual);
+  TEST_ASSERT_EQUAL_INT(KC_MAX_BATCH_SIZE, batch.count);
+}
+
+void testThatEmptyBatchUpdateDoesNotChangeTheState() {
+  // Fixture
+  kalmanCoreBatch_t batch;
+  kalmanCoreBatchInit(&batch);
+  fixtureRandomSymmetricCovariance(&this);
+  this.S[KC_STATE_X] = 1.0f;
+
+  // Test
+  kalmanCoreBatchUpdate(&this, &batch);
+
+  // Assert
+  TEST_ASSERT_EQUAL_FLOAT(1.0f, this.S[KC_STATE_X]);
+  assertCovarianceEqualWithinTolerance((const float (*)[KC_STATE_DIM])P0, this.P);
+}
+
+void testThatRetrodictionIsNotStartedForMeasurementAfterLatestPrediction() {
+  // Fixture
+  kalmanCoreHistory_t history;
+  kalmanCoreHistoryInit(&history);
+  kalmanCoreRetrodiction_t retrodiction;
+  Axis3f acc = {.x = 0.0f, .y = 0.0f, .z = GRAVITY_MAGNITUDE};
+  Axis3f gyro = {.x = 0.0f, .y = 0.0f, .z = 0.0f};
+  this.S[KC_STATE_PX] = 1.0f;
+  kalmanCorePredictWithHistory(&this, &history, &acc, &gyro, 0.01f, true, 10000);
+  float expectedX = this.S[KC_STATE_X];
+
+  // Test
+  bool actual = kalmanCoreRetrodictionStart(&this, &history, 10000, &retrodiction);
+
+  // Assert
+  TEST_ASSERT_FALSE(actual);
+  TEST_ASSERT_FALSE(retrodiction.isActive);
+  TEST_ASSERT_EQUAL_FLOAT(expectedX, this.S[KC_STATE_X]);
+}
+
+void testThatRetrodictionIsNotStartedWithoutHistory() {
+  // Fixture
+  kalmanCoreHistory_t history;
+  kalmanCoreHistoryInit(&history);
+  kalmanCoreRetrodiction_t retrodiction;
+
+  // Test
+  bool actual = kalmanCoreRetrodictionStart(&this, &history, 10000, &retrodiction);
+
+  // Assert
+  TEST_ASSERT_FALSE(actual);
+}
+
+void testThatRetrodictedStateMatchesStateAtTimeOfMeasurement() {
+  // Fixture
+  kalmanCoreHistory_t history;
+  kalmanCoreHistoryInit(&history);
+  kalmanCoreRetrodiction_t retrodiction;
+  fixtureAttitude(&this, 0.1f, -0.2f, 0.7f);
+  this.S[KC_STATE_PX] = 0.5f;
+  this.S[KC_STATE_PY] = -0.3f;
+
+  Axis3f acc = {.x = 0.3f, .y = -0.2f, .z = 9.9f};
+  Axis3f gyro = {.x = 0.3f, .y = -0.5f, .z = 1.2f};
+
+  float expectedS[KC_STATE_DIM];
+  float expectedQ[4];
+  for (int i = 1; i <= 10; i++) {
+    kalmanCorePredictWithHistory(&this, &history, &acc, &gyro, 0.01f, true, i * 10000);
+    if (i == 4) {
+      memcpy(expectedS, this.S, sizeof(expectedS));
+      memcpy(expectedQ, this.q, sizeof(expectedQ));
+    }
+  }
+
+  // Test
+  bool actual = kalmanCoreRetrodictionStart(&this, &history, 40000, &retrodiction);
+
+  // Assert
+  TEST_ASSERT_TRUE(actual);
+  for (int i = 0; i < KC_STATE_D0; i++) {
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, expectedS[i], this.S[i]);
+  }
+  for (int i = 0; i < 4; i++) {
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, expectedQ[i], this.q[i]);
+  }
+}
+
+void testThatRetrodictionInterpolatesWithinPrediction() {
+  // Fixture
+  kalmanCoreHistory_t history;
+  kalmanCoreHistoryInit(&history);
+  kalmanCoreRetrodiction_t retrodiction;
+  Axis3f acc = {.x = 0.0f, .y = 0.0f, .z = GRAVITY_MAGNITUDE};
+  Axis3f gyro = {.x = 0.0f, .y = 0.0f, .z = 0.0f};
+  this.S[KC_STATE_PX] = 1.0f;
+  kalmanCorePredictWithHistory(&this, &history, &acc, &gyro, 0.01f, true, 10000);
+  kalmanCorePredictWithHistory(&this, &history, &acc, &gyro, 0.01f, true, 20000);
+
+  // Test
+  kalmanCoreRetrodictionStart(&this, &history, 15000, &retrodiction);
+
+  // Assert
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, 0.015f, this.S[KC_STATE_X]);
+}
+
+void testThatHistoryCoversItsDurationAtHighPredictionRates() {
+  // Fixture
+  kalmanCoreHistory_t history;
+  kalmanCoreHistoryInit(&history);
+  kalmanCoreRetrodiction_t retrodiction;
+  fixtureAttitude(&this, 0.1f, -0.2f, 0.7f);
+  this.S[KC_STATE_PX] = 0.5f;
+
+  Axis3f acc = {.x = 0.3f, .y = -0.2f, .z = 9.9f};
+  Axis3f gyro = {.x = 0.3f, .y = -0.5f, .z = 1.2f};
+
+  // Predictions at 1 kHz, the measurement is older than KC_HISTORY_LENGTH predictions
+  const int measurementTime = 50000;
+  const int predictionCount = KC_HISTORY_DURATION_US / 1000;
+  float expectedS[KC_STATE_DIM];
+  float expectedQ[4];
+  for (int i = 1; i <= predictionCount; i++) {
+    kalmanCorePredictWithHistory(&this, &history, &acc, &gyro, 0.001f, true, i * 1000);
+    if (i * 1000 == measurementTime) {
+      memcpy(expectedS, this.S, sizeof(expectedS));
+      memcpy(expectedQ, this.q, sizeof(expectedQ));
+    }
+  }
+
+  // Test
+  bool actual = kalmanCoreRetrodictionStart(&this, &history, measurementTime, &retrodiction);
+
+  // Assert
+  TEST_ASSERT_TRUE(actual);
+  TEST_ASSERT_EQUAL_INT(KC_HISTORY_LENGTH, history.count);
+  for (int i = 0; i < KC_STATE_D0; i++) {
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, expectedS[i], this.S[i]);
+  }
+  for (int i = 0; i < 4; i++) {
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, expectedQ[i], this.q[i]);
+  }
+}
+
+void testThatRetrodictionEndRestoresCurrentStateWithCorrection() {
+  // Fixture
+  kalmanCoreHistory_t history;
+  kalmanCoreHistoryInit(&history);
+  kalmanCoreRetrodiction_t retrodiction;
+  fixtureAttitude(&this, 0.1f, -0.2f, 0.7f);
+  this.S[KC_STATE_PX] = 0.5f;
+
+  Axis3f acc = {.x = 0.3f, .y = -0.2f, .z = 9.9f};
+  Axis3f gyro = {.x = 0.3f, .y = -0.5f, .z = 1.2f};
+  for (int i = 1; i <= 5; i++) {
+    kalmanCorePredictWithHistory(&this, &history, &acc, &gyro, 0.01f, true, i * 10000);
+  }
+
+  kalmanCoreData_t expected;
+  memcpy(&expected, &this, sizeof(expected));
+
+  kalmanCoreRetrodictionStart(&this, &history, 20000, &retrodiction);
+
+  // A measurement update of the retrodicted state
+  this.S[KC_STATE_X] += 0.1f;
+  this.S[KC_STATE_PY] -= 0.2f;
+  this.S[KC_STATE_D2] += 0.05f;
+
+  // Test
+  kalmanCoreRetrodictionEnd(&this, &retrodiction);
+
+  // Assert
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, expected.S[KC_STATE_X] + 0.1f, this.S[KC_STATE_X]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, expected.S[KC_STATE_Y], this.S[KC_STATE_Y]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, expected.S[KC_STATE_PY] - 0.2f, this.S[KC_STATE_PY]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, 0.05f, this.S[KC_STATE_D2]);
+  TEST_ASSERT_EQUAL_FLOAT_ARRAY(expected.q, this.q, 4);
+  TEST_ASSERT_EQUAL_FLOAT_ARRAY((float*)expected.R, (float*)this.R, 9);
+}
+
+// Helpers ////////////////////////////////////////////////////////////////
+
+static float randomFloat(float min, float max) {
+  return min + (max - min) * ((float)rand() / (float)RAND_MAX);
+}
+
+// Creates a symmetric, positive definite, covariance matrix as L L' and stores a copy in P0
+static void fixtureRandomSymmetricCovariance(kalmanCoreData_t* data) {
+  float L[KC_STATE_DIM][KC_STATE_DIM] = {0};
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    for (int j = 0; j <= i; j++) {
+      L[i][j] = randomFloat(-0.5f, 0.5f);
+    }
+    L[i][i] += 1.0f;
+  }
+
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    for (int j = 0; j < KC_STATE_DIM; j++) {
+      float sum = 0.0f;
+      for (int k = 0; k < KC_STATE_DIM; k++) {
+        sum += L[i][k] * L[j][k];
+      }
+      data->P[i][j] = sum;
+    }
+  }
+
+  memcpy(P0, data->P, sizeof(P0));
+}
+
+static void fixtureScaleCovariance(kalmanCoreData_t* data, float scale) {
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    for (int j = 0; j < KC_STATE_DIM; j++) {
+      data->P[i][j] *= scale;
+    }
+  }
+
+  memcpy(P0, data->P, sizeof(P0));
+}
+
+// Scalar update of a linear measurement, where the error is relative to the state before the first update
+static void sequentialReferenceUpdate(kalmanCoreData_t* data, const kalmanCoreData_t* before, arm_matrix_instance_f32* H, float error, float stdMeasNoise) {
+  float hx0 = 0.0f;
+  float hx = 0.0f;
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    hx0 += H->pData[i] * before->S[i];
+    hx += H->pData[i] * data->S[i];
+  }
+  kalmanCoreScalarUpdate(data, H, error + hx0 - hx, stdMeasNoise);
+}
+
+static void fixtureAttitude(kalmanCoreData_t* data, float roll, float pitch, float yaw) {
+  float cr = cosf(roll / 2), sr = sinf(roll / 2);
+  float cp = cosf(pitch / 2), sp = sinf(pitch / 2);
+  float cy = cosf(yaw / 2), sy = sinf(yaw / 2);
+
+  float* q = data->q;
+  q[0] = cr * cp * cy + sr * sp * sy;
+  q[1] = sr * cp * cy - cr * sp * sy;
+  q[2] = cr * sp * cy + sr * cp * sy;
+  q[3] = cr * cp * sy - sr * sp * cy;
+
+  data->R[0][0] = q[0] * q[0] + q[1] * q[1] - q[2] * q[2] - q[3] * q[3];
+  data->R[0][1] = 2 * q[1] * q[2] - 2 * q[0] * q[3];
+  data->R[0][2] = 2 * q[1] * q[3] + 2 * q[0] * q[2];
+  data->R[1][0] = 2 * q[1] * q[2] + 2 * q[0] * q[3];
+  data->R[1][1] = q[0] * q[0] - q[1] * q[1] + q[2] * q[2] - q[3] * q[3];
+  data->R[1][2] = 2 * q[2] * q[3] - 2 * q[0] * q[1];
+  data->R[2][0] = 2 * q[1] * q[3] - 2 * q[0] * q[2];
+  data->R[2][1] = 2 * q[2] * q[3] + 2 * q[0] * q[1];
+  data->R[2][2] = q[0] * q[0] - q[1] * q[1] - q[2] * q[2] + q[3] * q[3];
+}
+
+static void fixtureAttitudeErrorRotation(float d0, float d1, float d2) {
+  A[KC_STATE_D0][KC_STATE_D0] =  1 - d1*d1/2 - d2*d2/2;
+  A[KC_STATE_D0][KC_STATE_D1] =  d2 + d0*d1/2;
+  A[KC_STATE_D0][KC_STATE_D2] = -d1 + d0*d2/2;
+
+  A[KC_STATE_D1][KC_STATE_D0] = -d2 + d0*d1/2;
+  A[KC_STATE_D1][KC_STATE_D1] =  1 - d0*d0/2 - d2*d2/2;
+  A[KC_STATE_D1][KC_STATE_D2] =  d0 + d1*d2/2;
+
+  A[KC_STATE_D2][KC_STATE_D0] =  d1 + d0*d2/2;
+  A[KC_STATE_D2][KC_STATE_D1] = -d0 + d1*d2/2;
+  A[KC_STATE_D2][KC_STATE_D2] = 1 - d0*d0/2 - d1*d1/2;
+}
+
+// The full, dense, linearized dynamics as used by kalmanCorePredict()
+static void fixturePredictionJacobian(const kalmanCoreData_t* data, const Axis3f* gyro, float dt) {
+  const float (*R)[3] = data->R;
+  const float* S = data->S;
+  const float g = GRAVITY_MAGNITUDE;
+
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    A[i][i] = 1;
+  }
+
+  for (int i = 0; i < 3; i++) {
+    A[KC_STATE_X + i][KC_STATE_PX] = R[i][0] * dt;
+    A[KC_STATE_X + i][KC_STATE_PY] = R[i][1] * dt;
+    A[KC_STATE_X + i][KC_STATE_PZ] = R[i][2] * dt;
+
+    A[KC_STATE_X + i][KC_STATE_D0] = (S[KC_STATE_PY] * R[i][2] - S[KC_STATE_PZ] * R[i][1]) * dt;
+    A[KC_STATE_X + i][KC_STATE_D1] = (- S[KC_STATE_PX] * R[i][2] + S[KC_STATE_PZ] * R[i][0]) * dt;
+    A[KC_STATE_X + i][KC_STATE_D2] = (S[KC_STATE_PX] * R[i][1] - S[KC_STATE_PY] * R[i][0]) * dt;
+  }
+
+  A[KC_STATE_PY][KC_STATE_PX] = -gyro->z * dt;
+  A[KC_STATE_PZ][KC_STATE_PX] = gyro->y * dt;
+  A[KC_STATE_PX][KC_STATE_PY] = gyro->z * dt;
+  A[KC_STATE_PZ][KC_STATE_PY] = -gyro->x * dt;
+  A[KC_STATE_PX][KC_STATE_PZ] = -gyro->y * dt;
+  A[KC_STATE_PY][KC_STATE_PZ] = gyro->x * dt;
+
+  A[KC_STATE_PY][KC_STATE_D0] = -g * R[2][2] * dt;
+  A[KC_STATE_PZ][KC_STATE_D0] =  g * R[2][1] * dt;
+  A[KC_STATE_PX][KC_STATE_D1] =  g * R[2][2] * dt;
+  A[KC_STATE_PZ][KC_STATE_D1] = -g * R[2][0] * dt;
+  A[KC_STATE_PX][KC_STATE_D2] = -g * R[2][1] * dt;
+  A[KC_STATE_PY][KC_STATE_D2] =  g * R[2][0] * dt;
+
+  fixtureAttitudeErrorRotation(gyro->x * dt / 2, gyro->y * dt / 2, gyro->z * dt / 2);
+}
+
+// The full, dense, attitude error rotation as used by kalmanCoreFinalize()
+static void fixtureFinalizationJacobian(const kalmanCoreData_t* data) {
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    A[i][i] = 1;
+  }
+
+  fixtureAttitudeErrorRotation(data->S[KC_STATE_D0] / 2, data->S[KC_STATE_D1] / 2, data->S[KC_STATE_D2] / 2);
+}
+
+// Reference implementation, P = A P A' using plain dense matrix multiplications
+static void denseCovarianceUpdate(float P[KC_STATE_DIM][KC_STATE_DIM]) {
+  float AP[KC_STATE_DIM][KC_STATE_DIM];
+
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    for (int j = 0; j < KC_STATE_DIM; j++) {
+      float sum = 0.0f;
+      for (int k = 0; k < KC_STATE_DIM; k++) {
+        sum += A[i][k] * P[k][j];
+      }
+      AP[i][j] = sum;
+    }
+  }
+
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    for (int j = 0; j < KC_STATE_DIM; j++) {
+      float sum = 0.0f;
+      for (int k = 0; k < KC_STATE_DIM; k++) {
+        sum += AP[i][k] * A[j][k];
+      }
+      P[i][j] = sum;
+    }
+  }
+}
+
+static void assertCovarianceEqualWithinTolerance(const float expected[KC_STATE_DIM][KC_STATE_DIM], const float actual[KC_STATE_DIM][KC_STATE_DIM]) {
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    for (int j = 0; j < KC_STATE_DIM; j++) {
+      float tolerance = 1e-5f + 1e-5f * fabsf(expected[i][j]);
+      TEST_ASSERT_FLOAT_WITHIN(tolerance, expected[i][j], actual[i][j]);
+    }
+  }
+}
@@ -17,6 +17,7 @@
 #include "mock_cfassert.h"
 #include "mock_crtp_localization_service.h"
 #include "mock_lighthouse_storage.h"
+#include "mock_usec_time.h"
 
 #include <stdbool.h>
 
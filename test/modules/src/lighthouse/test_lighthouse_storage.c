@@ -74,6 +74,41 @@ void testThatFailedCalibDataWriteToStorageReturnsFailure() {
   TEST_ASSERT_FALSE(actual);
 }
 
+static bool storageStoreBatchMockFunc(const storageItem_t* items, size_t count, int cmock_num_calls) {
+  TEST_ASSERT_EQUAL(3, count);
+  TEST_ASSERT_EQUAL_STRING("lh/sys/0/geo/0", items[0].key);
+  TEST_ASSERT_EQUAL_PTR(&lighthouseCoreState.bsGeometry[0], items[0].buffer);
+  TEST_ASSERT_EQUAL(sizeof(baseStationGeometry_t), items[0].length);
+  TEST_ASSERT_EQUAL_STRING("lh/sys/0/geo/1", items[1].key);
+  TEST_ASSERT_EQUAL_STRING("lh/sys/0/cal/1", items[2].key);
+  TEST_ASSERT_EQUAL_PTR(&lighthouseCoreState.bsCalibration[1], items[2].buffer);
+  TEST_ASSERT_EQUAL(sizeof(lighthouseCalibration_t), items[2].length);
+
+  return true;
+}
+
+void testThatDataForBaseStationsIsWrittenToStorageInOneBatch() {
+  // Fixture
+  storageStoreBatch_StubWithCallback(storageStoreBatchMockFunc);
+
+  // Test
+  bool actual = lighthouseStoragePersistDataForBaseStations(0x0003, 0x0002);
+
+  // Actual
+  TEST_ASSERT_TRUE(actual);
+}
+
+void testThatFailedBatchWriteToStorageReturnsFailure() {
+  // Fixture
+  storageStoreBatch_IgnoreAndReturn(false);
+
+  // Test
+  bool actual = lighthouseStoragePersistDataForBaseStations(0x0003, 0x0002);
+
+  // Actual
+  TEST_ASSERT_FALSE(actual);
+}
+
 void testThatNoInitializationOfGeoIsDoneWhenStorageIsEmpty() {
   // Fixture
   storageFetch_IgnoreAndReturn(0);
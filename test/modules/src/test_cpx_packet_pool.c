@@ -0,0 +1,213 @@
+// File under test cpx_packet_pool.c
+#include "cpx_packet_pool.h"
+
+#include <string.h>
+
+#include "unity.h"
+#include "mock_cfassert.h"
+#include "mock_usec_time.h"
+
+#include "FreeRTOS.h"
+#include "queue.h"
+
+// Fakes of the FreeRTOS queues the pool keeps its free packets in, the
+// reserve for receiving and the packets for sending
+typedef struct {
+  void* items[CPX_PACKET_POOL_SIZE];
+  int length;
+  int count;
+  int head;
+} fakeQueue_t;
+
+static fakeQueue_t freeQueues[2];
+static int freeQueuesCreated;
+
+// Called when the pool waits for a free packet, stands in for the task that releases one
+static void (*onWaitForPacket)(void);
+
+QueueHandle_t xQueueGenericCreateStatic(const UBaseType_t uxQueueLength, const UBaseType_t uxItemSize, uint8_t* pucQueueStorage, StaticQueue_t* pxStaticQueue, const uint8_t ucQueueType) {
+  TEST_ASSERT_TRUE(freeQueuesCreated < 2);
+  TEST_ASSERT_EQUAL(sizeof(void*), uxItemSize);
+  fakeQueue_t* queue = &freeQueues[freeQueuesCreated++];
+  queue->length = uxQueueLength;
+  return (QueueHandle_t)queue;
+}
+
+BaseType_t xQueueGenericSend(QueueHandle_t xQueue, const void* const pvItemToQueue, TickType_t xTicksToWait, const BaseType_t xCopyPosition) {
+  fakeQueue_t* queue = (fakeQueue_t*)xQueue;
+  TEST_ASSERT_TRUE_MESSAGE(queue->count < queue->length, "More packets returned than allocated");
+  memcpy(&queue->items[(queue->head + queue->count) % queue->length], pvItemToQueue, sizeof(void*));
+  queue->count++;
+  return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t xQueue, void* const pvBuffer, TickType_t xTicksToWait) {
+  fakeQueue_t* queue = (fakeQueue_t*)xQueue;
+  if (queue->count == 0 && xTicksToWait == portMAX_DELAY && onWaitForPacket) {
+    onWaitForPacket();
+  }
+  TEST_ASSERT_TRUE_MESSAGE(queue->count > 0, "Waiting for a packet that is never released");
+
+  memcpy(pvBuffer, &queue->items[queue->head], sizeof(void*));
+  queue->head = (queue->head + 1) % queue->length;
+  queue->count--;
+  return pdTRUE;
+}
+
+static int freeCount() {
+  return freeQueues[0].count + freeQueues[1].count;
+}
+
+void vPortEnterCritical(void) {}
+void vPortExitCritical(void) {}
+
+static CPXRoutablePacket_t* allocated[CPX_PACKET_POOL_SIZE];
+static int allocatedCount;
+
+static void allocateAll() {
+  for (int i = 0; i < CPX_PACKET_POOL_TX; i++) {
+    allocated[allocatedCount++] = cpxPacketPoolAllocate();
+  }
+}
+
+static void allocateAllRx() {
+  for (int i = 0; i < CPX_PACKET_POOL_RX_RESERVED; i++) {
+    allocated[allocatedCount++] = cpxPacketPoolAllocateRx();
+  }
+}
+
+static void releaseAllAllocated() {
+  for (int i = 0; i < allocatedCount; i++) {
+    cpxPacketPoolRelease(allocated[i]);
+  }
+}
+
+static void releaseFirstAllocated() {
+  cpxPacketPoolRelease(allocated[0]);
+}
+
+void setUp(void) {
+  usecTimestamp_IgnoreAndReturn(0);
+  onWaitForPacket = 0;
+  allocatedCount = 0;
+
+  // The pool is only initialized once, the tests return all packets when done
+  cpxPacketPoolInit();
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testThatReserveFitsFullReceiveQueuesAndTheRouter() {
+  // Fixture
+  const int expected = 2 * CPX_INTERNAL_ROUTER_QUEUE_LENGTH + 1;
+
+  // Test
+  // Assert
+  TEST_ASSERT_TRUE(CPX_PACKET_POOL_RX_RESERVED >= expected);
+}
+
+void testThatTxPacketsFitFullSendQueuesAndAllHolders() {
+  // Fixture
+  const int expected = CPX_INTERNAL_ROUTER_QUEUE_LENGTH + CPX_UART_TRANSPORT_TX_QUEUE_LENGTH + 2;
+
+  // Test
+  // Assert
+  TEST_ASSERT_TRUE(CPX_PACKET_POOL_TX >= expected);
+}
+
+void testThatAllPacketsCanBeAllocatedAndAreDistinct() {
+  // Fixture
+  // Test
+  allocateAll();
+  allocateAllRx();
+
+  // Assert
+  TEST_ASSERT_EQUAL(CPX_PACKET_POOL_SIZE, allocatedCount);
+  for (int i = 0; i < CPX_PACKET_POOL_SIZE; i++) {
+    TEST_ASSERT_NOT_NULL(allocated[i]);
+    for (int j = 0; j < i; j++) {
+      TEST_ASSERT_TRUE(allocated[i] != allocated[j]);
+    }
+  }
+
+  releaseAllAllocated();
+}
+
+void testThatReleasedPacketIsAllocatedAgain() {
+  // Fixture
+  allocateAll();
+  CPXRoutablePacket_t* expected = allocated[5];
+  cpxPacketPoolRelease(expected);
+
+  // Test
+  CPXRoutablePacket_t* actual = cpxPacketPoolAllocate();
+
+  // Assert
+  TEST_ASSERT_EQUAL_PTR(expected, actual);
+
+  releaseAllAllocated();
+}
+
+void testThatAllocationFromExhaustedPoolWaitsForRelease() {
+  // Fixture
+  allocateAll();
+  onWaitForPacket = releaseFirstAllocated;
+
+  // Test
+  CPXRoutablePacket_t* actual = cpxPacketPoolAllocate();
+
+  // Assert
+  TEST_ASSERT_EQUAL_PTR(allocated[0], actual);
+
+  releaseAllAllocated();
+}
+
+void testThatReceivingDoesNotWaitWhenSendersHaveUsedAllTxPackets() {
+  // Fixture
+  allocateAll();
+
+  // Test
+  // Fails in the fake queue if it waits, no packet is released
+  allocateAllRx();
+
+  // Assert
+  TEST_ASSERT_EQUAL(CPX_PACKET_POOL_SIZE, allocatedCount);
+
+  releaseAllAllocated();
+}
+
+void testThatReleasedReceivedPacketIsReturnedToTheReserve() {
+  // Fixture
+  allocateAllRx();
+  CPXRoutablePacket_t* expected = allocated[2];
+  cpxPacketPoolRelease(expected);
+  allocateAll();
+
+  // Test
+  CPXRoutablePacket_t* actual = cpxPacketPoolAllocateRx();
+
+  // Assert
+  TEST_ASSERT_EQUAL_PTR(expected, actual);
+
+  releaseAllAllocated();
+}
+
+void testThatReleasingPacketTwiceAsserts() {
+  // Fixture
+  CPXRoutablePacket_t* packet = cpxPacketPoolAllocate();
+  cpxPacketPoolRelease(packet);
+
+  assertFail_Expect("", "", 0);
+  assertFail_IgnoreArg_exp();
+  assertFail_IgnoreArg_file();
+  assertFail_IgnoreArg_line();
+
+  // Test
+  cpxPacketPoolRelease(packet);
+
+  // Assert
+  // Mock automatically validated after test, the packet is not returned to the pool twice
+  TEST_ASSERT_EQUAL(CPX_PACKET_POOL_SIZE, freeCount());
+}
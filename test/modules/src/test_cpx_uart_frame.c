@@ -0,0 +1,188 @@
+// File under test cpx_uart_frame.c
+#include "cpx_uart_frame.h"
+
+#include <string.h>
+
+#include "unity.h"
+
+#define BUFFER_SIZE 64
+
+static uint8_t buffer[BUFFER_SIZE];
+static cpxUartFrame_t frame;
+
+static uint8_t referenceChecksum(const uint8_t* data, uint32_t length) {
+  uint8_t checksum = 0;
+  for (uint32_t i = 0; i < length; i++) {
+    checksum ^= data[i];
+  }
+  return checksum;
+}
+
+// Writes a frame at index in the circular buffer, returns the frame length
+static uint32_t writeFrame(uint32_t index, const uint8_t* payload, uint8_t payloadLength) {
+  uint8_t frameData[BUFFER_SIZE];
+  frameData[0] = CPX_UART_FRAME_START;
+  frameData[1] = payloadLength;
+  memcpy(&frameData[2], payload, payloadLength);
+  uint32_t length = CPX_UART_FRAME_HEADER_LENGTH + payloadLength;
+  frameData[length] = referenceChecksum(frameData, length);
+  length += CPX_UART_FRAME_CHECKSUM_LENGTH;
+
+  for (uint32_t i = 0; i < length; i++) {
+    buffer[(index + i) % BUFFER_SIZE] = frameData[i];
+  }
+  return length;
+}
+
+void setUp(void) {
+  memset(buffer, 0, sizeof(buffer));
+  memset(&frame, 0, sizeof(frame));
+}
+
+void tearDown(void) {}
+
+void testThatChecksumIsEqualToByteWiseXorForAllAlignmentsAndLengths() {
+  // Fixture
+  uint8_t data[40];
+  for (int i = 0; i < (int)sizeof(data); i++) {
+    data[i] = (uint8_t)(i * 37 + 11);
+  }
+
+  for (int offset = 0; offset < 4; offset++) {
+    for (int length = 0; length <= (int)sizeof(data) - offset; length++) {
+      // Test
+      uint8_t actual = cpxUartChecksum(&data[offset], length, 0);
+
+      // Assert
+      TEST_ASSERT_EQUAL_UINT8(referenceChecksum(&data[offset], length), actual);
+    }
+  }
+}
+
+void testThatChecksumCanBeChained() {
+  // Fixture
+  const uint8_t data[] = {0xFF, 12, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+  uint8_t expected = referenceChecksum(data, sizeof(data));
+
+  // Test
+  uint8_t actual = cpxUartChecksum(&data[5], sizeof(data) - 5, cpxUartChecksum(data, 5, 0));
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT8(expected, actual);
+}
+
+void testThatPacketIsParsed() {
+  // Fixture
+  const uint8_t payload[] = {0x12, 0x34, 0x56, 0x78, 0x9a};
+  uint32_t length = writeFrame(0, payload, sizeof(payload));
+
+  // Test
+  cpxUartFrameResult_t actual = cpxUartFrameParse(buffer, BUFFER_SIZE, 0, length, &frame);
+
+  // Assert
+  TEST_ASSERT_EQUAL(cpxUartFramePacket, actual);
+  TEST_ASSERT_EQUAL_UINT32(2, frame.payloadIndex);
+  TEST_ASSERT_EQUAL_UINT8(sizeof(payload), frame.payloadLength);
+  TEST_ASSERT_EQUAL_UINT32(length, frame.consumed);
+}
+
+void testThatPacketWrappingTheEndOfTheBufferIsParsedAndCopied() {
+  // Fixture
+  uint8_t payload[20];
+  for (int i = 0; i < (int)sizeof(payload); i++) {
+    payload[i] = (uint8_t)(i + 1);
+  }
+  const uint32_t index = BUFFER_SIZE - 7;
+  uint32_t length = writeFrame(index, payload, sizeof(payload));
+  uint8_t copied[sizeof(payload)];
+
+  // Test
+  cpxUartFrameResult_t actual = cpxUartFrameParse(buffer, BUFFER_SIZE, index, length, &frame);
+  cpxUartFrameCopy(copied, buffer, BUFFER_SIZE, frame.payloadIndex, frame.payloadLength);
+
+  // Assert
+  TEST_ASSERT_EQUAL(cpxUartFramePacket, actual);
+  TEST_ASSERT_EQUAL_UINT32(BUFFER_SIZE - 5, frame.payloadIndex);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(payload, copied, sizeof(payload));
+}
+
+void testThatClearToSendIsParsed() {
+  // Fixture
+  buffer[0] = CPX_UART_FRAME_START;
+  buffer[1] = 0;
+
+  // Test
+  cpxUartFrameResult_t actual = cpxUartFrameParse(buffer, BUFFER_SIZE, 0, 2, &frame);
+
+  // Assert
+  TEST_ASSERT_EQUAL(cpxUartFrameClearToSend, actual);
+  TEST_ASSERT_EQUAL_UINT32(2, frame.consumed);
+}
+
+void testThatIncompletePacketIsNotParsed() {
+  // Fixture
+  const uint8_t payload[] = {1, 2, 3};
+  uint32_t length = writeFrame(0, payload, sizeof(payload));
+
+  // Test
+  cpxUartFrameResult_t actual = cpxUartFrameParse(buffer, BUFFER_SIZE, 0, length - 1, &frame);
+
+  // Assert
+  TEST_ASSERT_EQUAL(cpxUartFrameIncomplete, actual);
+  TEST_ASSERT_EQUAL_UINT32(0, frame.consumed);
+}
+
+void testThatGarbageBeforeStartIsConsumed() {
+  // Fixture
+  buffer[0] = 0x12;
+  buffer[1] = 0x34;
+  const uint8_t payload[] = {1, 2, 3};
+  uint32_t length = writeFrame(2, payload, sizeof(payload));
+
+  // Test
+  cpxUartFrameResult_t incomplete = cpxUartFrameParse(buffer, BUFFER_SIZE, 0, 3, &frame);
+  uint32_t consumedWhenIncomplete = frame.consumed;
+  cpxUartFrameResult_t actual = cpxUartFrameParse(buffer, BUFFER_SIZE, 0, 2 + length, &frame);
+
+  // Assert
+  TEST_ASSERT_EQUAL(cpxUartFrameIncomplete, incomplete);
+  TEST_ASSERT_EQUAL_UINT32(2, consumedWhenIncomplete);
+  TEST_ASSERT_EQUAL(cpxUartFramePacket, actual);
+  TEST_ASSERT_EQUAL_UINT32(2 + length, frame.consumed);
+}
+
+void testThatCorruptPacketIsConsumedWithBadChecksum() {
+  // Fixture
+  const uint8_t payload[] = {1, 2, 3, 4};
+  uint32_t length = writeFrame(0, payload, sizeof(payload));
+  buffer[3] ^= 0x40;
+
+  // Test
+  cpxUartFrameResult_t actual = cpxUartFrameParse(buffer, BUFFER_SIZE, 0, length, &frame);
+
+  // Assert
+  TEST_ASSERT_EQUAL(cpxUartFrameBadChecksum, actual);
+  TEST_ASSERT_EQUAL_UINT32(1, frame.consumed);
+}
+
+void testThatFrameAfterCorruptLengthIsFound() {
+  // Fixture
+  const uint8_t payload[] = {1, 2, 3, 5};
+  uint32_t length = writeFrame(0, payload, sizeof(payload));
+  // The length claims more data than the frame has, the checksum is then
+  // read from the zeroed buffer after the next frame
+  buffer[1] = 12;
+  const uint32_t nextFrameIndex = length;
+  length += writeFrame(nextFrameIndex, payload, sizeof(payload));
+  length += 10;
+
+  // Test
+  cpxUartFrameResult_t first = cpxUartFrameParse(buffer, BUFFER_SIZE, 0, length, &frame);
+  uint32_t index = frame.consumed;
+  cpxUartFrameResult_t second = cpxUartFrameParse(buffer, BUFFER_SIZE, index, length - index, &frame);
+
+  // Assert
+  TEST_ASSERT_EQUAL(cpxUartFrameBadChecksum, first);
+  TEST_ASSERT_EQUAL(cpxUartFramePacket, second);
+  TEST_ASSERT_EQUAL_UINT32(nextFrameIndex + 2, frame.payloadIndex);
+}
@@ -0,0 +1,208 @@
+// File under test crtp_frame.c
+#include "crtp_frame.h"
+
+#include <string.h>
+
+#include "unity.h"
+
+#define USB_FRAME_SIZE 64
+#define CPX_FRAME_SIZE 98
+
+static uint8_t buffer[128];
+static crtpFrame_t frame;
+
+// Unpacks a frame the way the client does, returns the number of packets or -1 if the frame is malformed
+static int unpackFrame(const uint8_t* data, uint32_t length, CRTPPacket* packets, int maxPackets) {
+  if (length < CRTP_FRAME_HEADER_SIZE || data[0] != CRTP_NULL_PACKET_HEADER || data[1] != CRTP_LINK_CTRL_FRAME) {
+    return -1;
+  }
+
+  int count = 0;
+  uint32_t offset = CRTP_FRAME_HEADER_SIZE;
+  while (offset < length) {
+    const uint8_t packetLength = data[offset++];
+    if (packetLength < 1 || packetLength > CRTP_MAX_DATA_SIZE + 1 || offset + packetLength > length || count >= maxPackets) {
+      return -1;
+    }
+
+    memset(&packets[count], 0, sizeof(CRTPPacket));
+    packets[count].size = packetLength - 1;
+    memcpy(packets[count].raw, &data[offset], packetLength);
+    offset += packetLength;
+    count++;
+  }
+
+  return count;
+}
+
+static CRTPPacket makePacket(uint8_t port, uint8_t channel, uint8_t size, uint8_t seed) {
+  CRTPPacket p;
+  memset(&p, 0, sizeof(p));
+  p.header = CRTP_HEADER(port, channel);
+  p.size = size;
+  for (int i = 0; i < size; i++) {
+    p.data[i] = seed + i;
+  }
+
+  return p;
+}
+
+static void assertPacketsEqual(const CRTPPacket* expected, const CRTPPacket* actual) {
+  TEST_ASSERT_EQUAL_UINT8(expected->header, actual->header);
+  TEST_ASSERT_EQUAL_UINT8(expected->size, actual->size);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expected->data, actual->data, expected->size);
+}
+
+void setUp(void) {
+  memset(buffer, 0xAA, sizeof(buffer));
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testThatEmptyFrameHasOnlyTheHeader() {
+  // Fixture
+  // Test
+  crtpFrameInit(&frame, buffer, USB_FRAME_SIZE);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT32(CRTP_FRAME_HEADER_SIZE, frame.length);
+  TEST_ASSERT_EQUAL_UINT32(0, frame.packetCount);
+  TEST_ASSERT_EQUAL_UINT8(CRTP_NULL_PACKET_HEADER, buffer[0]);
+  TEST_ASSERT_EQUAL_UINT8(CRTP_LINK_CTRL_FRAME, buffer[1]);
+}
+
+void testThatPacketIsWrittenWithLengthHeaderAndData() {
+  // Fixture
+  crtpFrameInit(&frame, buffer, USB_FRAME_SIZE);
+  CRTPPacket p = makePacket(CRTP_PORT_LOG, 2, 3, 10);
+
+  // Test
+  bool actual = crtpFrameAdd(&frame, &p);
+
+  // Assert
+  TEST_ASSERT_TRUE(actual);
+  TEST_ASSERT_EQUAL_UINT32(CRTP_FRAME_HEADER_SIZE + CRTP_FRAME_PACKET_SIZE(3), frame.length);
+  const uint8_t expected[] = {CRTP_NULL_PACKET_HEADER, CRTP_LINK_CTRL_FRAME, 4, CRTP_HEADER(CRTP_PORT_LOG, 2), 10, 11, 12};
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, buffer, sizeof(expected));
+}
+
+void testThatEmptyPacketIsPacked() {
+  // Fixture
+  crtpFrameInit(&frame, buffer, USB_FRAME_SIZE);
+  CRTPPacket p = makePacket(CRTP_PORT_LINK, 0, 0, 0);
+  CRTPPacket unpacked[1];
+
+  // Test
+  crtpFrameAdd(&frame, &p);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(1, unpackFrame(buffer, frame.length, unpacked, 1));
+  assertPacketsEqual(&p, &unpacked[0]);
+}
+
+void testThatPacketsAreUnpackedInOrder() {
+  // Fixture
+  crtpFrameInit(&frame, buffer, CPX_FRAME_SIZE);
+  CRTPPacket packets[] = {
+    makePacket(CRTP_PORT_LOG, 2, 30, 0),
+    makePacket(CRTP_PORT_CONSOLE, 0, 7, 100),
+    makePacket(CRTP_PORT_PARAM, 1, 12, 200),
+  };
+  CRTPPacket unpacked[3];
+
+  // Test
+  for (int i = 0; i < 3; i++) {
+    TEST_ASSERT_TRUE(crtpFrameAdd(&frame, &packets[i]));
+  }
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(3, unpackFrame(buffer, frame.length, unpacked, 3));
+  TEST_ASSERT_EQUAL_UINT32(3, frame.packetCount);
+  for (int i = 0; i < 3; i++) {
+    assertPacketsEqual(&packets[i], &unpacked[i]);
+  }
+}
+
+void testThatPacketThatDoesNotFitIsRejectedAndFrameIsUnchanged() {
+  // Fixture
+  crtpFrameInit(&frame, buffer, USB_FRAME_SIZE);
+  CRTPPacket full = makePacket(CRTP_PORT_LOG, 2, CRTP_MAX_DATA_SIZE, 0);
+  crtpFrameAdd(&frame, &full);
+  uint8_t before[sizeof(buffer)];
+  memcpy(before, buffer, sizeof(buffer));
+
+  // Test
+  bool actual = crtpFrameAdd(&frame, &full);
+
+  // Assert
+  TEST_ASSERT_FALSE(actual);
+  TEST_ASSERT_EQUAL_UINT32(1, frame.packetCount);
+  TEST_ASSERT_EQUAL_UINT32(CRTP_FRAME_HEADER_SIZE + CRTP_FRAME_PACKET_SIZE(CRTP_MAX_DATA_SIZE), frame.length);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(before, buffer, sizeof(buffer));
+}
+
+void testThatFrameIsNeverLongerThanMaxSize() {
+  // Fixture
+  crtpFrameInit(&frame, buffer, USB_FRAME_SIZE);
+  CRTPPacket p = makePacket(CRTP_PORT_LOG, 2, 5, 0);
+
+  // Test
+  while (crtpFrameAdd(&frame, &p)) {
+  }
+
+  // Assert
+  TEST_ASSERT_TRUE(frame.length <= USB_FRAME_SIZE);
+  TEST_ASSERT_TRUE(frame.length + CRTP_FRAME_PACKET_SIZE(5) > USB_FRAME_SIZE);
+  TEST_ASSERT_EQUAL_UINT8(0xAA, buffer[USB_FRAME_SIZE]);
+}
+
+void testThatPacketFillingTheFrameExactlyIsAccepted() {
+  // Fixture
+  const uint32_t maxSize = CRTP_FRAME_HEADER_SIZE + CRTP_FRAME_PACKET_SIZE(10);
+  crtpFrameInit(&frame, buffer, maxSize);
+  CRTPPacket p = makePacket(CRTP_PORT_LOG, 2, 10, 0);
+
+  // Test
+  bool actual = crtpFrameAdd(&frame, &p);
+
+  // Assert
+  TEST_ASSERT_TRUE(actual);
+  TEST_ASSERT_EQUAL_UINT32(maxSize, frame.length);
+}
+
+void testThatUsbFrameHoldsOneFullSizePacket() {
+  // Fixture
+  crtpFrameInit(&frame, buffer, USB_FRAME_SIZE);
+  CRTPPacket full = makePacket(CRTP_PORT_LOG, 2, CRTP_MAX_DATA_SIZE, 0);
+
+  // Test
+  int count = 0;
+  while (crtpFrameAdd(&frame, &full)) {
+    count++;
+  }
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(1, count);
+}
+
+void testThatCpxFrameHoldsThreeFullSizePackets() {
+  // Fixture
+  crtpFrameInit(&frame, buffer, CPX_FRAME_SIZE);
+  CRTPPacket full = makePacket(CRTP_PORT_LOG, 2, CRTP_MAX_DATA_SIZE, 0);
+  CRTPPacket unpacked[3];
+
+  // Test
+  int count = 0;
+  while (crtpFrameAdd(&frame, &full)) {
+    count++;
+  }
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(3, count);
+  TEST_ASSERT_EQUAL_INT(3, unpackFrame(buffer, frame.length, unpacked, 3));
+  for (int i = 0; i < 3; i++) {
+    assertPacketsEqual(&full, &unpacked[i]);
+  }
+}
@@ -0,0 +1,106 @@
+// File under test crtp_tx_scheduler.c
+#include "crtp_tx_scheduler.h"
+
+#include <string.h>
+
+#include "unity.h"
+
+static const uint8_t weights[CRTP_TX_LANE_COUNT] = {4, 2, 1};
+static crtpTxScheduler_t scheduler;
+static uint32_t pending[CRTP_TX_LANE_COUNT];
+
+// Runs the scheduler for a number of packets and counts the packets sent per lane
+static void runScheduler(int packets, int sent[CRTP_TX_LANE_COUNT]) {
+  memset(sent, 0, sizeof(int) * CRTP_TX_LANE_COUNT);
+  for (int i = 0; i < packets; i++) {
+    int lane = crtpTxSchedulerNext(&scheduler, pending);
+    TEST_ASSERT_TRUE(lane >= 0);
+    sent[lane]++;
+  }
+}
+
+void setUp(void) {
+  crtpTxSchedulerInit(&scheduler, weights);
+  memset(pending, 0, sizeof(pending));
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testThatNoLaneIsPickedWhenAllLanesAreEmpty() {
+  // Fixture
+  // Test
+  int actual = crtpTxSchedulerNext(&scheduler, pending);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(-1, actual);
+}
+
+void testThatTheOnlyLaneWithPacketsIsPicked() {
+  // Fixture
+  pending[crtpTxLaneLow] = 100;
+  int sent[CRTP_TX_LANE_COUNT];
+
+  // Test
+  runScheduler(20, sent);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(20, sent[crtpTxLaneLow]);
+}
+
+void testThatTheHighLaneIsPickedFirst() {
+  // Fixture
+  pending[crtpTxLaneHigh] = 1;
+  pending[crtpTxLaneNormal] = 1;
+  pending[crtpTxLaneLow] = 1;
+
+  // Test
+  int actual = crtpTxSchedulerNext(&scheduler, pending);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(crtpTxLaneHigh, actual);
+}
+
+void testThatSaturatedLanesShareTheLinkByWeight() {
+  // Fixture
+  pending[crtpTxLaneHigh] = 1000;
+  pending[crtpTxLaneNormal] = 1000;
+  pending[crtpTxLaneLow] = 1000;
+  int sent[CRTP_TX_LANE_COUNT];
+
+  // Test
+  runScheduler(7 * 10, sent);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(40, sent[crtpTxLaneHigh]);
+  TEST_ASSERT_EQUAL_INT(20, sent[crtpTxLaneNormal]);
+  TEST_ASSERT_EQUAL_INT(10, sent[crtpTxLaneLow]);
+}
+
+void testThatTheLowLaneIsNotStarvedByTheHighLane() {
+  // Fixture
+  pending[crtpTxLaneHigh] = 1000;
+  pending[crtpTxLaneLow] = 1000;
+  int sent[CRTP_TX_LANE_COUNT];
+
+  // Test
+  runScheduler(5, sent);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(4, sent[crtpTxLaneHigh]);
+  TEST_ASSERT_EQUAL_INT(1, sent[crtpTxLaneLow]);
+}
+
+void testThatAHighPacketIsSentBeforeQueuedLowPacketsWhenCreditsRemain() {
+  // Fixture
+  pending[crtpTxLaneLow] = 1000;
+  crtpTxSchedulerNext(&scheduler, pending);
+  pending[crtpTxLaneHigh] = 1;
+
+  // Test
+  int actual = crtpTxSchedulerNext(&scheduler, pending);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(crtpTxLaneHigh, actual);
+}
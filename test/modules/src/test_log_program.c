@@ -0,0 +1,271 @@
+// File under test log_program.c
+#include "log_program.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "unity.h"
+#include "num.h"
+
+#define MAX_DATA_LENGTH 26
+#define PROGRAM_CAPACITY 26
+
+static logProgramOp_t ops[PROGRAM_CAPACITY];
+static logProgram_t program;
+static uint8_t data[MAX_DATA_LENGTH];
+static uint8_t expectedData[MAX_DATA_LENGTH];
+
+static const uint32_t timestamp = 4711;
+
+// The packing of log.c before log blocks were compiled, used as reference
+typedef struct {
+  const void* variable;
+  uint8_t storageType;
+  uint8_t logType;
+  bool isAcquiredByFunction;
+} referenceVariable_t;
+
+static int referencePack(const referenceVariable_t* variables, int count, uint8_t* dst) {
+  int size = 0;
+
+  for (int i = 0; i < count; i++) {
+    const referenceVariable_t* var = &variables[i];
+    const logByFunction_t* logByFunction = var->variable;
+    int valuei = 0;
+    float valuef = 0;
+
+    switch (var->storageType) {
+      case LOG_UINT8: { uint8_t v; if (var->isAcquiredByFunction) { v = logByFunction->acquireUInt8(timestamp, logByFunction->data); } else { memcpy(&v, var->variable, sizeof(v)); } valuei = v; break; }
+      case LOG_INT8: { int8_t v; if (var->isAcquiredByFunction) { v = logByFunction->acquireInt8(timestamp, logByFunction->data); } else { memcpy(&v, var->variable, sizeof(v)); } valuei = v; break; }
+      case LOG_UINT16: { uint16_t v; if (var->isAcquiredByFunction) { v = logByFunction->acquireUInt16(timestamp, logByFunction->data); } else { memcpy(&v, var->variable, sizeof(v)); } valuei = v; break; }
+      case LOG_INT16: { int16_t v; if (var->isAcquiredByFunction) { v = logByFunction->acquireInt16(timestamp, logByFunction->data); } else { memcpy(&v, var->variable, sizeof(v)); } valuei = v; break; }
+      case LOG_UINT32: { uint32_t v; if (var->isAcquiredByFunction) { v = logByFunction->acquireUInt32(timestamp, logByFunction->data); } else { memcpy(&v, var->variable, sizeof(v)); } valuei = v; break; }
+      case LOG_INT32: { int32_t v; if (var->isAcquiredByFunction) { v = logByFunction->acquireInt32(timestamp, logByFunction->data); } else { memcpy(&v, var->variable, sizeof(v)); } valuei = v; break; }
+      case LOG_FLOAT: { float v; if (var->isAcquiredByFunction) { v = logByFunction->aquireFloat(timestamp, logByFunction->data); } else { memcpy(&v, var->variable, sizeof(v)); } valuei = v; valuef = v; break; }
+    }
+
+    if (var->logType == LOG_FLOAT || var->logType == LOG_FP16) {
+      if (var->storageType != LOG_FLOAT) {
+        valuef = valuei;
+      }
+      if (var->logType == LOG_FLOAT) {
+        memcpy(&dst[size], &valuef, 4);
+        size += 4;
+      } else {
+        valuei = single2half(valuef);
+        memcpy(&dst[size], &valuei, 2);
+        size += 2;
+      }
+    } else {
+      memcpy(&dst[size], &valuei, logTypeLength[var->logType]);
+      size += logTypeLength[var->logType];
+    }
+  }
+
+  return size;
+}
+
+static void compile(const referenceVariable_t* variables, int count) {
+  for (int i = 0; i < count; i++) {
+    TEST_ASSERT_TRUE(logProgramAppend(&program, variables[i].variable, variables[i].storageType, variables[i].logType, variables[i].isAcquiredByFunction));
+  }
+}
+
+static void assertSameAsReference(const referenceVariable_t* variables, int count) {
+  memset(data, 0, sizeof(data));
+  memset(expectedData, 0, sizeof(expectedData));
+
+  const int expectedLength = referencePack(variables, count, expectedData);
+  logProgramRun(&program, data, timestamp);
+
+  TEST_ASSERT_EQUAL(expectedLength, program.dataLength);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expectedData, data, expectedLength);
+}
+
+static float acquireFloat(uint32_t timestamp, void* data) {
+  return timestamp + *(float*)data;
+}
+
+static int16_t acquireInt16(uint32_t timestamp, void* data) {
+  return -(int16_t)timestamp;
+}
+
+static struct {
+  float x;
+  float y;
+  float z;
+} position = {1.5f, -2.25f, 3.125f};
+
+static int32_t int32Value = -123456;
+static uint32_t uint32Value = 0xdeadbeef;
+static int16_t int16Value = -1234;
+static uint16_t uint16Value = 54321;
+static int8_t int8Value = -12;
+static uint8_t uint8Value = 250;
+static float floatValue = -47.11f;
+
+static const void* valueOfType(uint8_t type) {
+  switch (type) {
+    case LOG_UINT8: return &uint8Value;
+    case LOG_UINT16: return &uint16Value;
+    case LOG_UINT32: return &uint32Value;
+    case LOG_INT8: return &int8Value;
+    case LOG_INT16: return &int16Value;
+    case LOG_INT32: return &int32Value;
+    default: return &floatValue;
+  }
+}
+
+void setUp(void) {
+  logProgramInit(&program, ops, PROGRAM_CAPACITY, MAX_DATA_LENGTH);
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testThatAllTypeConversionsAreTheSameAsReference(void) {
+  for (uint8_t storageType = LOG_UINT8; storageType <= LOG_FLOAT; storageType++) {
+    for (uint8_t logType = LOG_UINT8; logType <= LOG_FP16; logType++) {
+      // Fixture
+      logProgramInit(&program, ops, PROGRAM_CAPACITY, MAX_DATA_LENGTH);
+      const referenceVariable_t variables[] = {
+        {valueOfType(storageType), storageType, logType, false},
+      };
+
+      // Test
+      compile(variables, 1);
+
+      // Assert
+      assertSameAsReference(variables, 1);
+    }
+  }
+}
+
+void testThatVariablesAcquiredByFunctionAreTheSameAsReference(void) {
+  // Fixture
+  float offset = 0.5f;
+  logByFunction_t floatFunction = {.aquireFloat = acquireFloat, .data = &offset};
+  logByFunction_t int16Function = {.acquireInt16 = acquireInt16, .data = 0};
+  const referenceVariable_t variables[] = {
+    {&floatFunction, LOG_FLOAT, LOG_FLOAT, true},
+    {&int16Function, LOG_INT16, LOG_INT16, true},
+    {&floatFunction, LOG_FLOAT, LOG_FP16, true},
+  };
+
+  // Test
+  compile(variables, 3);
+
+  // Assert
+  assertSameAsReference(variables, 3);
+  TEST_ASSERT_EQUAL(3, program.length);
+}
+
+void testThatAdjacentVariablesAreCopiedInOneOp(void) {
+  // Fixture
+  const referenceVariable_t variables[] = {
+    {&position.x, LOG_FLOAT, LOG_FLOAT, false},
+    {&position.y, LOG_FLOAT, LOG_FLOAT, false},
+    {&position.z, LOG_FLOAT, LOG_FLOAT, false},
+    {&int32Value, LOG_INT32, LOG_INT16, false},
+  };
+
+  // Test
+  compile(variables, 4);
+
+  // Assert
+  TEST_ASSERT_EQUAL(2, program.length);
+  TEST_ASSERT_EQUAL(logProgramOpCopy, ops[0].kind);
+  TEST_ASSERT_EQUAL(12, ops[0].size);
+  assertSameAsReference(variables, 4);
+}
+
+void testThatConvertedVariablesAreNotMerged(void) {
+  // Fixture
+  const referenceVariable_t variables[] = {
+    {&position.x, LOG_FLOAT, LOG_FLOAT, false},
+    {&position.y, LOG_FLOAT, LOG_FP16, false},
+    {&position.z, LOG_FLOAT, LOG_FLOAT, false},
+  };
+
+  // Test
+  compile(variables, 3);
+
+  // Assert
+  TEST_ASSERT_EQUAL(3, program.length);
+  assertSameAsReference(variables, 3);
+}
+
+void testThatAppendFailsWhenDataIsFull(void) {
+  // Fixture
+  for (int i = 0; i < MAX_DATA_LENGTH / 4; i++) {
+    logProgramAppend(&program, &floatValue, LOG_FLOAT, LOG_FLOAT, false);
+  }
+
+  // Test
+  bool actualFloat = logProgramAppend(&program, &floatValue, LOG_FLOAT, LOG_FLOAT, false);
+  bool actualInt16 = logProgramAppend(&program, &int16Value, LOG_INT16, LOG_INT16, false);
+  bool actualInt8 = logProgramAppend(&program, &int8Value, LOG_INT8, LOG_INT8, false);
+
+  // Assert
+  TEST_ASSERT_FALSE(actualFloat);
+  TEST_ASSERT_TRUE(actualInt16);
+  TEST_ASSERT_FALSE(actualInt8);
+  TEST_ASSERT_EQUAL(26, program.dataLength);
+}
+
+void testThatAppendFailsWhenProgramIsFull(void) {
+  // Fixture
+  logProgramInit(&program, ops, 2, MAX_DATA_LENGTH);
+  logProgramAppend(&program, &int8Value, LOG_INT8, LOG_FLOAT, false);
+  logProgramAppend(&program, &int8Value, LOG_INT8, LOG_FLOAT, false);
+
+  // Test
+  bool actual = logProgramAppend(&program, &int8Value, LOG_INT8, LOG_FLOAT, false);
+
+  // Assert
+  TEST_ASSERT_FALSE(actual);
+}
+
+#define BENCHMARK_BLOCKS 10
+#define BENCHMARK_RUNS 10000
+
+void testBenchmarkBlockPacking(void) {
+  // Fixture
+  // A typical block, a state estimate and a few converted variables
+  static struct {
+    float x, y, z, vx, vy, vz;
+  } state = {0.1f, 0.2f, 0.3f, 0.4f, 0.5f, 0.6f};
+  const referenceVariable_t variables[] = {
+    {&state.x, LOG_FLOAT, LOG_FLOAT, false},
+    {&state.y, LOG_FLOAT, LOG_FLOAT, false},
+    {&state.z, LOG_FLOAT, LOG_FLOAT, false},
+    {&state.vx, LOG_FLOAT, LOG_FP16, false},
+    {&state.vy, LOG_FLOAT, LOG_FP16, false},
+    {&state.vz, LOG_FLOAT, LOG_FP16, false},
+    {&uint16Value, LOG_UINT16, LOG_UINT16, false},
+    {&uint8Value, LOG_UINT8, LOG_UINT8, false},
+  };
+  const int count = sizeof(variables) / sizeof(variables[0]);
+  compile(variables, count);
+
+  // Test
+  clock_t start = clock();
+  for (int run = 0; run < BENCHMARK_RUNS * BENCHMARK_BLOCKS; run++) {
+    logProgramRun(&program, data, timestamp);
+  }
+  const double compiledTime = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+  start = clock();
+  for (int run = 0; run < BENCHMARK_RUNS * BENCHMARK_BLOCKS; run++) {
+    referencePack(variables, count, expectedData);
+  }
+  const double referenceTime = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+  // Assert
+  printf("Log block packing: %.1f ns per block compiled, %.1f ns per block interpreted\n",
+    1e9 * compiledTime / (BENCHMARK_RUNS * BENCHMARK_BLOCKS),
+    1e9 * referenceTime / (BENCHMARK_RUNS * BENCHMARK_BLOCKS));
+  assertSameAsReference(variables, count);
+}
@@ -5,6 +5,8 @@
 #include <string.h>
 #include <limits.h>
 #include <errno.h>
+#include <stdio.h>
+#include <time.h>
 
 #include "unity.h"
 
@@ -458,3 +460,142 @@ void testPersistentGetStateWithNonExistingParameter(void) {
   TEST_ASSERT_EQUAL_UINT8(testPk.size, replyPk.size);
   TEST_ASSERT_EQUAL_UINT8_ARRAY(&testPk.data[0], &replyPk.data[0], replyPk.size);
 }
+
+void testGetVarIdOfAllParams(void) {
+  // Fixture
+  const char* names[] = {"myUint8", "myUint16", "myUint32", "myInt8", "myInt16", "myInt32", "myFloat",
+    "myPersistent", "myPersistentFloat", "myShortPersistent"};
+
+  for (int i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++) {
+    // Test
+    paramVarId_t varid = paramGetVarId("myGroup", names[i]);
+
+    // Assert
+    TEST_ASSERT_TRUE(PARAM_VARID_IS_VALID(varid));
+    TEST_ASSERT_EQUAL_UINT16(i, varid.id);
+    TEST_ASSERT_EQUAL_UINT16(i + 1, varid.index);
+  }
+}
+
+void testGetVarIdOfUnknownParam(void) {
+  // Fixture
+  // Test
+  paramVarId_t unknownName = paramGetVarId("myGroup", "myUnknown");
+  paramVarId_t unknownGroup = paramGetVarId("myUnknownGroup", "myUint8");
+  paramVarId_t groupAsName = paramGetVarId("myUint8", "myGroup");
+
+  // Assert
+  TEST_ASSERT_FALSE(PARAM_VARID_IS_VALID(unknownName));
+  TEST_ASSERT_FALSE(PARAM_VARID_IS_VALID(unknownGroup));
+  TEST_ASSERT_FALSE(PARAM_VARID_IS_VALID(groupAsName));
+}
+
+void testGetVarIdFromComplete(void) {
+  // Fixture
+  // Test
+  paramVarId_t varid = paramGetVarIdFromComplete("myGroup.myInt16");
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT16(4, varid.id);
+}
+
+void testGetGroupAndName(void) {
+  // Fixture
+  char* group;
+  char* name;
+  paramVarId_t varid = paramGetVarId("myGroup", "myFloat");
+
+  // Test
+  paramGetGroupAndName(varid, &group, &name);
+
+  // Assert
+  TEST_ASSERT_EQUAL_STRING("myGroup", group);
+  TEST_ASSERT_EQUAL_STRING("myFloat", name);
+}
+
+// A table of the size of a full firmware build, 70 groups with 10 params each
+#define BENCHMARK_GROUPS 70
+#define BENCHMARK_PARAMS_PER_GROUP 10
+#define BENCHMARK_TABLE_LEN (BENCHMARK_GROUPS * (BENCHMARK_PARAMS_PER_GROUP + 2))
+#define BENCHMARK_RESTORED_PARAMS 100
+#define BENCHMARK_ITERATIONS 100
+
+static struct param_s benchmarkParams[BENCHMARK_TABLE_LEN];
+static char benchmarkNames[BENCHMARK_TABLE_LEN][16];
+static float benchmarkValue;
+
+static void fixtureBenchmarkParams() {
+  int index = 0;
+  for (int group = 0; group < BENCHMARK_GROUPS; group++) {
+    snprintf(benchmarkNames[index], sizeof(benchmarkNames[index]), "group%d", group);
+    benchmarkParams[index] = (struct param_s){.type = PARAM_GROUP | PARAM_START, .name = benchmarkNames[index]};
+    index++;
+
+    for (int param = 0; param < BENCHMARK_PARAMS_PER_GROUP; param++) {
+      // The same names in every group, like kp, ki and kd in the controllers
+      snprintf(benchmarkNames[index], sizeof(benchmarkNames[index]), "param%d", param);
+      benchmarkParams[index] = (struct param_s){.type = PARAM_FLOAT, .name = benchmarkNames[index], .address = &benchmarkValue};
+      index++;
+    }
+
+    snprintf(benchmarkNames[index], sizeof(benchmarkNames[index]), "stop_group%d", group);
+    benchmarkParams[index] = (struct param_s){.type = PARAM_GROUP | PARAM_STOP, .name = benchmarkNames[index]};
+    index++;
+  }
+
+  _param_start = benchmarkParams;
+  _param_stop = benchmarkParams + BENCHMARK_TABLE_LEN;
+  paramLogicInit();
+}
+
+void testGetVarIdOfAllParamsInLargeTable(void) {
+  // Fixture
+  fixtureBenchmarkParams();
+
+  char group[16];
+  char name[16];
+  for (int i = 0; i < BENCHMARK_GROUPS * BENCHMARK_PARAMS_PER_GROUP; i++) {
+    snprintf(group, sizeof(group), "group%d", i / BENCHMARK_PARAMS_PER_GROUP);
+    snprintf(name, sizeof(name), "param%d", i % BENCHMARK_PARAMS_PER_GROUP);
+
+    // Test
+    paramVarId_t varid = paramGetVarId(group, name);
+
+    // Assert
+    TEST_ASSERT_EQUAL_UINT16(i, varid.id);
+    TEST_ASSERT_EQUAL_STRING(name, benchmarkNames[varid.index]);
+  }
+}
+
+void testBenchmarkGetVarIdOfRestoredParams(void) {
+  // Fixture
+  fixtureBenchmarkParams();
+
+  // Restore the params at the end of the table, the worst case for a linear search
+  char completeNames[BENCHMARK_RESTORED_PARAMS][32];
+  const int firstId = BENCHMARK_GROUPS * BENCHMARK_PARAMS_PER_GROUP - BENCHMARK_RESTORED_PARAMS;
+  for (int i = 0; i < BENCHMARK_RESTORED_PARAMS; i++) {
+    const int id = firstId + i;
+    snprintf(completeNames[i], sizeof(completeNames[i]), "group%d.param%d",
+      id / BENCHMARK_PARAMS_PER_GROUP, id % BENCHMARK_PARAMS_PER_GROUP);
+  }
+
+  // Test
+  int found = 0;
+  const clock_t start = clock();
+  for (int iteration = 0; iteration < BENCHMARK_ITERATIONS; iteration++) {
+    for (int i = 0; i < BENCHMARK_RESTORED_PARAMS; i++) {
+      paramVarId_t varid = paramGetVarIdFromComplete(completeNames[i]);
+      if (varid.id == firstId + i) {
+        found++;
+      }
+    }
+  }
+  const clock_t stop = clock();
+
+  // Assert
+  printf("paramGetVarId: %.3f us per lookup in a table of %d params\n",
+    1e6 * (double)(stop - start) / CLOCKS_PER_SEC / (BENCHMARK_ITERATIONS * BENCHMARK_RESTORED_PARAMS),
+    BENCHMARK_GROUPS * BENCHMARK_PARAMS_PER_GROUP);
+  TEST_ASSERT_EQUAL_INT(BENCHMARK_ITERATIONS * BENCHMARK_RESTORED_PARAMS, found);
+}
@@ -0,0 +1,127 @@
+#include "i2cPeripheralMocks.h"
+
+#include <string.h>
+#include "unity.h"
+
+
+I2C_TypeDef i2cMockI2c1;
+I2C_TypeDef i2cMockI2c3;
+GPIO_TypeDef i2cMockGpio;
+DMA_Stream_TypeDef i2cMockDmaStream;
+
+i2cPeripheralMock_t i2cPeripheralMock;
+
+void i2cPeripheralMockReset(void) {
+  memset(&i2cPeripheralMock, 0, sizeof(i2cPeripheralMock));
+  memset(&i2cMockI2c1, 0, sizeof(i2cMockI2c1));
+  memset(&i2cMockI2c3, 0, sizeof(i2cMockI2c3));
+}
+
+
+// Time ///////////////////////////////////////////////////////////////////////
+
+// Each call takes 1 us, during which the peripheral generates the requested
+// start or stop condition, unless a device holds the bus
+uint64_t usecTimestamp(void) {
+  i2cPeripheralMock.now++;
+  if (!i2cPeripheralMock.isBusHeld) {
+    i2cMockI2c1.CR1 &= ~(I2C_CR1_START | I2C_CR1_STOP);
+    i2cMockI2c3.CR1 &= ~(I2C_CR1_START | I2C_CR1_STOP);
+  }
+  return i2cPeripheralMock.now;
+}
+
+
+// I2C ////////////////////////////////////////////////////////////////////////
+
+void I2C_DeInit(I2C_TypeDef* I2Cx) {
+  I2Cx->CR1 = 0;
+  I2Cx->SR1 = 0;
+  I2Cx->SR2 = 0;
+  i2cPeripheralMock.restarts++;
+}
+
+void I2C_Init(I2C_TypeDef* I2Cx, I2C_InitTypeDef* I2C_InitStruct) {}
+void I2C_ITConfig(I2C_TypeDef* I2Cx, uint16_t I2C_IT, FunctionalState NewState) {}
+void I2C_AcknowledgeConfig(I2C_TypeDef* I2Cx, FunctionalState NewState) {}
+void I2C_DMACmd(I2C_TypeDef* I2Cx, FunctionalState NewState) {}
+void I2C_DMALastTransferCmd(I2C_TypeDef* I2Cx, FunctionalState NewState) {}
+
+void I2C_Send7bitAddress(I2C_TypeDef* I2Cx, uint8_t Address, uint8_t I2C_Direction) {
+  TEST_ASSERT_TRUE(i2cPeripheralMock.addressCount < I2C_MOCK_MAX_BYTES);
+  i2cPeripheralMock.addresses[i2cPeripheralMock.addressCount++] = Address | I2C_Direction;
+}
+
+void I2C_SendData(I2C_TypeDef* I2Cx, uint8_t Data) {
+  TEST_ASSERT_TRUE(i2cPeripheralMock.dataCount < I2C_MOCK_MAX_BYTES);
+  i2cPeripheralMock.data[i2cPeripheralMock.dataCount++] = Data;
+}
+
+uint8_t I2C_ReceiveData(I2C_TypeDef* I2Cx) {
+  return 0;
+}
+
+FlagStatus I2C_GetFlagStatus(I2C_TypeDef* I2Cx, uint32_t I2C_FLAG) {
+  switch (I2C_FLAG) {
+    case I2C_FLAG_AF:
+      return i2cPeripheralMock.isAckFailure ? SET : RESET;
+    case I2C_FLAG_BUSY:
+      return i2cPeripheralMock.isBusHeld ? SET : RESET;
+    default:
+      return RESET;
+  }
+}
+
+void I2C_ClearFlag(I2C_TypeDef* I2Cx, uint32_t I2C_FLAG) {
+  if (I2C_FLAG == I2C_FLAG_AF) {
+    i2cPeripheralMock.isAckFailure = false;
+  }
+}
+
+
+// DMA ////////////////////////////////////////////////////////////////////////
+
+void DMA_Init(DMA_Stream_TypeDef* DMAy_Streamx, DMA_InitTypeDef* DMA_InitStruct) {}
+void DMA_Cmd(DMA_Stream_TypeDef* DMAy_Streamx, FunctionalState NewState) {}
+void DMA_ITConfig(DMA_Stream_TypeDef* DMAy_Streamx, uint32_t DMA_IT, FunctionalState NewState) {}
+
+FlagStatus DMA_GetFlagStatus(DMA_Stream_TypeDef* DMAy_Streamx, uint32_t DMA_FLAG) {
+  if (DMA_FLAG == DMA_FLAG_TCIF0 || DMA_FLAG == DMA_FLAG_TCIF2 || DMA_FLAG == DMA_FLAG_TCIF5) {
+    return i2cPeripheralMock.isDmaTransferComplete ? SET : RESET;
+  }
+  return RESET;
+}
+
+void DMA_ClearITPendingBit(DMA_Stream_TypeDef* DMAy_Streamx, uint32_t DMA_IT) {
+  if (DMA_IT == DMA_FLAG_TCIF0 || DMA_IT == DMA_FLAG_TCIF2 || DMA_IT == DMA_FLAG_TCIF5) {
+    i2cPeripheralMock.isDmaTransferComplete = false;
+  }
+}
+
+
+// GPIO, clocks and NVIC //////////////////////////////////////////////////////
+
+void RCC_AHB1PeriphClockCmd(uint32_t RCC_AHB1Periph, FunctionalState NewState) {}
+void RCC_APB1PeriphClockCmd(uint32_t RCC_APB1Periph, FunctionalState NewState) {}
+
+void GPIO_StructInit(GPIO_InitTypeDef* GPIO_InitStruct) {
+  memset(GPIO_InitStruct, 0, sizeof(GPIO_InitTypeDef));
+}
+
+void GPIO_Init(GPIO_TypeDef* GPIOx, GPIO_InitTypeDef* GPIO_InitStruct) {}
+void GPIO_PinAFConfig(GPIO_TypeDef* GPIOx, uint16_t GPIO_PinSource, uint8_t GPIO_AF) {}
+void GPIO_SetBits(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin) {}
+void GPIO_ResetBits(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin) {}
+
+// The lines always read high, a held bus only shows as the busy flag of the
+// peripheral. Otherwise the bus unlock would clock SCL forever.
+uint8_t GPIO_ReadInputDataBit(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin) {
+  return Bit_SET;
+}
+
+void NVIC_Init(NVIC_InitTypeDef* NVIC_InitStruct) {}
+
+void NVIC_SetPendingIRQ(IRQn_Type IRQn) {
+  TEST_ASSERT_TRUE(IRQn == I2C1_EV_IRQn || IRQn == I2C3_EV_IRQn);
+  i2cPeripheralMock.isEventInterruptPending = true;
+}
@@ -0,0 +1,221 @@
+#ifndef __I2C_PERIPHERAL_MOCKS_H__
+#define __I2C_PERIPHERAL_MOCKS_H__
+
+// Simulated I2C peripheral for the unit tests of i2c_drv.c. It stands in for
+// the parts of the ST peripheral library that the driver uses, and is included
+// by i2c_drv.h instead of stm32fxxx.h in unit tests.
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "FreeRTOS.h"
+
+typedef enum {RESET = 0, SET = !RESET} FlagStatus;
+typedef enum {DISABLE = 0, ENABLE = !DISABLE} FunctionalState;
+typedef enum {Bit_RESET = 0, Bit_SET} BitAction;
+typedef int IRQn_Type;
+
+typedef struct {
+  volatile uint16_t CR1;
+  volatile uint16_t SR1;
+  volatile uint16_t SR2;
+  volatile uint16_t DR;
+} I2C_TypeDef;
+
+typedef struct {
+  uint32_t dummy;
+} GPIO_TypeDef;
+
+typedef struct {
+  uint32_t dummy;
+} DMA_Stream_TypeDef;
+
+typedef struct {
+  uint32_t I2C_ClockSpeed;
+  uint16_t I2C_Mode;
+  uint16_t I2C_DutyCycle;
+  uint16_t I2C_OwnAddress1;
+  uint16_t I2C_Ack;
+  uint16_t I2C_AcknowledgedAddress;
+} I2C_InitTypeDef;
+
+typedef struct {
+  uint32_t GPIO_Pin;
+  uint32_t GPIO_Mode;
+  uint32_t GPIO_Speed;
+  uint32_t GPIO_OType;
+} GPIO_InitTypeDef;
+
+typedef struct {
+  uint8_t NVIC_IRQChannel;
+  uint8_t NVIC_IRQChannelPreemptionPriority;
+  uint8_t NVIC_IRQChannelSubPriority;
+  FunctionalState NVIC_IRQChannelCmd;
+} NVIC_InitTypeDef;
+
+typedef struct {
+  uint32_t DMA_Channel;
+  uint32_t DMA_PeripheralBaseAddr;
+  uint32_t DMA_Memory0BaseAddr;
+  uint32_t DMA_DIR;
+  uint32_t DMA_BufferSize;
+  uint32_t DMA_PeripheralInc;
+  uint32_t DMA_MemoryInc;
+  uint32_t DMA_PeripheralDataSize;
+  uint32_t DMA_MemoryDataSize;
+  uint32_t DMA_Mode;
+  uint32_t DMA_Priority;
+  uint32_t DMA_FIFOMode;
+  uint32_t DMA_FIFOThreshold;
+  uint32_t DMA_MemoryBurst;
+  uint32_t DMA_PeripheralBurst;
+} DMA_InitTypeDef;
+
+// The simulated peripherals
+extern I2C_TypeDef i2cMockI2c1;
+extern I2C_TypeDef i2cMockI2c3;
+extern GPIO_TypeDef i2cMockGpio;
+extern DMA_Stream_TypeDef i2cMockDmaStream;
+
+#define I2C1 (&i2cMockI2c1)
+#define I2C3 (&i2cMockI2c3)
+#define GPIOA (&i2cMockGpio)
+#define GPIOB (&i2cMockGpio)
+#define GPIOC (&i2cMockGpio)
+#define DMA1_Stream0 (&i2cMockDmaStream)
+#define DMA1_Stream2 (&i2cMockDmaStream)
+#define DMA1_Stream5 (&i2cMockDmaStream)
+
+#define I2C1_EV_IRQn 31
+#define I2C1_ER_IRQn 32
+#define I2C3_EV_IRQn 72
+#define I2C3_ER_IRQn 73
+#define DMA1_Stream0_IRQn 11
+#define DMA1_Stream2_IRQn 13
+#define DMA1_Stream5_IRQn 16
+
+#define RCC_AHB1Periph_GPIOA 0x00000001
+#define RCC_AHB1Periph_GPIOB 0x00000002
+#define RCC_AHB1Periph_GPIOC 0x00000004
+#define RCC_AHB1Periph_DMA1 0x00200000
+#define RCC_APB1Periph_I2C1 0x00200000
+#define RCC_APB1Periph_I2C3 0x00800000
+
+#define GPIO_Pin_6 0x0040
+#define GPIO_Pin_7 0x0080
+#define GPIO_Pin_8 0x0100
+#define GPIO_Pin_9 0x0200
+#define GPIO_PinSource6 6
+#define GPIO_PinSource7 7
+#define GPIO_PinSource8 8
+#define GPIO_PinSource9 9
+#define GPIO_AF_I2C1 4
+#define GPIO_AF_I2C3 4
+#define GPIO_Mode_OUT 1
+#define GPIO_Mode_AF 2
+#define GPIO_Speed_50MHz 2
+#define GPIO_OType_OD 1
+
+#define I2C_Mode_I2C 0x0000
+#define I2C_DutyCycle_2 0xBFFF
+#define I2C_Ack_Enable 0x0400
+#define I2C_AcknowledgedAddress_7bit 0x4000
+#define I2C_Direction_Transmitter 0x00
+#define I2C_Direction_Receiver 0x01
+
+#define I2C_CR1_PE 0x0001
+#define I2C_CR1_START 0x0100
+#define I2C_CR1_STOP 0x0200
+#define I2C_SR1_SB 0x0001
+#define I2C_SR1_ADDR 0x0002
+#define I2C_SR1_BTF 0x0004
+#define I2C_SR1_RXNE 0x0040
+#define I2C_SR1_TXE 0x0080
+#define I2C_SR2_TRA 0x0004
+
+#define I2C_IT_BUF 0x0400
+#define I2C_IT_EVT 0x0200
+#define I2C_IT_ERR 0x0100
+
+#define I2C_FLAG_AF 0x10000400
+#define I2C_FLAG_ARLO 0x10000200
+#define I2C_FLAG_BERR 0x10000100
+#define I2C_FLAG_OVR 0x10000800
+#define I2C_FLAG_BUSY 0x00020000
+
+#define DMA_Channel_1 0x02000000
+#define DMA_Channel_3 0x06000000
+#define DMA_DIR_PeripheralToMemory 0x00000000
+#define DMA_PeripheralInc_Disable 0x00000000
+#define DMA_MemoryInc_Enable 0x00000400
+#define DMA_PeripheralDataSize_Byte 0x00000000
+#define DMA_MemoryDataSize_Byte 0x00000000
+#define DMA_Mode_Normal 0x00000000
+#define DMA_Priority_High 0x00020000
+#define DMA_FIFOMode_Disable 0x00000000
+#define DMA_FIFOThreshold_1QuarterFull 0x00000000
+#define DMA_MemoryBurst_Single 0x00000000
+#define DMA_PeripheralBurst_Single 0x00000000
+#define DMA_IT_TC 0x00000010
+#define DMA_IT_TE 0x00000004
+#define DMA_FLAG_TCIF0 0x10000020
+#define DMA_FLAG_TEIF0 0x10000008
+#define DMA_FLAG_TCIF2 0x10200000
+#define DMA_FLAG_TEIF2 0x10080000
+#define DMA_FLAG_TCIF5 0x20000800
+#define DMA_FLAG_TEIF5 0x20000200
+
+#define __DMB()
+
+// The ISRs run on the host, where there is no scheduler to switch to
+#undef portYIELD
+#define portYIELD() do {} while (0)
+
+void RCC_AHB1PeriphClockCmd(uint32_t RCC_AHB1Periph, FunctionalState NewState);
+void RCC_APB1PeriphClockCmd(uint32_t RCC_APB1Periph, FunctionalState NewState);
+void GPIO_StructInit(GPIO_InitTypeDef* GPIO_InitStruct);
+void GPIO_Init(GPIO_TypeDef* GPIOx, GPIO_InitTypeDef* GPIO_InitStruct);
+void GPIO_PinAFConfig(GPIO_TypeDef* GPIOx, uint16_t GPIO_PinSource, uint8_t GPIO_AF);
+void GPIO_SetBits(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin);
+void GPIO_ResetBits(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin);
+uint8_t GPIO_ReadInputDataBit(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin);
+void NVIC_Init(NVIC_InitTypeDef* NVIC_InitStruct);
+void NVIC_SetPendingIRQ(IRQn_Type IRQn);
+void I2C_DeInit(I2C_TypeDef* I2Cx);
+void I2C_Init(I2C_TypeDef* I2Cx, I2C_InitTypeDef* I2C_InitStruct);
+void I2C_ITConfig(I2C_TypeDef* I2Cx, uint16_t I2C_IT, FunctionalState NewState);
+void I2C_AcknowledgeConfig(I2C_TypeDef* I2Cx, FunctionalState NewState);
+void I2C_DMACmd(I2C_TypeDef* I2Cx, FunctionalState NewState);
+void I2C_DMALastTransferCmd(I2C_TypeDef* I2Cx, FunctionalState NewState);
+void I2C_Send7bitAddress(I2C_TypeDef* I2Cx, uint8_t Address, uint8_t I2C_Direction);
+void I2C_SendData(I2C_TypeDef* I2Cx, uint8_t Data);
+uint8_t I2C_ReceiveData(I2C_TypeDef* I2Cx);
+FlagStatus I2C_GetFlagStatus(I2C_TypeDef* I2Cx, uint32_t I2C_FLAG);
+void I2C_ClearFlag(I2C_TypeDef* I2Cx, uint32_t I2C_FLAG);
+void DMA_Init(DMA_Stream_TypeDef* DMAy_Streamx, DMA_InitTypeDef* DMA_InitStruct);
+void DMA_Cmd(DMA_Stream_TypeDef* DMAy_Streamx, FunctionalState NewState);
+void DMA_ITConfig(DMA_Stream_TypeDef* DMAy_Streamx, uint32_t DMA_IT, FunctionalState NewState);
+FlagStatus DMA_GetFlagStatus(DMA_Stream_TypeDef* DMAy_Streamx, uint32_t DMA_FLAG);
+void DMA_ClearITPendingBit(DMA_Stream_TypeDef* DMAy_Streamx, uint32_t DMA_IT);
+
+#define I2C_MOCK_MAX_BYTES 32
+
+// State of the simulated bus, reset by i2cPeripheralMockReset()
+typedef struct {
+  uint64_t now;                           // Time [us], advanced by each call to usecTimestamp()
+  bool isBusHeld;                         // A device holds the bus low: start and stop conditions are never generated
+  bool isAckFailure;                      // The addressed device did not ack (AF flag)
+  bool isDmaTransferComplete;             // The DMA has received all bytes (TC flag)
+  bool isEventInterruptPending;           // The event interrupt has been pended by software
+  int restarts;                           // Number of times the peripheral has been reset
+  uint8_t addresses[I2C_MOCK_MAX_BYTES];  // Address bytes sent on the bus, (slave address << 1) | direction
+  int addressCount;
+  uint8_t data[I2C_MOCK_MAX_BYTES];       // Data bytes sent on the bus
+  int dataCount;
+} i2cPeripheralMock_t;
+
+extern i2cPeripheralMock_t i2cPeripheralMock;
+
+void i2cPeripheralMockReset(void);
+
+#endif // __I2C_PERIPHERAL_MOCKS_H__
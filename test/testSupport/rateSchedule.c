@@ -0,0 +1,83 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2023 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * rateSchedule.c - evaluation of multi rate, phase staggered schedules
+ */
+
+#include <stddef.h>
+
+#include "rateSchedule.h"
+
+static uint32_t greatestCommonDivisor(uint32_t a, uint32_t b) {
+  while (b != 0) {
+    const uint32_t remainder = a % b;
+    a = b;
+    b = remainder;
+  }
+
+  return a;
+}
+
+bool rateScheduleIsDue(const rateScheduleEntry_t* entry, const uint32_t tick) {
+  return (tick % entry->period) == (entry->phase % entry->period);
+}
+
+uint32_t rateScheduleHyperperiod(const rateScheduleEntry_t* entries, const int count) {
+  uint32_t result = 1;
+  for (int i = 0; i < count; i++) {
+    result = (result / greatestCommonDivisor(result, entries[i].period)) * entries[i].period;
+  }
+
+  return result;
+}
+
+uint32_t rateScheduleTickCost(const rateScheduleEntry_t* entries, const int count, const uint32_t tick) {
+  uint32_t result = 0;
+  for (int i = 0; i < count; i++) {
+    if (rateScheduleIsDue(&entries[i], tick)) {
+      result += entries[i].cost;
+    }
+  }
+
+  return result;
+}
+
+uint32_t rateScheduleMaxTickCost(const rateScheduleEntry_t* entries, const int count, uint32_t* worstTick) {
+  uint32_t result = 0;
+  uint32_t resultTick = 0;
+
+  const uint32_t hyperperiod = rateScheduleHyperperiod(entries, count);
+  for (uint32_t tick = 0; tick < hyperperiod; tick++) {
+    const uint32_t cost = rateScheduleTickCost(entries, count, tick);
+    if (cost > result) {
+      result = cost;
+      resultTick = tick;
+    }
+  }
+
+  if (worstTick != NULL) {
+    *worstTick = resultTick;
+  }
+
+  return result;
+}
@@ -0,0 +1,82 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2023 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * rateSchedule.h - evaluation of multi rate, phase staggered schedules
+ *
+ * Test support for the unit tests of the phases of the stabilizer loop.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * One periodic job of a schedule. The job is due in the ticks where
+ * (tick % period) == (phase % period), which is the same rule as
+ * RATE_DO_EXECUTE_PHASED() in stabilizer_types.h.
+ */
+typedef struct {
+  uint32_t period; // Ticks between executions
+  uint32_t phase;  // Tick offset within the period
+  uint32_t cost;   // Worst case execution time, in any unit
+} rateScheduleEntry_t;
+
+/**
+ * @brief Check if a job is due in a tick
+ *
+ * @param entry The job
+ * @param tick The tick
+ * @return true if the job shall execute in the tick
+ */
+bool rateScheduleIsDue(const rateScheduleEntry_t* entry, const uint32_t tick);
+
+/**
+ * @brief Get the number of ticks after which a schedule repeats itself, that is
+ * the least common multiple of the periods
+ *
+ * @param entries The jobs of the schedule
+ * @param count The number of jobs
+ * @return uint32_t The hyperperiod, in ticks
+ */
+uint32_t rateScheduleHyperperiod(const rateScheduleEntry_t* entries, const int count);
+
+/**
+ * @brief Get the summed cost of the jobs that are due in a tick
+ *
+ * @param entries The jobs of the schedule
+ * @param count The number of jobs
+ * @param tick The tick
+ * @return uint32_t The cost of the tick
+ */
+uint32_t rateScheduleTickCost(const rateScheduleEntry_t* entries, const int count, const uint32_t tick);
+
+/**
+ * @brief Get the highest cost of any tick of a schedule
+ *
+ * @param entries The jobs of the schedule
+ * @param count The number of jobs
+ * @param worstTick Set to the first tick with the highest cost, may be NULL
+ * @return uint32_t The highest cost
+ */
+uint32_t rateScheduleMaxTickCost(const rateScheduleEntry_t* entries, const int count, uint32_t* worstTick);
@@ -12,6 +12,10 @@
 #define KVE_PARTITION_LENGTH (7*1024)
 
 uint8_t kveData[KVE_PARTITION_LENGTH];
+static int readCount;
+// Writes after this many are lost, as when the system is reset
+static int writesLeft;
+static int writeCount;
 
 static size_t read(size_t address, void* data, size_t length)
 {
@@ -19,6 +23,8 @@ static size_t read(size_t address, void* data, size_t length)
     return 0;
   }
 
+  readCount++;
+
   memcpy(data, &kveData[address], length);
 
   return length;
@@ -30,6 +36,12 @@ static size_t write(size_t address, const void* data, size_t length)
     return 0;
   }
 
+  writeCount++;
+  if (writesLeft == 0) {
+    return length;
+  }
+  writesLeft--;
+
   memcpy(&kveData[address], data, length);
 
   return length;
@@ -47,6 +59,22 @@ static kveMemory_t kve = {
   .flush = flush,
 };
 
+#define INDEX_CAPACITY 64
+static kveIndexEntry_t indexEntries[INDEX_CAPACITY];
+static kveIndex_t kveIndex = {
+  .entries = indexEntries,
+  .capacity = INDEX_CAPACITY,
+};
+
+// The same memory, with an index
+static kveMemory_t kveIndexed = {
+  .memorySize = KVE_PARTITION_LENGTH,
+  .read = read,
+  .write = write,
+  .flush = flush,
+  .index = &kveIndex,
+};
+
 static bool fromStorageOneKey(const char *key, void *buffer, size_t length)
 {
 
@@ -84,7 +112,7 @@ static bool fromFullStorageAllKeys(const char *key, void *buffer, size_t length)
   return true;
 }
 
-static void fillKveMemory(void)
+static void fillMemory(kveMemory_t *memory)
 {
   int i;
   char keyString[30];
@@ -92,7 +120,7 @@ static void fillKveMemory(void)
   for (i = 0; i < (KVE_PARTITION_LENGTH / 10); i++)
   {
     sprintf(keyString, "prm/test.value%i", i);
-    if (!kveStore(&kve, keyString, &i, sizeof(i)))
+    if (!kveStore(memory, keyString, &i, sizeof(i)))
     {
       break;
     }
@@ -100,12 +128,31 @@ static void fillKveMemory(void)
   //printf("Nr stored:%i\n", i);
 }
 
+static void fillKveMemory(void)
+{
+  fillMemory(&kve);
+}
+
+static void storeValues(kveMemory_t *memory, int count)
+{
+  char keyString[30];
+  for (int i = 0; i < count; i++)
+  {
+    sprintf(keyString, "prm/test.value%i", i);
+    kveStore(memory, keyString, &i, sizeof(i));
+  }
+}
+
 //-----------------------------Test cases -------------------------------- //
 
 void setUp(void) {
+  writesLeft = INT_MAX;
   // The full memory is initialized to zero
   memset(kveData, 0, KVE_PARTITION_LENGTH);
   kveFormat(&kve);
+  kveIndex.isBuilt = false;
+  readCount = 0;
+  writeCount = 0;
 }
 
 void tearDown(void) {
@@ -213,3 +260,411 @@ void testRemoveAndStoreBiggerWhenMemoryIsFull(void) {
   TEST_ASSERT_EQUAL(true, actualDelete);
   TEST_ASSERT_EQUAL(false, actualStore);
 }
+
+void testIndexIsBuiltFromMemory(void) {
+  // Fixture
+  storeValues(&kve, 40);
+  int value = 0;
+
+  // Test
+  size_t actual = kveFetch(&kveIndexed, "prm/test.value39", &value, sizeof(value));
+
+  // Assert
+  TEST_ASSERT_EQUAL(sizeof(value), actual);
+  TEST_ASSERT_EQUAL(39, value);
+  TEST_ASSERT_EQUAL(40, kveIndex.count);
+}
+
+void testFetchWithIndexDoesNotScanTheTable(void) {
+  // Fixture
+  storeValues(&kveIndexed, 40);
+  int value = 0;
+
+  // Test
+  readCount = 0;
+  size_t actualIndexed = kveFetch(&kveIndexed, "prm/test.value39", &value, sizeof(value));
+  const int readsIndexed = readCount;
+
+  readCount = 0;
+  kveFetch(&kve, "prm/test.value39", &value, sizeof(value));
+  const int readsScanned = readCount;
+
+  // Assert
+  TEST_ASSERT_EQUAL(sizeof(value), actualIndexed);
+  TEST_ASSERT_EQUAL(39, value);
+  TEST_ASSERT_LESS_OR_EQUAL(3, readsIndexed);
+  TEST_ASSERT_GREATER_THAN(40, readsScanned);
+}
+
+void testIndexIsKeptUpToDateOnResizeAndDelete(void) {
+  // Fixture
+  storeValues(&kveIndexed, 10);
+  uint64_t bigger = 0x0102030405060708;
+  uint64_t actualBigger = 0;
+  int value;
+
+  // Test
+  kveStore(&kveIndexed, "prm/test.value3", &bigger, sizeof(bigger));
+  kveDelete(&kveIndexed, "prm/test.value5");
+
+  // Assert
+  TEST_ASSERT_EQUAL(sizeof(bigger), kveFetch(&kveIndexed, "prm/test.value3", &actualBigger, sizeof(actualBigger)));
+  TEST_ASSERT_EQUAL_UINT64(bigger, actualBigger);
+  TEST_ASSERT_EQUAL(0, kveFetch(&kveIndexed, "prm/test.value5", &value, sizeof(value)));
+  TEST_ASSERT_EQUAL(sizeof(value), kveFetch(&kveIndexed, "prm/test.value9", &value, sizeof(value)));
+  TEST_ASSERT_EQUAL(9, value);
+  TEST_ASSERT_EQUAL(9, kveIndex.count);
+
+  // The index matches the memory
+  TEST_ASSERT_EQUAL(sizeof(bigger), kveFetch(&kve, "prm/test.value3", &actualBigger, sizeof(actualBigger)));
+  TEST_ASSERT_EQUAL(0, kveFetch(&kve, "prm/test.value5", &value, sizeof(value)));
+  TEST_ASSERT_TRUE(kveCheck(&kve));
+}
+
+void testFullMemoryWithIndexOverflow(void) {
+  // Fixture
+  uint32_t u32Store = 0xBEAF;
+  fillMemory(&kveIndexed);
+
+  // Test
+  bool actualFull = kveStore(&kveIndexed, "prm/full", &u32Store, sizeof(uint32_t));
+  bool actualDelete = kveDelete(&kveIndexed, "prm/test.value10");
+  bool actualStore = kveStore(&kveIndexed, "prm/test.hole10", &u32Store, sizeof(uint32_t));
+
+  // Assert
+  TEST_ASSERT_FALSE(kveIndex.isValid);
+  TEST_ASSERT_FALSE(actualFull);
+  TEST_ASSERT_TRUE(actualDelete);
+  TEST_ASSERT_TRUE(actualStore);
+  TEST_ASSERT_TRUE(kveCheck(&kve));
+  int value;
+  TEST_ASSERT_EQUAL(sizeof(u32Store), kveFetch(&kve, "prm/test.hole10", &value, sizeof(value)));
+  TEST_ASSERT_EQUAL(0xBEAF, value);
+}
+
+void testStoreBatch(void) {
+  // Fixture
+  storeValues(&kveIndexed, 10);
+  int sameSize = 4711;
+  uint64_t bigger = 0x0102030405060708;
+  uint16_t newValue = 0x1234;
+  const kveItem_t items[] = {
+    {"prm/test.value2", &sameSize, sizeof(sameSize)},
+    {"prm/test.value4", &bigger, sizeof(bigger)},
+    {"prm/test.new", &newValue, sizeof(newValue)},
+  };
+  int value;
+  uint64_t actualBigger;
+  uint16_t actualNew;
+
+  // Test
+  bool actual = kveStoreBatch(&kveIndexed, items, 3);
+
+  // Assert
+  TEST_ASSERT_TRUE(actual);
+  TEST_ASSERT_TRUE(kveCheck(&kve));
+  TEST_ASSERT_EQUAL(sizeof(value), kveFetch(&kve, "prm/test.value2", &value, sizeof(value)));
+  TEST_ASSERT_EQUAL(sameSize, value);
+  TEST_ASSERT_EQUAL(sizeof(bigger), kveFetch(&kve, "prm/test.value4", &actualBigger, sizeof(actualBigger)));
+  TEST_ASSERT_EQUAL_UINT64(bigger, actualBigger);
+  TEST_ASSERT_EQUAL(sizeof(newValue), kveFetch(&kve, "prm/test.new", &actualNew, sizeof(actualNew)));
+  TEST_ASSERT_EQUAL_UINT16(newValue, actualNew);
+  TEST_ASSERT_EQUAL(sizeof(value), kveFetch(&kveIndexed, "prm/test.value9", &value, sizeof(value)));
+  TEST_ASSERT_EQUAL(9, value);
+}
+
+void testStoreBatchWithoutIndex(void) {
+  // Fixture
+  int value1 = 1;
+  int value2 = 2;
+  const kveItem_t items[] = {
+    {"prm/test.value1", &value1, sizeof(value1)},
+    {"prm/test.value2", &value2, sizeof(value2)},
+  };
+  int value;
+
+  // Test
+  bool actual = kveStoreBatch(&kve, items, 2);
+
+  // Assert
+  TEST_ASSERT_TRUE(actual);
+  TEST_ASSERT_EQUAL(sizeof(value), kveFetch(&kve, "prm/test.value2", &value, sizeof(value)));
+  TEST_ASSERT_EQUAL(2, value);
+}
+
+void testStoreBatchThatDoesNotFitStoresNothing(void) {
+  // Fixture
+  static uint8_t expected[KVE_PARTITION_LENGTH];
+  static uint8_t big[KVE_PARTITION_LENGTH / 4];
+  storeValues(&kveIndexed, 10);
+  const kveItem_t items[] = {
+    {"prm/test.value1", big, sizeof(big)},
+    {"prm/test.big1", big, sizeof(big)},
+    {"prm/test.big2", big, sizeof(big)},
+    {"prm/test.big3", big, sizeof(big)},
+  };
+  memcpy(expected, kveData, sizeof(expected));
+
+  // Test
+  bool actual = kveStoreBatch(&kveIndexed, items, 4);
+
+  // Assert
+  TEST_ASSERT_FALSE(actual);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, kveData, sizeof(expected));
+}
+
+void testStoreBatchDefragsWhenNeeded(void) {
+  // Fixture
+  static uint8_t big[KVE_PARTITION_LENGTH / 4];
+  memset(big, 0x5a, sizeof(big));
+  const kveItem_t bigItems[] = {
+    {"prm/test.big1", big, sizeof(big)},
+    {"prm/test.big2", big, sizeof(big)},
+    {"prm/test.big3", big, sizeof(big)},
+  };
+  kveStoreBatch(&kveIndexed, bigItems, 3);
+  kveDelete(&kveIndexed, "prm/test.big1");
+  kveDelete(&kveIndexed, "prm/test.big2");
+  const kveItem_t items[] = {
+    {"prm/test.big4", big, sizeof(big)},
+    {"prm/test.big5", big, sizeof(big)},
+  };
+  uint8_t actualByte = 0;
+
+  // Test
+  bool actual = kveStoreBatch(&kveIndexed, items, 2);
+
+  // Assert
+  TEST_ASSERT_TRUE(actual);
+  TEST_ASSERT_TRUE(kveCheck(&kve));
+  TEST_ASSERT_EQUAL(1, kveFetch(&kve, "prm/test.big5", &actualByte, 1));
+  TEST_ASSERT_EQUAL_UINT8(0x5a, actualByte);
+  TEST_ASSERT_EQUAL(1, kveFetch(&kveIndexed, "prm/test.big3", &actualByte, 1));
+}
+
+void testStoreBatchWithDuplicateKeysStoresNothing(void) {
+  // Fixture
+  static uint8_t expected[KVE_PARTITION_LENGTH];
+  storeValues(&kveIndexed, 10);
+  int value1 = 1;
+  int value2 = 2;
+  const kveItem_t duplicateFirst[] = {
+    {"prm/test.new", &value1, sizeof(value1)},
+    {"prm/test.value2", &value1, sizeof(value1)},
+    {"prm/test.new", &value2, sizeof(value2)},
+  };
+  const kveItem_t duplicateExisting[] = {
+    {"prm/test.value2", &value1, sizeof(value1)},
+    {"prm/test.value2", &value2, sizeof(value2)},
+  };
+  memcpy(expected, kveData, sizeof(expected));
+
+  // Test
+  bool actualFirst = kveStoreBatch(&kveIndexed, duplicateFirst, 3);
+  bool actualExisting = kveStoreBatch(&kveIndexed, duplicateExisting, 2);
+  bool actualWithoutIndex = kveStoreBatch(&kve, duplicateExisting, 2);
+
+  // Assert
+  TEST_ASSERT_FALSE(actualFirst);
+  TEST_ASSERT_FALSE(actualExisting);
+  TEST_ASSERT_FALSE(actualWithoutIndex);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, kveData, sizeof(expected));
+}
+
+void testInterruptedStoreBatchStoresAllOrNoAppendedItems(void) {
+  // Fixture
+  static uint8_t initial[KVE_PARTITION_LENGTH];
+  storeValues(&kveIndexed, 10);
+  memcpy(initial, kveData, sizeof(initial));
+  int sameSize = 4711;
+  uint64_t bigger = 0x0102030405060708;
+  uint16_t newValue = 0x1234;
+  const kveItem_t items[] = {
+    {"prm/test.value4", &bigger, sizeof(bigger)},
+    {"prm/test.value2", &sameSize, sizeof(sameSize)},
+    {"prm/test.new", &newValue, sizeof(newValue)},
+  };
+
+  writeCount = 0;
+  kveStoreBatch(&kveIndexed, items, 3);
+  const int batchWrites = writeCount;
+
+  for (int cut = 0; cut <= batchWrites; cut++) {
+    memcpy(kveData, initial, sizeof(initial));
+    kveIndex.isBuilt = false;
+    writesLeft = cut;
+
+    // Test
+    kveStoreBatch(&kveIndexed, items, 3);
+
+    // Assert, after a reset
+    writesLeft = INT_MAX;
+    TEST_ASSERT_TRUE(kveCheck(&kveIndexed));
+
+    uint64_t actualValue4 = 0;
+    uint16_t actualNew = 0;
+    int value2 = 0;
+    size_t value4Length = kveFetch(&kveIndexed, "prm/test.value4", &actualValue4, sizeof(actualValue4));
+    size_t newLength = kveFetch(&kveIndexed, "prm/test.new", &actualNew, sizeof(actualNew));
+    TEST_ASSERT_EQUAL(sizeof(int), kveFetch(&kveIndexed, "prm/test.value2", &value2, sizeof(value2)));
+    TEST_ASSERT_TRUE(value2 == 2 || value2 == sameSize);
+
+    if (newLength == 0) {
+      TEST_ASSERT_EQUAL(sizeof(int), value4Length);
+      TEST_ASSERT_EQUAL(4, (int)actualValue4);
+    } else {
+      TEST_ASSERT_EQUAL(sizeof(newValue), newLength);
+      TEST_ASSERT_EQUAL_UINT16(newValue, actualNew);
+      TEST_ASSERT_EQUAL(sizeof(bigger), value4Length);
+      TEST_ASSERT_EQUAL_UINT64(bigger, actualValue4);
+    }
+
+    // The old copy is released when the index is built, a table scan finds the same value
+    uint64_t scannedValue4 = 0;
+    TEST_ASSERT_EQUAL(value4Length, kveFetch(&kve, "prm/test.value4", &scannedValue4, sizeof(scannedValue4)));
+    TEST_ASSERT_EQUAL_UINT64(actualValue4, scannedValue4);
+  }
+}
+
+static void storeAndDeleteEverySecondValue(kveMemory_t *memory, int count)
+{
+  char keyString[30];
+  storeValues(memory, count);
+  for (int i = 0; i < count; i += 2)
+  {
+    sprintf(keyString, "prm/test.value%i", i);
+    kveDelete(memory, keyString);
+  }
+}
+
+static void assertOddValuesStored(kveMemory_t *memory, int count)
+{
+  char keyString[30];
+  int value;
+  for (int i = 0; i < count; i++)
+  {
+    sprintf(keyString, "prm/test.value%i", i);
+    size_t expectedLength = (i % 2) ? sizeof(value) : 0;
+    TEST_ASSERT_EQUAL(expectedLength, kveFetch(memory, keyString, &value, sizeof(value)));
+    if (i % 2) {
+      TEST_ASSERT_EQUAL(i, value);
+    }
+  }
+}
+
+void testStats(void) {
+  // Fixture
+  kveStats_t stats;
+  storeAndDeleteEverySecondValue(&kve, 10);
+
+  // Test
+  bool actual = kveGetStats(&kve, &stats);
+
+  // Assert
+  // Items are 3 + 15 + 4 bytes long
+  TEST_ASSERT_TRUE(actual);
+  TEST_ASSERT_EQUAL(5 * 22, stats.usedLength);
+  TEST_ASSERT_EQUAL(5 * 22, stats.holeLength);
+  TEST_ASSERT_EQUAL(KVE_PARTITION_LENGTH - 1 - 10 * 22 - 2, stats.freeLength);
+}
+
+void testStatsWithIndex(void) {
+  // Fixture
+  kveStats_t expected;
+  kveStats_t actual;
+  storeAndDeleteEverySecondValue(&kveIndexed, 10);
+  kveGetStats(&kve, &expected);
+
+  // Test
+  kveGetStats(&kveIndexed, &actual);
+
+  // Assert
+  TEST_ASSERT_EQUAL(expected.usedLength, actual.usedLength);
+  TEST_ASSERT_EQUAL(expected.holeLength, actual.holeLength);
+  TEST_ASSERT_EQUAL(expected.freeLength, actual.freeLength);
+}
+
+void testStoreNeedsDefragWhenMemoryIsFull(void) {
+  // Fixture
+  int value = 0;
+  fillKveMemory();
+  kveDelete(&kve, "prm/test.value10");
+
+  // Test
+  bool actualNew = kveStoreNeedsDefrag(&kve, "prm/test.new", sizeof(value));
+  bool actualInPlace = kveStoreNeedsDefrag(&kve, "prm/test.value11", sizeof(value));
+
+  // Assert
+  TEST_ASSERT_TRUE(actualNew);
+  TEST_ASSERT_FALSE(actualInPlace);
+}
+
+void testStoreDoesNotNeedDefragWhenThereIsSpace(void) {
+  // Fixture
+  int value = 0;
+  storeValues(&kve, 10);
+
+  // Test
+  bool actual = kveStoreNeedsDefrag(&kve, "prm/test.new", sizeof(value));
+
+  // Assert
+  TEST_ASSERT_FALSE(actual);
+}
+
+void testDefragStepIsBounded(void) {
+  // Fixture
+  storeAndDeleteEverySecondValue(&kve, 10);
+
+  // Test
+  bool actual = kveDefragStep(&kve, 1);
+
+  // Assert
+  // One item moved to the first hole, the holes are merged behind it
+  TEST_ASSERT_FALSE(actual);
+  kveStats_t stats;
+  kveGetStats(&kve, &stats);
+  TEST_ASSERT_EQUAL(5 * 22, stats.holeLength);
+  TEST_ASSERT_TRUE(kveCheck(&kve));
+  assertOddValuesStored(&kve, 10);
+}
+
+void testDefragStepsCompactTheTable(void) {
+  // Fixture
+  storeAndDeleteEverySecondValue(&kve, 10);
+  int steps = 0;
+
+  // Test
+  while (!kveDefragStep(&kve, 32)) {
+    steps++;
+  }
+
+  // Assert
+  kveStats_t stats;
+  kveGetStats(&kve, &stats);
+  TEST_ASSERT_EQUAL(5, steps);
+  TEST_ASSERT_EQUAL(0, stats.holeLength);
+  TEST_ASSERT_EQUAL(5 * 22, stats.usedLength);
+  TEST_ASSERT_TRUE(kveCheck(&kve));
+  assertOddValuesStored(&kve, 10);
+}
+
+void testDefragStepsKeepTheIndexUpToDate(void) {
+  // Fixture
+  storeAndDeleteEverySecondValue(&kveIndexed, 10);
+
+  // Test
+  while (!kveDefragStep(&kveIndexed, 32)) {
+  }
+
+  // Assert
+  TEST_ASSERT_TRUE(kveIndex.isValid);
+  assertOddValuesStored(&kveIndexed, 10);
+  kveStats_t stats;
+  kveGetStats(&kveIndexed, &stats);
+  TEST_ASSERT_EQUAL(0, stats.holeLength);
+
+  int value = 4711;
+  TEST_ASSERT_TRUE(kveStore(&kveIndexed, "prm/test.new", &value, sizeof(value)));
+  TEST_ASSERT_TRUE(kveCheck(&kve));
+  assertOddValuesStored(&kve, 10);
+}
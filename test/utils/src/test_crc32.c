@@ -0,0 +1,168 @@
+// File under test crc32.c
+#include "crc32.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "unity.h"
+
+#define BUFFER_SIZE 4096
+
+static uint8_t buffer[BUFFER_SIZE];
+
+// Reference implementation, one bit at the time
+static uint32_t referenceCrc32(const uint8_t* data, size_t size) {
+  uint32_t remainder = 0xFFFFFFFF;
+  for (size_t i = 0; i < size; i++) {
+    remainder ^= data[i];
+    for (int bit = 0; bit < 8; bit++) {
+      remainder = (remainder & 1) ? (remainder >> 1) ^ 0xEDB88320 : remainder >> 1;
+    }
+  }
+  return remainder ^ 0xFFFFFFFF;
+}
+
+void setUp(void) {
+  srand(4711);
+  for (int i = 0; i < BUFFER_SIZE; i++) {
+    buffer[i] = rand();
+  }
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testThatCheckValueIsCalculated(void) {
+  // Fixture
+  const char* data = "123456789";
+  uint32_t expected = 0xCBF43926;
+
+  // Test
+  uint32_t actual = crc32CalculateBuffer(data, 9);
+
+  // Assert
+  TEST_ASSERT_EQUAL_HEX32(expected, actual);
+}
+
+void testThatEmptyBufferGivesZero(void) {
+  // Fixture
+  // Test
+  uint32_t actual = crc32CalculateBuffer(buffer, 0);
+
+  // Assert
+  TEST_ASSERT_EQUAL_HEX32(0, actual);
+}
+
+void testThatRandomBuffersAreTheSameAsReference(void) {
+  for (int i = 0; i < 200; i++) {
+    // Fixture
+    // Random alignment and length, to cover both the sliced part and the tail
+    size_t offset = rand() % 8;
+    size_t size = rand() % (BUFFER_SIZE - offset);
+    uint32_t expected = referenceCrc32(&buffer[offset], size);
+
+    // Test
+    uint32_t actual = crc32CalculateBuffer(&buffer[offset], size);
+
+    // Assert
+    TEST_ASSERT_EQUAL_HEX32(expected, actual);
+  }
+}
+
+void testThatUpdatesInPiecesAreTheSameAsOneUpdate(void) {
+  for (int i = 0; i < 100; i++) {
+    // Fixture
+    crc32Context_t context;
+    crc32ContextInit(&context);
+    size_t size = rand() % BUFFER_SIZE;
+    uint32_t expected = referenceCrc32(buffer, size);
+
+    // Test
+    size_t done = 0;
+    while (done < size) {
+      size_t piece = rand() % 20;
+      if (piece > size - done) {
+        piece = size - done;
+      }
+      crc32Update(&context, &buffer[done], piece);
+      done += piece;
+    }
+    uint32_t actual = crc32Out(&context);
+
+    // Assert
+    TEST_ASSERT_EQUAL_HEX32(expected, actual);
+  }
+}
+
+// Model of the CRC unit of the MCU, words are processed MSB first
+static uint32_t hardwareWrite(uint32_t state, uint32_t word) {
+  state ^= word;
+  for (int bit = 0; bit < 32; bit++) {
+    state = (state & 0x80000000) ? (state << 1) ^ 0x04C11DB7 : state << 1;
+  }
+  return state;
+}
+
+void testThatReflectReversesTheBits(void) {
+  // Fixture
+  // Test
+  // Assert
+  TEST_ASSERT_EQUAL_HEX32(0x80000000, crc32HardwareReflect(0x00000001));
+  TEST_ASSERT_EQUAL_HEX32(0x0000000F, crc32HardwareReflect(0xF0000000));
+  TEST_ASSERT_EQUAL_HEX32(0x1E6A2C48, crc32HardwareReflect(0x12345678));
+  TEST_ASSERT_EQUAL_HEX32(0xFFFFFFFF, crc32HardwareReflect(0xFFFFFFFF));
+}
+
+void testThatHardwareCalculationFromSeedIsTheSameAsReference(void) {
+  for (int i = 0; i < 200; i++) {
+    // Fixture
+    // The seed is the remainder after a prefix of any length, followed by whole words and a tail
+    size_t prefix = rand() % 64;
+    size_t words = rand() % 64;
+    size_t tail = rand() % 4;
+    size_t size = prefix + 4 * words + tail;
+    uint32_t expected = referenceCrc32(buffer, size);
+
+    crc32Context_t context;
+    crc32ContextInit(&context);
+    crc32Update(&context, buffer, prefix);
+
+    // Test
+    uint32_t state = 0xFFFFFFFF;
+    state = hardwareWrite(state, crc32HardwareSeed(context.remainder));
+    for (size_t word = 0; word < words; word++) {
+      const uint8_t* data = &buffer[prefix + 4 * word];
+      uint32_t value = data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+      state = hardwareWrite(state, crc32HardwareReflect(value));
+    }
+    context.remainder = crc32HardwareReflect(state);
+    crc32Update(&context, &buffer[prefix + 4 * words], tail);
+    uint32_t actual = crc32Out(&context);
+
+    // Assert
+    TEST_ASSERT_EQUAL_HEX32(expected, actual);
+  }
+}
+
+void testThatHardwareCalculationWithoutSeedStartsFromTheInitialRemainder(void) {
+  // Fixture
+  // crcByHardware() skips the seed for a new context
+  size_t words = 16;
+  uint32_t expected = referenceCrc32(buffer, 4 * words);
+  crc32Context_t context;
+  crc32ContextInit(&context);
+
+  // Test
+  uint32_t state = 0xFFFFFFFF;
+  for (size_t word = 0; word < words; word++) {
+    const uint8_t* data = &buffer[4 * word];
+    uint32_t value = data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+    state = hardwareWrite(state, crc32HardwareReflect(value));
+  }
+  context.remainder = crc32HardwareReflect(state);
+  uint32_t actual = crc32Out(&context);
+
+  // Assert
+  TEST_ASSERT_EQUAL_HEX32(expected, actual);
+}
@@ -0,0 +1,90 @@
+// File under test cycleStats.c
+#include "cycleStats.h"
+
+#include "unity.h"
+
+static cycleStats_t stats;
+
+void setUp(void) {
+  cycleStatsInit(&stats, 100);
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testThatStatsAreEmptyAfterInit(void) {
+  // Fixture
+  // Test
+  // Assert
+  TEST_ASSERT_EQUAL_UINT32(0, stats.count);
+  TEST_ASSERT_EQUAL_UINT32(0, cycleStatsMin(&stats));
+  TEST_ASSERT_EQUAL_UINT32(0, cycleStatsAverage(&stats));
+  TEST_ASSERT_EQUAL_UINT32(0, stats.max);
+}
+
+void testThatMinAvgAndMaxAreTracked(void) {
+  // Fixture
+  // Test
+  cycleStatsAdd(&stats, 30);
+  cycleStatsAdd(&stats, 10);
+  cycleStatsAdd(&stats, 50);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT32(3, stats.count);
+  TEST_ASSERT_EQUAL_UINT32(10, cycleStatsMin(&stats));
+  TEST_ASSERT_EQUAL_UINT32(30, cycleStatsAverage(&stats));
+  TEST_ASSERT_EQUAL_UINT32(50, stats.max);
+}
+
+void testThatSamplesAreBinnedLogarithmically(void) {
+  // Fixture
+  // Test
+  cycleStatsAdd(&stats, 0);
+  cycleStatsAdd(&stats, 99);
+  cycleStatsAdd(&stats, 100);
+  cycleStatsAdd(&stats, 199);
+  cycleStatsAdd(&stats, 200);
+  cycleStatsAdd(&stats, 6399);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT32(2, stats.bins[0]);
+  TEST_ASSERT_EQUAL_UINT32(2, stats.bins[1]);
+  TEST_ASSERT_EQUAL_UINT32(1, stats.bins[2]);
+  TEST_ASSERT_EQUAL_UINT32(1, stats.bins[CYCLE_STATS_BIN_COUNT - 2]);
+}
+
+void testThatLargeSamplesEndUpInTheLastBin(void) {
+  // Fixture
+  // Test
+  cycleStatsAdd(&stats, 6400);
+  cycleStatsAdd(&stats, UINT32_MAX);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT32(2, stats.bins[CYCLE_STATS_BIN_COUNT - 1]);
+  TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, stats.max);
+}
+
+void testThatAverageDoesNotOverflow(void) {
+  // Fixture
+  // Test
+  cycleStatsAdd(&stats, UINT32_MAX);
+  cycleStatsAdd(&stats, UINT32_MAX);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, cycleStatsAverage(&stats));
+}
+
+void testThatResetClearsSamplesButKeepsBinLayout(void) {
+  // Fixture
+  cycleStatsAdd(&stats, 150);
+
+  // Test
+  cycleStatsReset(&stats);
+  cycleStatsAdd(&stats, 150);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT32(1, stats.count);
+  TEST_ASSERT_EQUAL_UINT32(150, cycleStatsMin(&stats));
+  TEST_ASSERT_EQUAL_UINT32(1, stats.bins[1]);
+}
@@ -0,0 +1,151 @@
+// File under test rateSchedule.c
+#include "rateSchedule.h"
+
+#include "stabilizer_types.h"
+
+#include "unity.h"
+
+#define PERIOD(RATE_HZ) (RATE_MAIN_LOOP / (RATE_HZ))
+
+// The sub loops of the stabilizer loop, with a cost of one stage each. The
+// stages that run in every tick (sensors, commander, supervisor, power
+// distribution) are lumped together.
+static const rateScheduleEntry_t stabilizerSchedule[] = {
+  {.period = 1, .phase = 0, .cost = 1},
+  {.period = PERIOD(ESTIMATOR_ATTITUDE_RATE), .phase = ESTIMATOR_ATTITUDE_PHASE, .cost = 1},
+  {.period = PERIOD(ATTITUDE_RATE), .phase = ATTITUDE_PHASE, .cost = 1},
+  {.period = PERIOD(ESTIMATOR_POSITION_RATE), .phase = ESTIMATOR_POSITION_PHASE, .cost = 1},
+  {.period = PERIOD(RATE_HL_COMMANDER), .phase = HL_COMMANDER_PHASE, .cost = 1},
+  {.period = PERIOD(POSITION_RATE), .phase = POSITION_PHASE, .cost = 1},
+  {.period = PERIOD(RATE_100_HZ), .phase = USDDECK_PHASE, .cost = 1},
+};
+static const int stabilizerScheduleCount = sizeof(stabilizerSchedule) / sizeof(stabilizerSchedule[0]);
+
+void setUp(void) {
+  // Empty
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testThatJobIsDueAtItsPhase(void) {
+  // Fixture
+  const rateScheduleEntry_t entry = {.period = 10, .phase = 3, .cost = 1};
+
+  // Test
+  // Assert
+  TEST_ASSERT_FALSE(rateScheduleIsDue(&entry, 0));
+  TEST_ASSERT_TRUE(rateScheduleIsDue(&entry, 3));
+  TEST_ASSERT_FALSE(rateScheduleIsDue(&entry, 4));
+  TEST_ASSERT_TRUE(rateScheduleIsDue(&entry, 13));
+}
+
+void testThatPhaseIsWrappedToThePeriod(void) {
+  // Fixture
+  const rateScheduleEntry_t entry = {.period = 2, .phase = 7, .cost = 1};
+
+  // Test
+  // Assert
+  TEST_ASSERT_TRUE(rateScheduleIsDue(&entry, 1));
+  TEST_ASSERT_FALSE(rateScheduleIsDue(&entry, 2));
+}
+
+void testThatIsDueMatchesTheStabilizerMacro(void) {
+  // Fixture
+  const rateScheduleEntry_t entry = {.period = PERIOD(POSITION_RATE), .phase = POSITION_PHASE, .cost = 1};
+
+  // Test
+  // Assert
+  for (uint32_t tick = 0; tick < 100; tick++) {
+    TEST_ASSERT_EQUAL(RATE_DO_EXECUTE_PHASED(POSITION_RATE, POSITION_PHASE, tick), rateScheduleIsDue(&entry, tick));
+  }
+}
+
+void testThatHyperperiodIsTheLeastCommonMultiple(void) {
+  // Fixture
+  const rateScheduleEntry_t entries[] = {
+    {.period = 4, .phase = 0, .cost = 1},
+    {.period = 10, .phase = 0, .cost = 1},
+    {.period = 2, .phase = 0, .cost = 1},
+  };
+
+  // Test
+  uint32_t actual = rateScheduleHyperperiod(entries, 3);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT32(20, actual);
+}
+
+void testThatTickCostIsTheSumOfTheDueJobs(void) {
+  // Fixture
+  const rateScheduleEntry_t entries[] = {
+    {.period = 1, .phase = 0, .cost = 1},
+    {.period = 2, .phase = 1, .cost = 10},
+    {.period = 4, .phase = 1, .cost = 100},
+  };
+
+  // Test
+  // Assert
+  TEST_ASSERT_EQUAL_UINT32(1, rateScheduleTickCost(entries, 3, 0));
+  TEST_ASSERT_EQUAL_UINT32(111, rateScheduleTickCost(entries, 3, 1));
+  TEST_ASSERT_EQUAL_UINT32(11, rateScheduleTickCost(entries, 3, 3));
+}
+
+void testThatMaxTickCostIsFoundOverTheHyperperiod(void) {
+  // Fixture
+  const rateScheduleEntry_t entries[] = {
+    {.period = 4, .phase = 3, .cost = 5},
+    {.period = 6, .phase = 1, .cost = 7},
+  };
+  uint32_t worstTick = 0;
+
+  // Test
+  uint32_t actual = rateScheduleMaxTickCost(entries, 2, &worstTick);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT32(12, actual);
+  TEST_ASSERT_EQUAL_UINT32(7, worstTick);
+}
+
+void testThatPhasesSpreadTheStabilizerStagesOverTheTicks(void) {
+  // Fixture
+  // All loops in the same tick, as with RATE_DO_EXECUTE()
+  rateScheduleEntry_t unstaggered[sizeof(stabilizerSchedule) / sizeof(stabilizerSchedule[0])];
+  for (int i = 0; i < stabilizerScheduleCount; i++) {
+    unstaggered[i] = stabilizerSchedule[i];
+    unstaggered[i].phase = 0;
+  }
+
+  // Test
+  uint32_t actual = rateScheduleMaxTickCost(stabilizerSchedule, stabilizerScheduleCount, NULL);
+  uint32_t actualUnstaggered = rateScheduleMaxTickCost(unstaggered, stabilizerScheduleCount, NULL);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT32(4, actual);
+  TEST_ASSERT_EQUAL_UINT32(stabilizerScheduleCount, actualUnstaggered);
+}
+
+void testThatThePositionChainRunsInOneTick(void) {
+  // Fixture
+  const rateScheduleEntry_t estimatorPosition = {.period = PERIOD(ESTIMATOR_POSITION_RATE), .phase = ESTIMATOR_POSITION_PHASE};
+  const rateScheduleEntry_t highLevelCommander = {.period = PERIOD(RATE_HL_COMMANDER), .phase = HL_COMMANDER_PHASE};
+  const rateScheduleEntry_t position = {.period = PERIOD(POSITION_RATE), .phase = POSITION_PHASE};
+
+  // Test
+  // Assert
+  for (uint32_t tick = 0; tick < PERIOD(POSITION_RATE); tick++) {
+    TEST_ASSERT_EQUAL(rateScheduleIsDue(&position, tick), rateScheduleIsDue(&estimatorPosition, tick));
+    TEST_ASSERT_EQUAL(rateScheduleIsDue(&position, tick), rateScheduleIsDue(&highLevelCommander, tick));
+  }
+}
+
+void testThatTheAttitudeLoopRunsInTheTickAfterThePositionLoop(void) {
+  // Fixture
+  const rateScheduleEntry_t attitude = {.period = PERIOD(ATTITUDE_RATE), .phase = ATTITUDE_PHASE};
+
+  // Test
+  // Assert
+  TEST_ASSERT_FALSE(rateScheduleIsDue(&attitude, POSITION_PHASE));
+  TEST_ASSERT_TRUE(rateScheduleIsDue(&attitude, POSITION_PHASE + 1));
+}
@@ -0,0 +1,182 @@
+#!/usr/bin/env python
+
+import os
+import struct
+import sys
+from zlib import crc32
+
+import numpy as np
+import pytest
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), '..', 'tools', 'usdlog'))
+import cfusdlog  # noqa: E402
+
+# Two event types, (name, [(variable, type character, delta encoded)])
+EVENTS = [
+    ('fixedFrequency', [('stateEstimate.x', 'f', False), ('pm.vbatMV', 'H', True), ('motor.m1', 'i', True)]),
+    ('estTDOA', [('idA', 'B', False), ('distanceDiff', 'f', False)]),
+]
+
+# (event index, timestamp [us], values)
+RECORDS = [
+    (0, 1000, (0.25, 3700, -5)),
+    (1, 1500, (3, -1.5)),
+    (0, 2000, (0.5, 3699, 70000)),
+    (0, 3000, (-0.125, 3705, -70000)),
+    (1, 3001, (255, 2.0)),
+    (0, 4000, (1.0e-3, 4000, 0)),
+]
+
+
+def _write_varint(value):
+    data = bytearray()
+    while value >= 0x80:
+        data.append((value & 0x7f) | 0x80)
+        value >>= 7
+    data.append(value)
+    return bytes(data)
+
+
+def _zigzag(value):
+    return (value << 1) ^ (value >> 63)
+
+
+def _header(version):
+    header = struct.pack('<BHH', 0xBC, version, len(EVENTS))
+    for event_id, (name, variables) in enumerate(EVENTS):
+        header += struct.pack('<H', event_id) + name.encode() + b'\0' + struct.pack('<H', len(variables))
+        for var_name, var_type, is_delta in variables:
+            suffix = ',delta' if is_delta and version == 3 else ''
+            header += '{}({}{})\0'.format(var_name, var_type, suffix).encode()
+    return header
+
+
+def _records_v12(version):
+    data = b''
+    for event_index, timestamp, values in RECORDS:
+        _, variables = EVENTS[event_index]
+        if version == 1:
+            data += struct.pack('<HI', event_index, timestamp)
+        else:
+            data += struct.pack('<HQ', event_index, timestamp)
+        data += struct.pack('<' + ''.join(var_type for _, var_type, _ in variables), *values)
+    return data
+
+
+def _block_v3(records, base_timestamp):
+    payload = b''
+    timestamp = base_timestamp
+    previous = [[0] * len(variables) for _, variables in EVENTS]
+    for event_index, record_timestamp, values in records:
+        _, variables = EVENTS[event_index]
+        payload += bytes([event_index]) + _write_varint(_zigzag(record_timestamp - timestamp))
+        timestamp = record_timestamp
+        deltas = b''
+        for i, ((_, var_type, is_delta), value) in enumerate(zip(variables, values)):
+            if is_delta:
+                deltas += _write_varint(_zigzag(value - previous[event_index][i]))
+                previous[event_index][i] = value
+            else:
+                payload += struct.pack('<' + var_type, value)
+        payload += deltas
+    block = cfusdlog.BLOCK_HEADER.pack(cfusdlog.BLOCK_MARKER, len(records), len(payload), base_timestamp) + payload
+    return block + struct.pack('<I', crc32(block))
+
+
+def _records_v3():
+    # Split over two blocks to check that the deltas restart in each block
+    return _block_v3(RECORDS[:3], 900) + _block_v3(RECORDS[3:], 2900)
+
+
+def write_log(filename, version):
+    data = _header(version)
+    if version == 3:
+        data += _records_v3()
+    else:
+        data += _records_v12(version)
+    data += struct.pack('<I', crc32(data))
+    with open(filename, 'wb') as f:
+        f.write(data)
+
+
+def expected_values(event_index):
+    records = [(timestamp, values) for index, timestamp, values in RECORDS if index == event_index]
+    timestamps = np.array([timestamp for timestamp, _ in records])
+    values = list(zip(*[values for _, values in records]))
+    return timestamps, values
+
+
+@pytest.mark.parametrize('version', [1, 2, 3])
+@pytest.mark.parametrize('native_types', [False, True])
+def test_that_decoded_log_matches_the_written_records(tmp_path, version, native_types):
+    # Fixture
+    filename = str(tmp_path / 'log{}.bin'.format(version))
+    write_log(filename, version)
+
+    # Test
+    actual = cfusdlog.decode(filename, native_types=native_types)
+
+    # Assert
+    assert list(actual.keys()) == [name for name, _ in EVENTS]
+    for event_index, (name, variables) in enumerate(EVENTS):
+        timestamps, values = expected_values(event_index)
+        if version == 1:
+            assert np.array_equal(actual[name]['timestamp'], timestamps)
+        else:
+            assert np.array_equal(actual[name]['timestamp'], timestamps / 1000.0)
+        for (var_name, var_type, _), expected in zip(variables, values):
+            assert np.array_equal(actual[name][var_name], np.array(expected, dtype='<' + var_type))
+
+
+@pytest.mark.parametrize('version', [1, 2, 3])
+def test_that_values_are_widened_by_default(tmp_path, version):
+    # Fixture
+    filename = str(tmp_path / 'log{}.bin'.format(version))
+    write_log(filename, version)
+
+    # Test
+    actual = cfusdlog.decode(filename)
+
+    # Assert
+    assert actual['fixedFrequency']['timestamp'].dtype == (np.int64 if version == 1 else np.float64)
+    assert actual['fixedFrequency']['stateEstimate.x'].dtype == np.float64
+    assert actual['fixedFrequency']['pm.vbatMV'].dtype == np.int64
+    assert actual['fixedFrequency']['motor.m1'].dtype == np.int64
+    assert actual['estTDOA']['idA'].dtype == np.int64
+    assert actual['estTDOA']['distanceDiff'].dtype == np.float64
+
+
+@pytest.mark.parametrize('version', [1, 2, 3])
+def test_that_logged_types_are_kept_with_native_types(tmp_path, version):
+    # Fixture
+    filename = str(tmp_path / 'log{}.bin'.format(version))
+    write_log(filename, version)
+
+    # Test
+    actual = cfusdlog.decode(filename, native_types=True)
+
+    # Assert
+    assert actual['fixedFrequency']['stateEstimate.x'].dtype == np.float32
+    assert actual['fixedFrequency']['pm.vbatMV'].dtype == np.uint16
+    assert actual['fixedFrequency']['motor.m1'].dtype == np.int32
+    assert actual['estTDOA']['idA'].dtype == np.uint8
+    assert actual['estTDOA']['distanceDiff'].dtype == np.float32
+
+
+@pytest.mark.parametrize('version', [2, 3])
+def test_that_chunks_add_up_to_the_complete_log(tmp_path, version):
+    # Fixture
+    filename = str(tmp_path / 'log{}.bin'.format(version))
+    write_log(filename, version)
+    expected = cfusdlog.decode(filename)
+
+    # Test
+    chunks = list(cfusdlog.iter_decode(filename, chunk_size=1))
+
+    # Assert
+    assert len(chunks) > 1
+    for name, variables in expected.items():
+        for var_name, values in variables.items():
+            actual = np.concatenate([chunk[name][var_name] for chunk in chunks if name in chunk])
+            assert np.array_equal(actual, values)
+            assert actual.dtype == values.dtype
@@ -0,0 +1,101 @@
+#!/usr/bin/env python
+
+import numpy as np
+import pytest
+
+import cffirmware
+
+STEPS = 50
+
+
+def make_inputs(vehicles, steps):
+    setpoints = np.zeros((vehicles, steps), dtype=cffirmware.setpoint_dtype)
+    setpoints['mode']['x'] = cffirmware.modeAbs
+    setpoints['mode']['y'] = cffirmware.modeAbs
+    setpoints['mode']['z'] = cffirmware.modeAbs
+    setpoints['mode']['yaw'] = cffirmware.modeAbs
+    setpoints['position']['z'] = 1.0
+
+    sensors = np.zeros((vehicles, steps), dtype=cffirmware.sensor_data_dtype)
+    sensors['gyro']['x'] = np.linspace(-5.0, 5.0, steps)
+
+    states = np.zeros((vehicles, steps), dtype=cffirmware.state_dtype)
+    states['position']['x'] = np.linspace(0.0, 0.2, steps)
+    states['position']['z'] = np.linspace(0.5, 0.9, steps)
+    states['attitude']['roll'] = np.linspace(-2.0, 2.0, steps)
+
+    return setpoints, sensors, states
+
+
+def run_single_steps(init, update, setpoints, sensors, states, tick):
+    init()
+    control = cffirmware.control_t()
+    controls = []
+    for s in range(len(setpoints)):
+        setpoint = cffirmware.setpoint_t()
+        setpoint.mode.x = int(setpoints[s]['mode']['x'])
+        setpoint.mode.y = int(setpoints[s]['mode']['y'])
+        setpoint.mode.z = int(setpoints[s]['mode']['z'])
+        setpoint.mode.yaw = int(setpoints[s]['mode']['yaw'])
+        setpoint.position.z = float(setpoints[s]['position']['z'])
+
+        sensor = cffirmware.sensorData_t()
+        sensor.gyro.x = float(sensors[s]['gyro']['x'])
+
+        state = cffirmware.state_t()
+        state.position.x = float(states[s]['position']['x'])
+        state.position.z = float(states[s]['position']['z'])
+        state.attitude.roll = float(states[s]['attitude']['roll'])
+
+        update(control, setpoint, sensor, state, tick + s)
+        controls.append((control.roll, control.pitch, control.yaw, control.thrust))
+    return controls
+
+
+@pytest.mark.parametrize("controller, init, update", [
+    (cffirmware.ControllerTypePID, lambda: (cffirmware.controllerPidInit(), cffirmware.controllerPidReset()), cffirmware.controllerPid),
+    (cffirmware.ControllerTypeMellinger, cffirmware.controllerMellingerInit, cffirmware.controllerMellinger),
+])
+def test_controller_batch_matches_single_steps(controller, init, update):
+    setpoints, sensors, states = make_inputs(1, STEPS)
+    tick = 1
+
+    controls, motors = cffirmware.controller_batch(controller, setpoints[0], sensors[0], states[0], tick=tick)
+
+    expected = run_single_steps(init, update, setpoints[0], sensors[0], states[0], tick)
+    assert controls.shape == (STEPS,)
+    assert motors.shape == (STEPS,)
+    for s in range(STEPS):
+        assert tuple(controls[s]) == pytest.approx(expected[s])
+
+
+def test_controller_batch_vehicles_are_independent():
+    setpoints, sensors, states = make_inputs(3, STEPS)
+
+    controls, motors = cffirmware.controller_batch(cffirmware.ControllerTypePID, setpoints, sensors, states, tick=1)
+
+    assert controls.shape == (3, STEPS)
+    assert (controls[0] == controls[1]).all()
+    assert (controls[0] == controls[2]).all()
+    assert (motors[0] == motors[2]).all()
+
+
+@pytest.mark.parametrize("ctype, dtype", [
+    ("setpoint_t", cffirmware.setpoint_dtype),
+    ("sensorData_t", cffirmware.sensor_data_dtype),
+    ("state_t", cffirmware.state_dtype),
+    ("control_t", cffirmware.control_dtype),
+    ("motors_thrust_t", cffirmware.motors_thrust_dtype),
+])
+def test_controller_batch_dtypes_match_firmware_structs(ctype, dtype):
+    assert dtype.itemsize == cffirmware.controllerBatchSizeof(ctype)
+    assert len(dtype.names) == cffirmware.controllerBatchFieldCount(ctype)
+    for name in dtype.names:
+        assert dtype.fields[name][1] == cffirmware.controllerBatchOffsetof(ctype, name)
+
+
+def test_controller_batch_unsupported_controller():
+    setpoints, sensors, states = make_inputs(1, STEPS)
+
+    with pytest.raises(ValueError):
+        cffirmware.controller_batch(cffirmware.ControllerTypeINDI, setpoints, sensors, states)
@@ -33,9 +33,10 @@ def test_controller_pid():
     sensors.gyro.y = 0
     sensors.gyro.z = 0
 
-    tick = 100
-
-    cffirmware.controllerPid(control, setpoint,sensors,state,tick)
+    # The position loop runs in tick 101 (POSITION_PHASE) and the attitude
+    # loop uses its output in tick 102
+    cffirmware.controllerPid(control, setpoint,sensors,state,101)
+    cffirmware.controllerPid(control, setpoint,sensors,state,102)
     # control.thrust will be at a (tuned) hover-state
     assert control.roll == 0
     assert control.pitch == 0
@@ -0,0 +1,96 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--'  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2023 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * crc32_benchmark.c - Host side benchmark of the CRC32 calculation
+ *
+ * Times crc32CalculateBuffer() on a random buffer and compares it to a bit wise reference calculation. The results
+ * are checked against the reference, test/utils/src/test_crc32.c covers the correctness.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "crc32.h"
+
+#define BUFFER_SIZE 4096
+#define DEFAULT_RUNS 20000
+
+static uint8_t buffer[BUFFER_SIZE];
+
+// Reference implementation, one bit at the time
+static uint32_t referenceCrc32(const uint8_t* data, size_t size) {
+  uint32_t remainder = 0xFFFFFFFF;
+  for (size_t i = 0; i < size; i++) {
+    remainder ^= data[i];
+    for (int bit = 0; bit < 8; bit++) {
+      remainder = (remainder & 1) ? (remainder >> 1) ^ 0xEDB88320 : remainder >> 1;
+    }
+  }
+  return remainder ^ 0xFFFFFFFF;
+}
+
+static double nsPerByte(clock_t start, int runs) {
+  return 1e9 * (double)(clock() - start) / CLOCKS_PER_SEC / ((double)runs * BUFFER_SIZE);
+}
+
+int main(int argc, char* argv[]) {
+  const int runs = (argc > 1) ? atoi(argv[1]) : DEFAULT_RUNS;
+  if (runs <= 0) {
+    fprintf(stderr, "Usage: %s [number of runs, default %d]\n", argv[0], DEFAULT_RUNS);
+    return 1;
+  }
+
+  srand(4711);
+  for (int i = 0; i < BUFFER_SIZE; i++) {
+    buffer[i] = rand();
+  }
+
+  const uint32_t expected = referenceCrc32(buffer, BUFFER_SIZE);
+  uint32_t actual = 0;
+
+  clock_t start = clock();
+  for (int run = 0; run < runs; run++) {
+    actual = crc32CalculateBuffer(buffer, BUFFER_SIZE);
+  }
+  const double time = nsPerByte(start, runs);
+
+  // The reference is much slower, it is run fewer times
+  const int referenceRuns = (runs + 19) / 20;
+  volatile uint32_t sink = 0;
+  start = clock();
+  for (int run = 0; run < referenceRuns; run++) {
+    sink ^= referenceCrc32(buffer, BUFFER_SIZE);
+  }
+  const double referenceTime = nsPerByte(start, referenceRuns);
+  (void)sink;
+
+  printf("CRC32: %.2f ns per byte, bit wise reference %.2f ns per byte\n", time, referenceTime);
+
+  if (actual != expected) {
+    printf("FAIL: CRC32 0x%08x, expected 0x%08x\n", (unsigned int)actual, (unsigned int)expected);
+    return 2;
+  }
+
+  return 0;
+}
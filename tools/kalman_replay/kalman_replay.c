@@ -0,0 +1,994 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--'  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2022 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * kalman_replay.c - Host side replay of estimator measurements recorded with the uSD deck
+ *
+ * Measurements recorded with the est* event triggers (see tools/usdlog/config_kalman.txt) are fed through the
+ * kalman core in the same order and at the same rates as in the kalman estimator task, using the logged time stamps
+ * as the time base. Every call into the kalman core is timed and the result is reported as per call histograms,
+ * together with the error of the final state compared to a reference.
+ *
+ * Measurements that depend on system configuration that is not part of the log (anchor positions for TDoA and TWR,
+ * base station geometry and calibration for lighthouse sweep angles) can not be replayed and are counted as skipped.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "kalman_core.h"
+#include "kalman_supervisor.h"
+#include "outlierFilter.h"
+#include "physicalConstants.h"
+#include "crc32.h"
+
+#include "mm_absolute_height.h"
+#include "mm_flow.h"
+#include "mm_pose.h"
+#include "mm_position.h"
+#include "mm_tof.h"
+#include "mm_yaw_error.h"
+
+
+// uSD log file format ////////////////////////////////////////////////////////
+
+#define USD_MAGIC 0xBC
+#define USD_CRC_SIZE 4
+#define USD_MAX_EVENT_TYPES 64
+#define USD_MAX_VARIABLES 32
+#define USD_MAX_NAME_LENGTH 64
+#define USD_MAX_RECORD_SIZE (USD_MAX_VARIABLES * 4)
+
+// Version 3 block framing, see usddeck_encoder.h
+#define USD_BLOCK_MARKER 0xB3
+#define USD_BLOCK_HEADER_SIZE 13
+#define USD_BLOCK_CRC_SIZE 4
+
+typedef struct {
+  char name[USD_MAX_NAME_LENGTH];
+  char type;
+  int offset;
+  bool isDelta;
+} usdVariable_t;
+
+typedef struct {
+  uint16_t id;
+  char name[USD_MAX_NAME_LENGTH];
+  int numVariables;
+  usdVariable_t variables[USD_MAX_VARIABLES];
+  int payloadSize;
+  uint32_t skipped;
+  // Version 3, the size of the raw part of a record and the values of the delta encoded variables
+  int rawSize;
+  uint32_t previousValues[USD_MAX_VARIABLES];
+} usdEventType_t;
+
+typedef struct {
+  uint8_t* data;
+  size_t size;
+  uint16_t version;
+  int numEventTypes;
+  usdEventType_t eventTypes[USD_MAX_EVENT_TYPES];
+  size_t firstRecord;
+  size_t end;
+
+  // Version 3 reader state
+  size_t nextBlock;
+  size_t blockEnd;
+  uint64_t timestamp_us;
+  uint8_t record[USD_MAX_RECORD_SIZE];
+} usdLog_t;
+
+typedef struct {
+  const usdEventType_t* eventType;
+  uint64_t timestamp_us;
+  const uint8_t* payload;
+} usdRecord_t;
+
+static int usdTypeSize(char type) {
+  switch (type) {
+    case 'b': case 'B': return 1;
+    case 'h': case 'H': case 'e': return 2;
+    case 'i': case 'I': case 'f': return 4;
+    default: return -1;
+  }
+}
+
+static bool usdReadName(usdLog_t* log, size_t* idx, char* name) {
+  size_t len = 0;
+  while (*idx < log->end && log->data[*idx] != 0) {
+    if (len < USD_MAX_NAME_LENGTH - 1) {
+      name[len++] = log->data[*idx];
+    }
+    (*idx)++;
+  }
+  name[len] = '\0';
+  (*idx)++;
+  return *idx <= log->end;
+}
+
+static bool usdOpen(usdLog_t* log, const char* fileName) {
+  memset(log, 0, sizeof(*log));
+
+  FILE* file = fopen(fileName, "rb");
+  if (!file) {
+    perror(fileName);
+    return false;
+  }
+
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  if (size < 5 + USD_CRC_SIZE) {
+    fprintf(stderr, "%s: file too short\n", fileName);
+    fclose(file);
+    return false;
+  }
+
+  log->size = size;
+  log->data = malloc(log->size);
+  if (fread(log->data, 1, log->size, file) != log->size) {
+    fprintf(stderr, "%s: read failed\n", fileName);
+    fclose(file);
+    return false;
+  }
+  fclose(file);
+
+  log->end = log->size - USD_CRC_SIZE;
+
+  if (log->data[0] != USD_MAGIC) {
+    fprintf(stderr, "%s: unsupported format\n", fileName);
+    return false;
+  }
+
+  uint16_t numEventTypes;
+  memcpy(&log->version, &log->data[1], 2);
+  memcpy(&numEventTypes, &log->data[3], 2);
+  if (log->version < 1 || log->version > 3) {
+    fprintf(stderr, "%s: unsupported version %d\n", fileName, log->version);
+    return false;
+  }
+  if (numEventTypes > USD_MAX_EVENT_TYPES) {
+    fprintf(stderr, "%s: too many event types (%d)\n", fileName, numEventTypes);
+    return false;
+  }
+
+  size_t idx = 5;
+  for (int i = 0; i < numEventTypes; i++) {
+    usdEventType_t* et = &log->eventTypes[i];
+    uint16_t numVariables;
+
+    memcpy(&et->id, &log->data[idx], 2);
+    idx += 2;
+    usdReadName(log, &idx, et->name);
+    memcpy(&numVariables, &log->data[idx], 2);
+    idx += 2;
+    if (numVariables > USD_MAX_VARIABLES) {
+      fprintf(stderr, "%s: too many variables in %s (%d)\n", fileName, et->name, numVariables);
+      return false;
+    }
+
+    et->numVariables = numVariables;
+    for (int j = 0; j < numVariables; j++) {
+      usdVariable_t* var = &et->variables[j];
+      char nameAndType[USD_MAX_NAME_LENGTH];
+      usdReadName(log, &idx, nameAndType);
+
+      // Variables are stored as "group.name(t)", or "group.name(t,delta)" if delta encoded
+      char* type = strrchr(nameAndType, '(');
+      if (!type || usdTypeSize(type[1]) < 0 || (strcmp(&type[2], ")") != 0 && strcmp(&type[2], ",delta)") != 0)) {
+        fprintf(stderr, "%s: unsupported variable %s\n", fileName, nameAndType);
+        return false;
+      }
+      var->type = type[1];
+      var->isDelta = (type[2] == ',');
+      *type = '\0';
+      strcpy(var->name, nameAndType);
+      var->offset = et->payloadSize;
+      et->payloadSize += usdTypeSize(var->type);
+      if (!var->isDelta) {
+        et->rawSize += usdTypeSize(var->type);
+      }
+    }
+  }
+
+  log->numEventTypes = numEventTypes;
+  log->firstRecord = idx;
+  log->nextBlock = idx;
+  return true;
+}
+
+static const usdEventType_t* usdFindEventType(const usdLog_t* log, uint16_t id) {
+  for (int i = 0; i < log->numEventTypes; i++) {
+    if (log->eventTypes[i].id == id) {
+      return &log->eventTypes[i];
+    }
+  }
+  return 0;
+}
+
+static uint64_t usdReadVarint(const usdLog_t* log, size_t* idx) {
+  uint64_t value = 0;
+  int shift = 0;
+  uint8_t b;
+  do {
+    b = log->data[(*idx)++];
+    value |= (uint64_t)(b & 0x7f) << shift;
+    shift += 7;
+  } while ((b & 0x80) && *idx < log->blockEnd);
+  return value;
+}
+
+static int64_t usdUnzigzag(uint64_t value) {
+  return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+// Find the next version 3 block with a valid CRC at or after idx, corrupt blocks are skipped
+static bool usdNextBlock(usdLog_t* log, size_t* idx) {
+  bool inSync = true;
+  while (*idx + USD_BLOCK_HEADER_SIZE + USD_BLOCK_CRC_SIZE <= log->end) {
+    const uint8_t* header = &log->data[*idx];
+    uint16_t length;
+    memcpy(&length, &header[3], 2);
+    const size_t blockEnd = *idx + USD_BLOCK_HEADER_SIZE + length;
+
+    if (header[0] == USD_BLOCK_MARKER && blockEnd + USD_BLOCK_CRC_SIZE <= log->end) {
+      uint32_t crc;
+      memcpy(&crc, &log->data[blockEnd], 4);
+      if (crc32CalculateBuffer(header, blockEnd - *idx) == crc) {
+        memcpy(&log->timestamp_us, &header[5], 8);
+        for (int i = 0; i < log->numEventTypes; i++) {
+          memset(log->eventTypes[i].previousValues, 0, sizeof(log->eventTypes[i].previousValues));
+        }
+        log->blockEnd = blockEnd;
+        log->nextBlock = blockEnd + USD_BLOCK_CRC_SIZE;
+        *idx += USD_BLOCK_HEADER_SIZE;
+        return true;
+      }
+    }
+
+    if (inSync) {
+      fprintf(stderr, "corrupt block at offset %zu\n", *idx);
+      inSync = false;
+    }
+    (*idx)++;
+  }
+  return false;
+}
+
+// Read a version 3 record, the values are unpacked to the layout of the older versions
+static bool usdNextRecordV3(usdLog_t* log, size_t* idx, usdRecord_t* record) {
+  if (*idx >= log->blockEnd) {
+    *idx = log->nextBlock;
+    if (!usdNextBlock(log, idx)) {
+      return false;
+    }
+  }
+
+  const uint8_t eventIndex = log->data[(*idx)++];
+  if (eventIndex >= log->numEventTypes) {
+    return false;
+  }
+  usdEventType_t* et = &log->eventTypes[eventIndex];
+  log->timestamp_us += usdUnzigzag(usdReadVarint(log, idx));
+  if (*idx + et->rawSize > log->blockEnd) {
+    return false;
+  }
+
+  const uint8_t* raw = &log->data[*idx];
+  *idx += et->rawSize;
+  for (int i = 0; i < et->numVariables; i++) {
+    const usdVariable_t* var = &et->variables[i];
+    const int size = usdTypeSize(var->type);
+    if (var->isDelta) {
+      et->previousValues[i] += (uint32_t)usdUnzigzag(usdReadVarint(log, idx));
+      memcpy(&log->record[var->offset], &et->previousValues[i], size);
+    } else {
+      memcpy(&log->record[var->offset], raw, size);
+      raw += size;
+    }
+  }
+
+  record->eventType = et;
+  record->timestamp_us = log->timestamp_us;
+  record->payload = log->record;
+  return true;
+}
+
+// Read the record at idx and advance idx to the next record. Returns false at the end of the log.
+static bool usdNextRecord(usdLog_t* log, size_t* idx, usdRecord_t* record) {
+  if (log->version == 3) {
+    return usdNextRecordV3(log, idx, record);
+  }
+
+  const int headerSize = (log->version == 1) ? 6 : 10;
+  if (*idx + headerSize > log->end) {
+    return false;
+  }
+
+  uint16_t id;
+  memcpy(&id, &log->data[*idx], 2);
+  if (log->version == 1) {
+    uint32_t timestamp_ms;
+    memcpy(&timestamp_ms, &log->data[*idx + 2], 4);
+    record->timestamp_us = (uint64_t)timestamp_ms * 1000;
+  } else {
+    memcpy(&record->timestamp_us, &log->data[*idx + 2], 8);
+  }
+
+  record->eventType = usdFindEventType(log, id);
+  if (!record->eventType || *idx + headerSize + record->eventType->payloadSize > log->end) {
+    return false;
+  }
+
+  record->payload = &log->data[*idx + headerSize];
+  *idx += headerSize + record->eventType->payloadSize;
+  return true;
+}
+
+static float fp16ToFloat(uint16_t h) {
+  const int sign = (h >> 15) & 0x1;
+  const int exponent = (h >> 10) & 0x1f;
+  const int mantissa = h & 0x3ff;
+
+  float value;
+  if (exponent == 0) {
+    value = ldexpf((float)mantissa, -24);
+  } else if (exponent == 31) {
+    value = mantissa ? NAN : INFINITY;
+  } else {
+    value = ldexpf((float)(mantissa | 0x400), exponent - 25);
+  }
+  return sign ? -value : value;
+}
+
+static float usdGetValue(const usdRecord_t* record, int varIndex) {
+  const usdVariable_t* var = &record->eventType->variables[varIndex];
+  const uint8_t* p = record->payload + var->offset;
+  union { int8_t i8; uint8_t u8; int16_t i16; uint16_t u16; int32_t i32; uint32_t u32; float f; } v;
+  memcpy(&v, p, usdTypeSize(var->type));
+
+  switch (var->type) {
+    case 'b': return v.i8;
+    case 'B': return v.u8;
+    case 'h': return v.i16;
+    case 'H': return v.u16;
+    case 'i': return v.i32;
+    case 'I': return v.u32;
+    case 'f': return v.f;
+    case 'e': return fp16ToFloat(v.u16);
+    default: return NAN;
+  }
+}
+
+static int usdFindVariable(const usdEventType_t* et, const char* name) {
+  for (int i = 0; i < et->numVariables; i++) {
+    if (strcmp(et->variables[i].name, name) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// Get the values of a list of variables, tries the alternative names in order. Returns false if any is missing.
+static bool usdGetValues(const usdRecord_t* record, const char* const names[], int count, float* values) {
+  for (int i = 0; i < count; i++) {
+    int varIndex = usdFindVariable(record->eventType, names[i]);
+    if (varIndex < 0) {
+      return false;
+    }
+    values[i] = usdGetValue(record, varIndex);
+  }
+  return true;
+}
+
+
+// Timing ////////////////////////////////////////////////////////////////////
+
+#define HISTOGRAM_BUCKETS 32
+
+typedef enum {
+  callPredict,
+  callPredictCovariance,
+  callAddProcessNoise,
+  callFinalize,
+  callExternalize,
+  callUpdatePosition,
+  callUpdatePose,
+  callUpdateTof,
+  callUpdateFlow,
+  callUpdateYawError,
+  callUpdateBaro,
+  callCount,
+} call_t;
+
+static const char* const callNames[callCount] = {
+  [callPredict] = "predict",
+  [callPredictCovariance] = "predictCovariance",
+  [callAddProcessNoise] = "addProcessNoise",
+  [callFinalize] = "finalize",
+  [callExternalize] = "externalize",
+  [callUpdatePosition] = "updatePosition",
+  [callUpdatePose] = "updatePose",
+  [callUpdateTof] = "updateTof",
+  [callUpdateFlow] = "updateFlow",
+  [callUpdateYawError] = "updateYawError",
+  [callUpdateBaro] = "updateBaro",
+};
+
+typedef struct {
+  uint64_t count;
+  uint64_t totalNs;
+  uint64_t minNs;
+  uint64_t maxNs;
+  uint64_t totalCycles;
+  // Bucket i holds calls that took [2^i, 2^(i+1)) ns
+  uint64_t histogram[HISTOGRAM_BUCKETS];
+} timingStats_t;
+
+static timingStats_t timingStats[callCount];
+
+static inline uint64_t nowNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static inline uint64_t nowCycles() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+static void timingAdd(call_t call, uint64_t ns, uint64_t cycles) {
+  timingStats_t* stats = &timingStats[call];
+
+  if (stats->count == 0 || ns < stats->minNs) {
+    stats->minNs = ns;
+  }
+  if (ns > stats->maxNs) {
+    stats->maxNs = ns;
+  }
+  stats->count++;
+  stats->totalNs += ns;
+  stats->totalCycles += cycles;
+
+  int bucket = 0;
+  while (bucket < HISTOGRAM_BUCKETS - 1 && (ns >> (bucket + 1)) != 0) {
+    bucket++;
+  }
+  stats->histogram[bucket]++;
+}
+
+#define TIMED(CALL, STATEMENT) do { \
+    const uint64_t t0 = nowNs(); \
+    const uint64_t c0 = nowCycles(); \
+    STATEMENT; \
+    const uint64_t c1 = nowCycles(); \
+    const uint64_t t1 = nowNs(); \
+    timingAdd(CALL, t1 - t0, c1 - c0); \
+  } while (0)
+
+// Upper bound of the bucket holding the given percentile
+static uint64_t timingPercentile(const timingStats_t* stats, float percentile) {
+  const uint64_t limit = (uint64_t)ceilf(stats->count * percentile / 100.0f);
+  uint64_t sum = 0;
+  for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+    sum += stats->histogram[i];
+    if (sum >= limit) {
+      return 2ull << i;
+    }
+  }
+  return stats->maxNs;
+}
+
+
+// Replay ////////////////////////////////////////////////////////////////////
+
+typedef struct {
+  int predictRate;
+  float stdDevPos;
+  float stdDevQuat;
+  float stdDevFlow;
+  float stdDevYawError;
+  float stdDevHeight;
+  bool useBaro;
+  bool retrodict;
+  float maxError;
+  bool verbose;
+} options_t;
+
+static options_t options = {
+  .predictRate = 100,
+  .stdDevPos = 0.01f,
+  .stdDevQuat = 4.5e-3f,
+  .stdDevFlow = 2.0f,
+  .stdDevYawError = 0.01f,
+  .stdDevHeight = 0.01f,
+  .useBaro = false,
+  .retrodict = true,
+  .maxError = -1.0f,
+  .verbose = false,
+};
+
+static kalmanCoreData_t coreData;
+static kalmanCoreParams_t coreParams;
+static OutlierFilterLhState_t sweepOutlierFilterState;
+static kalmanCoreHistory_t history;
+
+static Axis3f accAccumulator;
+static Axis3f gyroAccumulator;
+static uint32_t accAccumulatorCount;
+static uint32_t gyroAccumulatorCount;
+static Axis3f accLatest;
+static Axis3f gyroLatest;
+static bool quadIsFlying = false;
+static state_t state;
+
+static uint32_t nrOfResets = 0;
+static uint32_t nrOfReplayedEvents = 0;
+static uint32_t nrOfSkippedEvents = 0;
+static uint32_t nrOfRetrodictions = 0;
+
+// Predictions are triggered by accelerometer samples, as in the kalman estimator
+static uint64_t lastPrediction;
+static uint64_t nextPrediction;
+static uint64_t lastAccTimestamp;
+static uint32_t accSampleInterval;
+static Axis3f covarianceGyroAccumulator;
+static float covarianceDt;
+static int predictionsSinceCovariancePrediction;
+
+// Position reference, from position or pose measurements, or a logged on board estimate
+static bool hasReference = false;
+static float reference[3];
+static double sumOfSquaredErrors = 0.0;
+static uint32_t nrOfErrorSamples = 0;
+
+// Tracks when the last flow measurement was received, to calculate dt
+static uint64_t lastFlowTimestamp_us = 0;
+
+static const char* const gyroNames[] = {"gyro.x", "gyro.y", "gyro.z"};
+static const char* const accNames[] = {"acc.x", "acc.y", "acc.z"};
+static const char* const locSrvPosNames[] = {"locSrv.x", "locSrv.y", "locSrv.z"};
+static const char* const lighthousePosNames[] = {"lighthouse.x", "lighthouse.y", "lighthouse.z"};
+static const char* const poseNames[] = {"locSrv.x", "locSrv.y", "locSrv.z", "locSrv.qx", "locSrv.qy", "locSrv.qz", "locSrv.qw"};
+static const char* const stateEstimateNames[] = {"stateEstimate.x", "stateEstimate.y", "stateEstimate.z"};
+static const char* const flowNames[] = {"motion.deltaX", "motion.deltaY"};
+static const char* const tofNames[] = {"range.zrange"};
+static const char* const baroNames[] = {"baro.asl"};
+static const char* const yawErrorNames[] = {"yawError"};
+
+static void resetEstimator() {
+  accAccumulator = (Axis3f){.axis = {0}};
+  gyroAccumulator = (Axis3f){.axis = {0}};
+  accAccumulatorCount = 0;
+  gyroAccumulatorCount = 0;
+  outlierFilterReset(&sweepOutlierFilterState, 0);
+  kalmanCoreHistoryInit(&history);
+
+  lastPrediction = 0;
+  lastAccTimestamp = 0;
+  accSampleInterval = 1000;
+  covarianceGyroAccumulator = (Axis3f){.axis = {0}};
+  covarianceDt = 0.0f;
+  predictionsSinceCovariancePrediction = 0;
+
+  kalmanCoreInit(&coreData, &coreParams);
+}
+
+static void updateReference(const float position[3]) {
+  for (int i = 0; i < 3; i++) {
+    reference[i] = position[i];
+  }
+  hasReference = true;
+
+  double squaredError = 0.0;
+  for (int i = 0; i < 3; i++) {
+    double error = coreData.S[KC_STATE_X + i] - position[i];
+    squaredError += error * error;
+  }
+  sumOfSquaredErrors += squaredError;
+  nrOfErrorSamples++;
+}
+
+static bool isPredictionDue(const uint64_t timestamp) {
+  if (lastAccTimestamp != 0) {
+    accSampleInterval = (7 * accSampleInterval + (uint32_t)(timestamp - lastAccTimestamp)) / 8;
+  }
+  lastAccTimestamp = timestamp;
+
+  if (lastPrediction == 0) {
+    lastPrediction = timestamp;
+    nextPrediction = timestamp + 1000000 / options.predictRate;
+    return false;
+  }
+
+  return timestamp + accSampleInterval / 2 >= nextPrediction;
+}
+
+static bool predictStateForward(uint64_t timestamp) {
+  if (gyroAccumulatorCount == 0 || accAccumulatorCount == 0) {
+    return false;
+  }
+
+  const float dt = (timestamp - lastPrediction) / 1e6f;
+
+  // gyro is in deg/sec but the estimator requires rad/sec
+  Axis3f gyroAverage;
+  gyroAverage.x = gyroAccumulator.x * DEG_TO_RAD / gyroAccumulatorCount;
+  gyroAverage.y = gyroAccumulator.y * DEG_TO_RAD / gyroAccumulatorCount;
+  gyroAverage.z = gyroAccumulator.z * DEG_TO_RAD / gyroAccumulatorCount;
+
+  // accelerometer is in Gs but the estimator requires ms^-2
+  Axis3f accAverage;
+  accAverage.x = accAccumulator.x * GRAVITY_MAGNITUDE / accAccumulatorCount;
+  accAverage.y = accAccumulator.y * GRAVITY_MAGNITUDE / accAccumulatorCount;
+  accAverage.z = accAccumulator.z * GRAVITY_MAGNITUDE / accAccumulatorCount;
+
+  accAccumulator = (Axis3f){.axis = {0}};
+  accAccumulatorCount = 0;
+  gyroAccumulator = (Axis3f){.axis = {0}};
+  gyroAccumulatorCount = 0;
+
+  // There is no supervisor on the host, approximate the flying state from the thrust
+  quadIsFlying = accAverage.z > 0.5f * GRAVITY_MAGNITUDE && coreData.S[KC_STATE_Z] > 0.05f;
+
+  // The covariance is predicted at 100 Hz at most
+  const int predictionsPerCovariancePrediction = (options.predictRate + 99) / 100;
+  covarianceGyroAccumulator.x += gyroAverage.x * dt;
+  covarianceGyroAccumulator.y += gyroAverage.y * dt;
+  covarianceGyroAccumulator.z += gyroAverage.z * dt;
+  covarianceDt += dt;
+  predictionsSinceCovariancePrediction++;
+
+  if (predictionsSinceCovariancePrediction >= predictionsPerCovariancePrediction && covarianceDt > 0.0f) {
+    Axis3f covarianceGyro;
+    covarianceGyro.x = covarianceGyroAccumulator.x / covarianceDt;
+    covarianceGyro.y = covarianceGyroAccumulator.y / covarianceDt;
+    covarianceGyro.z = covarianceGyroAccumulator.z / covarianceDt;
+    TIMED(callPredictCovariance, kalmanCorePredictCovariance(&coreData, &covarianceGyro, covarianceDt));
+
+    covarianceGyroAccumulator = (Axis3f){.axis = {0}};
+    covarianceDt = 0.0f;
+    predictionsSinceCovariancePrediction = 0;
+  }
+
+  TIMED(callPredict, kalmanCorePredictStateWithHistory(&coreData, &history, &accAverage, &gyroAverage, dt, quadIsFlying, timestamp));
+
+  lastPrediction = timestamp;
+  nextPrediction += 1000000 / options.predictRate;
+  if (nextPrediction <= timestamp) {
+    nextPrediction = timestamp + 1000000 / options.predictRate;
+  }
+
+  return true;
+}
+
+// Apply one recorded measurement. Returns true if the state was updated.
+static bool applyMeasurement(const usdRecord_t* record) {
+  const char* name = record->eventType->name;
+  float v[7];
+
+  if (strcmp(name, "estGyroscope") == 0 && usdGetValues(record, gyroNames, 3, v)) {
+    gyroAccumulator.x += v[0];
+    gyroAccumulator.y += v[1];
+    gyroAccumulator.z += v[2];
+    gyroLatest = (Axis3f){.x = v[0], .y = v[1], .z = v[2]};
+    gyroAccumulatorCount++;
+    nrOfReplayedEvents++;
+    return false;
+  }
+
+  if (strcmp(name, "estAcceleration") == 0 && usdGetValues(record, accNames, 3, v)) {
+    accAccumulator.x += v[0];
+    accAccumulator.y += v[1];
+    accAccumulator.z += v[2];
+    accLatest = (Axis3f){.x = v[0], .y = v[1], .z = v[2]};
+    accAccumulatorCount++;
+    nrOfReplayedEvents++;
+    return isPredictionDue(record->timestamp_us) && predictStateForward(record->timestamp_us);
+  }
+
+  if (strcmp(name, "estPosition") == 0 &&
+      (usdGetValues(record, locSrvPosNames, 3, v) || usdGetValues(record, lighthousePosNames, 3, v))) {
+    positionMeasurement_t position = {.x = v[0], .y = v[1], .z = v[2], .stdDev = options.stdDevPos};
+    updateReference(position.pos);
+    TIMED(callUpdatePosition, kalmanCoreUpdateWithPosition(&coreData, &position));
+    nrOfReplayedEvents++;
+    return true;
+  }
+
+  if (strcmp(name, "estPose") == 0 && usdGetValues(record, poseNames, 7, v)) {
+    poseMeasurement_t pose = {.x = v[0], .y = v[1], .z = v[2],
+      .quat = {.x = v[3], .y = v[4], .z = v[5], .w = v[6]},
+      .stdDevPos = options.stdDevPos, .stdDevQuat = options.stdDevQuat};
+    updateReference(pose.pos);
+    TIMED(callUpdatePose, kalmanCoreUpdateWithPose(&coreData, &pose));
+    nrOfReplayedEvents++;
+    return true;
+  }
+
+  if (strcmp(name, "estTOF") == 0 && usdGetValues(record, tofNames, 1, v)) {
+    // Same noise model as the z-ranger v2 deck
+    const float expPointA = 2.5f;
+    const float expStdA = 0.0025f;
+    const float expPointB = 4.0f;
+    const float expStdB = 0.2f;
+    const float expCoeff = logf(expStdB / expStdA) / (expPointB - expPointA);
+
+    tofMeasurement_t tof = {.distance = v[0] * 0.001f};
+    tof.stdDev = expStdA * (1.0f + expf(expCoeff * (tof.distance - expPointA)));
+    TIMED(callUpdateTof, kalmanCoreUpdateWithTof(&coreData, &tof));
+    nrOfReplayedEvents++;
+    return true;
+  }
+
+  if (strcmp(name, "estFlow") == 0 && usdGetValues(record, flowNames, 2, v)) {
+    // Flip motion information to comply with sensor mounting, as in the flow deck driver
+    flowMeasurement_t flow = {.dpixelx = -v[1], .dpixely = -v[0], .stdDevX = options.stdDevFlow, .stdDevY = options.stdDevFlow};
+    flow.dt = lastFlowTimestamp_us ? (record->timestamp_us - lastFlowTimestamp_us) / 1e6f : 0.01f;
+    lastFlowTimestamp_us = record->timestamp_us;
+    TIMED(callUpdateFlow, kalmanCoreUpdateWithFlow(&coreData, &flow, &gyroLatest));
+    nrOfReplayedEvents++;
+    return true;
+  }
+
+  if (strcmp(name, "estYawError") == 0 && usdGetValues(record, yawErrorNames, 1, v)) {
+    yawErrorMeasurement_t yawError = {.yawError = v[0], .stdDev = options.stdDevYawError};
+    TIMED(callUpdateYawError, kalmanCoreUpdateWithYawError(&coreData, &yawError));
+    nrOfReplayedEvents++;
+    return true;
+  }
+
+  if (strcmp(name, "estBarometer") == 0 && usdGetValues(record, baroNames, 1, v)) {
+    nrOfReplayedEvents++;
+    if (options.useBaro) {
+      TIMED(callUpdateBaro, kalmanCoreUpdateWithBaro(&coreData, &coreParams, v[0], quadIsFlying));
+      return true;
+    }
+    return false;
+  }
+
+  // A logged on board estimate, for instance from a fixedFrequency event, is used as reference if present
+  if (usdGetValues(record, stateEstimateNames, 3, v)) {
+    updateReference(v);
+    return false;
+  }
+
+  ((usdEventType_t*)record->eventType)->skipped++;
+  nrOfSkippedEvents++;
+  return false;
+}
+
+// Apply a record, measurements taken before the latest prediction are fused with a retrodicted state as in the firmware
+static bool applyRecord(const usdRecord_t* record) {
+  const char* name = record->eventType->name;
+  const bool isImu = strcmp(name, "estGyroscope") == 0 || strcmp(name, "estAcceleration") == 0;
+
+  kalmanCoreRetrodiction_t retrodiction = {.isActive = false};
+  if (options.retrodict && !isImu && kalmanCoreRetrodictionStart(&coreData, &history, record->timestamp_us, &retrodiction)) {
+    nrOfRetrodictions++;
+  }
+
+  bool result = applyMeasurement(record);
+
+  kalmanCoreRetrodictionEnd(&coreData, &retrodiction);
+  return result;
+}
+
+// Replay the log, one iteration of the kalman task per ms (the stabilizer loop rate)
+static void replay(usdLog_t* log, double* duration) {
+  size_t idx = log->firstRecord;
+  usdRecord_t record;
+  bool hasRecord = usdNextRecord(log, &idx, &record);
+  if (!hasRecord) {
+    *duration = 0.0;
+    return;
+  }
+
+  const uint32_t firstTick = record.timestamp_us / 1000;
+  uint32_t tick = firstTick;
+  uint32_t lastPNUpdate = tick;
+
+  resetEstimator();
+
+  while (hasRecord) {
+    tick++;
+    bool doneUpdate = false;
+
+    {
+      float dt = (tick - lastPNUpdate) / 1000.0f;
+      if (dt > 0.0f) {
+        TIMED(callAddProcessNoise, kalmanCoreAddProcessNoise(&coreData, &coreParams, dt));
+        lastPNUpdate = tick;
+      }
+    }
+
+    // All measurements recorded before this tick are in the queue
+    while (hasRecord && record.timestamp_us / 1000 < tick) {
+      if (applyRecord(&record)) {
+        doneUpdate = true;
+      }
+      hasRecord = usdNextRecord(log, &idx, &record);
+    }
+
+    if (doneUpdate) {
+      TIMED(callFinalize, kalmanCoreFinalize(&coreData, tick));
+      if (!kalmanSupervisorIsStateWithinBounds(&coreData)) {
+        resetEstimator();
+        nrOfResets++;
+      }
+    }
+
+    TIMED(callExternalize, kalmanCoreExternalizeState(&coreData, &state, &accLatest, tick));
+  }
+
+  *duration = (tick - firstTick) / 1000.0;
+}
+
+
+// Report ////////////////////////////////////////////////////////////////////
+
+static void printReport(const usdLog_t* log, double duration) {
+  printf("Replayed %u events over %.1f s, %u skipped, %u retrodicted, %u estimator resets\n", nrOfReplayedEvents, duration, nrOfSkippedEvents, nrOfRetrodictions, nrOfResets);
+  for (int i = 0; i < log->numEventTypes; i++) {
+    const usdEventType_t* et = &log->eventTypes[i];
+    if (et->skipped) {
+      printf("  skipped %s: %u\n", et->name, et->skipped);
+    }
+  }
+
+  printf("\n%-16s %10s %10s %10s %10s %10s %10s %12s %10s\n", "call", "count", "mean[ns]", "min[ns]", "p50[ns]", "p99[ns]", "max[ns]", "mean[cycles]", "total[ms]");
+  for (int i = 0; i < callCount; i++) {
+    const timingStats_t* stats = &timingStats[i];
+    if (stats->count == 0) {
+      continue;
+    }
+    printf("%-16s %10lu %10lu %10lu %10lu %10lu %10lu %12lu %10.1f\n", callNames[i],
+      (unsigned long)stats->count,
+      (unsigned long)(stats->totalNs / stats->count),
+      (unsigned long)stats->minNs,
+      (unsigned long)timingPercentile(stats, 50.0f),
+      (unsigned long)timingPercentile(stats, 99.0f),
+      (unsigned long)stats->maxNs,
+      (unsigned long)(stats->totalCycles / stats->count),
+      stats->totalNs / 1e6);
+  }
+
+  if (options.verbose) {
+    for (int i = 0; i < callCount; i++) {
+      const timingStats_t* stats = &timingStats[i];
+      if (stats->count == 0) {
+        continue;
+      }
+
+      printf("\n%s [ns]\n", callNames[i]);
+      uint64_t maxBucket = 0;
+      for (int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+        if (stats->histogram[b] > maxBucket) {
+          maxBucket = stats->histogram[b];
+        }
+      }
+      for (int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+        if (stats->histogram[b] == 0) {
+          continue;
+        }
+        int bar = (int)(50 * stats->histogram[b] / maxBucket);
+        printf("  [%10lu, %10lu) %10lu %.*s\n", 1ul << b, 2ul << b, (unsigned long)stats->histogram[b], bar,
+          "##################################################");
+      }
+    }
+  }
+
+  printf("\nFinal state: x=%.3f y=%.3f z=%.3f roll=%.1f pitch=%.1f yaw=%.1f\n",
+    state.position.x, state.position.y, state.position.z, state.attitude.roll, state.attitude.pitch, state.attitude.yaw);
+}
+
+static float finalError() {
+  const float dx = coreData.S[KC_STATE_X] - reference[0];
+  const float dy = coreData.S[KC_STATE_Y] - reference[1];
+  const float dz = coreData.S[KC_STATE_Z] - reference[2];
+  return sqrtf(dx * dx + dy * dy + dz * dz);
+}
+
+static void usage(const char* name) {
+  fprintf(stderr, "Usage: %s [options] <uSD log file>\n"
+    "  -r <Hz>   prediction rate (default %d)\n"
+    "  -p <m>    std dev of position measurements (default %.3f)\n"
+    "  -q <rad>  std dev of pose quaternion measurements (default %.4f)\n"
+    "  -f <px>   std dev of flow measurements (default %.2f)\n"
+    "  -b        use barometer measurements\n"
+    "  -n        do not retrodict delayed measurements\n"
+    "  -e <m>    fail (exit code 2) if the final position error is larger than this\n"
+    "  -v        print timing histograms\n",
+    name, options.predictRate, options.stdDevPos, options.stdDevQuat, options.stdDevFlow);
+}
+
+int main(int argc, char* argv[]) {
+  int opt;
+  while ((opt = getopt(argc, argv, "r:p:q:f:bne:vh")) != -1) {
+    switch (opt) {
+      case 'r': options.predictRate = atoi(optarg); break;
+      case 'p': options.stdDevPos = atof(optarg); break;
+      case 'q': options.stdDevQuat = atof(optarg); break;
+      case 'f': options.stdDevFlow = atof(optarg); break;
+      case 'b': options.useBaro = true; break;
+      case 'n': options.retrodict = false; break;
+      case 'e': options.maxError = atof(optarg); break;
+      case 'v': options.verbose = true; break;
+      default: usage(argv[0]); return 1;
+    }
+  }
+
+  if (optind >= argc || options.predictRate <= 0 || options.predictRate > 1000) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  static usdLog_t log;
+  if (!usdOpen(&log, argv[optind])) {
+    return 1;
+  }
+
+  kalmanCoreDefaultParams(&coreParams);
+
+  double duration;
+  replay(&log, &duration);
+  printReport(&log, duration);
+
+  if (!hasReference) {
+    printf("No position reference in log\n");
+    return 0;
+  }
+
+  const float error = finalError();
+  printf("Position error: final %.4f m, rms %.4f m (%u samples)\n", error, sqrt(sumOfSquaredErrors / nrOfErrorSamples), nrOfErrorSamples);
+
+  if (options.maxError >= 0.0f && !(error <= options.maxError)) {
+    printf("FAIL: final position error above %.4f m\n", options.maxError);
+    return 2;
+  }
+
+  return 0;
+}
+
+// Support functions for the firmware modules on the host
+
+void assertFail(char *exp, char *file, int line) {
+  fprintf(stderr, "Assert failed %s:%d (%s)\n", file, line, exp);
+  abort();
+}
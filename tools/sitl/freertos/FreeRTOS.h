@@ -0,0 +1,88 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2023 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * FreeRTOS.h - Minimal FreeRTOS API for the software in the loop simulation
+ *
+ * The firmware is built against these headers instead of the FreeRTOS kernel. The API is implemented by the stub
+ * scheduler in sitl_freertos.c, that runs all tasks in one host thread and on a virtual clock.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef uint32_t TickType_t;
+typedef TickType_t portTickType;
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t StackType_t;
+
+#include "FreeRTOSConfig.h"
+
+#define pdTRUE  ((BaseType_t)1)
+#define pdFALSE ((BaseType_t)0)
+#define pdPASS  pdTRUE
+#define pdFAIL  pdFALSE
+#define errQUEUE_FULL  ((BaseType_t)0)
+#define errQUEUE_EMPTY ((BaseType_t)0)
+
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS ((TickType_t)1000 / configTICK_RATE_HZ)
+#define portTICK_RATE_MS portTICK_PERIOD_MS
+#define pdMS_TO_TICKS(ms) ((TickType_t)(((TickType_t)(ms) * configTICK_RATE_HZ) / 1000))
+
+// Tasks are only switched in blocking calls, there is nothing to protect against
+#define portENTER_CRITICAL()
+#define portEXIT_CRITICAL()
+#define taskENTER_CRITICAL()
+#define taskEXIT_CRITICAL()
+#define taskENTER_CRITICAL_FROM_ISR() 0
+#define taskEXIT_CRITICAL_FROM_ISR(x) (void)(x)
+#define taskDISABLE_INTERRUPTS()
+#define taskENABLE_INTERRUPTS()
+#define portYIELD_FROM_ISR(x) (void)(x)
+
+typedef void (*TaskFunction_t)(void *);
+typedef struct sitlTask* TaskHandle_t;
+typedef TaskHandle_t xTaskHandle;
+
+// The tasks are allocated by the scheduler, the static buffers of the firmware are not used
+typedef struct {
+  uint8_t unused;
+} StaticTask_t;
+
+// Queues and semaphores, a semaphore is a queue with items of size 0
+typedef struct sitlQueue {
+  uint8_t *storage;
+  UBaseType_t length;
+  UBaseType_t itemSize;
+  UBaseType_t count;
+  UBaseType_t head;
+} StaticQueue_t;
+typedef StaticQueue_t StaticSemaphore_t;
+
+typedef struct sitlQueue* QueueHandle_t;
+typedef QueueHandle_t xQueueHandle;
+typedef QueueHandle_t SemaphoreHandle_t;
+typedef QueueHandle_t xSemaphoreHandle;
@@ -0,0 +1,406 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2023 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * sitl_freertos.c - Stub scheduler of the software in the loop simulation
+ *
+ * The FreeRTOS API used by the firmware is implemented on a virtual clock. All tasks run in the host thread that
+ * started the scheduler, each on its own stack, and are only switched when a task blocks or wakes up a task with a
+ * higher priority. The ready task with the highest priority always runs, tasks with the same priority take turns.
+ * When all tasks are blocked the clock jumps to the next timeout, so the firmware runs as fast as the host can
+ * execute it and the result does not depend on the load of the host.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ucontext.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+#include "sitl_freertos.h"
+
+#define SITL_MAX_TASKS 32
+// Host code needs a lot more stack than the firmware configures for the target
+#define SITL_TASK_STACK_SIZE (512 * 1024)
+
+struct sitlTask {
+  ucontext_t context;
+  TaskFunction_t function;
+  void *parameters;
+  const char *name;
+  UBaseType_t priority;
+  void *tag;
+
+  bool isBlocked;
+  bool hasTimeout;
+  TickType_t wakeTime;
+  struct sitlQueue *waitingFor;
+
+  uint64_t runTime_ns;
+  uint32_t runCount;
+};
+
+static struct sitlTask tasks[SITL_MAX_TASKS];
+static int taskCount;
+static struct sitlTask *currentTask;
+static int lastTaskIndex;
+
+static ucontext_t schedulerContext;
+static bool isStopping;
+static TickType_t tickCount;
+
+static uint64_t hostTime_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+static void fatal(const char *message) {
+  fprintf(stderr, "sitl: %s (task %s)\n", message, currentTask ? currentTask->name : "none");
+  abort();
+}
+
+static bool isTimeReached(TickType_t time) {
+  return (int32_t)(tickCount - time) >= 0;
+}
+
+
+// Tasks //////////////////////////////////////////////////////////////////////
+
+static void runTask(void) {
+  currentTask->function(currentTask->parameters);
+  fatal("task returned");
+}
+
+TaskHandle_t xTaskCreateStatic(TaskFunction_t function, const char *name, uint32_t stackDepth, void *parameters,
+  UBaseType_t priority, StackType_t *stack, StaticTask_t *taskBuffer) {
+  if (taskCount >= SITL_MAX_TASKS) {
+    fatal("too many tasks");
+  }
+
+  struct sitlTask *task = &tasks[taskCount++];
+  task->function = function;
+  task->parameters = parameters;
+  task->name = name;
+  task->priority = priority;
+
+  getcontext(&task->context);
+  task->context.uc_stack.ss_sp = malloc(SITL_TASK_STACK_SIZE);
+  task->context.uc_stack.ss_size = SITL_TASK_STACK_SIZE;
+  task->context.uc_link = 0;
+  makecontext(&task->context, runTask, 0);
+
+  return task;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint16_t stackDepth, void *parameters,
+  UBaseType_t priority, TaskHandle_t *handle) {
+  TaskHandle_t task = xTaskCreateStatic(function, name, stackDepth, parameters, priority, 0, 0);
+  if (handle) {
+    *handle = task;
+  }
+  return pdPASS;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+  return currentTask;
+}
+
+void vTaskSetApplicationTaskTag(TaskHandle_t task, void *tag) {
+  if (!task) {
+    task = currentTask;
+  }
+  if (task) {
+    task->tag = tag;
+  }
+}
+
+TickType_t xTaskGetTickCount(void) {
+  return tickCount;
+}
+
+// Switch back to the scheduler, the current task continues when it is picked again
+static void yield(void) {
+  if (!currentTask) {
+    fatal("blocking call outside of a task");
+  }
+  swapcontext(&currentTask->context, &schedulerContext);
+}
+
+static void blockUntil(struct sitlQueue *queue, bool hasTimeout, TickType_t wakeTime) {
+  currentTask->isBlocked = true;
+  currentTask->waitingFor = queue;
+  currentTask->hasTimeout = hasTimeout;
+  currentTask->wakeTime = wakeTime;
+  yield();
+}
+
+void vTaskDelay(TickType_t ticks) {
+  if (ticks == 0) {
+    yield();
+  } else {
+    blockUntil(0, true, tickCount + ticks);
+  }
+}
+
+void vTaskDelayUntil(TickType_t *previousWakeTime, TickType_t increment) {
+  *previousWakeTime += increment;
+  if (isTimeReached(*previousWakeTime)) {
+    yield();
+  } else {
+    blockUntil(0, true, *previousWakeTime);
+  }
+}
+
+// The ready task with the highest priority, tasks with the same priority take turns
+static struct sitlTask *pickTask(void) {
+  struct sitlTask *picked = 0;
+  for (int i = 1; i <= taskCount; i++) {
+    struct sitlTask *task = &tasks[(lastTaskIndex + i) % taskCount];
+    if (!task->isBlocked && (!picked || task->priority > picked->priority)) {
+      picked = task;
+    }
+  }
+  return picked;
+}
+
+// Advance the clock to the next timeout and wake up the tasks waiting for it
+static bool advanceTime(void) {
+  bool hasTimeout = false;
+  TickType_t next = 0;
+  for (int i = 0; i < taskCount; i++) {
+    struct sitlTask *task = &tasks[i];
+    if (task->isBlocked && task->hasTimeout) {
+      if (!hasTimeout || (int32_t)(task->wakeTime - next) < 0) {
+        next = task->wakeTime;
+        hasTimeout = true;
+      }
+    }
+  }
+
+  if (!hasTimeout) {
+    return false;
+  }
+
+  if (!isTimeReached(next)) {
+    tickCount = next;
+  }
+  for (int i = 0; i < taskCount; i++) {
+    struct sitlTask *task = &tasks[i];
+    if (task->isBlocked && task->hasTimeout && isTimeReached(task->wakeTime)) {
+      task->isBlocked = false;
+      task->waitingFor = 0;
+    }
+  }
+  return true;
+}
+
+void vTaskStartScheduler(void) {
+  while (!isStopping) {
+    struct sitlTask *task = pickTask();
+    if (!task) {
+      if (!advanceTime()) {
+        fprintf(stderr, "sitl: all tasks are blocked without timeout at tick %u\n", (unsigned)tickCount);
+        return;
+      }
+      continue;
+    }
+
+    currentTask = task;
+    lastTaskIndex = task - tasks;
+    const uint64_t start = hostTime_ns();
+    swapcontext(&schedulerContext, &task->context);
+    task->runTime_ns += hostTime_ns() - start;
+    task->runCount++;
+    currentTask = 0;
+  }
+}
+
+void sitlSchedulerStop(void) {
+  isStopping = true;
+  yield();
+  fatal("stopped task resumed");
+}
+
+int sitlSchedulerGetTaskStats(sitlTaskStats_t *stats, int maxCount) {
+  for (int i = 0; i < taskCount && i < maxCount; i++) {
+    stats[i].name = tasks[i].name;
+    stats[i].priority = tasks[i].priority;
+    stats[i].runTime_ns = tasks[i].runTime_ns;
+    stats[i].runCount = tasks[i].runCount;
+  }
+  return taskCount;
+}
+
+
+// Queues and semaphores //////////////////////////////////////////////////////
+
+// Make the tasks waiting for the queue ready, they check the queue again when they run. Switch to a woken task
+// with higher priority, as the kernel would.
+static void wakeWaitingTasks(struct sitlQueue *queue) {
+  bool isPreempted = false;
+  for (int i = 0; i < taskCount; i++) {
+    struct sitlTask *task = &tasks[i];
+    if (task->isBlocked && task->waitingFor == queue) {
+      task->isBlocked = false;
+      task->waitingFor = 0;
+      if (currentTask && task->priority > currentTask->priority) {
+        isPreempted = true;
+      }
+    }
+  }
+
+  if (isPreempted) {
+    yield();
+  }
+}
+
+// Wait until the queue has items (or free space), returns false on timeout
+static bool waitForQueue(struct sitlQueue *queue, bool forItems, TickType_t wait) {
+  const TickType_t deadline = tickCount + wait;
+  while (forItems ? queue->count == 0 : queue->count == queue->length) {
+    if (wait == 0 || (wait != portMAX_DELAY && isTimeReached(deadline))) {
+      return false;
+    }
+    blockUntil(queue, wait != portMAX_DELAY, deadline);
+  }
+  return true;
+}
+
+QueueHandle_t xQueueCreateStatic(UBaseType_t length, UBaseType_t itemSize, uint8_t *storage, StaticQueue_t *queue) {
+  memset(queue, 0, sizeof(*queue));
+  queue->storage = storage;
+  queue->length = length;
+  queue->itemSize = itemSize;
+  return queue;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+  return xQueueCreateStatic(length, itemSize, calloc(length, itemSize ? itemSize : 1), malloc(sizeof(StaticQueue_t)));
+}
+
+static void *itemAt(struct sitlQueue *queue, UBaseType_t index) {
+  return queue->storage + ((queue->head + index) % queue->length) * queue->itemSize;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t wait) {
+  if (!waitForQueue(queue, false, wait)) {
+    return errQUEUE_FULL;
+  }
+
+  memcpy(itemAt(queue, queue->count), item, queue->itemSize);
+  queue->count++;
+  wakeWaitingTasks(queue);
+  return pdTRUE;
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item) {
+  if (queue->count == queue->length) {
+    memcpy(itemAt(queue, queue->count - 1), item, queue->itemSize);
+    return pdTRUE;
+  }
+  return xQueueSend(queue, item, 0);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void *buffer, TickType_t wait) {
+  if (!waitForQueue(queue, true, wait)) {
+    return errQUEUE_EMPTY;
+  }
+
+  memcpy(buffer, itemAt(queue, 0), queue->itemSize);
+  return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *buffer, TickType_t wait) {
+  if (!waitForQueue(queue, true, wait)) {
+    return errQUEUE_EMPTY;
+  }
+
+  if (buffer) {
+    memcpy(buffer, itemAt(queue, 0), queue->itemSize);
+  }
+  queue->head = (queue->head + 1) % queue->length;
+  queue->count--;
+  wakeWaitingTasks(queue);
+  return pdTRUE;
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue) {
+  queue->head = 0;
+  queue->count = 0;
+  wakeWaitingTasks(queue);
+  return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+  return queue->count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue) {
+  return queue->length - queue->count;
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initialCount) {
+  SemaphoreHandle_t semaphore = xQueueCreate(maxCount, 0);
+  semaphore->count = initialCount;
+  return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *semaphoreBuffer) {
+  static uint8_t noStorage;
+  return xQueueCreateStatic(1, 0, &noStorage, semaphoreBuffer);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+  return xSemaphoreCreateCounting(1, 0);
+}
+
+// Mutexes are binary semaphores that are given at creation, there is no priority inheritance
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *semaphoreBuffer) {
+  SemaphoreHandle_t mutex = xSemaphoreCreateBinaryStatic(semaphoreBuffer);
+  mutex->count = 1;
+  return mutex;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+  return xSemaphoreCreateCounting(1, 1);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t wait) {
+  return xQueueReceive(semaphore, 0, wait);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+  if (semaphore->count == semaphore->length) {
+    return pdFALSE;
+  }
+
+  semaphore->count++;
+  wakeWaitingTasks(semaphore);
+  return pdTRUE;
+}
@@ -0,0 +1,53 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2023 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * sitl_freertos.h - Control and statistics of the stub scheduler of the software in the loop simulation
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+
+typedef struct {
+  const char *name;
+  UBaseType_t priority;
+  // Host time spent running the task
+  uint64_t runTime_ns;
+  uint32_t runCount;
+} sitlTaskStats_t;
+
+/**
+ * @brief Stop the scheduler, vTaskStartScheduler() returns to the caller. Must be called from a task, the call
+ * does not return.
+ */
+void sitlSchedulerStop(void);
+
+/**
+ * @brief Get the statistics of the created tasks
+ *
+ * @param stats array to fill with the statistics
+ * @param maxCount size of the array
+ * @return the number of tasks
+ */
+int sitlSchedulerGetTaskStats(sitlTaskStats_t *stats, int maxCount);
@@ -0,0 +1,46 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2023 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * task.h - Minimal FreeRTOS task API for the software in the loop simulation
+ */
+#pragma once
+
+#include "FreeRTOS.h"
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint16_t stackDepth, void *parameters,
+  UBaseType_t priority, TaskHandle_t *handle);
+TaskHandle_t xTaskCreateStatic(TaskFunction_t function, const char *name, uint32_t stackDepth, void *parameters,
+  UBaseType_t priority, StackType_t *stack, StaticTask_t *taskBuffer);
+
+void vTaskStartScheduler(void);
+
+void vTaskDelay(TickType_t ticks);
+void vTaskDelayUntil(TickType_t *previousWakeTime, TickType_t increment);
+#define taskYIELD() vTaskDelay(0)
+
+TickType_t xTaskGetTickCount(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+void vTaskSetApplicationTaskTag(TaskHandle_t task, void *tag);
+
+#define vTaskSuspendAll()
+#define xTaskResumeAll() pdFALSE
@@ -0,0 +1,44 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2023 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * stm32f4xx.h - Peripheral types of the MCU for the software in the loop simulation
+ *
+ * Only the types that appear in the driver interfaces used by the simulated modules are declared, no peripheral
+ * is accessed on the host. The system control block is always read as thread mode, the simulation has no interrupts.
+ */
+#pragma once
+
+#include <stdint.h>
+
+typedef struct GPIO_TypeDef GPIO_TypeDef;
+typedef struct TIM_TypeDef TIM_TypeDef;
+typedef struct DMA_Stream_TypeDef DMA_Stream_TypeDef;
+typedef struct TIM_OCInitTypeDef TIM_OCInitTypeDef;
+
+typedef struct {
+  volatile uint32_t ICSR;
+} SCB_Type;
+
+extern SCB_Type sitlScb;
+#define SCB (&sitlScb)
+#define SCB_ICSR_VECTACTIVE_Msk 0x1FFUL
@@ -0,0 +1,468 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2023 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * sitl.c - Software in the loop simulation of the stabilizer loop
+ *
+ * The stabilizer task and the modules it calls run unmodified on a stub scheduler in simulated time, see
+ * freertos/sitl_freertos.c. Simulated sensors and a quadrotor model close the loop at 1 kHz, see sitl_hal.c. A
+ * scenario task flies take off, a position step and landing with the high level commander.
+ *
+ * Every stage of the stabilizer loop is timed on the host by wrapping it at link time (-Wl,--wrap, see the Makefile).
+ * The report contains per stage timing, host time per task, the speed compared to real time and the position error,
+ * the exit code can be used to fail a CI job on regressions.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "sitl_freertos.h"
+
+#include "stabilizer.h"
+#include "stabilizer_types.h"
+#include "estimator.h"
+#include "estimator_kalman.h"
+#include "controller.h"
+#include "commander.h"
+#include "crtp_commander_high_level.h"
+#include "collision_avoidance.h"
+#include "supervisor.h"
+#include "power_distribution.h"
+#include "sensors.h"
+
+#include "sitl_hal.h"
+#include "sitl_stubs.h"
+
+
+// Options ////////////////////////////////////////////////////////////////////
+
+typedef struct {
+  float duration;
+  float height;
+  float step;
+  StateEstimatorType estimator;
+  ControllerType controller;
+  sitlHalConfig_t hal;
+  float maxError;
+  bool verbose;
+} options_t;
+
+static options_t options = {
+  .duration = 12.0f,
+  .height = 1.0f,
+  .step = 0.5f,
+  .estimator = kalmanEstimator,
+  .controller = ControllerTypePID,
+  .hal = {
+    .gyroNoise = 0.1f,
+    .accNoise = 0.002f,
+    .baroNoise = 0.05f,
+    .positionNoise = 0.001f,
+    .positionRate = 100,
+    .seed = 1,
+  },
+  .maxError = -1.0f,
+  .verbose = false,
+};
+
+
+// Timing ////////////////////////////////////////////////////////////////////
+
+#define HISTOGRAM_BUCKETS 32
+
+typedef enum {
+  stageSensors,
+  stageEstimator,
+  stageHighLevelCommander,
+  stageCommander,
+  stageCollisionAvoidance,
+  stageController,
+  stageSupervisor,
+  stagePowerDistribution,
+  stageCount,
+} stage_t;
+
+static const char* const stageNames[stageCount] = {
+  [stageSensors] = "sensors",
+  [stageEstimator] = "estimator",
+  [stageHighLevelCommander] = "highLevelCmd",
+  [stageCommander] = "commander",
+  [stageCollisionAvoidance] = "collisionAvoid",
+  [stageController] = "controller",
+  [stageSupervisor] = "supervisor",
+  [stagePowerDistribution] = "powerDist",
+};
+
+typedef struct {
+  uint64_t count;
+  uint64_t totalNs;
+  uint64_t minNs;
+  uint64_t maxNs;
+  // Bucket i holds calls that took [2^i, 2^(i+1)) ns
+  uint64_t histogram[HISTOGRAM_BUCKETS];
+} timingStats_t;
+
+static timingStats_t timingStats[stageCount];
+
+static inline uint64_t nowNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void timingAdd(stage_t stage, uint64_t ns) {
+  timingStats_t* stats = &timingStats[stage];
+
+  if (stats->count == 0 || ns < stats->minNs) {
+    stats->minNs = ns;
+  }
+  if (ns > stats->maxNs) {
+    stats->maxNs = ns;
+  }
+  stats->count++;
+  stats->totalNs += ns;
+
+  int bucket = 0;
+  while (bucket < HISTOGRAM_BUCKETS - 1 && (ns >> (bucket + 1)) != 0) {
+    bucket++;
+  }
+  stats->histogram[bucket]++;
+}
+
+#define TIMED(STAGE, STATEMENT) do { \
+    const uint64_t t0 = nowNs(); \
+    STATEMENT; \
+    timingAdd(STAGE, nowNs() - t0); \
+  } while (0)
+
+// Upper bound of the bucket holding the given percentile
+static uint64_t timingPercentile(const timingStats_t* stats, float percentile) {
+  const uint64_t limit = (uint64_t)ceilf(stats->count * percentile / 100.0f);
+  uint64_t sum = 0;
+  for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+    sum += stats->histogram[i];
+    if (sum >= limit) {
+      return 2ull << i;
+    }
+  }
+  return stats->maxNs;
+}
+
+
+// Wrapped stages of the stabilizer loop ////////////////////////////////////
+
+static state_t estimatedState;
+
+void __real_sensorsAcquire(sensorData_t *sensors, const uint32_t tick);
+void __wrap_sensorsAcquire(sensorData_t *sensors, const uint32_t tick) {
+  TIMED(stageSensors, __real_sensorsAcquire(sensors, tick));
+}
+
+void __real_stateEstimator(state_t *state, const uint32_t tick);
+void __wrap_stateEstimator(state_t *state, const uint32_t tick) {
+  TIMED(stageEstimator, __real_stateEstimator(state, tick));
+  estimatedState = *state;
+}
+
+bool __real_crtpCommanderHighLevelGetSetpoint(setpoint_t* setpoint, const state_t *state, uint32_t tick);
+bool __wrap_crtpCommanderHighLevelGetSetpoint(setpoint_t* setpoint, const state_t *state, uint32_t tick) {
+  bool result;
+  TIMED(stageHighLevelCommander, result = __real_crtpCommanderHighLevelGetSetpoint(setpoint, state, tick));
+  return result;
+}
+
+void __real_commanderGetSetpoint(setpoint_t *setpoint, const state_t *state);
+void __wrap_commanderGetSetpoint(setpoint_t *setpoint, const state_t *state) {
+  TIMED(stageCommander, __real_commanderGetSetpoint(setpoint, state));
+}
+
+void __real_collisionAvoidanceUpdateSetpoint(setpoint_t *setpoint, sensorData_t const *sensorData, state_t const *state, uint32_t tick);
+void __wrap_collisionAvoidanceUpdateSetpoint(setpoint_t *setpoint, sensorData_t const *sensorData, state_t const *state, uint32_t tick) {
+  TIMED(stageCollisionAvoidance, __real_collisionAvoidanceUpdateSetpoint(setpoint, sensorData, state, tick));
+}
+
+void __real_controller(control_t *control, setpoint_t *setpoint, const sensorData_t *sensors, const state_t *state, const uint32_t tick);
+void __wrap_controller(control_t *control, setpoint_t *setpoint, const sensorData_t *sensors, const state_t *state, const uint32_t tick) {
+  TIMED(stageController, __real_controller(control, setpoint, sensors, state, tick));
+}
+
+void __real_supervisorUpdate(const sensorData_t *data);
+void __wrap_supervisorUpdate(const sensorData_t *data) {
+  TIMED(stageSupervisor, __real_supervisorUpdate(data));
+}
+
+void __real_powerDistribution(motors_thrust_t* motorPower, const control_t *control);
+void __wrap_powerDistribution(motors_thrust_t* motorPower, const control_t *control) {
+  TIMED(stagePowerDistribution, __real_powerDistribution(motorPower, control));
+}
+
+// The stabilizer initializes the default controller, use the selected one instead. This is what the
+// stabilizer.controller parameter does on the Crazyflie.
+void __real_controllerInit(ControllerType controller);
+void __wrap_controllerInit(ControllerType controller) {
+  __real_controllerInit(controller == ControllerTypeAny ? options.controller : controller);
+}
+
+
+// Scenario //////////////////////////////////////////////////////////////////
+
+#define SCENARIO_TASK_PRI 1
+
+static float target[3];
+// Estimated position at take off, the estimate is compared to the true position relative to this
+static float estimateOrigin[3];
+static bool hasEstimateOrigin = false;
+static float positionError = NAN;
+static float estimateError = NAN;
+static double sumOfSquaredEstimateErrors = 0.0;
+static uint32_t nrOfEstimateErrorSamples = 0;
+
+static float distance(const float a[3], const float b[3]) {
+  const float dx = a[0] - b[0];
+  const float dy = a[1] - b[1];
+  const float dz = a[2] - b[2];
+  return sqrtf(dx * dx + dy * dy + dz * dz);
+}
+
+static void updateEstimateError() {
+  if (!hasEstimateOrigin) {
+    return;
+  }
+
+  const sitlQuadrotor_t* quad = sitlHalGetQuadrotor();
+  const float estimate[3] = {
+    estimatedState.position.x - estimateOrigin[0],
+    estimatedState.position.y - estimateOrigin[1],
+    estimatedState.position.z - estimateOrigin[2],
+  };
+  estimateError = distance(quad->position, estimate);
+  sumOfSquaredEstimateErrors += estimateError * estimateError;
+  nrOfEstimateErrorSamples++;
+}
+
+// Wait until the given time after start, sampling the estimate error every 10 ms
+static void waitUntil(TickType_t* lastWakeTime, float time) {
+  const TickType_t end = M2T(time * 1000.0f);
+  while ((int32_t)(end - *lastWakeTime) > 0) {
+    vTaskDelayUntil(lastWakeTime, M2T(10));
+    updateEstimateError();
+  }
+}
+
+static void scenarioTask(void* param) {
+  const float takeOffTime = 2.0f;
+  const float stepTime = takeOffTime + 3.0f;
+  const float landTime = options.duration - 3.0f;
+
+  TickType_t lastWakeTime = 0;
+
+  waitUntil(&lastWakeTime, takeOffTime);
+  // Relative to the estimated position, the complementary estimator estimates the altitude above sea level
+  estimateOrigin[0] = estimatedState.position.x;
+  estimateOrigin[1] = estimatedState.position.y;
+  estimateOrigin[2] = estimatedState.position.z;
+  hasEstimateOrigin = true;
+  target[2] = options.height;
+  crtpCommanderHighLevelTakeoffWithVelocity(options.height, options.height / 2.0f, true);
+
+  waitUntil(&lastWakeTime, stepTime);
+  target[0] = options.step;
+  target[1] = options.step;
+  crtpCommanderHighLevelGoTo(options.step, options.step, 0.0f, 0.0f, 2.0f, true);
+
+  waitUntil(&lastWakeTime, landTime);
+  positionError = distance(sitlHalGetQuadrotor()->position, target);
+  crtpCommanderHighLevelLandWithVelocity(options.height, options.height / 2.0f, true);
+
+  waitUntil(&lastWakeTime, options.duration);
+  sitlSchedulerStop();
+}
+
+
+// Report ////////////////////////////////////////////////////////////////////
+
+static void printReport(double wallTime) {
+  const float simulatedTime = xTaskGetTickCount() / 1000.0f;
+  printf("Simulated %.1f s in %.3f s, %.1f times real time (%s estimator, %s controller)\n", simulatedTime, wallTime,
+    simulatedTime / wallTime, stateEstimatorGetName(), controllerGetName());
+
+  printf("\n%-16s %10s %10s %10s %10s %10s %10s %10s\n", "stage", "count", "mean[ns]", "min[ns]", "p50[ns]", "p99[ns]", "max[ns]", "total[ms]");
+  for (int i = 0; i < stageCount; i++) {
+    const timingStats_t* stats = &timingStats[i];
+    if (stats->count == 0) {
+      continue;
+    }
+    printf("%-16s %10lu %10lu %10lu %10lu %10lu %10lu %10.1f\n", stageNames[i],
+      (unsigned long)stats->count,
+      (unsigned long)(stats->totalNs / stats->count),
+      (unsigned long)stats->minNs,
+      (unsigned long)timingPercentile(stats, 50.0f),
+      (unsigned long)timingPercentile(stats, 99.0f),
+      (unsigned long)stats->maxNs,
+      stats->totalNs / 1e6);
+  }
+
+  sitlTaskStats_t tasks[32];
+  const int taskCount = sitlSchedulerGetTaskStats(tasks, 32);
+  printf("\n%-16s %4s %10s %12s %12s\n", "task", "pri", "runs", "total[ms]", "us/sim s");
+  for (int i = 0; i < taskCount && i < 32; i++) {
+    printf("%-16s %4u %10u %12.1f %12.1f\n", tasks[i].name, (unsigned)tasks[i].priority, tasks[i].runCount,
+      tasks[i].runTime_ns / 1e6, tasks[i].runTime_ns / 1e3 / simulatedTime);
+  }
+
+  if (options.verbose) {
+    for (int i = 0; i < stageCount; i++) {
+      const timingStats_t* stats = &timingStats[i];
+      if (stats->count == 0) {
+        continue;
+      }
+
+      printf("\n%s [ns]\n", stageNames[i]);
+      uint64_t maxBucket = 0;
+      for (int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+        if (stats->histogram[b] > maxBucket) {
+          maxBucket = stats->histogram[b];
+        }
+      }
+      for (int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+        if (stats->histogram[b] == 0) {
+          continue;
+        }
+        int bar = (int)(50 * stats->histogram[b] / maxBucket);
+        printf("  [%10lu, %10lu) %10lu %.*s\n", 1ul << b, 2ul << b, (unsigned long)stats->histogram[b], bar,
+          "##################################################");
+      }
+    }
+  }
+
+  const sitlQuadrotor_t* quad = sitlHalGetQuadrotor();
+  printf("\nFinal state: x=%.3f y=%.3f z=%.3f, estimate x=%.3f y=%.3f z=%.3f\n",
+    quad->position[0], quad->position[1], quad->position[2],
+    estimatedState.position.x, estimatedState.position.y, estimatedState.position.z);
+}
+
+static void usage(const char* name) {
+  fprintf(stderr, "Usage: %s [options]\n"
+    "  -t <s>    duration of the flight (default %.1f)\n"
+    "  -z <m>    take off height (default %.2f)\n"
+    "  -x <m>    size of the position step in x and y (default %.2f)\n"
+    "  -E <name> estimator, complementary or kalman (default kalman)\n"
+    "  -C <name> controller, pid, mellinger or indi (default pid)\n"
+    "  -p <Hz>   rate of the simulated motion capture positions, 0 to disable (default %u)\n"
+    "  -n <x>    scale of the sensor noise (default 1)\n"
+    "  -s <n>    seed of the sensor noise (default %u)\n"
+    "  -e <m>    fail (exit code 2) if the position error before landing is larger than this\n"
+    "  -d        print the console output of the firmware\n"
+    "  -v        print timing histograms\n",
+    name, options.duration, options.height, options.step, options.hal.positionRate, options.hal.seed);
+}
+
+static bool parseEstimator(const char* name) {
+  if (strcmp(name, "complementary") == 0) {
+    options.estimator = complementaryEstimator;
+  } else if (strcmp(name, "kalman") == 0) {
+    options.estimator = kalmanEstimator;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+static bool parseController(const char* name) {
+  if (strcmp(name, "pid") == 0) {
+    options.controller = ControllerTypePID;
+  } else if (strcmp(name, "mellinger") == 0) {
+    options.controller = ControllerTypeMellinger;
+  } else if (strcmp(name, "indi") == 0) {
+    options.controller = ControllerTypeINDI;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char* argv[]) {
+  bool printConsole = false;
+  float noiseScale = 1.0f;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "t:z:x:E:C:p:n:s:e:dvh")) != -1) {
+    switch (opt) {
+      case 't': options.duration = atof(optarg); break;
+      case 'z': options.height = atof(optarg); break;
+      case 'x': options.step = atof(optarg); break;
+      case 'E': if (!parseEstimator(optarg)) { usage(argv[0]); return 1; } break;
+      case 'C': if (!parseController(optarg)) { usage(argv[0]); return 1; } break;
+      case 'p': options.hal.positionRate = atoi(optarg); break;
+      case 'n': noiseScale = atof(optarg); break;
+      case 's': options.hal.seed = atoi(optarg); break;
+      case 'e': options.maxError = atof(optarg); break;
+      case 'd': printConsole = true; break;
+      case 'v': options.verbose = true; break;
+      default: usage(argv[0]); return 1;
+    }
+  }
+
+  if (options.duration < 10.0f || options.hal.positionRate > 1000 || (options.hal.positionRate && 1000 % options.hal.positionRate)) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  options.hal.gyroNoise *= noiseScale;
+  options.hal.accNoise *= noiseScale;
+  options.hal.baroNoise *= noiseScale;
+  options.hal.positionNoise *= noiseScale;
+
+  // Initialized in the same order as in system.c
+  sitlStubsInit(printConsole);
+  sitlHalInit(&options.hal);
+  commanderInit();
+  estimatorKalmanTaskInit();
+  stabilizerInit(options.estimator);
+  xTaskCreate(scenarioTask, "SCENARIO", configMINIMAL_STACK_SIZE, NULL, SCENARIO_TASK_PRI, NULL);
+
+  const uint64_t start = nowNs();
+  vTaskStartScheduler();
+  const double wallTime = (nowNs() - start) / 1e9;
+
+  printReport(wallTime);
+
+  printf("Position error before landing: %.4f m, estimate error: final %.4f m, rms %.4f m\n", positionError,
+    estimateError, sqrt(sumOfSquaredEstimateErrors / nrOfEstimateErrorSamples));
+
+  if (options.maxError >= 0.0f && !(positionError <= options.maxError)) {
+    printf("FAIL: position error before landing above %.4f m\n", options.maxError);
+    return 2;
+  }
+
+  return 0;
+}
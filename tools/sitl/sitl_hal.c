@@ -0,0 +1,229 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2023 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * sitl_hal.c - Simulated sensors and motors of the software in the loop simulation
+ *
+ * Implements the sensors and motors interfaces of the firmware. A simulation task, running at the priority of the
+ * sensors task, steps the quadrotor model at 1 kHz with the latest motor ratios and produces the sensor data and
+ * estimator measurements the same way as the sensors task of the Bolt/Crazyflie 2.X sensor drivers.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include "config.h"
+#include "sensors.h"
+#include "motors.h"
+#include "estimator.h"
+
+#include "sitl_hal.h"
+
+#define SENSORS_READ_RATE_HZ 1000
+#define SENSORS_READ_BARO_HZ 50
+#define SENSORS_DELAY_BARO (SENSORS_READ_RATE_HZ / SENSORS_READ_BARO_HZ)
+#define GRAVITY 9.81f
+#define RAD_TO_DEG (180.0f / (float)M_PI)
+// Altitude of the ground above sea level [m]
+#define GROUND_ASL 100.0f
+// Time to find the gyro bias on the Crazyflie, the stabilizer loop waits for the calibration [ms]
+#define CALIBRATION_TIME 1000
+
+static sitlHalConfig_t config;
+static sitlQuadrotor_t quadrotor;
+static uint16_t motorRatios[NBR_OF_MOTORS];
+
+static sensorData_t sensorData;
+static bool isBaroUpdated;
+static SemaphoreHandle_t dataReady;
+
+static uint32_t randomState;
+
+// xorshift32 with Box-Muller, the same seed always gives the same flight
+static float randomUniform(void) {
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 17;
+  randomState ^= randomState << 5;
+  return (randomState >> 8) * (1.0f / 16777216.0f);
+}
+
+static float randomNormal(float stdDev) {
+  if (stdDev == 0.0f) {
+    return 0.0f;
+  }
+  const float u1 = randomUniform() + 1e-7f;
+  const float u2 = randomUniform();
+  return stdDev * sqrtf(-2.0f * logf(u1)) * cosf(2.0f * (float)M_PI * u2);
+}
+
+static void updateSensors(uint32_t step) {
+  measurement_t measurement;
+
+  sensorData.gyro.x = quadrotor.angularVelocity[0] * RAD_TO_DEG + randomNormal(config.gyroNoise);
+  sensorData.gyro.y = quadrotor.angularVelocity[1] * RAD_TO_DEG + randomNormal(config.gyroNoise);
+  sensorData.gyro.z = quadrotor.angularVelocity[2] * RAD_TO_DEG + randomNormal(config.gyroNoise);
+  measurement.type = MeasurementTypeGyroscope;
+  measurement.data.gyroscope.gyro = sensorData.gyro;
+  estimatorEnqueue(&measurement);
+
+  sensorData.acc.x = quadrotor.specificForce[0] / GRAVITY + randomNormal(config.accNoise);
+  sensorData.acc.y = quadrotor.specificForce[1] / GRAVITY + randomNormal(config.accNoise);
+  sensorData.acc.z = quadrotor.specificForce[2] / GRAVITY + randomNormal(config.accNoise);
+  measurement.type = MeasurementTypeAcceleration;
+  measurement.data.acceleration.acc = sensorData.acc;
+  estimatorEnqueue(&measurement);
+
+  if (step % SENSORS_DELAY_BARO == 0) {
+    sensorData.baro.asl = GROUND_ASL + quadrotor.position[2] + randomNormal(config.baroNoise);
+    sensorData.baro.temperature = 25.0f;
+    sensorData.baro.pressure = 1013.25f * powf(1.0f - sensorData.baro.asl / 44330.0f, 5.255f);
+    isBaroUpdated = true;
+    measurement.type = MeasurementTypeBarometer;
+    measurement.data.barometer.baro = sensorData.baro;
+    estimatorEnqueue(&measurement);
+  }
+
+  if (config.positionRate > 0 && step % (SENSORS_READ_RATE_HZ / config.positionRate) == 0) {
+    positionMeasurement_t position;
+    for (int i = 0; i < 3; i++) {
+      position.pos[i] = quadrotor.position[i] + randomNormal(config.positionNoise);
+    }
+    position.stdDev = fmaxf(config.positionNoise, 0.001f);
+    position.source = MeasurementSourceLocationService;
+    estimatorEnqueuePosition(&position);
+  }
+}
+
+static void simulationTask(void *param) {
+  const float dt = 1.0f / SENSORS_READ_RATE_HZ;
+  TickType_t lastWakeTime = xTaskGetTickCount();
+  uint32_t step = 0;
+
+  while (1) {
+    vTaskDelayUntil(&lastWakeTime, F2T(SENSORS_READ_RATE_HZ));
+
+    sitlQuadrotorStep(&quadrotor, motorRatios, dt);
+    step++;
+
+    sensorData.interruptTimestamp = (uint64_t)xTaskGetTickCount() * 1000;
+    updateSensors(step);
+
+    xSemaphoreGive(dataReady);
+  }
+}
+
+void sitlHalInit(const sitlHalConfig_t *halConfig) {
+  config = *halConfig;
+  randomState = config.seed ? config.seed : 1;
+  sitlQuadrotorInit(&quadrotor);
+}
+
+const sitlQuadrotor_t *sitlHalGetQuadrotor(void) {
+  return &quadrotor;
+}
+
+// Sensors interface
+
+void sensorsInit(void) {
+  dataReady = xSemaphoreCreateBinary();
+  xTaskCreate(simulationTask, SENSORS_TASK_NAME, SENSORS_TASK_STACKSIZE, NULL, SENSORS_TASK_PRI, NULL);
+}
+
+bool sensorsTest(void) {
+  return true;
+}
+
+bool sensorsAreCalibrated(void) {
+  return xTaskGetTickCount() >= M2T(CALIBRATION_TIME);
+}
+
+bool sensorsManufacturingTest(void) {
+  return true;
+}
+
+void sensorsAcquire(sensorData_t *sensors, const uint32_t tick) {
+  sensorsReadGyro(&sensors->gyro);
+  sensorsReadAcc(&sensors->acc);
+  sensorsReadBaro(&sensors->baro);
+  sensors->interruptTimestamp = sensorData.interruptTimestamp;
+}
+
+void sensorsWaitDataReady(void) {
+  xSemaphoreTake(dataReady, portMAX_DELAY);
+}
+
+bool sensorsReadGyro(Axis3f *gyro) {
+  *gyro = sensorData.gyro;
+  return true;
+}
+
+bool sensorsReadAcc(Axis3f *acc) {
+  *acc = sensorData.acc;
+  return true;
+}
+
+bool sensorsReadMag(Axis3f *mag) {
+  return false;
+}
+
+bool sensorsReadBaro(baro_t *baro) {
+  const bool isUpdated = isBaroUpdated;
+  *baro = sensorData.baro;
+  isBaroUpdated = false;
+  return isUpdated;
+}
+
+void sensorsSuspend() {
+}
+
+void sensorsResume() {
+}
+
+void sensorsSetAccMode(accModes accMode) {
+}
+
+// Motors interface
+
+void motorsInit(const MotorPerifDef **motorMapSelect) {
+}
+
+bool motorsTest(void) {
+  return true;
+}
+
+void motorsStop() {
+  memset(motorRatios, 0, sizeof(motorRatios));
+}
+
+void motorsSetRatio(uint32_t id, uint16_t ratio) {
+  if (id < NBR_OF_MOTORS) {
+    motorRatios[id] = ratio;
+  }
+}
+
+int motorsGetRatio(uint32_t id) {
+  return id < NBR_OF_MOTORS ? motorRatios[id] : 0;
+}
@@ -0,0 +1,51 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2023 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * sitl_hal.h - Simulated sensors and motors of the software in the loop simulation
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include "sitl_quadrotor.h"
+
+typedef struct {
+  // Standard deviation of the sensor noise
+  float gyroNoise;      // deg/s
+  float accNoise;       // Gs
+  float baroNoise;      // m
+  float positionNoise;  // m
+  // Rate of the position measurements from a simulated motion capture system, 0 to disable [Hz]
+  uint32_t positionRate;
+  uint32_t seed;
+} sitlHalConfig_t;
+
+/**
+ * @brief Configure the simulated hardware, must be called before the scheduler is started
+ */
+void sitlHalInit(const sitlHalConfig_t *config);
+
+/**
+ * @brief The simulated quadrotor, updated by the simulation task at 1 kHz
+ */
+const sitlQuadrotor_t *sitlHalGetQuadrotor(void);
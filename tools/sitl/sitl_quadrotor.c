@@ -0,0 +1,146 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2023 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * sitl_quadrotor.c - Rigid body model of a Crazyflie 2.X for the software in the loop simulation
+ *
+ * The motors are in X configuration, M1 front right, M2 back right, M3 back left and M4 front left, where M1 and M3
+ * turn counter clockwise. The thrust of the motors follows the PWM to thrust curve in docs/functional-areas/pwm-to-thrust.md
+ * and reacts with a first order lag.
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "sitl_quadrotor.h"
+
+#define GRAVITY 9.81f
+#define MASS 0.027f
+// Distance from the center to a motor along the x and y axis [m]
+#define ARM 0.0325f
+// Inertia [kg m^2]
+static const float inertia[3] = {1.657e-5f, 1.666e-5f, 2.926e-5f};
+// Yaw torque per thrust [m]
+#define TORQUE_COEFFICIENT 0.005964f
+#define MOTOR_TIME_CONSTANT 0.02f
+#define LINEAR_DRAG 0.01f
+
+static const float motorX[4] = {ARM, -ARM, -ARM, ARM};
+static const float motorY[4] = {-ARM, -ARM, ARM, ARM};
+static const float motorSpin[4] = {-1.0f, 1.0f, -1.0f, 1.0f};
+
+static float ratioToThrust(uint16_t ratio) {
+  if (ratio == 0) {
+    return 0.0f;
+  }
+  const float pwm = ratio;
+  return 2.130295e-11f * pwm * pwm + 1.032633e-6f * pwm + 5.484560e-4f;
+}
+
+// v_world = R * v_body
+static void rotate(const float q[4], const float v[3], float out[3]) {
+  const float w = q[0], x = q[1], y = q[2], z = q[3];
+  out[0] = (1 - 2 * (y * y + z * z)) * v[0] + 2 * (x * y - w * z) * v[1] + 2 * (x * z + w * y) * v[2];
+  out[1] = 2 * (x * y + w * z) * v[0] + (1 - 2 * (x * x + z * z)) * v[1] + 2 * (y * z - w * x) * v[2];
+  out[2] = 2 * (x * z - w * y) * v[0] + 2 * (y * z + w * x) * v[1] + (1 - 2 * (x * x + y * y)) * v[2];
+}
+
+// v_body = R^T * v_world
+static void rotateInverse(const float q[4], const float v[3], float out[3]) {
+  const float conjugate[4] = {q[0], -q[1], -q[2], -q[3]};
+  rotate(conjugate, v, out);
+}
+
+void sitlQuadrotorInit(sitlQuadrotor_t *quad) {
+  memset(quad, 0, sizeof(*quad));
+  quad->quaternion[0] = 1.0f;
+  quad->specificForce[2] = GRAVITY;
+}
+
+void sitlQuadrotorStep(sitlQuadrotor_t *quad, const uint16_t motorRatio[4], float dt) {
+  float thrust = 0.0f;
+  float torque[3] = {0.0f, 0.0f, 0.0f};
+  for (int i = 0; i < 4; i++) {
+    quad->motorThrust[i] += (ratioToThrust(motorRatio[i]) - quad->motorThrust[i]) * dt / MOTOR_TIME_CONSTANT;
+    const float f = quad->motorThrust[i];
+    thrust += f;
+    torque[0] += motorY[i] * f;
+    torque[1] -= motorX[i] * f;
+    torque[2] += motorSpin[i] * TORQUE_COEFFICIENT * f;
+  }
+
+  // Translation
+  const float thrustBody[3] = {0.0f, 0.0f, thrust / MASS};
+  float thrustWorld[3];
+  rotate(quad->quaternion, thrustBody, thrustWorld);
+
+  float acc[3];
+  for (int i = 0; i < 3; i++) {
+    acc[i] = thrustWorld[i] - LINEAR_DRAG / MASS * quad->velocity[i];
+  }
+  acc[2] -= GRAVITY;
+
+  // Rotation, Euler's equations
+  const float *w = quad->angularVelocity;
+  float angularAcc[3];
+  angularAcc[0] = (torque[0] - (inertia[2] - inertia[1]) * w[1] * w[2]) / inertia[0];
+  angularAcc[1] = (torque[1] - (inertia[0] - inertia[2]) * w[2] * w[0]) / inertia[1];
+  angularAcc[2] = (torque[2] - (inertia[1] - inertia[0]) * w[0] * w[1]) / inertia[2];
+
+  const bool isOnGround = quad->position[2] <= 0.0f && acc[2] <= 0.0f;
+  if (isOnGround) {
+    // The ground holds the quadrotor still, until the thrust lifts it
+    memset(quad->velocity, 0, sizeof(quad->velocity));
+    memset(quad->angularVelocity, 0, sizeof(quad->angularVelocity));
+    memset(acc, 0, sizeof(acc));
+    quad->position[2] = 0.0f;
+  } else {
+    for (int i = 0; i < 3; i++) {
+      quad->velocity[i] += acc[i] * dt;
+      quad->position[i] += quad->velocity[i] * dt;
+      quad->angularVelocity[i] += angularAcc[i] * dt;
+    }
+  }
+
+  // q' = q * [0, w] / 2
+  float *q = quad->quaternion;
+  const float dq[4] = {
+    0.5f * (-q[1] * w[0] - q[2] * w[1] - q[3] * w[2]),
+    0.5f * (q[0] * w[0] + q[2] * w[2] - q[3] * w[1]),
+    0.5f * (q[0] * w[1] - q[1] * w[2] + q[3] * w[0]),
+    0.5f * (q[0] * w[2] + q[1] * w[1] - q[2] * w[0]),
+  };
+  float norm = 0.0f;
+  for (int i = 0; i < 4; i++) {
+    q[i] += dq[i] * dt;
+    norm += q[i] * q[i];
+  }
+  norm = sqrtf(norm);
+  for (int i = 0; i < 4; i++) {
+    q[i] /= norm;
+  }
+
+  // The accelerometer measures all forces except gravity
+  const float specificForceWorld[3] = {acc[0], acc[1], acc[2] + GRAVITY};
+  rotateInverse(q, specificForceWorld, quad->specificForce);
+}
@@ -0,0 +1,56 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2023 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * sitl_quadrotor.h - Rigid body model of a Crazyflie 2.X for the software in the loop simulation
+ */
+#pragma once
+
+#include <stdint.h>
+
+typedef struct {
+  // World frame, z up [m] and [m/s]
+  float position[3];
+  float velocity[3];
+  // Body to world rotation, w x y z
+  float quaternion[4];
+  // Body frame [rad/s]
+  float angularVelocity[3];
+  // Specific force in the body frame, what an accelerometer measures [m/s^2]
+  float specificForce[3];
+  // Thrust of the motors [N]
+  float motorThrust[4];
+} sitlQuadrotor_t;
+
+/**
+ * @brief Initialize the model, standing still on the ground at the origin
+ */
+void sitlQuadrotorInit(sitlQuadrotor_t *quad);
+
+/**
+ * @brief Advance the model one time step
+ *
+ * @param quad the model
+ * @param motorRatio PWM ratio of the motors M1 to M4, as set by the firmware
+ * @param dt time step [s]
+ */
+void sitlQuadrotorStep(sitlQuadrotor_t *quad, const uint16_t motorRatio[4], float dt);
@@ -0,0 +1,142 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2023 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * sitl_stubs.c - Host implementations of the firmware modules outside of the software in the loop simulation
+ *
+ * The system is always started and armed, the radio link and the memory subsystem are not available and the health
+ * tests are never requested. Time stamps follow the simulated clock.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+#include "config.h"
+#include "cfassert.h"
+#include "console.h"
+#include "crtp.h"
+#include "crtp_commander.h"
+#include "eventtrigger.h"
+#include "health.h"
+#include "mem.h"
+#include "motors.h"
+#include "platform.h"
+#include "pm.h"
+#include "system.h"
+#include "usddeck.h"
+#include "usec_time.h"
+
+#include "sitl_stubs.h"
+
+SCB_Type sitlScb;
+
+static bool isConsolePrinted;
+static xQueueHandle noPackets;
+
+void sitlStubsInit(bool printConsole) {
+  isConsolePrinted = printConsole;
+  noPackets = xQueueCreate(1, sizeof(CRTPPacket));
+}
+
+// System
+
+void systemWaitStart(void) {
+}
+
+bool systemIsArmed() {
+  return true;
+}
+
+bool pmIsChargerConnected(void) {
+  return false;
+}
+
+const MotorPerifDef** platformConfigGetMotorMapping() {
+  return 0;
+}
+
+bool healthShallWeRunTest(void) {
+  return false;
+}
+
+void healthRunTests(sensorData_t *sensors) {
+}
+
+// 1 tick is 1 ms
+uint64_t usecTimestamp(void) {
+  return (uint64_t)xTaskGetTickCount() * 1000;
+}
+
+void assertFail(char *exp, char *file, int line) {
+  fprintf(stderr, "Assert failed %s:%d (%s) at tick %u\n", file, line, exp, (unsigned)xTaskGetTickCount());
+  abort();
+}
+
+int consolePutchar(int ch) {
+  if (isConsolePrinted) {
+    putchar(ch);
+  }
+  return (unsigned char)ch;
+}
+
+void eventTrigger(const eventtrigger *event) {
+}
+
+// Communication, no packets are ever received
+
+void crtpInitTaskQueue(CRTPPort taskId) {
+}
+
+int crtpReceivePacketBlock(CRTPPort taskId, CRTPPacket *p) {
+  return xQueueReceive(noPackets, p, portMAX_DELAY);
+}
+
+int crtpSendPacketBlock(CRTPPacket *p) {
+  return pdTRUE;
+}
+
+void crtpCommanderInit(void) {
+}
+
+void memoryRegisterHandler(const MemoryHandlerDef_t* handlerDef) {
+}
+
+// Decks
+
+bool usddeckLoggingEnabled(void) {
+  return false;
+}
+
+enum usddeckLoggingMode_e usddeckLoggingMode(void) {
+  return usddeckLoggingMode_SynchronousStabilizer;
+}
+
+int usddeckFrequency(void) {
+  return 0;
+}
+
+void usddeckTriggerLogging(void) {
+}
@@ -0,0 +1,114 @@
+# -*- coding: utf-8 -*-
+"""
+Benchmark of the uSD log decoder on a synthetic log
+
+Writes a log with a fixed frequency event at 1 kHz and a number of float
+variables, and measures the time and peak memory used to decode it with
+decode() and iter_decode(), keeping the logged float32 types.
+
+    python3 benchmark_decode.py --size 1024 --version 3 /tmp/synthetic.bin
+"""
+import argparse
+import resource
+import struct
+import time
+from zlib import crc32
+import numpy as np
+
+import cfusdlog
+
+RECORDS_PER_BLOCK = 64
+RECORD_PERIOD_US = 1000
+
+def _header(version, num_variables):
+    header = struct.pack('<BHH', 0xBC, version, 1)
+    header += struct.pack('<H', 0xFFFF) + b'fixedFrequency\0' + struct.pack('<H', num_variables)
+    for i in range(num_variables):
+        header += 'var.v{}(f)\0'.format(i).encode()
+    return header
+
+def _write_v2(f, size, num_variables, crc):
+    dtype = np.dtype([('event_id', '<u2'), ('timestamp', '<u8'), ('values', '<f4', (num_variables,))])
+    records_per_write = 1 << 16
+    num_records = size // dtype.itemsize
+    rng = np.random.default_rng(1)
+    for first in range(0, num_records, records_per_write):
+        records = np.zeros(min(records_per_write, num_records - first), dtype=dtype)
+        records['event_id'] = 0xFFFF
+        records['timestamp'] = (first + np.arange(len(records), dtype=np.uint64)) * RECORD_PERIOD_US
+        records['values'] = rng.standard_normal(records['values'].shape)
+        data = records.tobytes()
+        f.write(data)
+        crc = crc32(data, crc)
+    return crc, num_records
+
+def _write_v3(f, size, num_variables, crc):
+    # Event index 0 and a timestamp delta of 1000 us, zigzag encoded as 2000
+    record_header = np.array([0, 0xD0, 0x0F], dtype=np.uint8)
+    record_size = len(record_header) + 4 * num_variables
+    payload_length = RECORDS_PER_BLOCK * record_size
+    block_size = cfusdlog.BLOCK_HEADER.size + payload_length + cfusdlog.BLOCK_CRC_SIZE
+    num_blocks = size // block_size
+
+    rng = np.random.default_rng(1)
+    records = np.zeros((RECORDS_PER_BLOCK, record_size), dtype=np.uint8)
+    records[:, :len(record_header)] = record_header
+    records[:, len(record_header):] = rng.standard_normal((RECORDS_PER_BLOCK, num_variables)).astype('<f4').view(np.uint8)
+    # The first record of a block has no delta
+    records[0, 1:3] = [0, 0]
+    payload = records.tobytes()
+    # Account for the zero delta being one byte shorter
+    payload = payload[:1] + payload[2:]
+    payload_length -= 1
+
+    for block in range(num_blocks):
+        base_timestamp = block * RECORDS_PER_BLOCK * RECORD_PERIOD_US
+        data = cfusdlog.BLOCK_HEADER.pack(cfusdlog.BLOCK_MARKER, RECORDS_PER_BLOCK, payload_length, base_timestamp) + payload
+        data += struct.pack('<I', crc32(data))
+        f.write(data)
+        crc = crc32(data, crc)
+    return crc, num_blocks * RECORDS_PER_BLOCK
+
+def write_log(filename, version, size, num_variables):
+    """Writes a synthetic log of about size bytes, returns the number of records"""
+    with open(filename, 'wb') as f:
+        header = _header(version, num_variables)
+        f.write(header)
+        crc = crc32(header)
+        if version == 2:
+            crc, num_records = _write_v2(f, size, num_variables, crc)
+        else:
+            crc, num_records = _write_v3(f, size, num_variables, crc)
+        f.write(struct.pack('<I', crc))
+    return num_records
+
+def _peak_memory_mb():
+    return resource.getrusage(resource.RUSAGE_SELF).ru_maxrss / 1024
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser()
+    parser.add_argument("filename", help="synthetic log file to write")
+    parser.add_argument("--size", type=int, default=1024, help="size of the log [MB]")
+    parser.add_argument("--version", type=int, default=3, choices=[2, 3], help="log format version")
+    parser.add_argument("--variables", type=int, default=20, help="number of variables")
+    parser.add_argument("--iter-only", action="store_true", help="only benchmark iter_decode()")
+    args = parser.parse_args()
+
+    start = time.time()
+    num_records = write_log(args.filename, args.version, args.size * 1024 * 1024, args.variables)
+    print("Wrote {} records in {:.1f} s".format(num_records, time.time() - start))
+
+    start = time.time()
+    decoded = 0
+    for chunk in cfusdlog.iter_decode(args.filename, native_types=True):
+        decoded += len(chunk['fixedFrequency']['timestamp'])
+    duration = time.time() - start
+    print("iter_decode: {} records in {:.1f} s ({:.2f} us per record), peak memory {:.0f} MB".format(
+        decoded, duration, 1e6 * duration / decoded, _peak_memory_mb()))
+
+    if not args.iter_only:
+        start = time.time()
+        data = cfusdlog.decode(args.filename, native_types=True)
+        duration = time.time() - start
+        print("decode: {} records in {:.1f} s ({:.2f} us per record), peak memory {:.0f} MB".format(
+            len(data['fixedFrequency']['timestamp']), duration, 1e6 * duration / decoded, _peak_memory_mb()))
@@ -1,102 +1,326 @@
 # -*- coding: utf-8 -*-
 """
 Helper to decode binary logged sensor data from crazyflie2 with uSD-Card-Deck
+
+The file is memory mapped and decoded in chunks. For each chunk the records
+are indexed in one pass, after which all records of an event type are decoded
+at once with numpy. decode() returns the complete log, iter_decode() yields
+one chunk at the time for logs that do not fit in memory.
+
+By default the values are returned as float64 and int64 arrays, as by earlier
+versions of the decoder. Pass native_types=True to keep the logged types (e.g.
+float32), which halves the memory used for most logs.
 """
 import argparse
+import mmap
 from zlib import crc32
 import struct
 import numpy as np
 
+# Version 3 block framing, see usddeck_encoder.h
+BLOCK_MARKER = 0xB3
+BLOCK_HEADER = struct.Struct('<BHHQ')
+BLOCK_CRC_SIZE = 4
+
+FILE_CRC_SIZE = 4
+
+# Amount of the file that is decoded at the time
+DEFAULT_CHUNK_SIZE = 64 * 1024 * 1024
+
 # extract null-terminated string
 def _get_name(data, idx):
-    endIdx = idx
-    while data[endIdx] != 0:
-        endIdx = endIdx + 1
+    endIdx = data.find(b'\0', idx)
     return data[idx:endIdx].decode("utf-8"), endIdx + 1
 
-def decode(filename):
-    # read file as binary
-    with open(filename, 'rb') as f:
-        data = f.read()
+def _read_varint(data, idx):
+    b = data[idx]
+    idx += 1
+    value = b & 0x7f
+    shift = 7
+    while b & 0x80:
+        b = data[idx]
+        idx += 1
+        value |= (b & 0x7f) << shift
+        shift += 7
+    return value, idx
 
-    # check magic header
-    if data[0] != 0xBC:
-        print("Unsupported format!")
-        return
+def _unzigzag(value):
+    return (value >> 1) ^ -(value & 1)
 
-    # check CRC
-    crc = crc32(data[0:-4])
-    expected_crc, = struct.unpack('I', data[-4:])
-    if crc != expected_crc:
-        print("WARNING: CRC does not match!")
+def _widened_type(dtype):
+    """The type of the values returned when native types are not requested"""
+    if dtype.kind == 'f':
+        return np.float64
+    if dtype == np.uint64:
+        return np.uint64
+    return np.int64
 
-    # check version
-    version, num_event_types = struct.unpack('HH', data[1:5])
-    if version != 1 and version != 2:
-        print("Unsupported version!", version)
-        return
+def _gather(buffer, offsets, dtype):
+    """Decodes the fields of dtype at each offset in buffer"""
+    if dtype.itemsize == 0:
+        return np.zeros(len(offsets), dtype=dtype)
+    # one row of dtype.itemsize bytes starting at each byte of the buffer
+    rows = np.lib.stride_tricks.as_strided(buffer, shape=(len(buffer) - dtype.itemsize + 1, dtype.itemsize),
+                                           strides=(1, 1), writeable=False)
+    raw = rows[np.asarray(offsets, dtype=np.int64)]
+    return raw.view(dtype).reshape(-1)
+
+
+class EventType:
+    def __init__(self, event_id, name, variables, version):
+        self.id = event_id
+        self.name = name
+        # list of (name, struct type character)
+        self.variables = [(var_name, var_type) for var_name, var_type, _ in variables]
+        self.delta_variables = [var_name for var_name, _, is_delta in variables if is_delta]
 
-    result = dict()
-    event_by_id = dict()
-
-    # read header with data types
-    idx = 5
-    for _ in range(num_event_types):
-        event_id, = struct.unpack('H', data[idx:idx+2])
-        idx += 2
-        event_name, idx = _get_name(data, idx)
-        result[event_name] = dict()
-        result[event_name]["timestamp"] = []
-        num_variables, = struct.unpack('H', data[idx:idx+2])
-        idx += 2
-        fmtStr = "<"
-        variables = []
-        for _ in range(num_variables):
-            var_name_and_type, idx = _get_name(data, idx)
-            var_name = var_name_and_type[0:-3]
-            var_type = var_name_and_type[-2]
-            result[event_name][var_name] = []
-            fmtStr += var_type
-            variables.append(var_name)
-        event_by_id[event_id] = {
-            'name': event_name,
-            'fmtStr': fmtStr,
-            'numBytes': struct.calcsize(fmtStr),
-            'variables': variables,
-            }
-
-    while idx < len(data) - 4:
+        raw = [(var_name, '<' + var_type) for var_name, var_type, is_delta in variables if not is_delta]
         if version == 1:
-            event_id, timestamp, = struct.unpack('<HI', data[idx:idx+6])
-            idx += 6
+            raw = [('event_id', '<u2'), ('timestamp', '<u4')] + raw
         elif version == 2:
-            event_id, timestamp, = struct.unpack('<HQ', data[idx:idx+10])
-            timestamp = timestamp / 1000.0
-            idx += 10
-        event = event_by_id[event_id]
-        fmtStr = event['fmtStr']
-        eventData = struct.unpack(fmtStr, data[idx:idx+event['numBytes']])
-        idx += event['numBytes']
-        for v,d in zip(event['variables'], eventData):
-            result[event['name']][v].append(d)
-        result[event['name']]["timestamp"].append(timestamp)
-
-    # remove keys that had no data
-    for event_name in list(result.keys()):
-        if len(result[event_name]['timestamp']) == 0:
-            del result[event_name]
-
-    # convert to numpy arrays
-    for event_name in result.keys():
-        for var_name in result[event_name]:
-            result[event_name][var_name] = np.array(result[event_name][var_name])
-
-    return result
+            raw = [('event_id', '<u2'), ('timestamp', '<u8')] + raw
+        # Records in version 1 and 2, the raw part of records in version 3
+        self.dtype = np.dtype(raw)
+
+    def to_dict(self, timestamps, raw, deltas=None, native_types=False):
+        result = dict()
+        result['timestamp'] = timestamps if native_types else timestamps.astype(_widened_type(timestamps.dtype))
+        for var_name, var_type in self.variables:
+            dtype = np.dtype('<' + var_type)
+            if not native_types:
+                dtype = _widened_type(dtype)
+            if var_name in self.delta_variables:
+                i = self.delta_variables.index(var_name)
+                result[var_name] = np.asarray(deltas[i], dtype=np.int64).astype(dtype)
+            else:
+                result[var_name] = np.ascontiguousarray(raw[var_name], dtype=dtype)
+        return result
+
+
+class UsdLog:
+    """A memory mapped uSD log file"""
+
+    def __init__(self, filename):
+        self._file = open(filename, 'rb')
+        self.data = mmap.mmap(self._file.fileno(), 0, access=mmap.ACCESS_READ)
+        self.buffer = np.frombuffer(self.data, dtype=np.uint8)
+        self.end = len(self.data) - FILE_CRC_SIZE
+
+        # check magic header
+        if self.data[0] != 0xBC:
+            raise ValueError("Unsupported format!")
+
+        # check version
+        self.version, num_event_types = struct.unpack_from('<HH', self.data, 1)
+        if self.version not in (1, 2, 3):
+            raise ValueError("Unsupported version! {}".format(self.version))
+
+        # read header with data types
+        self.events = []
+        idx = 5
+        for _ in range(num_event_types):
+            event_id, = struct.unpack_from('<H', self.data, idx)
+            idx += 2
+            event_name, idx = _get_name(self.data, idx)
+            num_variables, = struct.unpack_from('<H', self.data, idx)
+            idx += 2
+            variables = []
+            for _ in range(num_variables):
+                # "name(t)", or "name(t,delta)" if delta encoded
+                var_name_and_type, idx = _get_name(self.data, idx)
+                var_name, var_type = var_name_and_type[0:-1].rsplit('(', 1)
+                variables.append((var_name, var_type[0], var_type.endswith(',delta')))
+            self.events.append(EventType(event_id, event_name, variables, self.version))
+
+        self.first_record = idx
+        self._released = 0
+
+    def close(self):
+        del self.buffer
+        self.data.close()
+        self._file.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+    def check_crc(self, chunk_size=DEFAULT_CHUNK_SIZE):
+        crc = 0
+        for idx in range(0, self.end, chunk_size):
+            crc = crc32(self.data[idx:min(idx + chunk_size, self.end)], crc)
+        expected_crc, = struct.unpack_from('<I', self.data, self.end)
+        return crc == expected_crc
+
+    def chunks(self, chunk_size=DEFAULT_CHUNK_SIZE, native_types=False):
+        """Yields the decoded records of about chunk_size bytes of the file at the
+        time, as a dictionary of event names with a dictionary of variables.
+        The values keep their logged types if native_types is set."""
+        if self.version == 3:
+            yield from self._chunks_v3(chunk_size, native_types)
+        else:
+            yield from self._chunks_v12(chunk_size, native_types)
+
+    def _release(self, end):
+        """Drops the mapped pages of the file before end, they are not read
+        again once a chunk has been decoded"""
+        end -= end % mmap.PAGESIZE
+        if end > self._released and hasattr(mmap, 'MADV_DONTNEED'):
+            self.data.madvise(mmap.MADV_DONTNEED, self._released, end - self._released)
+            self._released = end
+
+    def _result(self, decoded, native_types):
+        result = dict()
+        for event, (timestamps, raw, deltas) in zip(self.events, decoded):
+            if len(timestamps) > 0:
+                result[event.name] = event.to_dict(timestamps, raw, deltas, native_types)
+        return result
+
+    # Version 1 and 2, records with a fixed size per event type
+
+    def _chunks_v12(self, chunk_size, native_types):
+        index_by_id = {event.id: i for i, event in enumerate(self.events)}
+        sizes = {event.id: event.dtype.itemsize for event in self.events}
+        data = self.data
+        end = self.end
+        idx = self.first_record
+
+        while idx < end:
+            chunk_end = min(idx + chunk_size, end)
+            offsets = {event.id: [] for event in self.events}
+            while idx < chunk_end:
+                event_id = data[idx] | (data[idx + 1] << 8)
+                size = sizes.get(event_id)
+                if size is None or idx + size > end:
+                    print("WARNING: invalid record at offset", idx)
+                    idx = end
+                    break
+                offsets[event_id].append(idx)
+                idx += size
+
+            decoded = [None] * len(self.events)
+            for event_id, event_offsets in offsets.items():
+                event = self.events[index_by_id[event_id]]
+                raw = _gather(self.buffer, event_offsets, event.dtype)
+                if self.version == 1:
+                    timestamps = raw['timestamp']
+                else:
+                    timestamps = raw['timestamp'] / 1000.0
+                decoded[index_by_id[event_id]] = (timestamps, raw, None)
+            yield self._result(decoded, native_types)
+            self._release(idx)
+
+    # Version 3, blocks of records with varints
+
+    def _blocks(self):
+        """Yields (start, end, base timestamp) of the records of each block with
+        a valid CRC. Corrupt blocks are skipped by searching for the next marker
+        that starts a valid block."""
+        data = self.data
+        idx = self.first_record
+        in_sync = True
+        while idx + BLOCK_HEADER.size + BLOCK_CRC_SIZE <= self.end:
+            marker, _, length, base_timestamp = BLOCK_HEADER.unpack_from(data, idx)
+            block_end = idx + BLOCK_HEADER.size + length
+            if marker == BLOCK_MARKER and block_end + BLOCK_CRC_SIZE <= self.end:
+                expected_crc, = struct.unpack_from('<I', data, block_end)
+                if crc32(data[idx:block_end]) == expected_crc:
+                    yield idx + BLOCK_HEADER.size, block_end, base_timestamp
+                    idx = block_end + BLOCK_CRC_SIZE
+                    in_sync = True
+                    continue
+            if in_sync:
+                print("WARNING: corrupt block at offset", idx)
+                in_sync = False
+            idx = data.find(bytes([BLOCK_MARKER]), idx + 1, self.end)
+            if idx < 0:
+                break
+
+    def _chunks_v3(self, chunk_size, native_types):
+        data = self.data
+        raw_sizes = [event.dtype.itemsize for event in self.events]
+        num_deltas = [len(event.delta_variables) for event in self.events]
+
+        def new_chunk():
+            return ([[] for _ in self.events], [[] for _ in self.events],
+                    [[[] for _ in event.delta_variables] for event in self.events])
+
+        offsets, timestamps, deltas = new_chunk()
+        chunk_length = 0
+        for start, block_end, timestamp in self._blocks():
+            previous = [[0] * n for n in num_deltas]
+            idx = start
+            while idx < block_end:
+                event_index = data[idx]
+                value, idx = _read_varint(data, idx + 1)
+                timestamp += _unzigzag(value)
+                offsets[event_index].append(idx)
+                timestamps[event_index].append(timestamp)
+                idx += raw_sizes[event_index]
+                if num_deltas[event_index]:
+                    values = previous[event_index]
+                    for i, event_deltas in enumerate(deltas[event_index]):
+                        value, idx = _read_varint(data, idx)
+                        values[i] += _unzigzag(value)
+                        event_deltas.append(values[i])
+
+            chunk_length += block_end - start
+            if chunk_length >= chunk_size:
+                yield self._decode_v3(offsets, timestamps, deltas, native_types)
+                self._release(block_end)
+                offsets, timestamps, deltas = new_chunk()
+                chunk_length = 0
+
+        if chunk_length > 0:
+            yield self._decode_v3(offsets, timestamps, deltas, native_types)
+
+    def _decode_v3(self, offsets, timestamps, deltas, native_types):
+        decoded = []
+        for event, event_offsets, event_timestamps, event_deltas in zip(self.events, offsets, timestamps, deltas):
+            raw = _gather(self.buffer, event_offsets, event.dtype)
+            decoded.append((np.array(event_timestamps, dtype=np.uint64) / 1000.0, raw, event_deltas))
+        return self._result(decoded, native_types)
+
+
+def iter_decode(filename, chunk_size=DEFAULT_CHUNK_SIZE, native_types=False):
+    """Decodes a log a chunk at the time, for logs that do not fit in memory.
+    Yields a dictionary of event names with a dictionary of variables for
+    each chunk, events without records in a chunk are left out."""
+    with UsdLog(filename) as log:
+        yield from log.chunks(chunk_size, native_types)
+
+def decode(filename, chunk_size=DEFAULT_CHUNK_SIZE, native_types=False):
+    try:
+        log = UsdLog(filename)
+    except ValueError as e:
+        print(e)
+        return
+
+    with log:
+        if not log.check_crc():
+            print("WARNING: CRC does not match!")
+
+        chunks = dict()
+        for chunk in log.chunks(chunk_size, native_types):
+            for event_name, variables in chunk.items():
+                event_chunks = chunks.setdefault(event_name, dict())
+                for var_name, values in variables.items():
+                    event_chunks.setdefault(var_name, []).append(values)
+
+        # keep the order of the events in the header
+        result = dict()
+        for event in log.events:
+            if event.name in chunks:
+                result[event.name] = {var_name: np.concatenate(values)
+                                      for var_name, values in chunks[event.name].items()}
+        return result
 
 
 if __name__ == "__main__":
     parser = argparse.ArgumentParser()
     parser.add_argument("filename")
+    parser.add_argument("--native-types", action="store_true", help="keep the logged types of the values")
     args = parser.parse_args()
-    data = decode(args.filename)
+    data = decode(args.filename, native_types=args.native_types)
     print(data)